@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// blockq
+//
+// lock-free single-producer/single-consumer queue of pooled sample
+// blocks; all blocks are allocated once when the queue is created
+//
+
+#ifndef __BLOCKQ_H__
+#define __BLOCKQ_H__
+
+#include <complex>
+
+// sample block
+struct blockq_block_s {
+    std::complex<float> * x;    // sample buffer [size: capacity x 1]
+    unsigned int capacity;      // allocated number of samples
+    unsigned int n;             // number of valid samples
+    double timestamp;           // time of first sample [seconds]
+};
+
+//
+// blockq object interface declarations
+//
+
+typedef struct blockq_s * blockq;
+
+// create blockq object
+//  _num_blocks :   number of blocks in pool (queue capacity)
+//  _block_len  :   number of samples in each block
+blockq blockq_create(unsigned int _num_blocks,
+                     unsigned int _block_len);
+
+// destroy blockq object
+void blockq_destroy(blockq _q);
+
+// print blockq object internals and counters
+void blockq_print(blockq _q);
+
+// reset queue (empty) and counters; not thread-safe
+void blockq_reset(blockq _q);
+
+//
+// producer
+//
+
+// get next free block to write into, or NULL if the queue is full (in
+// which case the overflow counter is incremented)
+struct blockq_block_s * blockq_write_acquire(blockq _q);
+
+// publish block previously obtained with blockq_write_acquire()
+void blockq_write_commit(blockq _q);
+
+//
+// consumer
+//
+
+// get oldest published block, or NULL if the queue is empty
+struct blockq_block_s * blockq_read_acquire(blockq _q);
+
+// return block previously obtained with blockq_read_acquire() to pool
+void blockq_read_release(blockq _q);
+
+//
+// counters
+//
+
+// number of blocks in pool
+unsigned int blockq_get_capacity(blockq _q);
+
+// number of published blocks waiting to be consumed
+unsigned int blockq_get_occupancy(blockq _q);
+
+// maximum occupancy observed since reset
+unsigned int blockq_get_high_water_mark(blockq _q);
+
+// number of times the producer found the queue full
+unsigned long int blockq_get_num_overflows(blockq _q);
+
+#endif // __BLOCKQ_H__
+
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// framelog
+//
+// binary per-frame statistics log: receiver callbacks push fixed-size
+// records into a lock-free ring, which a background thread drains to an
+// append-only file.  The file is a header followed by records, both in
+// host byte order:
+//
+//  header  :   magic "FLOG", version, record size, baseband rate [Hz]
+//  record  :   struct framelog_record_s
+//
+// Records are pushed from a single thread (the synchronizer's).
+//
+
+#ifndef __FRAMELOG_H__
+#define __FRAMELOG_H__
+
+#include <stdint.h>
+#include <liquid/liquid.h>
+
+#define FRAMELOG_VERSION        (1)
+
+// record flags
+#define FRAMELOG_HEADER_VALID   (0x01)
+#define FRAMELOG_PAYLOAD_VALID  (0x02)
+
+// file header
+struct framelog_header_s {
+    char magic[4];                  // "FLOG"
+    uint32_t version;               // FRAMELOG_VERSION
+    uint32_t record_size;           // sizeof(struct framelog_record_s)
+    uint32_t reserved;
+    double rate;                    // baseband sample rate [Hz]
+};
+
+// frame record (32 bytes)
+struct framelog_record_s {
+    double timestamp;               // time of frame (sample clock) [s]
+    uint16_t packet_id;             // header bytes 0,1 (if header valid)
+    uint8_t flags;                  // FRAMELOG_HEADER_VALID, _PAYLOAD_VALID
+    uint8_t reserved;
+    uint32_t payload_len;           // payload length [bytes]
+    float evm;                      // error vector magnitude [dB]
+    float rssi;                     // received signal strength [dB]
+    float cfo;                      // carrier offset [radians/sample]
+    uint32_t reserved2;
+};
+
+//
+// writer
+//
+
+typedef struct framelog_s * framelog;
+
+// create frame log, appending to _filename if it is already a frame log
+// of the same rate, and start drain thread
+//  _filename   :   log file name
+//  _rate       :   baseband sample rate [Hz]
+//  _ring_len   :   ring capacity [records] (rounded up to power of 2)
+framelog framelog_create(const char * _filename,
+                         double _rate,
+                         unsigned int _ring_len);
+
+// drain remaining records, stop thread, close file and destroy log
+void framelog_destroy(framelog _q);
+
+// print counters
+void framelog_print(framelog _q);
+
+// push record into ring; never blocks, dropping (and counting) the
+// record if the ring is full
+void framelog_push(framelog _q,
+                   struct framelog_record_s * _r);
+
+// push frame from synchronizer callback
+//  _q              :   frame log
+//  _timestamp      :   time of frame [s]
+//  _header         :   frame header (packet id in bytes 0,1)
+//  _header_valid   :   header valid?
+//  _payload_len    :   payload length [bytes]
+//  _payload_valid  :   payload valid?
+//  _stats          :   synchronizer statistics
+void framelog_push_frame(framelog _q,
+                         double _timestamp,
+                         unsigned char * _header,
+                         int _header_valid,
+                         unsigned int _payload_len,
+                         int _payload_valid,
+                         framesyncstats_s * _stats);
+
+//
+// reader
+//
+
+typedef struct framelog_reader_s * framelog_reader;
+
+// open frame log for reading
+framelog_reader framelog_reader_open(const char * _filename);
+
+// close frame log
+void framelog_reader_close(framelog_reader _q);
+
+// get baseband sample rate [Hz]
+double framelog_reader_get_rate(framelog_reader _q);
+
+// read next record, returning 1 on success, 0 at end of log
+int framelog_reader_read(framelog_reader _q,
+                         struct framelog_record_s * _r);
+
+#endif // __FRAMELOG_H__
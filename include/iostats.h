@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// iostats
+//
+// usrp i/o accounting: receive overflows, transmit underflows, late
+// packets/commands and zero-length reads, plus receive samples lost to
+// gaps in the hardware time stamps, totalled and binned per second of
+// (host) run time so that DSP starvation can be told apart from RF loss
+//
+
+#ifndef __IOSTATS_H__
+#define __IOSTATS_H__
+
+// events
+#define IOSTATS_OVERFLOW        (0) // receive overflow (host too slow)
+#define IOSTATS_UNDERFLOW       (1) // transmit underflow (host too slow)
+#define IOSTATS_LATE            (2) // packet/command arrived after its time
+#define IOSTATS_NUM_EVENTS      (3)
+
+// counters
+struct iostats_counters_s {
+    unsigned long int num_rx_samples;   // samples received
+    unsigned long int num_rx_packets;   // recv() calls returning samples
+    unsigned long int num_zero_reads;   // recv() calls returning no samples
+    unsigned long int num_lost_samples; // samples missing from time stamps
+    unsigned long int num_tx_samples;   // samples sent
+    unsigned long int num_events[IOSTATS_NUM_EVENTS];
+};
+
+typedef struct iostats_s * iostats;
+
+// create iostats object
+//  _rx_rate    :   receive sample rate [Hz], used to convert time stamp
+//                  gaps into lost samples (see iostats_set_rx_rate)
+iostats iostats_create(double _rx_rate);
+
+// destroy iostats object
+void iostats_destroy(iostats _q);
+
+// clear counters and time series
+void iostats_reset(iostats _q);
+
+// set receive sample rate [Hz]
+void iostats_set_rx_rate(iostats _q,
+                         double _rx_rate);
+
+// record recv() result
+//  _q          :   iostats object
+//  _n          :   number of samples returned
+//  _has_time   :   time stamp valid?
+//  _timestamp  :   time stamp of first sample [s]
+void iostats_rx(iostats _q,
+                unsigned int _n,
+                int _has_time,
+                double _timestamp);
+
+// record samples sent
+void iostats_tx(iostats _q,
+                unsigned int _n);
+
+// record event (IOSTATS_OVERFLOW, _UNDERFLOW, _LATE)
+void iostats_event(iostats _q,
+                   int _event);
+
+// get totals
+void iostats_get_counters(iostats _q,
+                          struct iostats_counters_s * _counters);
+
+// print totals and per-second time series
+void iostats_print(iostats _q);
+
+#endif // __IOSTATS_H__
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//
+// iqfile
+//
+// raw IQ capture files with a metadata sidecar: the writer streams
+// samples to disk in large aligned (O_DIRECT where supported) writes from
+// its own thread; the reader memory-maps a capture and hands it out in
+// blocks as fast as the consumer can take them.
+//
+// The sidecar '<filename>.meta' is plain text, one 'key = value' per
+// line, followed by 'timestamp' and 'overflow' events:
+//
+//  format      = sc16
+//  rate        = 250000.000000
+//  frequency   = 462000000.000000
+//  gain        = 20.000000
+//  timestamp   <sample index> <time [s]>
+//  overflow    <sample index> <time [s]>
+//  num_samples = 1250000
+//
+// A timestamp event is written for the first sample and for every
+// discontinuity in the receive time stamps.
+//
+
+#ifndef __IQFILE_H__
+#define __IQFILE_H__
+
+#include <complex>
+
+// sample formats
+#define IQFILE_FORMAT_FC32      (0) // complex float32
+#define IQFILE_FORMAT_SC16      (1) // complex int16 (interleaved I/Q)
+
+// capture metadata
+struct iqfile_meta_s {
+    int format;                     // IQFILE_FORMAT_FC32 or _SC16
+    double rate;                    // sample rate [Hz]
+    double frequency;               // center frequency [Hz]
+    double gain;                    // receive gain [dB]
+    double time_start;              // time of first sample [s]
+    unsigned long int num_samples;  // number of samples
+    unsigned int num_timestamps;    // number of timestamp events
+    unsigned int num_overflows;     // number of overflow events
+};
+
+// get sample format name
+const char * iqfile_format_str(int _format);
+
+// get sample format from name ("fc32" or "sc16"), -1 if unknown
+int iqfile_format_parse(const char * _str);
+
+//
+// writer
+//
+
+typedef struct iqfile_writer_s * iqfile_writer;
+
+// create iqfile writer
+//  _filename   :   capture file name (sidecar is <filename>.meta)
+//  _format     :   sample format (IQFILE_FORMAT_FC32, _SC16)
+//  _rate       :   sample rate [Hz]
+//  _frequency  :   center frequency [Hz]
+//  _gain       :   receive gain [dB]
+iqfile_writer iqfile_writer_create(const char * _filename,
+                                   int _format,
+                                   double _rate,
+                                   double _frequency,
+                                   double _gain);
+
+// flush remaining samples, complete sidecar and destroy writer
+void iqfile_writer_destroy(iqfile_writer _q);
+
+// print writer counters
+void iqfile_writer_print(iqfile_writer _q);
+
+// append samples; blocks only if the disk falls behind by more than the
+// writer's buffering
+//  _q          :   iqfile writer
+//  _x          :   samples in the writer's format [size: _n x 1]
+//  _n          :   number of (complex) samples
+//  _timestamp  :   time of first sample [s]
+void iqfile_writer_write(iqfile_writer _q,
+                         const void * _x,
+                         unsigned int _n,
+                         double _timestamp);
+
+// record receive overflow before the next sample
+void iqfile_writer_overflow(iqfile_writer _q,
+                            double _timestamp);
+
+//
+// reader
+//
+
+typedef struct iqfile_reader_s * iqfile_reader;
+
+// open capture for reading; without a sidecar the file is taken to be
+// raw complex float32 of unknown rate
+iqfile_reader iqfile_reader_open(const char * _filename);
+
+// close capture
+void iqfile_reader_close(iqfile_reader _q);
+
+// print capture metadata
+void iqfile_reader_print(iqfile_reader _q);
+
+// get capture metadata
+struct iqfile_meta_s * iqfile_reader_get_meta(iqfile_reader _q);
+
+// rewind to first sample
+void iqfile_reader_rewind(iqfile_reader _q);
+
+// seek to sample index (clipped to the end of the capture)
+void iqfile_reader_seek(iqfile_reader _q,
+                        unsigned long int _index);
+
+// read next block as complex float, converting sc16 captures; returns
+// number of samples read, 0 at the end of the capture (compatible with
+// rxpipe_recv)
+//  _x          :   output buffer [size: _n x 1]
+//  _n          :   output buffer length
+//  _userdata   :   iqfile_reader object
+unsigned int iqfile_reader_recv(std::complex<float> * _x,
+                                unsigned int _n,
+                                void * _userdata);
+
+// read next block as sc16, converting fc32 captures (compatible with
+// rxpipe_recv_sc16)
+//  _x          :   output buffer [size: 2*_n x 1]
+//  _n          :   output buffer length [complex samples]
+//  _userdata   :   iqfile_reader object
+unsigned int iqfile_reader_recv_sc16(short * _x,
+                                     unsigned int _n,
+                                     void * _userdata);
+
+#endif // __IQFILE_H__
@@ -27,8 +27,10 @@
 #ifndef __IQPR_H__
 #define __IQPR_H__
 
+#include <complex>
 #include <liquid/liquid.h>
-#include <uhd/usrp/single_usrp.hpp>
+#include "iostats.h"
+#include "rateplan.h"
 
 // 
 // iqpr object interface declarations
@@ -36,9 +38,125 @@
 
 typedef struct iqpr_s * iqpr;
 
-// create iqpr object
+// received frame (queue entry)
+struct iqprframe_s {
+    unsigned char header[14];   // received header
+    int header_valid;           // header valid?
+    unsigned char * payload;    // payload data (pooled buffer)
+    unsigned int payload_len;   // number of bytes in payload
+    int payload_valid;          // payload valid?
+    framesyncstats_s stats;     // received frame statistics
+    double timestamp;           // arrival time, usrp clock [seconds]
+};
+
+//
+// sample source/sink backend
+//
+
+typedef struct iqpr_backend_s * iqpr_backend;
+
+// backend operations; rates are usrp (pre-decimation) sample rates and
+// times are in seconds on the backend's clock
+struct iqpr_backend_s {
+    void * userdata;                // backend-specific state
+    unsigned int max_recv_samps;    // maximum samples per recv() call
+    unsigned int max_send_samps;    // maximum samples per send() call
+
+    // destroy backend-specific state
+    void (*destroy)(void * _userdata);
+
+    // set sample rate, returning actual rate
+    double (*set_rx_rate)(void * _userdata, double _rate);
+    double (*set_tx_rate)(void * _userdata, double _rate);
+
+    // set hardware gain/frequency
+    void (*set_rx_gain)(void * _userdata, double _gain);
+    void (*set_tx_gain)(void * _userdata, double _gain);
+    void (*set_rx_freq)(void * _userdata, double _freq);
+    void (*set_tx_freq)(void * _userdata, double _freq);
+
+    // start/stop receiver streaming
+    void (*rx_start)(void * _userdata);
+    void (*rx_stop)(void * _userdata);
+
+    // receive block of samples, returning number of samples and the
+    // time of the first sample
+    unsigned int (*recv)(void *                _userdata,
+                         std::complex<float> * _x,
+                         unsigned int          _n,
+                         double *              _timestamp);
+
+    // send block of samples, returning number of samples sent
+    unsigned int (*send)(void *                _userdata,
+                         std::complex<float> * _x,
+                         unsigned int          _n,
+                         int                   _start_of_burst,
+                         int                   _end_of_burst);
+
+    // get current time
+    double (*get_time)(void * _userdata);
+
+    // i/o accounting: samples and time stamp gaps are recorded by
+    // iqpr_backend_recv()/iqpr_backend_send(), device events (overflow,
+    // underflow, late packets) by the backend itself
+    iostats stats;
+};
+
+// allocate backend with default (no-op) operations; used by backend
+// implementations
+iqpr_backend iqpr_backend_alloc();
+
+// destroy backend object
+void iqpr_backend_destroy(iqpr_backend _b);
+
+// receive block of samples through backend, recording it in the
+// backend's i/o accounting
+unsigned int iqpr_backend_recv(iqpr_backend _b,
+                               std::complex<float> * _x,
+                               unsigned int _n,
+                               double * _timestamp);
+
+// send block of samples through backend, recording it in the backend's
+// i/o accounting
+unsigned int iqpr_backend_send(iqpr_backend _b,
+                               std::complex<float> * _x,
+                               unsigned int _n,
+                               int _start_of_burst,
+                               int _end_of_burst);
+
+// create usrp (uhd) backend
+iqpr_backend iqpr_backend_create_uhd();
+
+// create usrp (uhd) backend receiving the native sc16 wire format, which
+// halves bus traffic; samples are converted to float on the host
+iqpr_backend iqpr_backend_create_uhd_sc16();
+
+// create memory-mapped file backend (raw complex float32 samples); the
+// receiver returns silence once the capture is exhausted
+//  _rx_filename    :   receive capture, NULL for silence
+//  _tx_filename    :   transmit output, NULL to discard
+iqpr_backend iqpr_backend_create_file(const char * _rx_filename,
+                                      const char * _tx_filename);
+
+// create pair of in-process loopback backends; samples sent on one are
+// received on the other after _delay samples
+//  _delay  :   link delay [samples]
+//  _b0     :   first endpoint
+//  _b1     :   second endpoint
+void iqpr_backend_create_loopback(unsigned int _delay,
+                                  iqpr_backend * _b0,
+                                  iqpr_backend * _b1);
+
+//
+// iqpr
+//
+
+// create iqpr object on usrp
 iqpr iqpr_create();
 
+// create iqpr object on backend (object takes ownership of backend)
+iqpr iqpr_create_backend(iqpr_backend _backend);
+
 // destroy iqpr object
 void iqpr_destroy(iqpr _q);
 
@@ -49,6 +167,71 @@ void iqpr_print(iqpr _q);
 void iqpr_set_verbose(iqpr _q);
 void iqpr_unset_verbose(iqpr _q);
 
+// enable/disable block-mode receiver: decimate, resample and synchronize
+// entire usrp blocks (get_max_recv_samps_per_packet) per call rather than
+// one sample pair at a time
+void iqpr_set_rx_block_mode(iqpr _q);
+void iqpr_unset_rx_block_mode(iqpr _q);
+
+// enable/disable burst-mode transmitter: render each frame into a
+// preallocated buffer and send it as a single burst (start/end of burst
+// flags set) rather than as a continuous stream of 256-sample chunks
+void iqpr_set_tx_burst_mode(iqpr _q);
+void iqpr_unset_tx_burst_mode(iqpr _q);
+
+// get burst-mode transmitter counters
+//  _q              :   iqpr object
+//  _num_bursts     :   number of bursts sent
+//  _num_samples    :   number of samples in last burst
+//  _latency        :   time to send last burst [seconds]
+void iqpr_get_tx_burst_stats(iqpr _q,
+                             unsigned long int * _num_bursts,
+                             unsigned int *      _num_samples,
+                             float *             _latency);
+
+// set rendered frame cache size; frames are rendered once and resent
+// from the cache while header, payload and properties are unchanged.
+// Disabled by default: enable only when packets are retransmitted, as
+// caching renders every continuous-mode frame in full
+//  _q              :   iqpr object
+//  _num_entries    :   maximum number of cached frames (0 disables),
+//                      default: 0
+//  _max_bytes      :   maximum buffer memory held by cache entries,
+//                      default: 0
+void iqpr_set_tx_cache(iqpr _q,
+                       unsigned int _num_entries,
+                       unsigned long int _max_bytes);
+
+// get rendered frame cache counters
+//  _q              :   iqpr object
+//  _num_hits       :   number of frames sent from cache
+//  _num_misses     :   number of frames rendered
+//  _num_bytes      :   buffer memory held by cache entries
+void iqpr_get_tx_cache_stats(iqpr _q,
+                             unsigned long int * _num_hits,
+                             unsigned long int * _num_misses,
+                             unsigned long int * _num_bytes);
+
+// enable/disable streaming receiver: a background thread owns recv()
+// and pushes usrp blocks into a fixed-capacity ring of _ring_len blocks
+// from which iqpr_rxpacket() consumes; must be set while stopped
+void iqpr_set_rx_streaming(iqpr _q, unsigned int _ring_len);
+void iqpr_unset_rx_streaming(iqpr _q);
+
+// get receive ring counters (streaming mode)
+//  _q                  :   iqpr object
+//  _occupancy          :   number of blocks waiting in ring
+//  _high_water_mark    :   maximum occupancy since receiver was started
+//  _num_overflows      :   number of usrp blocks dropped on full ring
+void iqpr_get_rx_ring_stats(iqpr _q,
+                            unsigned int *      _occupancy,
+                            unsigned int *      _high_water_mark,
+                            unsigned long int * _num_overflows);
+
+// get usrp i/o accounting (overflows, underflows, late packets, lost
+// samples); owned by the iqpr object
+iostats iqpr_get_iostats(iqpr _q);
+
 //
 // PHY properties
 //
@@ -67,18 +250,55 @@ void iqpr_set_rx_power(iqpr _q, float _rx_power);
 void iqpr_set_tx_rate(iqpr _q, float _tx_rate);
 void iqpr_set_rx_rate(iqpr _q, float _rx_rate);
 
+// get rate plan (usrp interpolation/decimation and host resampling
+// chain) chosen by iqpr_set_tx_rate()/iqpr_set_rx_rate()
+void iqpr_get_tx_rateplan(iqpr _q, struct rateplan_s * _plan);
+void iqpr_get_rx_rateplan(iqpr _q, struct rateplan_s * _plan);
+
 // set transmit/receive frequency
 void iqpr_set_tx_freq(iqpr _q, float _tx_freq);
 void iqpr_set_rx_freq(iqpr _q, float _rx_freq);
 
-// set flexframesync properties (receiver)
-void iqpr_rxconfig(iqpr _q, framesyncprops_s * _fsprops);
+// set OFDM subcarrier layout of frame generator/synchronizer; safe to
+// call while another thread is transmitting/receiving (the new layout
+// is swapped in between packets/received blocks)
+//  _q      :   iqpr object
+//  _M      :   number of subcarriers (even, at least 8), default: 40
+//  _cp_len :   cyclic prefix length, default: 8
+//  _p      :   subcarrier allocation [size: _M x 1], NULL gives default
+void iqpr_txconfig(iqpr _q,
+                   unsigned int _M,
+                   unsigned int _cp_len,
+                   unsigned char * _p);
+void iqpr_rxconfig(iqpr _q,
+                   unsigned int _M,
+                   unsigned int _cp_len,
+                   unsigned char * _p);
 
 // start/stop receiver streaming
 void iqpr_rx_start(iqpr _q);
 void iqpr_rx_stop(iqpr _q);
 
 
+// set received frame queue size (must be set while stopped)
+//  _q              :   iqpr object
+//  _queue_len      :   maximum number of queued frames, default: 16
+//  _payload_max    :   maximum payload length [bytes], default: 2048
+void iqpr_set_rx_queue(iqpr _q,
+                       unsigned int _queue_len,
+                       unsigned int _payload_max);
+
+// get received frame queue counters
+//  _q                  :   iqpr object
+//  _num_frames         :   number of frames received by the synchronizer
+//  _num_drops_full     :   number of frames dropped because queue was full
+//  _num_drops_oversize :   number of frames dropped because payload was
+//                          longer than the queue's payload buffers
+void iqpr_get_rx_queue_stats(iqpr _q,
+                             unsigned long int * _num_frames,
+                             unsigned long int * _num_drops_full,
+                             unsigned long int * _num_drops_oversize);
+
 // 
 // low-level functionality
 //
@@ -104,6 +324,9 @@ void iqpr_txpacket(iqpr _q,
 //  _payload_len    :   number of bytes in payload
 //  _payload_valid  :   payload valid?
 //  _stats          :   received frame statistics
+//
+// NOTE : _header and _payload point into the queue entry, which remains
+//        valid until the next call to iqpr_rxpacket() or iqpr_rxframe()
 int iqpr_rxpacket(iqpr _q,
                   unsigned int _timespec,
                   unsigned char ** _header,
@@ -113,6 +336,31 @@ int iqpr_rxpacket(iqpr _q,
                   int           *  _payload_valid,
                   framesyncstats_s * _stats);
 
+// borrow oldest received frame with timeout, returning 1 if found, 0 if
+// not; the frame is not copied and remains valid until it is released,
+// either explicitly or by the next call to iqpr_rxframe/iqpr_rxpacket
+//  _q              :   iqpr object
+//  _timespec       :   time specifier
+//  _frame          :   pointer to received frame entry
+int iqpr_rxframe(iqpr _q,
+                 unsigned int _timespec,
+                 struct iqprframe_s ** _frame);
+
+// borrow oldest received frame with timeout in microseconds (usrp
+// clock), returning 1 if found, 0 if not; see iqpr_rxframe()
+//  _q              :   iqpr object
+//  _timeout_us     :   timeout [microseconds]
+//  _frame          :   pointer to received frame entry
+int iqpr_rxframe_us(iqpr _q,
+                    unsigned int _timeout_us,
+                    struct iqprframe_s ** _frame);
+
+// release frame borrowed with iqpr_rxframe()
+void iqpr_rxframe_release(iqpr _q);
+
+// get current usrp time [seconds]
+double iqpr_get_time(iqpr _q);
+
 //
 // higher functionality
 //
@@ -161,6 +409,141 @@ int iqpr_callback(unsigned char *  _rx_header,
                   framesyncstats_s _stats,
                   void *           _userdata);
 
+// wait for received frame until sample count or deadline is reached
+int iqpr_rx_wait(iqpr _q,
+                 unsigned long int _num_samples,
+                 double _deadline,
+                 struct iqprframe_s ** _frame);
+
+// receive loop of iqpr_rx_wait() (rx_mutex held)
+int iqpr_rx_run(iqpr _q,
+                unsigned long int _num_samples,
+                double _deadline,
+                struct iqprframe_s ** _frame);
+
+// get time of next unconsumed received sample (usrp clock) [seconds]
+double iqpr_rx_time(iqpr _q);
+
+// read block of samples from the usrp (or receive ring) into the
+// receive buffer, releasing rx_mutex while waiting
+void iqpr_rx_read_block(iqpr _q);
+
+// wait for block of samples from the usrp (or receive ring)
+void iqpr_rx_wait_block(iqpr _q);
+
+// receive one usrp packet into buffer, returning number of samples
+unsigned int iqpr_rx_recv(iqpr _q,
+                          std::complex<float> * _x,
+                          unsigned int _n,
+                          double * _timestamp);
+
+// receive thread (streaming mode)
+void * iqpr_rx_process(void * _userdata);
+
+// decimate and resample block of raw samples into pending buffer
+void iqpr_rx_process_block(iqpr _q,
+                           std::complex<float> * _x,
+                           unsigned int _n);
+
+// push raw sample through half-band decimators, returning 1 when the
+// last stage produces an output
+int iqpr_rx_decim_push(iqpr _q,
+                       std::complex<float> _x,
+                       std::complex<float> * _y);
+
+// decimate block by 2 in half-band stage _s (in place allowed),
+// returning number of output samples
+unsigned int iqpr_rx_decim_block(iqpr _q,
+                                 unsigned int _s,
+                                 std::complex<float> * _x,
+                                 unsigned int _n,
+                                 std::complex<float> * _y);
+
+// re-create receiver decimators and resampler for rate plan
+void iqpr_rx_set_plan(iqpr _q,
+                      struct rateplan_s * _plan);
+
+// push pending resampled samples through frame synchronizer, returning
+// 1 once the received frame queue is not empty
+int iqpr_rx_sync_pending(iqpr _q);
+
+// render assembled frame into render buffer with _zero_pad symbols of
+// silence, returning number of samples
+unsigned int iqpr_tx_render(iqpr _q,
+                            unsigned int _zero_pad);
+
+// interpolate block through half-band cascade, returning number of
+// output samples
+unsigned int iqpr_tx_interp_block(iqpr _q,
+                                  std::complex<float> * _x,
+                                  unsigned int _n,
+                                  std::complex<float> * _y);
+
+// interpolate one sample from half-band stage _s onward
+unsigned int iqpr_tx_interp_push(iqpr _q,
+                                 unsigned int _s,
+                                 std::complex<float> _x,
+                                 std::complex<float> * _y);
+
+// re-create transmitter interpolators and resampler for rate plan
+void iqpr_tx_set_plan(iqpr _q,
+                      struct rateplan_s * _plan);
+
+// (re-)allocate transmit scratch buffers for subcarrier layout,
+// half-band cascade and resampling rate
+void iqpr_tx_alloc_buffers(iqpr _q);
+
+// upper bound on resampler output for _n interpolated samples
+unsigned int iqpr_tx_resamp_len(iqpr _q,
+                                unsigned int _n);
+
+// grow render buffer to at least _n samples, keeping first _num_rendered
+void iqpr_tx_render_reserve(iqpr _q,
+                            unsigned int _n,
+                            unsigned int _num_rendered);
+
+// allocate cache-aligned sample buffer (release with free())
+std::complex<float> * iqpr_malloc_samples(unsigned int _n);
+
+// send rendered frame (burst or continuous)
+void iqpr_tx_send(iqpr _q,
+                  std::complex<float> * _x,
+                  unsigned int _n);
+
+// send rendered frame as a single burst
+void iqpr_tx_send_burst(iqpr _q,
+                        std::complex<float> * _x,
+                        unsigned int _n);
+
+// rendered frame cache
+unsigned int iqpr_tx_cache_key(unsigned char * _header,
+                               unsigned char * _payload,
+                               unsigned int _payload_len,
+                               ofdmflexframegenprops_s * _fgprops);
+struct iqprtxcache_s * iqpr_tx_cache_lookup(iqpr _q,
+                                            unsigned char * _header,
+                                            unsigned char * _payload,
+                                            unsigned int _payload_len);
+void iqpr_tx_cache_invalidate(iqpr _q,
+                              struct iqprtxcache_s * _e);
+void iqpr_tx_cache_evict(iqpr _q,
+                         struct iqprtxcache_s * _e);
+void iqpr_tx_cache_insert(iqpr _q,
+                          unsigned char * _header,
+                          unsigned char * _payload,
+                          unsigned int _payload_len,
+                          std::complex<float> * _x,
+                          unsigned int _n);
+void iqpr_tx_cache_clear(iqpr _q);
+
+// create subcarrier allocation (copy of _p, or default if NULL)
+unsigned char * iqpr_subcarriers_create(unsigned int _M,
+                                        unsigned char * _p);
+
+// lend oldest queued frame to user
+int iqpr_rxframe_borrow(iqpr _q,
+                        struct iqprframe_s ** _frame);
+
 #if 0
 // iqpr packet header descriptor (14 bytes total space)
 //  length  name        description
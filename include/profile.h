@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// profile
+//
+// per-stage DSP profiler: time spent and samples processed in each stage
+// of the transmit/receive chains, with a log2 latency histogram per
+// stage.  Stages are bracketed with PROFILE_BEGIN()/PROFILE_END(), which
+// compile to nothing unless LIQUID_USRP_PROFILE is defined (configure
+// with --enable-profile).
+//
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+// stages
+#define PROFILE_RECV            (0) // usrp/replay recv()
+#define PROFILE_SC16            (1) // sc16 conversion (and first decimation)
+#define PROFILE_HALFBAND        (2) // resamp2 half-band decimation/interpolation
+#define PROFILE_RESAMP          (3) // resamp arbitrary resampling
+#define PROFILE_CHANNELIZER     (4) // polyphase filterbank channelizer
+#define PROFILE_SYNC            (5) // frame synchronizer
+#define PROFILE_FRAMEGEN        (6) // frame generator
+#define PROFILE_SEND            (7) // usrp send()
+#define PROFILE_NUM_STAGES      (8)
+
+// maximum nesting depth of stages within one thread
+#define PROFILE_MAX_DEPTH       (8)
+
+// number of log2 latency histogram buckets
+#define PROFILE_NUM_BUCKETS     (40)
+
+#ifdef LIQUID_USRP_PROFILE
+#  define PROFILE_BEGIN(_stage)         profile_begin(_stage)
+#  define PROFILE_END(_stage,_n)        profile_end(_stage,_n)
+#  define PROFILE_PRINT()               profile_print()
+#else
+#  define PROFILE_BEGIN(_stage)         do {} while (0)
+#  define PROFILE_END(_stage,_n)        do {} while (0)
+#  define PROFILE_PRINT()               do {} while (0)
+#endif
+
+// start timing stage in calling thread; stages may nest, in which case
+// the time spent in the inner stage is not counted against the outer
+void profile_begin(int _stage);
+
+// stop timing stage in calling thread
+//  _stage  :   stage (must match innermost PROFILE_BEGIN)
+//  _n      :   number of samples processed
+void profile_end(int _stage,
+                 unsigned int _n);
+
+// clear counters of all threads
+void profile_reset();
+
+// print per-stage totals over all threads: calls, samples, time,
+// samples/second, ns/sample and call latency percentiles
+void profile_print();
+
+#endif // __PROFILE_H__
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rateplan
+//
+// Choose usrp interpolation/decimation factor and host resampling chain
+// between the usrp sample rate and a baseband rate, minimizing modelled
+// host DSP cost for a target stopband attenuation.
+//
+
+#ifndef __RATEPLAN_H__
+#define __RATEPLAN_H__
+
+// direction
+#define RATEPLAN_RX             (0) // decimation (usrp > baseband)
+#define RATEPLAN_TX             (1) // interpolation (baseband > usrp)
+
+// maximum number of half-band stages
+#define RATEPLAN_MAX_HALFBAND   (4)
+
+// host chain types (bit mask for rateplan_design)
+#define RATEPLAN_CHAIN_HALFBAND     (1<<0)  // half-band cascade + arbitrary resampler
+#define RATEPLAN_CHAIN_POLYPHASE    (1<<1)  // rational polyphase resampler P/Q
+#define RATEPLAN_CHAIN_ALL          (RATEPLAN_CHAIN_HALFBAND | RATEPLAN_CHAIN_POLYPHASE)
+
+// rate plan
+struct rateplan_s {
+    int direction;                  // RATEPLAN_RX or RATEPLAN_TX
+    double converter_rate;          // ADC/DAC rate
+    double baseband_rate;           // host rate at synchronizer/generator
+    float As;                       // target stopband attenuation [dB]
+
+    // hardware
+    unsigned int hw_factor;         // usrp decimation/interpolation
+    double usrp_rate;               // converter_rate / hw_factor
+
+    // host chain
+    int chain;                      // RATEPLAN_CHAIN_HALFBAND or _POLYPHASE
+    unsigned int num_halfband;      // number of half-band stages
+    unsigned int halfband_m[RATEPLAN_MAX_HALFBAND]; // stage semi-lengths (in signal order)
+    double resamp_rate;             // arbitrary resampler rate (output/input)
+    unsigned int resamp_m;          // arbitrary resampler semi-length
+    float resamp_fc;                // arbitrary resampler cutoff
+    unsigned int P;                 // polyphase interpolation factor
+    unsigned int Q;                 // polyphase decimation factor
+    unsigned int poly_len;          // polyphase prototype filter length
+
+    // modelled cost
+    float cost;                     // multiply-accumulates per baseband sample
+    float cost_mmacs;               // millions of multiply-accumulates per second
+};
+
+// design rate plan, returning 0 on success, -1 if no plan is feasible
+//  _plan           :   output plan
+//  _direction      :   RATEPLAN_RX or RATEPLAN_TX
+//  _converter_rate :   ADC/DAC rate
+//  _baseband_rate  :   host rate at synchronizer (rx) or generator (tx)
+//  _As             :   target stopband attenuation [dB]
+//  _chain_mask     :   allowed host chains (RATEPLAN_CHAIN_*)
+int rateplan_design(struct rateplan_s * _plan,
+                    int          _direction,
+                    double       _converter_rate,
+                    double       _baseband_rate,
+                    float        _As,
+                    unsigned int _chain_mask);
+
+// design half-band chain of _num_halfband stages for a given usrp
+// factor (e.g. one chosen by the application), returning 0 on success,
+// -1 if the arbitrary resampler is infeasible
+//  _plan           :   output plan
+//  _direction      :   RATEPLAN_RX or RATEPLAN_TX
+//  _converter_rate :   ADC/DAC rate
+//  _hw_factor      :   usrp decimation/interpolation
+//  _baseband_rate  :   host rate at synchronizer (rx) or generator (tx)
+//  _num_halfband   :   number of half-band stages
+//  _As             :   target stopband attenuation [dB]
+int rateplan_design_fixed(struct rateplan_s * _plan,
+                          int          _direction,
+                          double       _converter_rate,
+                          unsigned int _hw_factor,
+                          double       _baseband_rate,
+                          unsigned int _num_halfband,
+                          float        _As);
+
+// print rate plan
+void rateplan_print(struct rateplan_s * _plan);
+
+// set actual usrp rate (as reported by the hardware), correcting the
+// arbitrary resampling rate of a half-band chain
+void rateplan_set_usrp_rate(struct rateplan_s * _plan,
+                            double _usrp_rate);
+
+// is usrp decimation (rx) or interpolation (tx) factor supported?
+int rateplan_valid_hw_factor(int _direction,
+                             unsigned int _factor);
+
+// estimate filter length for transition band _df (normalized to the
+// filter's sample rate) and stopband attenuation _As
+unsigned int rateplan_filter_len(float _df,
+                                 float _As);
+
+#endif // __RATEPLAN_H__
+
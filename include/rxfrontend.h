@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rxfrontend
+//
+// receiver front end: half-band decimator cascade and arbitrary resampler
+// (see rateplan.h) between raw usrp blocks of any size and a frame
+// synchronizer, which is fed fixed-size blocks of baseband samples
+// through a sink callback; raw blocks are complex float or the usrp's
+// native complex int16 (sc16), whose conversion, scaling and first
+// half-band stage are fused (see sc16.h).  An optional energy gate skips
+// the filters and synchronizer for raw samples near the noise floor, so
+// that the baseband stream is then no longer contiguous.
+//
+
+#ifndef __RXFRONTEND_H__
+#define __RXFRONTEND_H__
+
+#include <complex>
+#include "rateplan.h"
+
+typedef struct rxfrontend_s * rxfrontend;
+
+// sink callback, invoked with each block of baseband samples
+//  _x          :   baseband samples [size: _n x 1]
+//  _n          :   number of samples
+//  _userdata   :   user-defined data pointer
+typedef void (*rxfrontend_sink)(std::complex<float> * _x,
+                                unsigned int _n,
+                                void * _userdata);
+
+// create rxfrontend object
+//  _plan       :   receive rate plan (half-band chain)
+//  _block_len  :   number of baseband samples per sink call
+//  _sink       :   sink callback
+//  _userdata   :   user-defined data pointer passed to sink
+rxfrontend rxfrontend_create(struct rateplan_s * _plan,
+                             unsigned int _block_len,
+                             rxfrontend_sink _sink,
+                             void * _userdata);
+
+// destroy rxfrontend object
+void rxfrontend_destroy(rxfrontend _q);
+
+// print rxfrontend object internals and counters
+void rxfrontend_print(rxfrontend _q);
+
+// reset filter states, drop partial output block
+void rxfrontend_reset(rxfrontend _q);
+
+// push block of raw usrp samples through front end, invoking sink for
+// each complete baseband block
+//  _q      :   rxfrontend object
+//  _x      :   raw usrp samples [size: _n x 1]
+//  _n      :   number of samples (any size)
+void rxfrontend_execute(rxfrontend _q,
+                        std::complex<float> * _x,
+                        unsigned int _n);
+
+// push block of raw sc16 usrp samples through front end, invoking sink
+// for each complete baseband block
+//  _q      :   rxfrontend object
+//  _x      :   raw interleaved I/Q samples [size: 2*_n x 1]
+//  _n      :   number of complex samples (any size)
+void rxfrontend_execute_sc16(rxfrontend _q,
+                             const short * _x,
+                             unsigned int _n);
+
+// set scaling of sc16 samples (default 1/32768, full scale to unity)
+void rxfrontend_set_gain(rxfrontend _q,
+                         float _gain);
+
+// invoke sink with partial output block, if any
+void rxfrontend_flush(rxfrontend _q);
+
+// advance raw position past samples lost before the next block (e.g. to
+// a receive overflow) without filtering them
+//  _q      :   rxfrontend object
+//  _n      :   number of raw samples lost
+void rxfrontend_skip(rxfrontend _q,
+                     unsigned long int _n);
+
+// get time of first sample in block passed to sink [s], from its raw
+// position at the usrp rate: unlike a count of baseband samples, this
+// includes samples skipped by the energy gate or lost (see
+// rxfrontend_skip); valid within the sink callback
+double rxfrontend_get_time(rxfrontend _q);
+
+// enable energy gate: raw chunks whose mean energy is less than
+// _threshold dB above the (tracked) noise floor bypass the filters and
+// synchronizer; the most recent _history raw samples are kept while the
+// gate is closed and pushed through ahead of the chunk which opens it.
+// The floor follows quiet chunks, and is moved to the minimum chunk
+// energy when a long window has none (so that a step in the floor does
+// not hold the gate open; a signal lasting that long becomes the floor)
+//  _q          :   rxfrontend object
+//  _threshold  :   threshold over noise floor [dB], <= 0 to disable
+//  _history    :   pre-trigger history [raw samples]
+void rxfrontend_set_gate(rxfrontend _q,
+                         float _threshold,
+                         unsigned int _history);
+
+// get energy gate counters
+//  _q              :   rxfrontend object
+//  _num_chunks     :   chunks seen by gate
+//  _num_skipped    :   chunks skipped
+//  _time_saved     :   estimated processing time saved [s]
+void rxfrontend_get_gate_stats(rxfrontend _q,
+                               unsigned long int * _num_chunks,
+                               unsigned long int * _num_skipped,
+                               double * _time_saved);
+
+#endif // __RXFRONTEND_H__
+
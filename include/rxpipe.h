@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rxpipe
+//
+// pipelined receiver: capture, resampling (rxfrontend) and synchronizer
+// stages each run in their own thread, linked by lock-free queues of
+// pooled sample blocks (blockq)
+//
+
+#ifndef __RXPIPE_H__
+#define __RXPIPE_H__
+
+#include <complex>
+#include "rateplan.h"
+#include "rxfrontend.h"
+#include "iostats.h"
+
+// pipeline stages
+#define RXPIPE_CAPTURE          (0) // usrp recv() into raw queue
+#define RXPIPE_RESAMP           (1) // raw queue through rxfrontend into baseband queue
+#define RXPIPE_SYNC             (2) // baseband queue into synchronizer
+#define RXPIPE_NUM_STAGES       (3)
+
+// capture callback, reading raw usrp samples into buffer; returns number
+// of samples read
+//  _x          :   output buffer [size: _n x 1]
+//  _n          :   output buffer length
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*rxpipe_recv)(std::complex<float> * _x,
+                                    unsigned int _n,
+                                    void * _userdata);
+
+// capture callback for raw sc16 samples (interleaved I/Q int16); returns
+// number of complex samples read
+//  _x          :   output buffer [size: 2*_n x 1]
+//  _n          :   output buffer length [complex samples]
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*rxpipe_recv_sc16)(short * _x,
+                                         unsigned int _n,
+                                         void * _userdata);
+
+typedef struct rxpipe_s * rxpipe;
+
+// create rxpipe object
+//  _plan           :   receive rate plan (half-band chain)
+//  _raw_len        :   raw samples per capture block (usrp packet size)
+//  _block_len      :   baseband samples per synchronizer block
+//  _num_blocks     :   number of blocks in each queue
+//  _recv           :   capture callback
+//  _recv_userdata  :   user-defined data pointer passed to capture callback
+//  _sink           :   synchronizer callback
+//  _sink_userdata  :   user-defined data pointer passed to synchronizer callback
+rxpipe rxpipe_create(struct rateplan_s * _plan,
+                     unsigned int _raw_len,
+                     unsigned int _block_len,
+                     unsigned int _num_blocks,
+                     rxpipe_recv _recv,
+                     void * _recv_userdata,
+                     rxfrontend_sink _sink,
+                     void * _sink_userdata);
+
+// destroy rxpipe object, stopping threads if running
+void rxpipe_destroy(rxpipe _q);
+
+// print per-stage utilization and queue depths
+void rxpipe_print(rxpipe _q);
+
+// pin stage thread to cpu (-1 for no affinity); takes effect on start
+//  _q      :   rxpipe object
+//  _stage  :   stage (RXPIPE_CAPTURE, RXPIPE_RESAMP, RXPIPE_SYNC)
+//  _cpu    :   cpu index
+void rxpipe_set_affinity(rxpipe _q,
+                         int _stage,
+                         int _cpu);
+
+// capture sc16 samples with _recv (passed the capture user data) instead
+// of the complex float callback; must be set before start
+void rxpipe_set_recv_sc16(rxpipe _q,
+                          rxpipe_recv_sc16 _recv);
+
+// set iostats object updated by the capture callback; samples it reports
+// lost (time stamp gaps) advance the raw position, like packets dropped
+// on a full raw queue, so that block times keep to the usrp clock; must
+// be set before start
+void rxpipe_set_iostats(rxpipe _q,
+                        iostats _stats);
+
+// get front end (e.g. to enable its energy gate); must not be modified
+// while the pipeline is running
+rxfrontend rxpipe_get_frontend(rxpipe _q);
+
+// get time of block passed to synchronizer callback [s] (see
+// rxfrontend_get_time()); valid within the callback
+double rxpipe_get_time(rxpipe _q);
+
+// start stage threads
+void rxpipe_start(rxpipe _q);
+
+// stop capture, drain queues through resampler and synchronizer, and
+// join stage threads
+void rxpipe_stop(rxpipe _q);
+
+#endif // __RXPIPE_H__
+
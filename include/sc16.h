@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// sc16
+//
+// conversion of the usrp's native complex int16 (sc16) wire format:
+// interleaved I/Q int16 samples are converted to complex float, scaled,
+// and (sc16decim) decimated by 2 with a half-band filter in a single
+// pass, using SSE2, AVX2 or NEON selected at run time
+//
+
+#ifndef __SC16_H__
+#define __SC16_H__
+
+#include <complex>
+
+// instruction set extensions
+#define SC16_ISA_AUTO       (-1)    // best supported by this cpu
+#define SC16_ISA_GENERIC    (0)     // portable C
+#define SC16_ISA_SSE2       (1)     // x86 SSE2
+#define SC16_ISA_AVX2       (2)     // x86 AVX2 + FMA
+#define SC16_ISA_NEON       (3)     // ARM NEON
+
+// scaling which maps full scale to unity
+#define SC16_GAIN_UNITY     (1.0f/32768.0f)
+
+// get best instruction set extension supported by this cpu
+int sc16_isa_detect();
+
+// is instruction set extension supported by this cpu (and build)?
+int sc16_isa_supported(int _isa);
+
+// get instruction set extension name
+const char * sc16_isa_str(int _isa);
+
+// convert sc16 samples to complex float
+//  _x      :   interleaved I/Q samples [size: 2*_n x 1]
+//  _n      :   number of complex samples
+//  _gain   :   scaling factor (1/32768 maps full scale to unity)
+//  _y      :   output samples [size: _n x 1]
+void sc16_convert(const short * _x,
+                  unsigned int _n,
+                  float _gain,
+                  std::complex<float> * _y);
+
+//
+// sc16decim: fused conversion, scaling and half-band decimation by 2
+//
+
+typedef struct sc16decim_s * sc16decim;
+
+// create sc16decim object
+//  _m      :   filter semi-length (filter length is 4*_m+1)
+//  _As     :   stopband attenuation [dB]
+//  _gain   :   scaling factor (1/32768 maps full scale to unity)
+//  _isa    :   instruction set extension (SC16_ISA_AUTO to detect)
+sc16decim sc16decim_create(unsigned int _m,
+                           float _As,
+                           float _gain,
+                           int _isa);
+
+// destroy sc16decim object
+void sc16decim_destroy(sc16decim _q);
+
+// print sc16decim object internals
+void sc16decim_print(sc16decim _q);
+
+// clear filter state
+void sc16decim_reset(sc16decim _q);
+
+// set scaling factor
+void sc16decim_set_gain(sc16decim _q,
+                        float _gain);
+
+// convert, scale and decimate block of samples; an odd trailing sample
+// is kept for the next call
+//  _q      :   sc16decim object
+//  _x      :   interleaved I/Q samples [size: 2*_n x 1]
+//  _n      :   number of complex input samples (any size)
+//  _y      :   output samples [size: (_n+1)/2 x 1]
+//  returns number of output samples
+unsigned int sc16decim_execute(sc16decim _q,
+                               const short * _x,
+                               unsigned int _n,
+                               std::complex<float> * _y);
+
+#endif // __SC16_H__
+
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txfrontend
+//
+// transmitter front end: half-band interpolator cascade, arbitrary
+// resampler and gain (see rateplan.h) between a frame generator and the
+// usrp, fused into one block-oriented pass whose filter kernels use
+// SSE2, AVX2 or NEON selected at run time (see sc16.h)
+//
+
+#ifndef __TXFRONTEND_H__
+#define __TXFRONTEND_H__
+
+#include <complex>
+#include "rateplan.h"
+
+typedef struct txfrontend_s * txfrontend;
+
+// create txfrontend object
+//  _plan   :   transmit rate plan (half-band chain)
+//  _gain   :   linear gain applied to output
+//  _isa    :   instruction set extension (SC16_ISA_AUTO to detect)
+txfrontend txfrontend_create(struct rateplan_s * _plan,
+                             float _gain,
+                             int _isa);
+
+// destroy txfrontend object
+void txfrontend_destroy(txfrontend _q);
+
+// print txfrontend object internals and counters
+void txfrontend_print(txfrontend _q);
+
+// clear filter states and resampler phase
+void txfrontend_reset(txfrontend _q);
+
+// set linear output gain
+void txfrontend_set_gain(txfrontend _q,
+                         float _gain);
+
+// get maximum number of output samples for _n input samples
+unsigned int txfrontend_max_output(txfrontend _q,
+                                   unsigned int _n);
+
+// interpolate, resample and scale block of baseband samples
+//  _q      :   txfrontend object
+//  _x      :   baseband samples [size: _n x 1]
+//  _n      :   number of input samples (any size)
+//  _y      :   usrp samples [size: txfrontend_max_output(_q,_n) x 1]
+//  returns number of output samples
+unsigned int txfrontend_execute(txfrontend _q,
+                                const std::complex<float> * _x,
+                                unsigned int _n,
+                                std::complex<float> * _y);
+
+#endif // __TXFRONTEND_H__
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txloop
+//
+// pre-rendered waveform loop: a fixed set of frames is rendered once
+// into one contiguous, page-aligned (and optionally memory-locked)
+// buffer, which is then streamed to the usrp over and over without
+// copying, taking frame generation off the transmit path
+//
+
+#ifndef __TXLOOP_H__
+#define __TXLOOP_H__
+
+#include <complex>
+
+// render callback; writes usrp samples of frame _k into buffer and
+// returns number of samples written
+//  _k          :   frame index in [0,num_frames)
+//  _y          :   output buffer [size: _n x 1]
+//  _n          :   output buffer length
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*txloop_generate)(unsigned int _k,
+                                        std::complex<float> * _y,
+                                        unsigned int _n,
+                                        void * _userdata);
+
+// send callback; writes usrp samples and returns number of samples sent
+//  _x          :   input buffer [size: _n x 1]
+//  _n          :   input buffer length
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*txloop_send)(std::complex<float> * _x,
+                                    unsigned int _n,
+                                    void * _userdata);
+
+typedef struct txloop_s * txloop;
+
+// create txloop object
+//  _num_frames :   number of distinct frames in loop
+//  _frame_len  :   maximum number of usrp samples per frame
+//  _lock       :   lock buffer in memory (mlock)?
+txloop txloop_create(unsigned int _num_frames,
+                     unsigned int _frame_len,
+                     int _lock);
+
+// destroy txloop object
+void txloop_destroy(txloop _q);
+
+// print buffer layout and render/stream counters
+void txloop_print(txloop _q);
+
+// render all frames back to back into loop buffer
+//  _q          :   txloop object
+//  _generate   :   render callback
+//  _userdata   :   user-defined data pointer passed to render callback
+void txloop_render(txloop _q,
+                   txloop_generate _generate,
+                   void * _userdata);
+
+// get loop length [samples]
+unsigned int txloop_get_length(txloop _q);
+
+// stream loop buffer repeatedly until _num_samples samples have been
+// sent (ending part way through the loop if need be)
+//  _q              :   txloop object
+//  _num_samples    :   number of samples to send
+//  _send           :   send callback
+//  _userdata       :   user-defined data pointer passed to send callback
+void txloop_run(txloop _q,
+                unsigned long int _num_samples,
+                txloop_send _send,
+                void * _userdata);
+
+#endif // __TXLOOP_H__
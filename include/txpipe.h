@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txpipe
+//
+// look-ahead transmitter: a pool of worker threads assembles and
+// modulates frames ahead of time into pooled sample blocks (blockq),
+// and a single sender thread streams them to the usrp in frame order
+//
+
+#ifndef __TXPIPE_H__
+#define __TXPIPE_H__
+
+#include <complex>
+
+// frame generator callback, run by worker threads; writes usrp samples
+// of frame _seq into buffer and returns number of samples written
+//  _worker     :   worker index in [0,num_workers), e.g. to select
+//                  per-worker frame generator and front end objects
+//  _seq        :   frame sequence number
+//  _y          :   output buffer [size: _n x 1]
+//  _n          :   output buffer length
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*txpipe_generate)(unsigned int _worker,
+                                        unsigned long int _seq,
+                                        std::complex<float> * _y,
+                                        unsigned int _n,
+                                        void * _userdata);
+
+// send callback, run by sender thread; writes usrp samples and returns
+// number of samples sent
+//  _x          :   input buffer [size: _n x 1]
+//  _n          :   input buffer length
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*txpipe_send)(std::complex<float> * _x,
+                                    unsigned int _n,
+                                    void * _userdata);
+
+typedef struct txpipe_s * txpipe;
+
+// create txpipe object
+//  _num_workers        :   number of frame generator threads
+//  _depth              :   number of frames generated ahead of sender
+//  _frame_len          :   maximum number of usrp samples per frame
+//  _generate           :   frame generator callback
+//  _generate_userdata  :   user-defined data pointer passed to generator
+//  _send               :   send callback
+//  _send_userdata      :   user-defined data pointer passed to send callback
+txpipe txpipe_create(unsigned int _num_workers,
+                     unsigned int _depth,
+                     unsigned int _frame_len,
+                     txpipe_generate _generate,
+                     void * _generate_userdata,
+                     txpipe_send _send,
+                     void * _send_userdata);
+
+// destroy txpipe object, stopping threads if running
+void txpipe_destroy(txpipe _q);
+
+// print per-thread utilization, underruns and look-ahead queue depth
+void txpipe_print(txpipe _q);
+
+// start worker and sender threads
+//  _q          :   txpipe object
+//  _num_frames :   number of frames to send (0 for no limit)
+void txpipe_start(txpipe _q,
+                  unsigned long int _num_frames);
+
+// wait for all frames to be sent and join threads; must not be called
+// when started without a frame limit
+void txpipe_wait(txpipe _q);
+
+// stop generating frames, send the frames already generated (in order)
+// and join threads
+void txpipe_stop(txpipe _q);
+
+// get number of frames sent
+unsigned long int txpipe_get_num_sent(txpipe _q);
+
+// get number of times the sender found the next frame not yet generated
+unsigned long int txpipe_get_num_underruns(txpipe _q);
+
+#endif // __TXPIPE_H__
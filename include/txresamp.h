@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txresamp
+//
+// run-time selectable transmit resampler strategies between a baseband
+// generator and the usrp, with a start-up calibration that times each
+// strategy at the configured rates and measures its spurious rejection,
+// picking the fastest one that meets a spectral mask
+//
+
+#ifndef __TXRESAMP_H__
+#define __TXRESAMP_H__
+
+#include <complex>
+
+// strategies
+#define TXRESAMP_RESAMP         (0) // liquid resamp_crcf, sample by sample
+#define TXRESAMP_MSRESAMP       (1) // liquid msresamp_crcf, multi-stage
+#define TXRESAMP_FRONTEND       (2) // txfrontend, arbitrary resampler only
+#define TXRESAMP_FRONTEND_HB    (3) // txfrontend, half-band + arbitrary resampler
+#define TXRESAMP_NUM_STRATEGIES (4)
+#define TXRESAMP_AUTO           (-1)// calibrate and select
+#define TXRESAMP_UNKNOWN        (-2)// unknown strategy string
+
+// rates and filter properties shared by all strategies
+struct txresamp_props_s {
+    double converter_rate;          // DAC rate
+    unsigned int hw_factor;         // usrp interpolation
+    double usrp_rate;               // actual usrp rate
+    double baseband_rate;           // generator rate
+    float As;                       // stopband attenuation [dB]
+    float gain;                     // linear output gain
+};
+
+// calibration result
+struct txresamp_result_s {
+    int feasible;                   // strategy can realize the rates
+    float ns_per_sample;            // run time per usrp sample [ns]
+    float load;                     // fraction of one core at usrp rate
+    float rejection;                // carrier to largest spur [dB]
+    int mask_ok;                    // rejection meets mask
+};
+
+typedef struct txresamp_s * txresamp;
+
+// create txresamp object, or return NULL if the strategy cannot realize
+// the rates
+//  _strategy   :   TXRESAMP_RESAMP, ...
+//  _props      :   rates and filter properties
+txresamp txresamp_create(int _strategy,
+                         struct txresamp_props_s * _props);
+
+// destroy txresamp object
+void txresamp_destroy(txresamp _q);
+
+// print txresamp object internals
+void txresamp_print(txresamp _q);
+
+// clear filter states
+void txresamp_reset(txresamp _q);
+
+// get strategy
+int txresamp_get_strategy(txresamp _q);
+
+// get maximum number of output samples for _n input samples
+unsigned int txresamp_max_output(txresamp _q,
+                                 unsigned int _n);
+
+// resample and scale block of baseband samples
+//  _q      :   txresamp object
+//  _x      :   baseband samples [size: _n x 1]
+//  _n      :   number of input samples
+//  _y      :   usrp samples [size: txresamp_max_output(_q,_n) x 1]
+//  returns number of output samples
+unsigned int txresamp_execute(txresamp _q,
+                              std::complex<float> * _x,
+                              unsigned int _n,
+                              std::complex<float> * _y);
+
+// time every strategy on a multi-tone test signal inside the signal
+// band and measure the largest spur anywhere else in the usrp band;
+// returns the fastest strategy meeting the mask or, if none does, the
+// one with the best rejection
+//  _props      :   rates and filter properties
+//  _edge       :   signal band edge [Hz]
+//  _block_len  :   input block length used by the application
+//  _mask       :   required rejection [dB]
+//  _results    :   per-strategy results [size: TXRESAMP_NUM_STRATEGIES x 1]
+int txresamp_calibrate(struct txresamp_props_s * _props,
+                       float _edge,
+                       unsigned int _block_len,
+                       float _mask,
+                       struct txresamp_result_s * _results);
+
+// print calibration results, marking selected strategy
+void txresamp_print_results(struct txresamp_result_s * _results,
+                            int _selected);
+
+// get strategy string
+const char * txresamp_strategy_str(int _strategy);
+
+// get strategy from string (TXRESAMP_AUTO for "auto"), or
+// TXRESAMP_UNKNOWN
+int txresamp_str2strategy(const char * _str);
+
+#endif // __TXRESAMP_H__
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txsched
+//
+// timed burst transmitter for TDMA: baseband bursts tagged with a slot
+// index or an absolute time are up-converted (txfrontend) and handed to
+// the usrp as timed bursts, accounting for late and missed slots against
+// the device clock or a simulated one
+//
+
+#ifndef __TXSCHED_H__
+#define __TXSCHED_H__
+
+#include <complex>
+#include "rateplan.h"
+
+// burst results
+#define TXSCHED_SENT            (0) // handed to device ahead of its time
+#define TXSCHED_LATE            (1) // handed to device with less than the lead time
+#define TXSCHED_MISSED          (2) // time had already passed; dropped
+#define TXSCHED_OVERSIZE        (3) // burst does not fit in its slot; dropped
+#define TXSCHED_NUM_RESULTS     (4)
+
+// device clock callback; returns current device time [s]
+//  _userdata   :   user-defined data pointer
+typedef double (*txsched_clock)(void * _userdata);
+
+// send callback, handing one complete timed burst to the device (i.e.
+// start and end of burst, with time spec); returns number of samples sent
+//  _x          :   usrp samples [size: _n x 1]
+//  _n          :   number of samples
+//  _time       :   device time of first sample [s]
+//  _userdata   :   user-defined data pointer
+typedef unsigned int (*txsched_send)(std::complex<float> * _x,
+                                     unsigned int _n,
+                                     double _time,
+                                     void * _userdata);
+
+typedef struct txsched_s * txsched;
+
+// create txsched object
+//  _plan       :   transmit rate plan (half-band chain)
+//  _gain       :   linear gain applied to output
+//  _max_len    :   maximum burst length [baseband samples]
+//  _send       :   send callback
+//  _userdata   :   user-defined data pointer passed to send callback
+txsched txsched_create(struct rateplan_s * _plan,
+                       float _gain,
+                       unsigned int _max_len,
+                       txsched_send _send,
+                       void * _userdata);
+
+// destroy txsched object
+void txsched_destroy(txsched _q);
+
+// print slot configuration and burst counters
+void txsched_print(txsched _q);
+
+// clear counters and allow slot indices to start over
+void txsched_reset(txsched _q);
+
+// set device clock callback (NULL for simulated clock: the host's
+// monotonic clock, shared by all txsched objects in a process)
+void txsched_set_clock(txsched _q,
+                       txsched_clock _clock,
+                       void * _userdata);
+
+// set slot grid
+//  _q          :   txsched object
+//  _epoch      :   device time of start of slot 0 [s]
+//  _slot_len   :   slot duration [s]
+//  _num_slots  :   slots per TDMA frame
+//  _guard      :   guard time at end of each slot [s]
+void txsched_set_slots(txsched _q,
+                       double _epoch,
+                       double _slot_len,
+                       unsigned int _num_slots,
+                       double _guard);
+
+// set hand-off window: bursts handed to the device less than _lead
+// seconds ahead of their time are late; bursts more than _horizon
+// seconds ahead are held back until within it (0 for no limit)
+void txsched_set_lead(txsched _q,
+                      double _lead,
+                      double _horizon);
+
+// get current device time [s]
+double txsched_get_time(txsched _q);
+
+// get device time of start of slot [s], on the usrp sample grid
+double txsched_get_slot_time(txsched _q,
+                             unsigned long int _slot);
+
+// get next slot index at position _slot within the TDMA frame that is
+// after the last slot sent and at least the lead time ahead
+unsigned long int txsched_next_slot(txsched _q,
+                                    unsigned int _slot);
+
+// up-convert and send burst at start of slot, returning TXSCHED_SENT,
+// _LATE, _MISSED or _OVERSIZE
+//  _q      :   txsched object
+//  _slot   :   absolute slot index
+//  _x      :   baseband samples [size: _n x 1]
+//  _n      :   number of baseband samples, _n <= _max_len
+int txsched_send_slot(txsched _q,
+                      unsigned long int _slot,
+                      const std::complex<float> * _x,
+                      unsigned int _n);
+
+// up-convert and send burst at absolute device time, returning
+// TXSCHED_SENT, _LATE or _MISSED
+//  _q      :   txsched object
+//  _time   :   device time of first sample [s]
+//  _x      :   baseband samples [size: _n x 1]
+//  _n      :   number of baseband samples, _n <= _max_len
+int txsched_send_at(txsched _q,
+                    double _time,
+                    const std::complex<float> * _x,
+                    unsigned int _n);
+
+// get number of bursts with result (TXSCHED_SENT, ...)
+unsigned long int txsched_get_num_results(txsched _q,
+                                          int _result);
+
+// get result string
+const char * txsched_result_str(int _result);
+
+#endif // __TXSCHED_H__
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// blockq
+//
+// The write index is only modified by the producer and the read index
+// only by the consumer; both run modulo twice the number of blocks so
+// that a full queue can be told apart from an empty one.  A full memory
+// barrier orders block contents before the index that publishes them.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "blockq.h"
+
+// blockq data structure
+struct blockq_s {
+    unsigned int num_blocks;            // number of blocks in pool
+    unsigned int block_len;             // samples per block
+    struct blockq_block_s * blocks;     // block pool
+    std::complex<float> * buffer;       // sample memory for all blocks
+
+    volatile unsigned int write_index;  // producer index
+    volatile unsigned int read_index;   // consumer index
+
+    // counters (producer only)
+    unsigned int high_water_mark;       // maximum occupancy
+    unsigned long int num_overflows;    // writes attempted while full
+};
+
+// create blockq object
+//  _num_blocks :   number of blocks in pool (queue capacity)
+//  _block_len  :   number of samples in each block
+blockq blockq_create(unsigned int _num_blocks,
+                     unsigned int _block_len)
+{
+    // validate input
+    if (_num_blocks == 0) {
+        fprintf(stderr,"error: blockq_create(), number of blocks must be greater than zero\n");
+        exit(1);
+    } else if (_block_len == 0) {
+        fprintf(stderr,"error: blockq_create(), block length must be greater than zero\n");
+        exit(1);
+    }
+
+    blockq q = (blockq) malloc(sizeof(struct blockq_s));
+    q->num_blocks = _num_blocks;
+    q->block_len  = _block_len;
+
+    // allocate all sample memory at once
+    q->buffer = (std::complex<float>*) malloc(q->num_blocks*q->block_len*sizeof(std::complex<float>));
+    q->blocks = (struct blockq_block_s*) malloc(q->num_blocks*sizeof(struct blockq_block_s));
+    unsigned int i;
+    for (i=0; i<q->num_blocks; i++) {
+        q->blocks[i].x        = &q->buffer[i*q->block_len];
+        q->blocks[i].capacity = q->block_len;
+        q->blocks[i].n        = 0;
+        q->blocks[i].timestamp = 0.0;
+    }
+
+    blockq_reset(q);
+
+    return q;
+}
+
+// destroy blockq object
+void blockq_destroy(blockq _q)
+{
+    free(_q->blocks);
+    free(_q->buffer);
+
+    // free main object memory
+    free(_q);
+}
+
+// print blockq object internals and counters
+void blockq_print(blockq _q)
+{
+    printf("blockq: %u blocks x %u samples\n", _q->num_blocks, _q->block_len);
+    printf("    occupancy           : %6u / %u\n", blockq_get_occupancy(_q), _q->num_blocks);
+    printf("    high-water mark     : %6u / %u\n", _q->high_water_mark, _q->num_blocks);
+    printf("    overflows           : %6lu\n", _q->num_overflows);
+}
+
+// reset queue (empty) and counters; not thread-safe
+void blockq_reset(blockq _q)
+{
+    _q->write_index     = 0;
+    _q->read_index      = 0;
+    _q->high_water_mark = 0;
+    _q->num_overflows   = 0;
+}
+
+// get next free block to write into, or NULL if the queue is full
+struct blockq_block_s * blockq_write_acquire(blockq _q)
+{
+    if (blockq_get_occupancy(_q) >= _q->num_blocks) {
+        _q->num_overflows++;
+        return NULL;
+    }
+
+    return &_q->blocks[_q->write_index % _q->num_blocks];
+}
+
+// publish block previously obtained with blockq_write_acquire()
+void blockq_write_commit(blockq _q)
+{
+    // ensure block contents are visible before index
+    __sync_synchronize();
+    _q->write_index = (_q->write_index + 1) % (2*_q->num_blocks);
+
+    unsigned int occupancy = blockq_get_occupancy(_q);
+    if (occupancy > _q->high_water_mark)
+        _q->high_water_mark = occupancy;
+}
+
+// get oldest published block, or NULL if the queue is empty
+struct blockq_block_s * blockq_read_acquire(blockq _q)
+{
+    if (_q->read_index == _q->write_index)
+        return NULL;
+
+    // ensure index is read before block contents
+    __sync_synchronize();
+    return &_q->blocks[_q->read_index % _q->num_blocks];
+}
+
+// return block previously obtained with blockq_read_acquire() to pool
+void blockq_read_release(blockq _q)
+{
+    // ensure block is consumed before it can be re-written
+    __sync_synchronize();
+    _q->read_index = (_q->read_index + 1) % (2*_q->num_blocks);
+}
+
+// number of blocks in pool
+unsigned int blockq_get_capacity(blockq _q)
+{
+    return _q->num_blocks;
+}
+
+// number of published blocks waiting to be consumed
+unsigned int blockq_get_occupancy(blockq _q)
+{
+    return (_q->write_index + 2*_q->num_blocks - _q->read_index) % (2*_q->num_blocks);
+}
+
+// maximum occupancy observed since reset
+unsigned int blockq_get_high_water_mark(blockq _q)
+{
+    return _q->high_water_mark;
+}
+
+// number of times the producer found the queue full
+unsigned long int blockq_get_num_overflows(blockq _q)
+{
+    return _q->num_overflows;
+}
+
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// framelog
+//
+// The ring is single-producer/single-consumer in the manner of blockq:
+// the write index is only modified by the callback and the read index
+// only by the drain thread, both running modulo twice the capacity.  The
+// drain thread writes whatever contiguous run of records is available in
+// one fwrite() and sleeps briefly when the ring is empty.
+//
+// A log left with a partial trailing record (e.g. after a crash) is
+// truncated to its last whole record before appending.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "framelog.h"
+
+// drain thread sleep when ring is empty [us]
+#define FRAMELOG_DRAIN_SLEEP    (1000)
+
+// framelog data structure
+struct framelog_s {
+    char * filename;                    // log file name
+    FILE * fid;                         // log file
+    double rate;                        // baseband sample rate [Hz]
+
+    // ring
+    struct framelog_record_s * ring;    // records [size: ring_len x 1]
+    unsigned int ring_len;              // capacity (power of 2)
+    volatile unsigned int write_index;  // producer index
+    volatile unsigned int read_index;   // consumer index
+
+    // drain thread
+    pthread_t thread;
+    volatile int running;
+
+    // counters
+    unsigned long int num_pushed;       // records pushed (producer only)
+    unsigned long int num_dropped;      // records dropped, ring full (producer only)
+    unsigned long int num_written;      // records written (consumer only)
+    unsigned long int num_existing;     // records already in file
+};
+
+// drain thread
+void * framelog_drain_process(void * _userdata);
+
+// write available records to file, returning number written
+unsigned int framelog_drain(framelog _q);
+
+// create frame log, appending to _filename if it is already a frame log
+framelog framelog_create(const char * _filename,
+                         double _rate,
+                         unsigned int _ring_len)
+{
+    if (_ring_len == 0) {
+        fprintf(stderr,"error: framelog_create(), ring length must be greater than zero\n");
+        exit(1);
+    }
+
+    framelog q = (framelog) malloc(sizeof(struct framelog_s));
+    q->filename = strdup(_filename);
+    q->rate     = _rate;
+    q->num_pushed   = 0;
+    q->num_dropped  = 0;
+    q->num_written  = 0;
+    q->num_existing = 0;
+
+    // validate existing log
+    struct framelog_header_s header;
+    struct stat st;
+    int append = stat(_filename, &st) == 0 && st.st_size > 0;
+    if (append) {
+        FILE * fid = fopen(_filename, "rb");
+        if (fid == NULL || fread(&header, sizeof(header), 1, fid) != 1 ||
+            memcmp(header.magic, "FLOG", 4) != 0 ||
+            header.version != FRAMELOG_VERSION ||
+            header.record_size != sizeof(struct framelog_record_s))
+        {
+            fprintf(stderr,"error: framelog_create(), '%s' exists and is not a frame log\n", _filename);
+            exit(1);
+        } else if (header.rate != _rate) {
+            fprintf(stderr,"error: framelog_create(), '%s' was logged at %f Hz (not %f Hz)\n",
+                    _filename, header.rate, _rate);
+            exit(1);
+        }
+        fclose(fid);
+
+        // drop partial trailing record
+        off_t len = st.st_size - sizeof(header);
+        q->num_existing = len / sizeof(struct framelog_record_s);
+        off_t whole = sizeof(header) + q->num_existing*sizeof(struct framelog_record_s);
+        if (whole != st.st_size && truncate(_filename, whole) != 0) {
+            fprintf(stderr,"error: framelog_create(), could not truncate '%s'\n", _filename);
+            exit(1);
+        }
+    }
+
+    q->fid = fopen(_filename, append ? "ab" : "wb");
+    if (q->fid == NULL) {
+        fprintf(stderr,"error: framelog_create(), could not open '%s' for writing\n", _filename);
+        exit(1);
+    }
+    if (!append) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "FLOG", 4);
+        header.version     = FRAMELOG_VERSION;
+        header.record_size = sizeof(struct framelog_record_s);
+        header.rate        = _rate;
+        fwrite(&header, sizeof(header), 1, q->fid);
+    }
+
+    // allocate ring
+    q->ring_len = 1;
+    while (q->ring_len < _ring_len)
+        q->ring_len <<= 1;
+    q->ring = (struct framelog_record_s*) malloc(q->ring_len*sizeof(struct framelog_record_s));
+    q->write_index = 0;
+    q->read_index  = 0;
+
+    // start drain thread
+    q->running = 1;
+    if (pthread_create(&q->thread, NULL, framelog_drain_process, (void*)q) != 0) {
+        fprintf(stderr,"error: framelog_create(), could not create drain thread\n");
+        exit(1);
+    }
+
+    return q;
+}
+
+// drain remaining records, stop thread, close file and destroy log
+void framelog_destroy(framelog _q)
+{
+    _q->running = 0;
+    pthread_join(_q->thread, NULL);
+
+    fclose(_q->fid);
+    free(_q->ring);
+    free(_q->filename);
+
+    // free main object memory
+    free(_q);
+}
+
+// print counters
+void framelog_print(framelog _q)
+{
+    printf("framelog: %s (%u-record ring)\n", _q->filename, _q->ring_len);
+    printf("    existing records    : %12lu\n", _q->num_existing);
+    printf("    records pushed      : %12lu\n", _q->num_pushed);
+    printf("    records written     : %12lu\n", _q->num_written);
+    printf("    records pending     : %12u\n", (_q->write_index - _q->read_index) & (2*_q->ring_len - 1));
+    printf("    records dropped     : %12lu\n", _q->num_dropped);
+}
+
+// push record into ring
+void framelog_push(framelog _q,
+                   struct framelog_record_s * _r)
+{
+    _q->num_pushed++;
+    unsigned int occupancy = (_q->write_index - _q->read_index) & (2*_q->ring_len - 1);
+    if (occupancy >= _q->ring_len) {
+        _q->num_dropped++;
+        return;
+    }
+
+    _q->ring[_q->write_index & (_q->ring_len - 1)] = *_r;
+
+    // ensure record is visible before index
+    __sync_synchronize();
+    _q->write_index = (_q->write_index + 1) & (2*_q->ring_len - 1);
+}
+
+// push frame from synchronizer callback
+void framelog_push_frame(framelog _q,
+                         double _timestamp,
+                         unsigned char * _header,
+                         int _header_valid,
+                         unsigned int _payload_len,
+                         int _payload_valid,
+                         framesyncstats_s * _stats)
+{
+    struct framelog_record_s r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp   = _timestamp;
+    r.packet_id   = _header_valid ? (_header[0] << 8 | _header[1]) : 0;
+    r.flags       = (_header_valid  ? FRAMELOG_HEADER_VALID  : 0) |
+                    (_payload_valid ? FRAMELOG_PAYLOAD_VALID : 0);
+    r.payload_len = _payload_len;
+    r.evm         = _stats->evm;
+    r.rssi        = _stats->rssi;
+    r.cfo         = _stats->cfo;
+    framelog_push(_q, &r);
+}
+
+// drain thread
+void * framelog_drain_process(void * _userdata)
+{
+    framelog q = (framelog) _userdata;
+
+    while (q->running) {
+        if (framelog_drain(q) == 0)
+            usleep(FRAMELOG_DRAIN_SLEEP);
+    }
+
+    // records pushed before stopping
+    while (framelog_drain(q) > 0)
+        ;
+
+    return NULL;
+}
+
+// write available records to file, returning number written
+unsigned int framelog_drain(framelog _q)
+{
+    unsigned int write_index = _q->write_index;
+    if (write_index == _q->read_index)
+        return 0;
+
+    // ensure index is read before records
+    __sync_synchronize();
+
+    // contiguous run up to the end of the ring
+    unsigned int mask = _q->ring_len - 1;
+    unsigned int n = (write_index - _q->read_index) & (2*_q->ring_len - 1);
+    unsigned int i = _q->read_index & mask;
+    if (i + n > _q->ring_len)
+        n = _q->ring_len - i;
+
+    if (fwrite(&_q->ring[i], sizeof(struct framelog_record_s), n, _q->fid) != n)
+        fprintf(stderr,"warning: framelog_drain(), could not write '%s'\n", _q->filename);
+    fflush(_q->fid);
+    _q->num_written += n;
+
+    // ensure records are consumed before they can be re-written
+    __sync_synchronize();
+    _q->read_index = (_q->read_index + n) & (2*_q->ring_len - 1);
+    return n;
+}
+
+//
+// reader
+//
+
+struct framelog_reader_s {
+    FILE * fid;
+    struct framelog_header_s header;
+};
+
+// open frame log for reading
+framelog_reader framelog_reader_open(const char * _filename)
+{
+    framelog_reader q = (framelog_reader) malloc(sizeof(struct framelog_reader_s));
+    q->fid = fopen(_filename, "rb");
+    if (q->fid == NULL) {
+        fprintf(stderr,"error: framelog_reader_open(), could not open '%s' for reading\n", _filename);
+        exit(1);
+    }
+    if (fread(&q->header, sizeof(q->header), 1, q->fid) != 1 ||
+        memcmp(q->header.magic, "FLOG", 4) != 0)
+    {
+        fprintf(stderr,"error: framelog_reader_open(), '%s' is not a frame log\n", _filename);
+        exit(1);
+    } else if (q->header.version != FRAMELOG_VERSION ||
+               q->header.record_size != sizeof(struct framelog_record_s))
+    {
+        fprintf(stderr,"error: framelog_reader_open(), '%s' has unsupported version %u\n",
+                _filename, q->header.version);
+        exit(1);
+    }
+    return q;
+}
+
+// close frame log
+void framelog_reader_close(framelog_reader _q)
+{
+    fclose(_q->fid);
+    free(_q);
+}
+
+// get baseband sample rate [Hz]
+double framelog_reader_get_rate(framelog_reader _q)
+{
+    return _q->header.rate;
+}
+
+// read next record, returning 1 on success, 0 at end of log (a partial
+// trailing record is ignored)
+int framelog_reader_read(framelog_reader _q,
+                         struct framelog_record_s * _r)
+{
+    return fread(_r, sizeof(struct framelog_record_s), 1, _q->fid) == 1;
+}
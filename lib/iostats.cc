@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// iostats.cc
+//
+// usrp i/o accounting
+//
+// Counters are kept both as totals and in one bin per second of host
+// (CLOCK_MONOTONIC) time since the first record.  A receive time stamp
+// later than the previous packet's time plus its duration by more than
+// half a sample counts the difference as lost samples.  Updates take a
+// mutex so that receive and transmit threads may share one object; at
+// one lock per usrp packet the cost is negligible.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "iostats.h"
+
+struct iostats_s {
+    double rx_rate;                     // receive sample rate [Hz]
+    double rx_time_next;                // expected time of next packet [s]
+    int rx_time_valid;                  // rx_time_next valid?
+
+    struct iostats_counters_s total;    // totals
+
+    // per-second time series
+    double time_start;                  // host time of first record [s]
+    int started;                        // any record yet?
+    struct iostats_counters_s * bins;   // bins [num_bins]
+    unsigned int num_bins;              // number of bins in use
+    unsigned int bins_len;              // number of bins allocated
+
+    pthread_mutex_t mutex;
+};
+
+// get host time [s]
+double iostats_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+// get bin for current time, growing the series as needed (mutex held)
+struct iostats_counters_s * iostats_bin(iostats _q)
+{
+    double t = iostats_time();
+    if (!_q->started) {
+        _q->time_start = t;
+        _q->started = 1;
+    }
+    unsigned int k = (unsigned int)(t - _q->time_start);
+
+    if (k >= _q->bins_len) {
+        unsigned int bins_len = _q->bins_len == 0 ? 64 : _q->bins_len;
+        while (k >= bins_len)
+            bins_len *= 2;
+        _q->bins = (struct iostats_counters_s*) realloc(_q->bins, bins_len*sizeof(struct iostats_counters_s));
+        memset(&_q->bins[_q->bins_len], 0, (bins_len - _q->bins_len)*sizeof(struct iostats_counters_s));
+        _q->bins_len = bins_len;
+    }
+    if (k >= _q->num_bins)
+        _q->num_bins = k + 1;
+
+    return &_q->bins[k];
+}
+
+// create iostats object
+iostats iostats_create(double _rx_rate)
+{
+    iostats q = (iostats) malloc(sizeof(struct iostats_s));
+    q->rx_rate  = _rx_rate;
+    q->bins     = NULL;
+    q->bins_len = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    iostats_reset(q);
+    return q;
+}
+
+// destroy iostats object
+void iostats_destroy(iostats _q)
+{
+    pthread_mutex_destroy(&_q->mutex);
+    free(_q->bins);
+    free(_q);
+}
+
+// clear counters and time series
+void iostats_reset(iostats _q)
+{
+    pthread_mutex_lock(&_q->mutex);
+    memset(&_q->total, 0, sizeof(struct iostats_counters_s));
+    if (_q->bins != NULL)
+        memset(_q->bins, 0, _q->bins_len*sizeof(struct iostats_counters_s));
+    _q->num_bins      = 0;
+    _q->started       = 0;
+    _q->time_start    = 0.0;
+    _q->rx_time_next  = 0.0;
+    _q->rx_time_valid = 0;
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// set receive sample rate
+void iostats_set_rx_rate(iostats _q,
+                         double _rx_rate)
+{
+    pthread_mutex_lock(&_q->mutex);
+    _q->rx_rate = _rx_rate;
+    _q->rx_time_valid = 0;
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// record recv() result
+void iostats_rx(iostats _q,
+                unsigned int _n,
+                int _has_time,
+                double _timestamp)
+{
+    pthread_mutex_lock(&_q->mutex);
+    struct iostats_counters_s * bin = iostats_bin(_q);
+
+    if (_n == 0) {
+        _q->total.num_zero_reads++;
+        bin->num_zero_reads++;
+        pthread_mutex_unlock(&_q->mutex);
+        return;
+    }
+
+    // samples missing between the previous packet and this one
+    if (_has_time && _q->rx_time_valid && _q->rx_rate > 0.0) {
+        double gap = (_timestamp - _q->rx_time_next) * _q->rx_rate;
+        if (gap > 0.5) {
+            unsigned long int num_lost = (unsigned long int) floor(gap + 0.5);
+            _q->total.num_lost_samples += num_lost;
+            bin->num_lost_samples      += num_lost;
+        }
+    }
+    if (_has_time && _q->rx_rate > 0.0) {
+        _q->rx_time_next  = _timestamp + (double)_n / _q->rx_rate;
+        _q->rx_time_valid = 1;
+    }
+
+    _q->total.num_rx_samples += _n;
+    _q->total.num_rx_packets++;
+    bin->num_rx_samples += _n;
+    bin->num_rx_packets++;
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// record samples sent
+void iostats_tx(iostats _q,
+                unsigned int _n)
+{
+    pthread_mutex_lock(&_q->mutex);
+    struct iostats_counters_s * bin = iostats_bin(_q);
+    _q->total.num_tx_samples += _n;
+    bin->num_tx_samples += _n;
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// record event
+void iostats_event(iostats _q,
+                   int _event)
+{
+    if (_event < 0 || _event >= IOSTATS_NUM_EVENTS) {
+        fprintf(stderr,"error: iostats_event(), invalid event\n");
+        exit(1);
+    }
+
+    pthread_mutex_lock(&_q->mutex);
+    struct iostats_counters_s * bin = iostats_bin(_q);
+    _q->total.num_events[_event]++;
+    bin->num_events[_event]++;
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// get totals
+void iostats_get_counters(iostats _q,
+                          struct iostats_counters_s * _counters)
+{
+    pthread_mutex_lock(&_q->mutex);
+    memmove(_counters, &_q->total, sizeof(struct iostats_counters_s));
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// print totals and per-second time series
+void iostats_print(iostats _q)
+{
+    pthread_mutex_lock(&_q->mutex);
+    struct iostats_counters_s * c = &_q->total;
+    printf("iostats:\n");
+    printf("    rx samples          : %12lu (%lu packets)\n", c->num_rx_samples, c->num_rx_packets);
+    printf("    rx lost samples     : %12lu\n", c->num_lost_samples);
+    printf("    rx zero-length reads: %12lu\n", c->num_zero_reads);
+    printf("    rx overflows        : %12lu\n", c->num_events[IOSTATS_OVERFLOW]);
+    printf("    tx samples          : %12lu\n", c->num_tx_samples);
+    printf("    tx underflows       : %12lu\n", c->num_events[IOSTATS_UNDERFLOW]);
+    printf("    late packets        : %12lu\n", c->num_events[IOSTATS_LATE]);
+
+    if (_q->num_bins > 0) {
+        printf("    %6s %12s %10s %8s %8s %12s %8s %8s\n",
+                "t [s]", "rx samples", "lost", "zero", "O", "tx samples", "U", "L");
+        unsigned int i;
+        for (i=0; i<_q->num_bins; i++) {
+            c = &_q->bins[i];
+            printf("    %6u %12lu %10lu %8lu %8lu %12lu %8lu %8lu\n",
+                    i,
+                    c->num_rx_samples,
+                    c->num_lost_samples,
+                    c->num_zero_reads,
+                    c->num_events[IOSTATS_OVERFLOW],
+                    c->num_tx_samples,
+                    c->num_events[IOSTATS_UNDERFLOW],
+                    c->num_events[IOSTATS_LATE]);
+        }
+    }
+    pthread_mutex_unlock(&_q->mutex);
+}
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//
+// iqfile.cc
+//
+// raw IQ capture writer and memory-mapped reader
+//
+// The writer copies samples into a small ring of large page-aligned
+// buffers; a writer thread hands each full buffer to the kernel in one
+// write() on a file opened with O_DIRECT, bypassing the page cache so
+// that long captures do not evict everything else.  File systems that
+// refuse O_DIRECT (e.g. tmpfs) fall back to buffered writes.  The last
+// partial buffer is padded to the alignment and the file truncated to
+// its exact length on close.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "iqfile.h"
+#include "sc16.h"
+
+// bytes per disk write
+#define IQFILE_BUFFER_LEN       (1<<22)
+
+// number of write buffers
+#define IQFILE_NUM_BUFFERS      (4)
+
+// buffer/write alignment for O_DIRECT [bytes]
+#define IQFILE_ALIGN            (4096)
+
+// get sample size [bytes]
+unsigned int iqfile_sample_size(int _format)
+{
+    return _format == IQFILE_FORMAT_SC16 ? 2*sizeof(short) : sizeof(std::complex<float>);
+}
+
+// get sample format name
+const char * iqfile_format_str(int _format)
+{
+    switch (_format) {
+    case IQFILE_FORMAT_FC32:    return "fc32";
+    case IQFILE_FORMAT_SC16:    return "sc16";
+    default:;
+    }
+    return "unknown";
+}
+
+// get sample format from name
+int iqfile_format_parse(const char * _str)
+{
+    if (strcmp(_str,"fc32")==0) return IQFILE_FORMAT_FC32;
+    if (strcmp(_str,"sc16")==0) return IQFILE_FORMAT_SC16;
+    return -1;
+}
+
+//
+// writer
+//
+
+struct iqfile_writer_s {
+    int fd;                         // capture file descriptor
+    int direct;                     // file opened with O_DIRECT?
+    FILE * fid_meta;                // sidecar
+    struct iqfile_meta_s meta;      // metadata
+    unsigned int sample_size;       // bytes per sample
+    double time_next;               // expected time of next sample [s]
+
+    // buffer ring: the producer fills buffer[write_index], the writer
+    // thread writes num_full buffers starting at read_index
+    unsigned char * buffer[IQFILE_NUM_BUFFERS];
+    unsigned int buffer_len;        // bytes in buffer being filled
+    unsigned int write_index;
+    unsigned int read_index;
+    unsigned int num_full;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_full;      // buffer published
+    pthread_cond_t  cond_free;      // buffer written
+    pthread_t thread;
+    int running;
+
+    // counters
+    unsigned long int num_writes;   // disk writes
+    unsigned long int num_stalls;   // producer waited on the disk
+};
+
+// writer thread
+void * iqfile_writer_process(void * _userdata);
+
+// write entire buffer to file, falling back to buffered i/o if O_DIRECT
+// is rejected
+void iqfile_writer_flush(iqfile_writer _q,
+                         unsigned char * _buffer,
+                         size_t _len);
+
+// create iqfile writer
+iqfile_writer iqfile_writer_create(const char * _filename,
+                                   int _format,
+                                   double _rate,
+                                   double _frequency,
+                                   double _gain)
+{
+    // validate input
+    if (_format != IQFILE_FORMAT_FC32 && _format != IQFILE_FORMAT_SC16) {
+        fprintf(stderr,"error: iqfile_writer_create(), invalid format\n");
+        exit(1);
+    } else if (_rate <= 0.0) {
+        fprintf(stderr,"error: iqfile_writer_create(), rate must be greater than zero\n");
+        exit(1);
+    }
+
+    iqfile_writer q = (iqfile_writer) malloc(sizeof(struct iqfile_writer_s));
+    memset(&q->meta, 0, sizeof(struct iqfile_meta_s));
+    q->meta.format    = _format;
+    q->meta.rate      = _rate;
+    q->meta.frequency = _frequency;
+    q->meta.gain      = _gain;
+    q->sample_size    = iqfile_sample_size(_format);
+    q->time_next      = 0.0;
+
+    // open capture, bypassing the page cache if possible
+    q->direct = 0;
+#ifdef O_DIRECT
+    q->fd = open(_filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    q->direct = q->fd >= 0;
+    if (q->fd < 0 && errno == EINVAL)
+#endif
+        q->fd = open(_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (q->fd < 0) {
+        fprintf(stderr,"error: iqfile_writer_create(), could not open '%s': %s\n", _filename, strerror(errno));
+        exit(1);
+    }
+
+    // open sidecar and write header
+    char filename_meta[strlen(_filename)+6];
+    sprintf(filename_meta, "%s.meta", _filename);
+    q->fid_meta = fopen(filename_meta, "w");
+    if (!q->fid_meta) {
+        fprintf(stderr,"error: iqfile_writer_create(), could not open '%s'\n", filename_meta);
+        exit(1);
+    }
+    fprintf(q->fid_meta, "# iqfile metadata\n");
+    fprintf(q->fid_meta, "format      = %s\n", iqfile_format_str(_format));
+    fprintf(q->fid_meta, "rate        = %.6f\n", _rate);
+    fprintf(q->fid_meta, "frequency   = %.6f\n", _frequency);
+    fprintf(q->fid_meta, "gain        = %.6f\n", _gain);
+
+    // buffers
+    unsigned int i;
+    for (i=0; i<IQFILE_NUM_BUFFERS; i++) {
+        if (posix_memalign((void**)&q->buffer[i], IQFILE_ALIGN, IQFILE_BUFFER_LEN) != 0) {
+            fprintf(stderr,"error: iqfile_writer_create(), could not allocate buffer\n");
+            exit(1);
+        }
+    }
+    q->buffer_len  = 0;
+    q->write_index = 0;
+    q->read_index  = 0;
+    q->num_full    = 0;
+    q->num_writes  = 0;
+    q->num_stalls  = 0;
+
+    // start writer thread
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->cond_full, NULL);
+    pthread_cond_init(&q->cond_free, NULL);
+    q->running = 1;
+    if (pthread_create(&q->thread, NULL, iqfile_writer_process, (void*)q) != 0) {
+        fprintf(stderr,"error: iqfile_writer_create(), could not create writer thread\n");
+        exit(1);
+    }
+
+    return q;
+}
+
+// flush remaining samples, complete sidecar and destroy writer
+void iqfile_writer_destroy(iqfile_writer _q)
+{
+    // stop writer thread once all full buffers are on disk
+    pthread_mutex_lock(&_q->mutex);
+    _q->running = 0;
+    pthread_cond_signal(&_q->cond_full);
+    pthread_mutex_unlock(&_q->mutex);
+    pthread_join(_q->thread, NULL);
+
+    // write partial buffer, padded to the alignment, then trim padding
+    if (_q->buffer_len > 0) {
+        size_t len = _q->buffer_len;
+        if (_q->direct) {
+            len = (len + IQFILE_ALIGN - 1) & ~(size_t)(IQFILE_ALIGN - 1);
+            memset(_q->buffer[_q->write_index] + _q->buffer_len, 0, len - _q->buffer_len);
+        }
+        iqfile_writer_flush(_q, _q->buffer[_q->write_index], len);
+    }
+    if (ftruncate(_q->fd, (off_t)_q->meta.num_samples * _q->sample_size) != 0)
+        fprintf(stderr,"warning: iqfile_writer_destroy(), could not truncate capture\n");
+    close(_q->fd);
+
+    fprintf(_q->fid_meta, "num_samples = %lu\n", _q->meta.num_samples);
+    fclose(_q->fid_meta);
+
+    unsigned int i;
+    for (i=0; i<IQFILE_NUM_BUFFERS; i++)
+        free(_q->buffer[i]);
+    pthread_mutex_destroy(&_q->mutex);
+    pthread_cond_destroy(&_q->cond_full);
+    pthread_cond_destroy(&_q->cond_free);
+    free(_q);
+}
+
+// print writer counters
+void iqfile_writer_print(iqfile_writer _q)
+{
+    printf("iqfile writer:\n");
+    printf("    format              :   %s%s\n", iqfile_format_str(_q->meta.format),
+            _q->direct ? " (O_DIRECT)" : "");
+    printf("    samples             :   %lu (%.3f s)\n", _q->meta.num_samples,
+            (double)_q->meta.num_samples / _q->meta.rate);
+    printf("    disk writes         :   %lu (%u bytes)\n", _q->num_writes, IQFILE_BUFFER_LEN);
+    printf("    stalls              :   %lu\n", _q->num_stalls);
+    printf("    timestamp events    :   %u\n", _q->meta.num_timestamps);
+    printf("    overflow events     :   %u\n", _q->meta.num_overflows);
+}
+
+// append samples
+void iqfile_writer_write(iqfile_writer _q,
+                         const void * _x,
+                         unsigned int _n,
+                         double _timestamp)
+{
+    if (_n == 0)
+        return;
+
+    // record start time and discontinuities (more than half a sample)
+    if (_q->meta.num_samples == 0 || fabs(_timestamp - _q->time_next)*_q->meta.rate > 0.5) {
+        if (_q->meta.num_samples == 0)
+            _q->meta.time_start = _timestamp;
+        fprintf(_q->fid_meta, "timestamp   %lu %.9f\n", _q->meta.num_samples, _timestamp);
+        _q->meta.num_timestamps++;
+    }
+    _q->time_next = _timestamp + (double)_n / _q->meta.rate;
+    _q->meta.num_samples += _n;
+
+    const unsigned char * x = (const unsigned char*) _x;
+    size_t len = (size_t)_n * _q->sample_size;
+    while (len > 0) {
+        // copy into current buffer
+        size_t k = IQFILE_BUFFER_LEN - _q->buffer_len;
+        k = k < len ? k : len;
+        memmove(_q->buffer[_q->write_index] + _q->buffer_len, x, k);
+        _q->buffer_len += k;
+        x   += k;
+        len -= k;
+
+        if (_q->buffer_len < IQFILE_BUFFER_LEN)
+            break;
+
+        // buffer is full: publish to writer thread and wait for the next
+        // one to become free
+        pthread_mutex_lock(&_q->mutex);
+        _q->num_full++;
+        pthread_cond_signal(&_q->cond_full);
+        _q->write_index = (_q->write_index + 1) % IQFILE_NUM_BUFFERS;
+        _q->buffer_len  = 0;
+        if (_q->num_full == IQFILE_NUM_BUFFERS) {
+            _q->num_stalls++;
+            while (_q->num_full == IQFILE_NUM_BUFFERS)
+                pthread_cond_wait(&_q->cond_free, &_q->mutex);
+        }
+        pthread_mutex_unlock(&_q->mutex);
+    }
+}
+
+// record receive overflow before the next sample
+void iqfile_writer_overflow(iqfile_writer _q,
+                            double _timestamp)
+{
+    fprintf(_q->fid_meta, "overflow    %lu %.9f\n", _q->meta.num_samples, _timestamp);
+    _q->meta.num_overflows++;
+}
+
+// writer thread
+void * iqfile_writer_process(void * _userdata)
+{
+    iqfile_writer q = (iqfile_writer) _userdata;
+
+    pthread_mutex_lock(&q->mutex);
+    while (1) {
+        while (q->num_full == 0 && q->running)
+            pthread_cond_wait(&q->cond_full, &q->mutex);
+        if (q->num_full == 0)
+            break;
+        unsigned char * buffer = q->buffer[q->read_index];
+        pthread_mutex_unlock(&q->mutex);
+
+        iqfile_writer_flush(q, buffer, IQFILE_BUFFER_LEN);
+
+        pthread_mutex_lock(&q->mutex);
+        q->read_index = (q->read_index + 1) % IQFILE_NUM_BUFFERS;
+        q->num_full--;
+        pthread_cond_signal(&q->cond_free);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+}
+
+// write entire buffer to file
+void iqfile_writer_flush(iqfile_writer _q,
+                         unsigned char * _buffer,
+                         size_t _len)
+{
+    while (_len > 0) {
+        ssize_t r = write(_q->fd, _buffer, _len);
+        if (r < 0 && errno == EINTR)
+            continue;
+#ifdef O_DIRECT
+        if (r < 0 && errno == EINVAL && _q->direct) {
+            // file system accepted O_DIRECT on open but not on write
+            fcntl(_q->fd, F_SETFL, fcntl(_q->fd, F_GETFL) & ~O_DIRECT);
+            _q->direct = 0;
+            continue;
+        }
+#endif
+        if (r < 0) {
+            fprintf(stderr,"error: iqfile_writer_flush(), write failed: %s\n", strerror(errno));
+            exit(1);
+        }
+        _buffer += r;
+        _len    -= r;
+        _q->num_writes++;
+    }
+}
+
+//
+// reader
+//
+
+struct iqfile_reader_s {
+    int fd;                         // capture file descriptor
+    unsigned char * map;            // mapped capture (NULL if empty)
+    size_t map_len;                 // mapped length [bytes]
+    struct iqfile_meta_s meta;      // metadata
+    unsigned int sample_size;       // bytes per sample
+    unsigned long int index;        // next sample
+};
+
+// open capture for reading
+iqfile_reader iqfile_reader_open(const char * _filename)
+{
+    iqfile_reader q = (iqfile_reader) malloc(sizeof(struct iqfile_reader_s));
+    memset(&q->meta, 0, sizeof(struct iqfile_meta_s));
+    q->meta.format = IQFILE_FORMAT_FC32;
+    long int num_samples_meta = -1;
+
+    // parse sidecar, if present
+    char filename_meta[strlen(_filename)+6];
+    sprintf(filename_meta, "%s.meta", _filename);
+    FILE * fid = fopen(filename_meta, "r");
+    if (fid) {
+        char line[256];
+        char key[64];
+        char value[64];
+        unsigned long int index;
+        double t;
+        while (fgets(line, sizeof(line), fid) != NULL) {
+            if (sscanf(line, "%63s", key) != 1 || key[0] == '#')
+                continue;
+
+            if (sscanf(line, "timestamp %lu %lf", &index, &t) == 2) {
+                if (q->meta.num_timestamps++ == 0)
+                    q->meta.time_start = t;
+            } else if (sscanf(line, "overflow %lu %lf", &index, &t) == 2) {
+                q->meta.num_overflows++;
+            } else if (sscanf(line, "%63s = %63s", key, value) == 2) {
+                if      (strcmp(key,"format")==0)      q->meta.format = iqfile_format_parse(value);
+                else if (strcmp(key,"rate")==0)        q->meta.rate = atof(value);
+                else if (strcmp(key,"frequency")==0)   q->meta.frequency = atof(value);
+                else if (strcmp(key,"gain")==0)        q->meta.gain = atof(value);
+                else if (strcmp(key,"num_samples")==0) num_samples_meta = atol(value);
+            }
+        }
+        fclose(fid);
+
+        if (q->meta.format < 0) {
+            fprintf(stderr,"error: iqfile_reader_open(), unknown format in '%s'\n", filename_meta);
+            exit(1);
+        }
+    }
+    q->sample_size = iqfile_sample_size(q->meta.format);
+
+    // map capture; a capture cut short (no num_samples in the sidecar)
+    // still holds whole write buffers
+    q->fd = open(_filename, O_RDONLY);
+    if (q->fd < 0) {
+        fprintf(stderr,"error: iqfile_reader_open(), could not open '%s': %s\n", _filename, strerror(errno));
+        exit(1);
+    }
+    struct stat st;
+    fstat(q->fd, &st);
+    q->meta.num_samples = st.st_size / q->sample_size;
+    if (num_samples_meta >= 0 && (unsigned long int)num_samples_meta < q->meta.num_samples)
+        q->meta.num_samples = num_samples_meta;
+
+    q->map_len = q->meta.num_samples * q->sample_size;
+    q->map = NULL;
+    if (q->map_len > 0) {
+        void * map = mmap(NULL, q->map_len, PROT_READ, MAP_PRIVATE, q->fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr,"error: iqfile_reader_open(), could not map '%s'\n", _filename);
+            exit(1);
+        }
+        madvise(map, q->map_len, MADV_SEQUENTIAL);
+        q->map = (unsigned char*) map;
+    }
+
+    q->index = 0;
+    return q;
+}
+
+// close capture
+void iqfile_reader_close(iqfile_reader _q)
+{
+    if (_q->map != NULL)
+        munmap(_q->map, _q->map_len);
+    close(_q->fd);
+    free(_q);
+}
+
+// print capture metadata
+void iqfile_reader_print(iqfile_reader _q)
+{
+    printf("iqfile capture:\n");
+    printf("    format              :   %s\n", iqfile_format_str(_q->meta.format));
+    printf("    rate                :   %12.6f kHz\n", _q->meta.rate*1e-3);
+    printf("    frequency           :   %12.6f MHz\n", _q->meta.frequency*1e-6);
+    printf("    gain                :   %6.2f dB\n", _q->meta.gain);
+    printf("    samples             :   %lu", _q->meta.num_samples);
+    if (_q->meta.rate > 0.0)
+        printf(" (%.3f s)", (double)_q->meta.num_samples / _q->meta.rate);
+    printf("\n");
+    printf("    timestamp events    :   %u (start %.6f s)\n", _q->meta.num_timestamps, _q->meta.time_start);
+    printf("    overflow events     :   %u\n", _q->meta.num_overflows);
+}
+
+// get capture metadata
+struct iqfile_meta_s * iqfile_reader_get_meta(iqfile_reader _q)
+{
+    return &_q->meta;
+}
+
+// rewind to first sample
+void iqfile_reader_rewind(iqfile_reader _q)
+{
+    _q->index = 0;
+}
+
+// seek to sample index
+void iqfile_reader_seek(iqfile_reader _q,
+                        unsigned long int _index)
+{
+    _q->index = _index < _q->meta.num_samples ? _index : _q->meta.num_samples;
+}
+
+// read next block as complex float
+unsigned int iqfile_reader_recv(std::complex<float> * _x,
+                                unsigned int _n,
+                                void * _userdata)
+{
+    iqfile_reader q = (iqfile_reader) _userdata;
+    unsigned long int num_remaining = q->meta.num_samples - q->index;
+    unsigned int n = num_remaining < _n ? (unsigned int)num_remaining : _n;
+
+    const unsigned char * x = q->map + q->index*q->sample_size;
+    if (q->meta.format == IQFILE_FORMAT_SC16)
+        sc16_convert((const short*)x, n, SC16_GAIN_UNITY, _x);
+    else
+        memmove(_x, x, n*sizeof(std::complex<float>));
+
+    q->index += n;
+    return n;
+}
+
+// read next block as sc16
+unsigned int iqfile_reader_recv_sc16(short * _x,
+                                     unsigned int _n,
+                                     void * _userdata)
+{
+    iqfile_reader q = (iqfile_reader) _userdata;
+    unsigned long int num_remaining = q->meta.num_samples - q->index;
+    unsigned int n = num_remaining < _n ? (unsigned int)num_remaining : _n;
+
+    const unsigned char * x = q->map + q->index*q->sample_size;
+    if (q->meta.format == IQFILE_FORMAT_SC16) {
+        memmove(_x, x, 2*n*sizeof(short));
+    } else {
+        // scale, round and saturate
+        const float * v = (const float*) x;
+        unsigned int i;
+        for (i=0; i<2*n; i++) {
+            float s = roundf(v[i] / SC16_GAIN_UNITY);
+            _x[i] = s > 32767.0f ? 32767 : (s < -32768.0f ? -32768 : (short)s);
+        }
+    }
+
+    q->index += n;
+    return n;
+}
@@ -30,50 +30,141 @@
 #include <string.h>
 #include <math.h>
 #include <complex>
+#include <vector>
+#include <pthread.h>
+#include <limits.h>
 
 #include <liquid/liquid.h>
-#include <uhd/types/stream_cmd.hpp>
-#include <uhd/usrp/single_usrp.hpp>
 
 #include "iqpr.h"
+#include "blockq.h"
+#include "profile.h"
+#include "timer.h"
+
+// stopband attenuation of host resampling chains [dB]
+#define IQPR_RATEPLAN_AS    (60.0f)
+
+// sample buffer alignment (cache line) [bytes]
+#define IQPR_ALIGN          (64)
+
+// continuous transmitter chunk size [samples]
+#define IQPR_TX_CHUNK_LEN   (256)
+
+// rendered frame (transmit cache entry)
+struct iqprtxcache_s {
+    int valid;                      // entry in use?
+    unsigned int key;               // hash of header, payload, properties
+    unsigned char header[14];       // frame header
+    unsigned char * payload;        // frame payload
+    unsigned int payload_len;       // number of bytes in payload
+    ofdmflexframegenprops_s fgprops;    // frame generator properties
+    std::complex<float> * samples;  // rendered samples
+    unsigned int num_samples;       // number of rendered samples
+    unsigned int payload_cap;       // allocated payload length
+    unsigned int samples_cap;       // allocated samples length
+    unsigned long int last_used;    // least-recently-used stamp
+};
 
 // iqpr data structure
 struct iqpr_s {
-    // UHD interface to hardware
-    uhd::usrp::single_usrp::sptr usrp;
+    // sample source/sink (usrp, file, loopback)
+    iqpr_backend backend;
 
     //
-    unsigned int M;                 // number of subcarriers
-    unsigned int cp_len;            // cyclic prefix length
-    unsigned char * p;              // subcarrier allocation
+    unsigned int M;                 // number of subcarriers (transmitter)
+    unsigned int cp_len;            // cyclic prefix length (transmitter)
+    unsigned char * p;              // subcarrier allocation (transmitter)
+    unsigned int rx_M;              // number of subcarriers (receiver)
+    unsigned int rx_cp_len;         // cyclic prefix length (receiver)
+    unsigned char * rx_p;           // subcarrier allocation (receiver)
+    pthread_mutex_t tx_mutex;       // generator, tx chain (reconfiguration)
+    pthread_mutex_t rx_mutex;       // synchronizer, rx chain (reconfiguration)
 
     // receiver
     std::vector<std::complex<float> > * rx_buffer;    // rx data buffer
+    std::complex<float> * rx_vector;                // current rx block
     unsigned int rx_vector_index;                   // index of rx buffer vector
     unsigned int rx_vector_length;                  // length of rx buffer vector
-    resamp2_crcf rx_decim;          // half-band decimator
+    resamp2_crcf rx_decim[RATEPLAN_MAX_HALFBAND];   // half-band decimators
+    unsigned int rx_num_halfband;   // number of half-band stages
     resamp_crcf rx_resamp;          // arbitrary resampler
+    struct rateplan_s rx_plan;      // receive rate plan
     ofdmflexframesync fs;               // frame synchronizer
-    int rx_packet_found;            // receiver packet found flag
-    unsigned char rx_header[14];    // received frame header
-    int rx_header_valid;            // receiver frame header valid?
-    unsigned char * rx_payload;        // received payload data
-    unsigned int rx_payload_len;       // received payload data length
-    int rx_payload_valid;           // receiver payload data valid?
-    framesyncstats_s rx_stats;      // frame synchronizer stats
+
+    // receive timing (usrp clock)
+    double rx_usrp_rate;            // usrp receive sample rate
+    double rx_resamp_rate;          // arbitrary resampling rate
+    double rx_vector_time;          // time of first sample in rx_vector [s]
+    double rx_resamp_time;          // time of first pending resampled sample [s]
+    double rx_sync_time;            // time at end of synchronizer input [s]
+
+    // received frame queue
+    unsigned int rx_queue_len;      // maximum number of queued frames
+    unsigned int rx_payload_max;    // payload buffer length per frame
+    struct iqprframe_s * rx_frames; // queue entries
+    unsigned char * rx_payload_pool;    // payload buffers for all entries
+    unsigned int rx_queue_read;     // index of oldest frame
+    unsigned int rx_queue_size;     // number of queued frames
+    int rx_frame_borrowed;          // oldest frame lent to user?
+    unsigned long int rx_num_frames;        // frames received
+    unsigned long int rx_num_drops_full;    // frames dropped on full queue
+    unsigned long int rx_num_drops_oversize;// frames dropped (payload too long)
+
+    // block-mode receiver
+    int rx_block_mode;              // process entire usrp blocks at once?
+    std::complex<float> rx_decim_in[RATEPLAN_MAX_HALFBAND][2];  // decimator inputs
+    unsigned int rx_decim_n[RATEPLAN_MAX_HALFBAND]; // samples in decimator inputs
+    std::complex<float> * rx_buffer_decim;  // decimated samples
+    std::complex<float> * rx_buffer_resamp; // resampled samples (pending sync)
+    unsigned int rx_resamp_index;   // index of next sample to synchronize
+    unsigned int rx_resamp_length;  // number of resampled samples
+    unsigned int rx_sync_len;       // synchronizer chunk size
+
+    // streaming receiver
+    int rx_streaming;               // receive on background thread?
+    unsigned int rx_ring_len;       // number of blocks in receive ring
+    blockq rx_ring;                 // receive ring (rx thread > rxpacket)
+    struct blockq_block_s * rx_block;   // ring block being consumed
+    pthread_t rx_thread;            // receive thread
+    volatile int rx_thread_running; // receive thread run flag
+    unsigned long int rx_num_dropped;   // samples dropped on full ring
 
     // transmitter
     unsigned char * tx_data;        // transmitted payload data
     unsigned int tx_data_len;       // transmitted payload data length
     ofdmflexframegenprops_s fgprops;    // frame generator properties
     ofdmflexframegen fg;                // frame generator
-    resamp2_crcf tx_interp;         // half-band interpolator
+    resamp2_crcf tx_interp[RATEPLAN_MAX_HALFBAND];  // half-band interpolators
+    unsigned int tx_num_halfband;   // number of half-band stages
     resamp_crcf tx_resamp;          // arbitrary resampler
-    //std::complex<float> * frame;    // frame buffer
-    std::complex<float> data_tx[32];                // tx data buffer (array)
-    std::complex<float> data_tx_interp[128];        // tx interpolated
-    std::complex<float> data_tx_resamp[256];        // tx resampled
-    std::vector<std::complex<float> > tx_buffer;    // tx data buffer
+    double tx_resamp_rate;          // arbitrary resampling rate
+    struct rateplan_s tx_plan;      // transmit rate plan
+
+    // scratch buffers (aligned, sized by iqpr_tx_alloc_buffers())
+    std::complex<float> * data_tx;          // generated symbol
+    std::complex<float> * data_tx_interp;   // interpolated symbol
+    std::complex<float> * data_tx_resamp;   // resampled symbol
+    unsigned int data_tx_resamp_len;        // allocated length of data_tx_resamp
+    std::complex<float> * tx_buffer;        // continuous send chunk
+
+    // burst-mode transmitter
+    int tx_burst_mode;              // render frame, send as single burst?
+    std::complex<float> * tx_render;    // rendered frame buffer
+    unsigned int tx_render_len;     // allocated length of render buffer
+    unsigned int tx_max_samps;      // max samples per usrp send packet
+    timer tx_timer;                 // burst send timer
+    unsigned long int tx_num_bursts;    // number of bursts sent
+    unsigned int tx_burst_samples;  // samples in last burst
+    float tx_burst_latency;         // send latency of last burst [s]
+
+    // rendered frame cache (retransmissions)
+    struct iqprtxcache_s * tx_cache;    // cache entries
+    unsigned int tx_cache_len;      // number of entries (0: disabled)
+    unsigned long int tx_cache_max_bytes;   // memory cap
+    unsigned long int tx_cache_bytes;       // buffer memory held by entries
+    unsigned long int tx_cache_clock;       // lru counter
+    unsigned long int tx_cache_hits;        // frames sent from cache
+    unsigned long int tx_cache_misses;      // frames rendered
 
     // debugging
     int verbose;
@@ -87,60 +178,84 @@ struct iqpr_s {
 
 // create iqpr object
 iqpr iqpr_create()
+{
+    return iqpr_create_backend(iqpr_backend_create_uhd());
+}
+
+// create iqpr object on backend (object takes ownership of backend)
+iqpr iqpr_create_backend(iqpr_backend _backend)
 {
     // allocate memory for main object
     iqpr q = (iqpr) malloc(sizeof(struct iqpr_s));
-
-    // TODO : create USRP object
-    uhd::device_addr_t dev_addr;
-    // TODO : set up address as necessary
-    q->usrp = uhd::usrp::single_usrp::make(dev_addr);
-
-    // set some properties
-    q->usrp->set_rx_antenna("TX/RX");
-    //q->usrp->set_rx_antenna("RX2");
-    // some hacked magic to 'disable' receive chain when transmitting
-    // (from http://www.ruby-forum.com/topic/1527488)
-    //q->usrp->set_rx_lo_freq((_freq_range.start() + _freq_range.stop())/2.0);
+    q->backend = _backend;
 
     //
     // common
     //
+    // default subcarrier layout (transmitter and receiver); changed with
+    // iqpr_txconfig() and iqpr_rxconfig()
     q->M = 40;      // number of subcarriers
     q->cp_len = 8;  // cyclic prefix length
-    q->p = NULL;    // subcarrier allocation (NULL gives default)
-    q->p = (unsigned char*)malloc(q->M*sizeof(unsigned char));
-    unsigned int guard = q->M / 6;
-    unsigned int pilot_spacing = 8;
-    unsigned int i0 = (q->M/2) - guard;
-    unsigned int i1 = (q->M/2) + guard;
+    q->p = iqpr_subcarriers_create(q->M, NULL);
+    q->rx_M      = q->M;
+    q->rx_cp_len = q->cp_len;
+    q->rx_p      = iqpr_subcarriers_create(q->M, q->p);
+    pthread_mutex_init(&q->tx_mutex, NULL);
+    pthread_mutex_init(&q->rx_mutex, NULL);
     unsigned int i;
-    for (i=0; i<q->M; i++) {
-        if ( i == 0 || (i > i0 && i < i1) )
-            q->p[i] = OFDMFRAME_SCTYPE_NULL;
-        else if ( (i%pilot_spacing)==0 )
-            q->p[i] = OFDMFRAME_SCTYPE_PILOT;
-        else
-            q->p[i] = OFDMFRAME_SCTYPE_DATA;
-    }
 
     // 
     // receiver objects
     //
-    const size_t max_samps_per_packet = q->usrp->get_device()->get_max_recv_samps_per_packet();
+    const size_t max_samps_per_packet = q->backend->max_recv_samps;
     q->rx_buffer = new std::vector< std::complex<float> >(max_samps_per_packet);
     printf("rx buffer size: %u\n", (unsigned int)(q->rx_buffer->size()));
+    q->rx_vector = &q->rx_buffer->front();
     q->rx_vector_index  = 0;
     q->rx_vector_length = 0;
     q->rx_resamp = resamp_crcf_create(1.0, 7, 0.4, 60.0, 64);
-    q->rx_decim = resamp2_crcf_create(7, 0.0, 40.0);
+    q->rx_decim[0] = resamp2_crcf_create(7, 0.0, 40.0);
+    q->rx_num_halfband = 1;     // re-planned by iqpr_set_rx_rate()
+    q->rx_plan.hw_factor = 0;
+
+    // receive timing
+    q->rx_usrp_rate   = 1.0;    // set by iqpr_set_rx_rate()
+    q->rx_resamp_rate = 1.0;
+    q->rx_vector_time = 0.0;
+    q->rx_resamp_time = 0.0;
+    q->rx_sync_time   = 0.0;
+
+    // block-mode buffers: the first half-band stage yields at most half of
+    // each usrp block (later stages decimate in place), and the resampler
+    // at most two outputs per input (no half-band stages)
+    q->rx_block_mode = 0;
+    for (i=0; i<RATEPLAN_MAX_HALFBAND; i++)
+        q->rx_decim_n[i] = 0;
+    q->rx_buffer_decim  = (std::complex<float>*) malloc((max_samps_per_packet/2 + 1)*sizeof(std::complex<float>));
+    q->rx_buffer_resamp = (std::complex<float>*) malloc((2*max_samps_per_packet + 4)*sizeof(std::complex<float>));
+    q->rx_resamp_index  = 0;
+    q->rx_resamp_length = 0;
+
+    // streaming receiver (ring is allocated when enabled)
+    q->rx_streaming      = 0;
+    q->rx_ring_len       = 0;
+    q->rx_ring           = NULL;
+    q->rx_block          = NULL;
+    q->rx_thread_running = 0;
+    q->rx_num_dropped    = 0;
 
     // create frame synchronizer
-    q->fs = ofdmflexframesync_create(q->M, q->cp_len, q->p, iqpr_callback, (void*)q);
+    q->fs = ofdmflexframesync_create(q->rx_M, q->rx_cp_len, q->rx_p, iqpr_callback, (void*)q);
+
+    // synchronize in chunks shorter than the shortest possible frame (S0,
+    // S1 and header symbols) so iqpr_rxpacket() returns soon after the
+    // first frame is found
+    q->rx_sync_len = 4*(q->rx_M + q->rx_cp_len);
 
-    // allocate memory for received data
-    q->rx_payload_len = 1024;
-    q->rx_payload = (unsigned char*) malloc(q->rx_payload_len*sizeof(unsigned char));
+    // allocate memory for received frame queue
+    q->rx_frames       = NULL;
+    q->rx_payload_pool = NULL;
+    iqpr_set_rx_queue(q, 16, 2048);
 
 
     // 
@@ -162,12 +277,35 @@ iqpr iqpr_create()
     q->fg = ofdmflexframegen_create(q->M, q->cp_len, q->p, &q->fgprops);
     ofdmflexframegen_print(q->fg);
 
-    // create interpolator
-    q->tx_interp = resamp2_crcf_create(7,0.0f,40.0f);
+    // create interpolator (re-planned by iqpr_set_tx_rate())
+    q->tx_interp[0] = resamp2_crcf_create(7,0.0f,40.0f);
+    q->tx_num_halfband = 1;
+    q->tx_plan.hw_factor = 0;
 
     q->tx_resamp = resamp_crcf_create(1.0, 7, 0.4, 60.0, 64);
-
-    //q->tx_buffer.resize(1);
+    q->tx_resamp_rate = 1.0;
+
+    // scratch buffers
+    q->data_tx        = NULL;
+    q->data_tx_interp = NULL;
+    q->data_tx_resamp = NULL;
+    q->tx_buffer      = iqpr_malloc_samples(IQPR_TX_CHUNK_LEN);
+    iqpr_tx_alloc_buffers(q);
+
+    // burst-mode transmitter (render buffer grows to longest frame)
+    q->tx_burst_mode    = 0;
+    q->tx_render_len    = 16384;
+    q->tx_render        = iqpr_malloc_samples(q->tx_render_len);
+    q->tx_max_samps     = q->backend->max_send_samps;
+    q->tx_timer         = timer_create();
+    q->tx_num_bursts    = 0;
+    q->tx_burst_samples = 0;
+    q->tx_burst_latency = 0.0f;
+
+    // rendered frame cache (disabled; continuous packets stream in chunks)
+    q->tx_cache     = NULL;
+    q->tx_cache_len = 0;
+    iqpr_set_tx_cache(q, 0, 0);
 
     // set hardware transmit/receive gains
     iqpr_set_tx_gain(q, 40.0f);
@@ -184,26 +322,54 @@ void iqpr_destroy(iqpr _q)
     // 
     // common objects
     //
-    if (_q->p != NULL)
-        free(_q->p);
+    free(_q->p);
+    free(_q->rx_p);
+
+    // stop receive thread if still running
+    if (_q->rx_thread_running)
+        iqpr_rx_stop(_q);
 
     // destroy receiver buffer
     delete _q->rx_buffer;
+    if (_q->rx_ring != NULL)
+        blockq_destroy(_q->rx_ring);
 
     // 
     // receiver objects
     //
+    unsigned int i;
     resamp_crcf_destroy(_q->rx_resamp);
-    resamp2_crcf_destroy(_q->rx_decim);
+    for (i=0; i<_q->rx_num_halfband; i++)
+        resamp2_crcf_destroy(_q->rx_decim[i]);
     ofdmflexframesync_destroy(_q->fs);
-    free(_q->rx_payload);
+    free(_q->rx_frames);
+    free(_q->rx_payload_pool);
+    free(_q->rx_buffer_decim);
+    free(_q->rx_buffer_resamp);
 
     // 
     // transmitter objects
     //
     ofdmflexframegen_destroy(_q->fg);
-    resamp2_crcf_destroy(_q->tx_interp);
+    for (i=0; i<_q->tx_num_halfband; i++)
+        resamp2_crcf_destroy(_q->tx_interp[i]);
     resamp_crcf_destroy(_q->tx_resamp);
+    free(_q->data_tx);
+    free(_q->data_tx_interp);
+    free(_q->data_tx_resamp);
+    free(_q->tx_buffer);
+    free(_q->tx_render);
+    timer_destroy(_q->tx_timer);
+    for (i=0; i<_q->tx_cache_len; i++)
+        iqpr_tx_cache_evict(_q, &_q->tx_cache[i]);
+    free(_q->tx_cache);
+
+    // destroy backend
+    iqpr_backend_destroy(_q->backend);
+
+    // destroy locks last (iqpr_rx_stop() takes rx_mutex)
+    pthread_mutex_destroy(&_q->tx_mutex);
+    pthread_mutex_destroy(&_q->rx_mutex);
 
     // free main object memory
     free(_q);
@@ -212,6 +378,40 @@ void iqpr_destroy(iqpr _q)
 void iqpr_print(iqpr _q)
 {
     printf("iqpr:\n");
+    printf("    tx subcarriers      : %u (cyclic prefix %u)\n", _q->M, _q->cp_len);
+    printf("    rx subcarriers      : %u (cyclic prefix %u)\n", _q->rx_M, _q->rx_cp_len);
+    printf("    rx mode             : %s, %s\n",
+            _q->rx_block_mode ? "block" : "sample",
+            _q->rx_streaming  ? "streaming" : "direct");
+    unsigned long int num_frames, num_drops_full, num_drops_oversize;
+    iqpr_get_rx_queue_stats(_q, &num_frames, &num_drops_full, &num_drops_oversize);
+    printf("    rx frame queue      : %u frames x %u bytes\n", _q->rx_queue_len, _q->rx_payload_max);
+    printf("    rx frames           : %6lu (dropped: %lu queue full, %lu oversize)\n",
+            num_frames, num_drops_full, num_drops_oversize);
+    if (_q->rx_streaming) {
+        unsigned int occupancy, high_water_mark;
+        unsigned long int num_overflows;
+        iqpr_get_rx_ring_stats(_q, &occupancy, &high_water_mark, &num_overflows);
+        printf("    rx ring occupancy   : %6u / %u\n", occupancy, _q->rx_ring_len);
+        printf("    rx ring high-water  : %6u / %u\n", high_water_mark, _q->rx_ring_len);
+        printf("    rx ring overflows   : %6lu (%lu samples dropped)\n",
+                num_overflows, _q->rx_num_dropped);
+    }
+    printf("    tx mode             : %s\n", _q->tx_burst_mode ? "burst" : "continuous");
+    if (_q->tx_burst_mode) {
+        printf("    tx bursts           : %6lu (last: %u samples, %.3f ms)\n",
+                _q->tx_num_bursts, _q->tx_burst_samples, _q->tx_burst_latency*1e3f);
+    }
+    if (_q->tx_cache_len > 0) {
+        printf("    tx frame cache      : %6lu hits, %lu misses (%lu / %lu bytes)\n",
+                _q->tx_cache_hits, _q->tx_cache_misses,
+                _q->tx_cache_bytes, _q->tx_cache_max_bytes);
+    }
+    iostats_print(_q->backend->stats);
+    if (_q->rx_plan.hw_factor > 0)
+        rateplan_print(&_q->rx_plan);
+    if (_q->tx_plan.hw_factor > 0)
+        rateplan_print(&_q->tx_plan);
 }
 
 // set verbosity on
@@ -226,16 +426,209 @@ void iqpr_unset_verbose(iqpr _q)
     _q->verbose = 0;
 }
 
+// enable block-mode receiver
+void iqpr_set_rx_block_mode(iqpr _q)
+{
+    _q->rx_block_mode = 1;
+}
+
+// disable block-mode receiver (process one sample at a time)
+void iqpr_unset_rx_block_mode(iqpr _q)
+{
+    _q->rx_block_mode = 0;
+}
+
+// enable burst-mode transmitter
+void iqpr_set_tx_burst_mode(iqpr _q)
+{
+    _q->tx_burst_mode = 1;
+    iqpr_tx_cache_clear(_q);    // zero tail differs
+}
+
+// disable burst-mode transmitter (continuous stream of fixed chunks)
+void iqpr_unset_tx_burst_mode(iqpr _q)
+{
+    _q->tx_burst_mode = 0;
+    iqpr_tx_cache_clear(_q);
+}
+
+// get burst-mode transmitter counters
+void iqpr_get_tx_burst_stats(iqpr _q,
+                             unsigned long int * _num_bursts,
+                             unsigned int *      _num_samples,
+                             float *             _latency)
+{
+    *_num_bursts  = _q->tx_num_bursts;
+    *_num_samples = _q->tx_burst_samples;
+    *_latency     = _q->tx_burst_latency;
+}
+
+// set rendered frame cache size; frames are rendered once and resent
+// from the cache while header, payload and properties are unchanged
+//  _q              :   iqpr object
+//  _num_entries    :   maximum number of cached frames (0 disables)
+//  _max_bytes      :   maximum buffer memory held by cache entries
+void iqpr_set_tx_cache(iqpr _q,
+                       unsigned int _num_entries,
+                       unsigned long int _max_bytes)
+{
+    unsigned int i;
+    if (_q->tx_cache != NULL) {
+        for (i=0; i<_q->tx_cache_len; i++)
+            iqpr_tx_cache_evict(_q, &_q->tx_cache[i]);
+        free(_q->tx_cache);
+    }
+
+    _q->tx_cache_len       = _num_entries;
+    _q->tx_cache_max_bytes = _max_bytes;
+    _q->tx_cache = (struct iqprtxcache_s*) malloc((_num_entries > 0 ? _num_entries : 1)*sizeof(struct iqprtxcache_s));
+    for (i=0; i<_q->tx_cache_len; i++) {
+        _q->tx_cache[i].valid       = 0;
+        _q->tx_cache[i].payload     = NULL;
+        _q->tx_cache[i].samples     = NULL;
+        _q->tx_cache[i].payload_cap = 0;
+        _q->tx_cache[i].samples_cap = 0;
+    }
+
+    _q->tx_cache_bytes  = 0;
+    _q->tx_cache_clock  = 0;
+    _q->tx_cache_hits   = 0;
+    _q->tx_cache_misses = 0;
+}
+
+// get rendered frame cache counters
+void iqpr_get_tx_cache_stats(iqpr _q,
+                             unsigned long int * _num_hits,
+                             unsigned long int * _num_misses,
+                             unsigned long int * _num_bytes)
+{
+    *_num_hits   = _q->tx_cache_hits;
+    *_num_misses = _q->tx_cache_misses;
+    *_num_bytes  = _q->tx_cache_bytes;
+}
+
+// enable streaming receiver: a background thread owns recv() and pushes
+// usrp blocks into a ring of _ring_len blocks consumed by iqpr_rxpacket()
+void iqpr_set_rx_streaming(iqpr _q,
+                           unsigned int _ring_len)
+{
+    if (_q->rx_thread_running) {
+        fprintf(stderr,"warning: iqpr_set_rx_streaming(), receiver is running; ignoring\n");
+        return;
+    } else if (_ring_len < 2) {
+        fprintf(stderr,"error: iqpr_set_rx_streaming(), ring length must be at least 2\n");
+        exit(1);
+    }
+
+    // re-create ring if necessary
+    if (_q->rx_ring != NULL && _q->rx_ring_len != _ring_len) {
+        blockq_destroy(_q->rx_ring);
+        _q->rx_ring = NULL;
+    }
+    if (_q->rx_ring == NULL)
+        _q->rx_ring = blockq_create(_ring_len, _q->rx_buffer->size());
+
+    _q->rx_ring_len  = _ring_len;
+    _q->rx_streaming = 1;
+}
+
+// disable streaming receiver (read from usrp inside iqpr_rxpacket())
+void iqpr_unset_rx_streaming(iqpr _q)
+{
+    if (_q->rx_thread_running) {
+        fprintf(stderr,"warning: iqpr_unset_rx_streaming(), receiver is running; ignoring\n");
+        return;
+    }
+    _q->rx_streaming = 0;
+}
+
+// get receive ring counters (streaming mode)
+//  _q                  :   iqpr object
+//  _occupancy          :   number of blocks waiting in ring
+//  _high_water_mark    :   maximum occupancy since receiver was started
+//  _num_overflows      :   number of usrp blocks dropped on full ring
+void iqpr_get_rx_ring_stats(iqpr _q,
+                            unsigned int *      _occupancy,
+                            unsigned int *      _high_water_mark,
+                            unsigned long int * _num_overflows)
+{
+    if (_q->rx_ring == NULL) {
+        *_occupancy       = 0;
+        *_high_water_mark = 0;
+        *_num_overflows   = 0;
+        return;
+    }
+    *_occupancy       = blockq_get_occupancy(_q->rx_ring);
+    *_high_water_mark = blockq_get_high_water_mark(_q->rx_ring);
+    *_num_overflows   = blockq_get_num_overflows(_q->rx_ring);
+}
+
+// get usrp i/o accounting
+iostats iqpr_get_iostats(iqpr _q)
+{
+    return _q->backend->stats;
+}
+
+// set received frame queue size; frames are copied by the synchronizer
+// callback into preallocated entries and dequeued by iqpr_rxframe()
+//  _q              :   iqpr object
+//  _queue_len      :   maximum number of queued frames
+//  _payload_max    :   maximum payload length [bytes]
+void iqpr_set_rx_queue(iqpr _q,
+                       unsigned int _queue_len,
+                       unsigned int _payload_max)
+{
+    if (_q->rx_thread_running) {
+        fprintf(stderr,"warning: iqpr_set_rx_queue(), receiver is running; ignoring\n");
+        return;
+    } else if (_queue_len == 0) {
+        fprintf(stderr,"error: iqpr_set_rx_queue(), queue length must be greater than zero\n");
+        exit(1);
+    }
+
+    _q->rx_queue_len   = _queue_len;
+    _q->rx_payload_max = _payload_max;
+    _q->rx_frames       = (struct iqprframe_s*) realloc(_q->rx_frames, _q->rx_queue_len*sizeof(struct iqprframe_s));
+    _q->rx_payload_pool = (unsigned char*) realloc(_q->rx_payload_pool, _q->rx_queue_len*_q->rx_payload_max*sizeof(unsigned char));
+
+    unsigned int i;
+    for (i=0; i<_q->rx_queue_len; i++)
+        _q->rx_frames[i].payload = &_q->rx_payload_pool[i*_q->rx_payload_max];
+
+    _q->rx_queue_read          = 0;
+    _q->rx_queue_size          = 0;
+    _q->rx_frame_borrowed      = 0;
+    _q->rx_num_frames          = 0;
+    _q->rx_num_drops_full      = 0;
+    _q->rx_num_drops_oversize  = 0;
+}
+
+// get received frame queue counters
+//  _q                  :   iqpr object
+//  _num_frames         :   number of frames received by the synchronizer
+//  _num_drops_full     :   number of frames dropped because queue was full
+//  _num_drops_oversize :   number of frames dropped because payload was
+//                          longer than the queue's payload buffers
+void iqpr_get_rx_queue_stats(iqpr _q,
+                             unsigned long int * _num_frames,
+                             unsigned long int * _num_drops_full,
+                             unsigned long int * _num_drops_oversize)
+{
+    *_num_frames         = _q->rx_num_frames;
+    *_num_drops_full     = _q->rx_num_drops_full;
+    *_num_drops_oversize = _q->rx_num_drops_oversize;
+}
+
 // set transmit/receive hardware gain
 void iqpr_set_tx_gain(iqpr _q, float _tx_gain)
 {
-    _q->usrp->set_tx_gain(_tx_gain);
+    _q->backend->set_tx_gain(_q->backend->userdata, _tx_gain);
 }
 
 // set transmit/receive hardware gain
 void iqpr_set_rx_gain(iqpr _q, float _rx_gain)
 {
-    _q->usrp->set_rx_gain(_rx_gain);
+    _q->backend->set_rx_gain(_q->backend->userdata, _rx_gain);
 }
 
 #if 0
@@ -249,37 +642,38 @@ void iqpr_set_tx_rate(iqpr _q, float _tx_rate)
 {
     unsigned long int DAC_RATE = 64e6;
 
-    // over-sampling by a factor of 4
-    _tx_rate *= 4.0;
+    // frame generator runs at twice the signal bandwidth
+    double baseband_rate = 2.0 * _tx_rate;
 
-    unsigned int interp_rate = (unsigned int)(DAC_RATE / _tx_rate);
-    // ensure multiple of 4
-    interp_rate = (interp_rate >> 2) << 2;
-    
-    //
-    while (interp_rate == 240 || interp_rate == 244)
-        interp_rate -= 4;
+    // choose interpolation and host chain
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_TX, DAC_RATE, baseband_rate,
+                        IQPR_RATEPLAN_AS, RATEPLAN_CHAIN_HALFBAND) != 0)
+    {
+        fprintf(stderr,"error: iqpr_set_tx_rate(), no rate plan for %f kHz\n", _tx_rate*1e-3f);
+        exit(1);
+    }
 
-    // compute usrp sampling rate
-    double usrp_tx_rate = DAC_RATE / (double)interp_rate;
+    // set hardware sampling rate, get actual rate
+    double usrp_tx_rate = _q->backend->set_tx_rate(_q->backend->userdata, plan.usrp_rate);
 
-    // set hardware sampling rate
-    _q->usrp->set_tx_rate(usrp_tx_rate);
+    // correct arbitrary resampling rate
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
 
-    // get actual rate
-    usrp_tx_rate = _q->usrp->get_tx_rate();
+    // re-create interpolators and resampler
+    pthread_mutex_lock(&_q->tx_mutex);
+    iqpr_tx_set_plan(_q, &plan);
 
-    // compute arbitrary resampling rate
-    double tx_resamp_rate = usrp_tx_rate / _tx_rate;
-    
-    // set software resampling rate
-    resamp_crcf_setrate(_q->tx_resamp, tx_resamp_rate);
+    // cached frames were rendered at the old rate
+    iqpr_tx_cache_clear(_q);
+    pthread_mutex_unlock(&_q->tx_mutex);
 
-    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (interp %u)\n",
-            _tx_rate * 1e-3f,
+    printf("sample rate :   %12.8f kHz = %12.8f / %8.6f (interp %u, %u half-band)\n",
+            baseband_rate * 1e-3f,
             usrp_tx_rate * 1e-3f,
-            1.0f / tx_resamp_rate,
-            interp_rate);
+            usrp_tx_rate / baseband_rate,
+            plan.hw_factor,
+            plan.num_halfband);
 }
 
 // set transmit/receive sample rate
@@ -287,125 +681,260 @@ void iqpr_set_rx_rate(iqpr _q, float _rx_rate)
 {
     unsigned long int ADC_RATE = 64e6;
 
-    // over-sampling by a factor of 4
-    _rx_rate *= 4.0;
+    // frame synchronizer runs at twice the signal bandwidth
+    double baseband_rate = 2.0 * _rx_rate;
 
-    unsigned int decim_rate = (unsigned int)(ADC_RATE / _rx_rate);
-    // ensure multiple of 2
-    decim_rate = (decim_rate >> 1) << 1;
+    // choose decimation and host chain
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, baseband_rate,
+                        IQPR_RATEPLAN_AS, RATEPLAN_CHAIN_HALFBAND) != 0)
+    {
+        fprintf(stderr,"error: iqpr_set_rx_rate(), no rate plan for %f kHz\n", _rx_rate*1e-3f);
+        exit(1);
+    }
 
-    // compute usrp sampling rate
-    double usrp_rx_rate = ADC_RATE / decim_rate;
+    // set hardware sampling rate, get actual rate
+    double usrp_rx_rate = _q->backend->set_rx_rate(_q->backend->userdata, plan.usrp_rate);
 
-    // set hardware sampling rate
-    _q->usrp->set_rx_rate(usrp_rx_rate);
+    // correct arbitrary resampling rate
+    rateplan_set_usrp_rate(&plan, usrp_rx_rate);
+    iostats_set_rx_rate(_q->backend->stats, usrp_rx_rate);
 
-    // get actual hardware sampling rate
-    usrp_rx_rate = _q->usrp->get_rx_rate();
+    // re-create decimators and resampler
+    pthread_mutex_lock(&_q->rx_mutex);
+    iqpr_rx_set_plan(_q, &plan);
+    pthread_mutex_unlock(&_q->rx_mutex);
 
-    // compute arbitrary resampling rate
-    double rx_resamp_rate = _rx_rate / usrp_rx_rate;
+    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (decim %u, %u half-band)\n",
+            baseband_rate * 1e-3f,
+            usrp_rx_rate * 1e-3f,
+            baseband_rate / usrp_rx_rate,
+            plan.hw_factor,
+            plan.num_halfband);
+}
 
-    // set software resampling rate
-    resamp_crcf_setrate(_q->rx_resamp, rx_resamp_rate);
+// get rate plans chosen by iqpr_set_tx_rate()/iqpr_set_rx_rate()
+void iqpr_get_tx_rateplan(iqpr _q,
+                          struct rateplan_s * _plan)
+{
+    *_plan = _q->tx_plan;
+}
 
-    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (decim %u)\n",
-            _rx_rate * 1e-3f,
-            usrp_rx_rate * 1e-3f,
-            rx_resamp_rate,
-            decim_rate);
+void iqpr_get_rx_rateplan(iqpr _q,
+                          struct rateplan_s * _plan)
+{
+    *_plan = _q->rx_plan;
 }
 
 // set transmit/receive frequency
 void iqpr_set_tx_freq(iqpr _q, float _tx_freq)
 {
-    _q->usrp->set_tx_freq(_tx_freq);
+    _q->backend->set_tx_freq(_q->backend->userdata, _tx_freq);
 }
 
 // set transmit/receive frequency
 void iqpr_set_rx_freq(iqpr _q, float _rx_freq)
 {
-    _q->usrp->set_rx_freq(_rx_freq);
+    _q->backend->set_rx_freq(_q->backend->userdata, _rx_freq);
+}
+
+// set OFDM subcarrier layout (transmitter); takes effect with the next
+// transmitted packet
+//  _q      :   iqpr object
+//  _M      :   number of subcarriers
+//  _cp_len :   cyclic prefix length
+//  _p      :   subcarrier allocation [size: _M x 1], NULL gives default
+void iqpr_txconfig(iqpr _q,
+                   unsigned int _M,
+                   unsigned int _cp_len,
+                   unsigned char * _p)
+{
+    if (_cp_len > _M) {
+        fprintf(stderr,"error: iqpr_txconfig(), cyclic prefix length cannot exceed number of subcarriers\n");
+        exit(1);
+    }
+    unsigned char * p = iqpr_subcarriers_create(_M, _p);
+
+    // generator is created with the current frame properties, which the
+    // transmit path owns
+    pthread_mutex_lock(&_q->tx_mutex);
+    ofdmflexframegen fg = ofdmflexframegen_create(_M, _cp_len, p, &_q->fgprops);
+
+    // swap in new layout
+    ofdmflexframegen fg_old = _q->fg;
+    unsigned char *  p_old  = _q->p;
+    _q->fg     = fg;
+    _q->p      = p;
+    _q->M      = _M;
+    _q->cp_len = _cp_len;
+    iqpr_tx_alloc_buffers(_q);
+
+    // cached frames were rendered with the old layout
+    iqpr_tx_cache_clear(_q);
+    pthread_mutex_unlock(&_q->tx_mutex);
+
+    ofdmflexframegen_destroy(fg_old);
+    free(p_old);
 }
 
-// set ofdmflexframesync properties (receiver)
+// set OFDM subcarrier layout (receiver); takes effect between received
+// blocks, dropping any partially synchronized frame
+//  _q      :   iqpr object
+//  _M      :   number of subcarriers
+//  _cp_len :   cyclic prefix length
+//  _p      :   subcarrier allocation [size: _M x 1], NULL gives default
 void iqpr_rxconfig(iqpr _q,
-                   framesyncprops_s * _fsprops)
+                   unsigned int _M,
+                   unsigned int _cp_len,
+                   unsigned char * _p)
 {
-    //flexframesync_setprops(_q->fs, _fsprops);
+    if (_cp_len > _M) {
+        fprintf(stderr,"error: iqpr_rxconfig(), cyclic prefix length cannot exceed number of subcarriers\n");
+        exit(1);
+    }
+
+    // build new synchronizer outside of the lock
+    unsigned char * p = iqpr_subcarriers_create(_M, _p);
+    ofdmflexframesync fs = ofdmflexframesync_create(_M, _cp_len, p, iqpr_callback, (void*)_q);
+
+    // swap in new layout
+    pthread_mutex_lock(&_q->rx_mutex);
+    ofdmflexframesync fs_old = _q->fs;
+    unsigned char *   p_old  = _q->rx_p;
+    _q->fs        = fs;
+    _q->rx_p      = p;
+    _q->rx_M      = _M;
+    _q->rx_cp_len = _cp_len;
+    _q->rx_sync_len = 4*(_M + _cp_len);
+
+    // resampled samples were partially consumed by the old synchronizer
+    _q->rx_resamp_index  = 0;
+    _q->rx_resamp_length = 0;
+    pthread_mutex_unlock(&_q->rx_mutex);
+
+    ofdmflexframesync_destroy(fs_old);
+    free(p_old);
 }
 
+// create subcarrier allocation, validating user-supplied layout
+//  _M      :   number of subcarriers
+//  _p      :   subcarrier allocation [size: _M x 1], NULL gives default
+unsigned char * iqpr_subcarriers_create(unsigned int _M,
+                                        unsigned char * _p)
+{
+    if (_M < 8 || (_M % 2) != 0) {
+        fprintf(stderr,"error: iqpr_subcarriers_create(), number of subcarriers must be even and at least 8\n");
+        exit(1);
+    }
+
+    unsigned char * p = (unsigned char*)malloc(_M*sizeof(unsigned char));
+    unsigned int i;
+    if (_p != NULL) {
+        memmove(p, _p, _M*sizeof(unsigned char));
+    } else {
+        // null dc and band edges, pilot every 8th subcarrier
+        unsigned int guard = _M / 6;
+        unsigned int pilot_spacing = 8;
+        unsigned int i0 = (_M/2) - guard;
+        unsigned int i1 = (_M/2) + guard;
+        for (i=0; i<_M; i++) {
+            if ( i == 0 || (i > i0 && i < i1) )
+                p[i] = OFDMFRAME_SCTYPE_NULL;
+            else if ( (i%pilot_spacing)==0 )
+                p[i] = OFDMFRAME_SCTYPE_PILOT;
+            else
+                p[i] = OFDMFRAME_SCTYPE_DATA;
+        }
+    }
+
+    // validate
+    unsigned int M_null, M_pilot, M_data;
+    ofdmframe_validate_sctype(p, _M, &M_null, &M_pilot, &M_data);
+    if (M_pilot < 2 || M_data == 0) {
+        fprintf(stderr,"error: iqpr_subcarriers_create(), need at least 2 pilot and 1 data subcarrier\n");
+        exit(1);
+    }
+
+    return p;
+}
 
 // start data transfer
 void iqpr_rx_start(iqpr _q)
 {
-    printf("issuing stream command...\n");
-    _q->usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    _q->backend->rx_start(_q->backend->userdata);
 
-    resamp2_crcf_clear(_q->rx_decim);
+    pthread_mutex_lock(&_q->rx_mutex);
+    unsigned int i;
+    for (i=0; i<_q->rx_num_halfband; i++) {
+        resamp2_crcf_clear(_q->rx_decim[i]);
+        _q->rx_decim_n[i] = 0;
+    }
     resamp_crcf_reset(_q->rx_resamp);
     ofdmflexframesync_reset(_q->fs);
 
     _q->rx_vector_index  = 0;
     _q->rx_vector_length = 0;
+    _q->rx_resamp_index  = 0;
+    _q->rx_resamp_length = 0;
+
+    // empty received frame queue
+    _q->rx_queue_read          = 0;
+    _q->rx_queue_size          = 0;
+    _q->rx_frame_borrowed      = 0;
+
+    // start receive thread
+    if (_q->rx_streaming) {
+        blockq_reset(_q->rx_ring);
+        _q->rx_block = NULL;
+        _q->rx_num_dropped = 0;
+        _q->rx_thread_running = 1;
+        if (pthread_create(&_q->rx_thread, NULL, iqpr_rx_process, (void*)_q) != 0) {
+            fprintf(stderr,"error: iqpr_rx_start(), could not create receive thread\n");
+            exit(1);
+        }
+    }
 
     //return;
 
     unsigned long int total_samples = 50;
     unsigned long int num_accumulated_samples = 0;
-    uhd::rx_metadata_t md;
 
     // chomp data
     while ( num_accumulated_samples < total_samples) {
         // check if we have read entire contents of buffer
-        while (_q->rx_vector_index == _q->rx_vector_length) {
-            // reset vector index
-            _q->rx_vector_index = 0;
-
-            // grab data from port
-            _q->rx_vector_length = _q->usrp->get_device()->recv(
-                &_q->rx_buffer->front(),
-                _q->rx_buffer->size(),
-                md,
-                uhd::io_type_t::COMPLEX_FLOAT32,
-                uhd::device::RECV_MODE_ONE_PACKET
-            );
-            //printf("reading data from usrp : rx vector length : %u\n", _q->rx_vector_length);
-
-            //handle the error codes
-            switch(md.error_code){
-            case uhd::rx_metadata_t::ERROR_CODE_NONE:
-            case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
-                break;
-            default:
-                std::cerr << "Error code: " << md.error_code << std::endl;
-                std::cerr << "Unexpected error on recv, exit test..." << std::endl;
-                exit(1);
-            }
-
-            if (_q->rx_vector_length == 0) {
-                printf("WARNING: vector length is zero!!!\n");
-                usleep(10000);
-            }
-
-        }
+        if (_q->rx_vector_index == _q->rx_vector_length)
+            iqpr_rx_read_block(_q);
 
         num_accumulated_samples++;
         _q->rx_vector_index++;
     }
-
+    pthread_mutex_unlock(&_q->rx_mutex);
 } 
 
 
 // stop data transfer
 void iqpr_rx_stop(iqpr _q)
 {
-    _q->usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+    // stop receive thread
+    if (_q->rx_thread_running) {
+        _q->rx_thread_running = 0;
+        pthread_join(_q->rx_thread, NULL);
+        _q->rx_block = NULL;
+    }
+
+    _q->backend->rx_stop(_q->backend->userdata);
 
     // clear buffers
     //_q->rx_buffer.clear();
+    pthread_mutex_lock(&_q->rx_mutex);
+    unsigned int i;
+    for (i=0; i<_q->rx_num_halfband; i++)
+        _q->rx_decim_n[i] = 0;
     _q->rx_vector_index  = 0;
     _q->rx_vector_length = 0;
+    _q->rx_resamp_index  = 0;
+    _q->rx_resamp_length = 0;
+    pthread_mutex_unlock(&_q->rx_mutex);
 } 
 
 
@@ -427,29 +956,36 @@ void iqpr_txpacket(iqpr _q,
 {
     //unsigned int i;
 
-    // reset interpolator, resampler (flush buffer)
-    resamp2_crcf_clear(_q->tx_interp);
-    resamp_crcf_reset(_q->tx_resamp);
+    // hold generator for the whole packet (see iqpr_txconfig())
+    pthread_mutex_lock(&_q->tx_mutex);
 
     // configure frame generator
     if (_fgprops != NULL)
         memmove(&_q->fgprops, _fgprops, sizeof(ofdmflexframegenprops_s));
-    ofdmflexframegen_setprops(_q->fg, &_q->fgprops);
 
-    // set up the metadta flags
-    uhd::tx_metadata_t md;
-    md.start_of_burst = false;  // never SOB when continuous
-    md.end_of_burst   = false;  // 
-    md.has_time_spec  = false;  // set to false to send immediately
+    // retransmission: send previously rendered frame
+    struct iqprtxcache_s * entry = iqpr_tx_cache_lookup(_q, _header, _payload, _payload_len);
+    if (entry != NULL) {
+        iqpr_tx_send(_q, entry->samples, entry->num_samples);
+        pthread_mutex_unlock(&_q->tx_mutex);
+        return;
+    }
+
+    // reset interpolators, resampler (flush buffer)
+    unsigned int i;
+    for (i=0; i<_q->tx_num_halfband; i++)
+        resamp2_crcf_clear(_q->tx_interp[i]);
+    resamp_crcf_reset(_q->tx_resamp);
+
+    ofdmflexframegen_setprops(_q->fg, &_q->fgprops);
 
     // compute 'frame' length (actually length of each symbol)
     unsigned int frame_len = _q->M + _q->cp_len;
 
-    // arrays
-    std::complex<float> buffer[frame_len];    // output time series
-    std::complex<float> buffer_interp[2*frame_len];
-    std::complex<float> buffer_resamp[3*frame_len];
-    std::vector<std::complex<float> > buff(256);
+    // scratch buffers
+    std::complex<float> * buffer        = _q->data_tx;          // output time series
+    std::complex<float> * buffer_interp = _q->data_tx_interp;
+    std::complex<float> * buffer_resamp = _q->data_tx_resamp;
 
     //printf("[tx] sending packet %u...\n", _pid);
 
@@ -457,9 +993,23 @@ void iqpr_txpacket(iqpr _q,
     ofdmflexframegen_reset(_q->fg);
     ofdmflexframegen_assemble(_q->fg, _header, _payload, _payload_len);
 
+    // zero padding: one symbol to flush the filters in burst mode, at
+    // least 512 samples between frames when continuous
+    unsigned int zero_pad = (512/frame_len) < 1 ? 1 : (512/frame_len);
+    if (_q->tx_burst_mode)
+        zero_pad = 1;
+
+    if (_q->tx_burst_mode || _q->tx_cache_len > 0) {
+        // render entire frame, keep for retransmission
+        unsigned int n = iqpr_tx_render(_q, zero_pad);
+        iqpr_tx_cache_insert(_q, _header, _payload, _payload_len, _q->tx_render, n);
+        iqpr_tx_send(_q, _q->tx_render, n);
+        pthread_mutex_unlock(&_q->tx_mutex);
+        return;
+    }
+
     // generate the frame
     int last_symbol=0;
-    unsigned int zero_pad = (512/frame_len) < 1 ? 1 : (512/frame_len);
     unsigned int num_samples;
     float g = 0.02f;
 
@@ -468,7 +1018,9 @@ void iqpr_txpacket(iqpr _q,
     while (!last_symbol || zero_pad > 0) {
         if (!last_symbol) {
             // generate symbol
+            PROFILE_BEGIN(PROFILE_FRAMEGEN);
             last_symbol = ofdmflexframegen_writesymbol(_q->fg, buffer, &num_samples);
+            PROFILE_END(PROFILE_FRAMEGEN, num_samples);
         } else {
             zero_pad--;
             num_samples = frame_len;
@@ -476,45 +1028,45 @@ void iqpr_txpacket(iqpr _q,
                 buffer[j] = 0.0f;
         }
 
-        // interpolate by 2
-        for (j=0; j<num_samples; j++)
-            resamp2_crcf_interp_execute(_q->tx_interp, buffer[j], &buffer_interp[2*j]);
+        // interpolate through half-band cascade
+        PROFILE_BEGIN(PROFILE_HALFBAND);
+        unsigned int num_interp = iqpr_tx_interp_block(_q, buffer, num_samples, buffer_interp);
+        PROFILE_END(PROFILE_HALFBAND, num_samples);
         
         // resample
+        if (iqpr_tx_resamp_len(_q, num_interp) > _q->data_tx_resamp_len) {
+            fprintf(stderr,"error: iqpr_txpacket(), resampler output exceeds scratch buffer\n");
+            exit(1);
+        }
         unsigned int nw;
         unsigned int n=0;
-        for (j=0; j<2*num_samples; j++) {
+        PROFILE_BEGIN(PROFILE_RESAMP);
+        for (j=0; j<num_interp; j++) {
             resamp_crcf_execute(_q->tx_resamp, buffer_interp[j], &buffer_resamp[n], &nw);
             n += nw;
         }
+        PROFILE_END(PROFILE_RESAMP, num_interp);
 
         // push samples into buffer
         for (j=0; j<n; j++) {
-            buff[tx_buffer_samples++] = g*buffer_resamp[j];
+            _q->tx_buffer[tx_buffer_samples++] = g*buffer_resamp[j];
 
-            if (tx_buffer_samples==256) {
+            if (tx_buffer_samples==IQPR_TX_CHUNK_LEN) {
                 // reset counter
                 tx_buffer_samples=0;
 
-                //send the entire contents of the buffer
-                _q->usrp->get_device()->send(
-                    &buff.front(), buff.size(), md,
-                    uhd::io_type_t::COMPLEX_FLOAT32,
-                    uhd::device::SEND_MODE_FULL_BUFF
-                );
+                //send the entire contents of the buffer (never SOB/EOB
+                //when continuous)
+                iqpr_backend_send(_q->backend, _q->tx_buffer, IQPR_TX_CHUNK_LEN, 0, 0);
             }
         }
     }
 
 #if 0
     // send a mini EOB packet
-    md.start_of_burst = false;
-    md.end_of_burst   = true;
-    _q->usrp->get_device()->send("", 0, md,
-        uhd::io_type_t::COMPLEX_FLOAT32,
-        uhd::device::SEND_MODE_FULL_BUFF
-    );
+    _q->backend->send(_q->backend->userdata, NULL, 0, 0, 1);
 #endif
+    pthread_mutex_unlock(&_q->tx_mutex);
 }
 
 // receive data packet with timeout, returning 1 if found, 0 if not
@@ -535,105 +1087,66 @@ int iqpr_rxpacket(iqpr _q,
                   int           *  _payload_valid,
                   framesyncstats_s * _stats)
 {
-    unsigned long int total_samples = _timespec;
-    // TODO : start 'timer'
-    unsigned long int num_accumulated_samples = 0;
-
-    //
-    if (total_samples < 2) total_samples = 2;   // set minimum
-    if (total_samples % 2) total_samples++;     // must be even
-
-    uhd::rx_metadata_t md;
-
-    // buffers
-    std::complex<float> rx_buffer_decim[2];
-    std::complex<float> rx_decim_out;
-    std::complex<float> rx_buffer_resamp[4];
-
-    // read samples from buffer, run through frame synchronizer
-    unsigned int n=0;
-    unsigned int nw=0;
-    while ( num_accumulated_samples < total_samples) {
-
-        // check if we have read entire contents of buffer
-        while (_q->rx_vector_index == _q->rx_vector_length) {
-            // reset vector index
-            _q->rx_vector_index = 0;
-
-            // grab data from port
-            _q->rx_vector_length = _q->usrp->get_device()->recv(
-                &_q->rx_buffer->front(),
-                _q->rx_buffer->size(),
-                md,
-                uhd::io_type_t::COMPLEX_FLOAT32,
-                uhd::device::RECV_MODE_ONE_PACKET
-            );
-            //printf("reading data from usrp : rx vector length : %u\n", _q->rx_vector_length);
-
-            //handle the error codes
-            switch(md.error_code){
-            case uhd::rx_metadata_t::ERROR_CODE_NONE:
-            case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
-                break;
-            default:
-                std::cerr << "Error code: " << md.error_code << std::endl;
-                std::cerr << "Unexpected error on recv, exit test..." << std::endl;
-                exit(1);
-            }
-
-            if (_q->rx_vector_length == 0) {
-                printf("WARNING: vector length is zero!!!\n");
-                usleep(10000);
-            }
-
-        }
-
-        // for now copy vector "buff" to array of complex float
-        // TODO : apply bandwidth-dependent gain
-        num_accumulated_samples++;
-
-        // push 2 samples into buffer
-        rx_buffer_decim[n++] = (*_q->rx_buffer)[_q->rx_vector_index++];
-
-        if (n==2) {
-            // reset counter
-            n=0;
+    struct iqprframe_s * frame = NULL;
+    if (!iqpr_rxframe(_q, _timespec, &frame))
+        return 0;
 
-            // decimate
-            resamp2_crcf_decim_execute(_q->rx_decim, rx_buffer_decim, &rx_decim_out);
+    // found packet; set outputs (pointing into borrowed queue entry)
+    *_header        = frame->header;
+    *_header_valid  = frame->header_valid;
+    *_payload       = frame->payload_valid ? frame->payload     : NULL;
+    *_payload_len   = frame->payload_valid ? frame->payload_len : 0;
+    *_payload_valid = frame->payload_valid;
 
-            // apply resampler
-            resamp_crcf_execute(_q->rx_resamp, rx_decim_out, rx_buffer_resamp, &nw);
+    // return frame stats
+    memmove(_stats, &frame->stats, sizeof(framesyncstats_s));
 
-            // push through synchronizer
-            ofdmflexframesync_execute(_q->fs, rx_buffer_resamp, nw);
+    return 1;
+}
 
-#if 1
-            // check status flag
-            if (_q->rx_packet_found) {
-                // found packet; set outputs
-                *_header        = _q->rx_header;
-                *_header_valid  = _q->rx_header_valid;
-                *_payload       = _q->rx_payload_valid ? _q->rx_payload     : NULL;
-                *_payload_len   = _q->rx_payload_valid ? _q->rx_payload_len : 0;
-                *_payload_valid = _q->rx_payload_valid;
+// borrow oldest received frame with timeout, returning 1 if found, 0 if
+// not; the frame is not copied and remains valid until it is released,
+// either explicitly or by the next call to iqpr_rxframe/iqpr_rxpacket
+//  _q              :   iqpr object
+//  _timespec       :   time specifier
+//  _frame          :   pointer to received frame entry
+int iqpr_rxframe(iqpr _q,
+                 unsigned int _timespec,
+                 struct iqprframe_s ** _frame)
+{
+    return iqpr_rx_wait(_q, _timespec, HUGE_VAL, _frame);
+}
 
-                // return frame stats
-                memmove(_stats, &_q->rx_stats, sizeof(framesyncstats_s));
+// borrow oldest received frame, waiting until samples received up to
+// _timeout_us microseconds from now (usrp clock) have been processed;
+// returns 1 if found, 0 if not
+//  _q              :   iqpr object
+//  _timeout_us     :   timeout [microseconds]
+//  _frame          :   pointer to received frame entry
+int iqpr_rxframe_us(iqpr _q,
+                    unsigned int _timeout_us,
+                    struct iqprframe_s ** _frame)
+{
+    double deadline = iqpr_get_time(_q) + 1e-6*(double)_timeout_us;
+    return iqpr_rx_wait(_q, ULONG_MAX, deadline, _frame);
+}
 
-                // reset status flag
-                _q->rx_packet_found = 0;
+// get current usrp time [seconds]
+double iqpr_get_time(iqpr _q)
+{
+    return _q->backend->get_time(_q->backend->userdata);
+}
 
-                memmove(_stats, &_q->rx_stats, sizeof(framesyncstats_s));
+// release frame borrowed with iqpr_rxframe(), returning its entry (and
+// payload buffer) to the queue
+void iqpr_rxframe_release(iqpr _q)
+{
+    if (!_q->rx_frame_borrowed)
+        return;
 
-                return 1;
-            }
-#endif
-        } // resamp
-    }
-    // packet was never received
-    //printf("  consumed %6lu / %6lu samples\n", num_accumulated_samples, total_samples);
-    return 0;
+    _q->rx_queue_read = (_q->rx_queue_read + 1) % _q->rx_queue_len;
+    _q->rx_queue_size--;
+    _q->rx_frame_borrowed = 0;
 }
 
 #if 0
@@ -767,6 +1280,758 @@ float iqpr_mac_getrssi(iqpr _q,
 // iqpr internal methods
 //
 
+// wait for received frame, returning 1 if found, 0 if not; stops after
+// _num_samples usrp samples have been processed or once received samples
+// are stamped at or after _deadline (usrp clock), whichever comes first
+//  _q              :   iqpr object
+//  _num_samples    :   maximum number of usrp samples to process
+//  _deadline       :   deadline [seconds]
+//  _frame          :   pointer to received frame entry
+int iqpr_rx_wait(iqpr _q,
+                 unsigned long int _num_samples,
+                 double _deadline,
+                 struct iqprframe_s ** _frame)
+{
+    // hold synchronizer except while waiting for samples (see
+    // iqpr_rxconfig() and iqpr_rx_read_block())
+    pthread_mutex_lock(&_q->rx_mutex);
+    int found = iqpr_rx_run(_q, _num_samples, _deadline, _frame);
+    pthread_mutex_unlock(&_q->rx_mutex);
+    return found;
+}
+
+// receive loop of iqpr_rx_wait(), called with rx_mutex held
+int iqpr_rx_run(iqpr _q,
+                unsigned long int _num_samples,
+                double _deadline,
+                struct iqprframe_s ** _frame)
+{
+    // return previously borrowed frame to the queue
+    iqpr_rxframe_release(_q);
+
+    unsigned long int total_samples = _num_samples;
+    unsigned long int num_accumulated_samples = 0;
+
+    //
+    if (total_samples < 2) total_samples = 2;   // set minimum
+    if (total_samples % 2 && total_samples < ULONG_MAX)
+        total_samples++;                        // must be even
+
+    // frames already in queue, or found in resampled samples left over
+    // from previous call
+    if (_q->rx_queue_size > 0 || iqpr_rx_sync_pending(_q))
+        return iqpr_rxframe_borrow(_q, _frame);
+
+    if (_q->rx_block_mode) {
+        // block mode: decimate, resample and synchronize the remainder
+        // of each usrp block at once
+        while ( num_accumulated_samples < total_samples) {
+            // check if we have read entire contents of buffer
+            if (_q->rx_vector_index == _q->rx_vector_length) {
+                iqpr_rx_read_block(_q);
+
+                // stop once samples are past the deadline (block is
+                // kept for the next call)
+                if (_q->rx_vector_time >= _deadline)
+                    return 0;
+            }
+
+            unsigned int num_samples = _q->rx_vector_length - _q->rx_vector_index;
+            iqpr_rx_process_block(_q, &_q->rx_vector[_q->rx_vector_index], num_samples);
+            _q->rx_vector_index = _q->rx_vector_length;
+            num_accumulated_samples += num_samples;
+
+            if (iqpr_rx_sync_pending(_q))
+                return iqpr_rxframe_borrow(_q, _frame);
+        }
+
+        // packet was never received
+        return 0;
+    }
+
+    // buffers
+    std::complex<float> rx_decim_out;
+    std::complex<float> rx_buffer_resamp[4];
+
+    // read samples from buffer, run through frame synchronizer
+    unsigned int nw=0;
+    while ( num_accumulated_samples < total_samples) {
+
+        // check if we have read entire contents of buffer
+        if (_q->rx_vector_index == _q->rx_vector_length) {
+            iqpr_rx_read_block(_q);
+
+            // stop once samples are past the deadline
+            if (_q->rx_vector_time >= _deadline)
+                return 0;
+        }
+
+        // for now copy vector "buff" to array of complex float
+        // TODO : apply bandwidth-dependent gain
+        num_accumulated_samples++;
+
+        // push sample through half-band decimators
+        if (iqpr_rx_decim_push(_q, _q->rx_vector[_q->rx_vector_index++], &rx_decim_out)) {
+            // apply resampler
+            resamp_crcf_execute(_q->rx_resamp, rx_decim_out, rx_buffer_resamp, &nw);
+
+            // push through synchronizer
+            _q->rx_sync_time = iqpr_rx_time(_q);
+            PROFILE_BEGIN(PROFILE_SYNC);
+            ofdmflexframesync_execute(_q->fs, rx_buffer_resamp, nw);
+            PROFILE_END(PROFILE_SYNC, nw);
+
+#if 1
+            // check queue
+            if (_q->rx_queue_size > 0)
+                return iqpr_rxframe_borrow(_q, _frame);
+#endif
+        } // resamp
+    }
+    // packet was never received
+    //printf("  consumed %6lu / %6lu samples\n", num_accumulated_samples, total_samples);
+    return 0;
+}
+
+// get time of next unconsumed sample in rx_vector [seconds]
+double iqpr_rx_time(iqpr _q)
+{
+    return _q->rx_vector_time + (double)(_q->rx_vector_index) / _q->rx_usrp_rate;
+}
+
+// read block of samples from the usrp into the receive buffer,
+// blocking until at least one sample is available; rx_mutex must be
+// held, and is released while waiting
+void iqpr_rx_read_block(iqpr _q)
+{
+    pthread_mutex_unlock(&_q->rx_mutex);
+    iqpr_rx_wait_block(_q);
+    pthread_mutex_lock(&_q->rx_mutex);
+}
+
+// wait for block of samples from the usrp (or receive ring)
+void iqpr_rx_wait_block(iqpr _q)
+{
+    if (_q->rx_streaming) {
+        // return consumed block to the ring
+        if (_q->rx_block != NULL)
+            blockq_read_release(_q->rx_ring);
+        _q->rx_block = NULL;
+        _q->rx_vector_index  = 0;
+        _q->rx_vector_length = 0;
+
+        // wait for the receive thread to publish a block
+        while ( (_q->rx_block = blockq_read_acquire(_q->rx_ring)) == NULL)
+            usleep(100);
+
+        _q->rx_vector        = _q->rx_block->x;
+        _q->rx_vector_length = _q->rx_block->n;
+        _q->rx_vector_time   = _q->rx_block->timestamp;
+        return;
+    }
+
+    _q->rx_vector = &_q->rx_buffer->front();
+    while (_q->rx_vector_index == _q->rx_vector_length) {
+        // reset vector index
+        _q->rx_vector_index = 0;
+
+        // grab data from port
+        _q->rx_vector_length = iqpr_rx_recv(_q, _q->rx_vector, _q->rx_buffer->size(),
+                                            &_q->rx_vector_time);
+
+        if (_q->rx_vector_length == 0) {
+            printf("WARNING: vector length is zero!!!\n");
+            usleep(10000);
+        }
+    }
+}
+
+// receive one usrp packet into buffer, returning number of samples
+//  _q          :   iqpr object
+//  _x          :   output buffer
+//  _n          :   output buffer length
+//  _timestamp  :   time of first sample (usrp clock) [seconds]
+unsigned int iqpr_rx_recv(iqpr _q,
+                          std::complex<float> * _x,
+                          unsigned int _n,
+                          double * _timestamp)
+{
+    return iqpr_backend_recv(_q->backend, _x, _n, _timestamp);
+}
+
+// receive thread (streaming mode): read usrp blocks into the ring
+void * iqpr_rx_process(void * _userdata)
+{
+    iqpr q = (iqpr) _userdata;
+
+    while (q->rx_thread_running) {
+        struct blockq_block_s * block = blockq_write_acquire(q->rx_ring);
+
+        if (block == NULL) {
+            // ring is full; keep draining the usrp so that the loss is
+            // confined to this block
+            double timestamp;
+            q->rx_num_dropped += iqpr_rx_recv(q, &q->rx_buffer->front(), q->rx_buffer->size(), &timestamp);
+            continue;
+        }
+
+        block->n = iqpr_rx_recv(q, block->x, block->capacity, &block->timestamp);
+        if (block->n > 0)
+            blockq_write_commit(q->rx_ring);
+    }
+
+    return NULL;
+}
+
+// decimate and resample block of raw samples, appending the result to
+// the pending (not yet synchronized) resampled buffer
+//  _q      :   iqpr object
+//  _x      :   input samples [size: _n x 1]
+//  _n      :   number of input samples
+void iqpr_rx_process_block(iqpr _q,
+                           std::complex<float> * _x,
+                           unsigned int _n)
+{
+    // duration of one resampled sample
+    double resamp_period = (double)(1<<_q->rx_num_halfband) / (_q->rx_usrp_rate * _q->rx_resamp_rate);
+
+    // shift unsynchronized samples to front of buffer
+    unsigned int num_pending = _q->rx_resamp_length - _q->rx_resamp_index;
+    if (num_pending > 0)
+        _q->rx_resamp_time += _q->rx_resamp_index * resamp_period;
+    else
+        _q->rx_resamp_time = iqpr_rx_time(_q);  // time of _x[0]
+    if (num_pending > 0 && _q->rx_resamp_index > 0)
+        memmove(_q->rx_buffer_resamp,
+                &_q->rx_buffer_resamp[_q->rx_resamp_index],
+                num_pending*sizeof(std::complex<float>));
+    _q->rx_resamp_index  = 0;
+    _q->rx_resamp_length = num_pending;
+
+    // decimate by 2 in each half-band stage (in place after the first)
+    std::complex<float> * x = _x;
+    unsigned int num_decim = _n;
+    unsigned int i;
+    PROFILE_BEGIN(PROFILE_HALFBAND);
+    for (i=0; i<_q->rx_num_halfband; i++) {
+        num_decim = iqpr_rx_decim_block(_q, i, x, num_decim, _q->rx_buffer_decim);
+        x = _q->rx_buffer_decim;
+    }
+    PROFILE_END(PROFILE_HALFBAND, num_decim);
+
+    // apply resampler
+    unsigned int nw;
+    PROFILE_BEGIN(PROFILE_RESAMP);
+    for (i=0; i<num_decim; i++) {
+        resamp_crcf_execute(_q->rx_resamp,
+                            x[i],
+                            &_q->rx_buffer_resamp[_q->rx_resamp_length],
+                            &nw);
+        _q->rx_resamp_length += nw;
+    }
+    PROFILE_END(PROFILE_RESAMP, num_decim);
+}
+
+// push raw sample through half-band decimators, returning 1 (and the
+// decimated sample) when the last stage produces an output
+int iqpr_rx_decim_push(iqpr _q,
+                       std::complex<float> _x,
+                       std::complex<float> * _y)
+{
+    unsigned int i;
+    for (i=0; i<_q->rx_num_halfband; i++) {
+        _q->rx_decim_in[i][_q->rx_decim_n[i]++] = _x;
+        if (_q->rx_decim_n[i] < 2)
+            return 0;
+
+        _q->rx_decim_n[i] = 0;
+        resamp2_crcf_decim_execute(_q->rx_decim[i], _q->rx_decim_in[i], &_x);
+    }
+
+    *_y = _x;
+    return 1;
+}
+
+// decimate block by 2 in half-band stage _s, carrying an odd sample over
+// to the next block; returns number of output samples
+//  _q      :   iqpr object
+//  _s      :   half-band stage index
+//  _x      :   input samples [size: _n x 1]
+//  _n      :   number of input samples
+//  _y      :   output samples (may be _x)
+unsigned int iqpr_rx_decim_block(iqpr _q,
+                                 unsigned int _s,
+                                 std::complex<float> * _x,
+                                 unsigned int _n,
+                                 std::complex<float> * _y)
+{
+    unsigned int i=0;
+    unsigned int num_decim=0;
+
+    // complete sample pair carried over from previous block
+    if (_q->rx_decim_n[_s] == 1 && _n > 0) {
+        _q->rx_decim_in[_s][1] = _x[i++];
+        resamp2_crcf_decim_execute(_q->rx_decim[_s], _q->rx_decim_in[_s], &_y[num_decim++]);
+        _q->rx_decim_n[_s] = 0;
+    }
+
+    // decimate by 2 (each output is written no earlier than its inputs
+    // are read, so the block can be decimated in place)
+    for ( ; i+1 < _n; i+=2)
+        resamp2_crcf_decim_execute(_q->rx_decim[_s], &_x[i], &_y[num_decim++]);
+
+    // save odd sample for next block
+    if (i < _n) {
+        _q->rx_decim_in[_s][0] = _x[i];
+        _q->rx_decim_n[_s] = 1;
+    }
+
+    return num_decim;
+}
+
+// re-create receiver half-band decimators and resampler for rate plan
+void iqpr_rx_set_plan(iqpr _q,
+                      struct rateplan_s * _plan)
+{
+    unsigned int i;
+    for (i=0; i<_q->rx_num_halfband; i++)
+        resamp2_crcf_destroy(_q->rx_decim[i]);
+    resamp_crcf_destroy(_q->rx_resamp);
+
+    _q->rx_num_halfband = _plan->num_halfband;
+    for (i=0; i<_q->rx_num_halfband; i++) {
+        _q->rx_decim[i] = resamp2_crcf_create(_plan->halfband_m[i], 0.0f, _plan->As);
+        _q->rx_decim_n[i] = 0;
+    }
+    _q->rx_resamp = resamp_crcf_create(_plan->resamp_rate, _plan->resamp_m,
+                                       _plan->resamp_fc, _plan->As, 64);
+
+    // drop samples resampled at the old rate
+    _q->rx_resamp_index  = 0;
+    _q->rx_resamp_length = 0;
+
+    // save rates for timestamping
+    _q->rx_usrp_rate   = _plan->usrp_rate;
+    _q->rx_resamp_rate = _plan->resamp_rate;
+    _q->rx_plan = *_plan;
+}
+
+// run pending resampled samples through the frame synchronizer, stopping
+// at the first chunk in which a frame is found; returns 1 if found
+int iqpr_rx_sync_pending(iqpr _q)
+{
+    double resamp_period = (double)(1<<_q->rx_num_halfband) / (_q->rx_usrp_rate * _q->rx_resamp_rate);
+
+    while (_q->rx_resamp_index < _q->rx_resamp_length) {
+        unsigned int n = _q->rx_resamp_length - _q->rx_resamp_index;
+        if (n > _q->rx_sync_len)
+            n = _q->rx_sync_len;
+
+        // push through synchronizer (frames found in this chunk are
+        // stamped with the time at its end)
+        _q->rx_sync_time = _q->rx_resamp_time + (_q->rx_resamp_index + n) * resamp_period;
+        PROFILE_BEGIN(PROFILE_SYNC);
+        ofdmflexframesync_execute(_q->fs, &_q->rx_buffer_resamp[_q->rx_resamp_index], n);
+        PROFILE_END(PROFILE_SYNC, n);
+        _q->rx_resamp_index += n;
+
+        // check queue
+        if (_q->rx_queue_size > 0)
+            return 1;
+    }
+    return 0;
+}
+
+// lend oldest queued frame to user, returning 1
+int iqpr_rxframe_borrow(iqpr _q,
+                        struct iqprframe_s ** _frame)
+{
+    *_frame = &_q->rx_frames[_q->rx_queue_read];
+    _q->rx_frame_borrowed = 1;
+    return 1;
+}
+
+// render assembled frame into render buffer (interpolate, resample and
+// scale), followed by _zero_pad symbols of silence, returning the number
+// of rendered samples
+unsigned int iqpr_tx_render(iqpr _q,
+                            unsigned int _zero_pad)
+{
+    unsigned int frame_len = _q->M + _q->cp_len;
+    std::complex<float> * buffer        = _q->data_tx;
+    std::complex<float> * buffer_interp = _q->data_tx_interp;
+    float g = 0.02f;
+
+    // reserve render buffer for the whole frame up front; only
+    // re-allocates on the longest frame yet
+    unsigned int num_symbols = ofdmflexframegen_getframelen(_q->fg) + _zero_pad;
+    iqpr_tx_render_reserve(_q, num_symbols*iqpr_tx_resamp_len(_q, frame_len << _q->tx_num_halfband), 0);
+
+    int last_symbol=0;
+    unsigned int zero_pad = _zero_pad;
+    unsigned int num_samples;
+    unsigned int j;
+    unsigned int nw;
+    unsigned int num_rendered = 0;
+    while (!last_symbol || zero_pad > 0) {
+        if (!last_symbol) {
+            // generate symbol
+            PROFILE_BEGIN(PROFILE_FRAMEGEN);
+            last_symbol = ofdmflexframegen_writesymbol(_q->fg, buffer, &num_samples);
+            PROFILE_END(PROFILE_FRAMEGEN, num_samples);
+        } else {
+            zero_pad--;
+            num_samples = frame_len;
+            for (j=0; j<num_samples; j++)
+                buffer[j] = 0.0f;
+        }
+
+        // ensure render buffer can hold resampler output
+        unsigned int n = num_rendered + iqpr_tx_resamp_len(_q, num_samples << _q->tx_num_halfband);
+        iqpr_tx_render_reserve(_q, n, num_rendered);
+
+        // interpolate through half-band cascade
+        PROFILE_BEGIN(PROFILE_HALFBAND);
+        unsigned int num_interp = iqpr_tx_interp_block(_q, buffer, num_samples, buffer_interp);
+        PROFILE_END(PROFILE_HALFBAND, num_samples);
+
+        // resample directly into render buffer
+        std::complex<float> * y = &_q->tx_render[num_rendered];
+        n = 0;
+        PROFILE_BEGIN(PROFILE_RESAMP);
+        for (j=0; j<num_interp; j++) {
+            resamp_crcf_execute(_q->tx_resamp, buffer_interp[j], &y[n], &nw);
+            n += nw;
+        }
+        PROFILE_END(PROFILE_RESAMP, num_interp);
+
+        // apply gain
+        for (j=0; j<n; j++)
+            y[j] *= g;
+
+        num_rendered += n;
+    }
+
+    return num_rendered;
+}
+
+// interpolate block through half-band cascade, returning number of
+// output samples (_n * 2^num_halfband)
+unsigned int iqpr_tx_interp_block(iqpr _q,
+                                  std::complex<float> * _x,
+                                  unsigned int _n,
+                                  std::complex<float> * _y)
+{
+    unsigned int i;
+    unsigned int n=0;
+    for (i=0; i<_n; i++)
+        n += iqpr_tx_interp_push(_q, 0, _x[i], &_y[n]);
+    return n;
+}
+
+// interpolate one sample from half-band stage _s onward, returning
+// number of output samples (2^(num_halfband - _s))
+unsigned int iqpr_tx_interp_push(iqpr _q,
+                                 unsigned int _s,
+                                 std::complex<float> _x,
+                                 std::complex<float> * _y)
+{
+    if (_s == _q->tx_num_halfband) {
+        _y[0] = _x;
+        return 1;
+    }
+
+    std::complex<float> v[2];
+    resamp2_crcf_interp_execute(_q->tx_interp[_s], _x, v);
+    unsigned int n = iqpr_tx_interp_push(_q, _s+1, v[0], _y);
+    return n + iqpr_tx_interp_push(_q, _s+1, v[1], &_y[n]);
+}
+
+// re-create transmitter half-band interpolators and resampler for rate
+// plan
+void iqpr_tx_set_plan(iqpr _q,
+                      struct rateplan_s * _plan)
+{
+    // resampler output (sized from the rate) must fit the scratch and
+    // render buffers for the largest symbol
+    double interp_len = (double)((_q->M + _q->cp_len) << _plan->num_halfband);
+    if (_plan->resamp_rate <= 0.0 || interp_len*_plan->resamp_rate > (double)(1<<24)) {
+        fprintf(stderr,"error: iqpr_tx_set_plan(), invalid resampling rate %f\n", _plan->resamp_rate);
+        exit(1);
+    }
+
+    unsigned int i;
+    for (i=0; i<_q->tx_num_halfband; i++)
+        resamp2_crcf_destroy(_q->tx_interp[i]);
+    resamp_crcf_destroy(_q->tx_resamp);
+
+    _q->tx_num_halfband = _plan->num_halfband;
+    for (i=0; i<_q->tx_num_halfband; i++)
+        _q->tx_interp[i] = resamp2_crcf_create(_plan->halfband_m[i], 0.0f, _plan->As);
+    _q->tx_resamp = resamp_crcf_create(_plan->resamp_rate, _plan->resamp_m,
+                                       _plan->resamp_fc, _plan->As, 64);
+    _q->tx_resamp_rate = _plan->resamp_rate;
+    _q->tx_plan = *_plan;
+
+    // interpolated symbols have changed length
+    iqpr_tx_alloc_buffers(_q);
+}
+
+// (re-)allocate transmit scratch buffers for the current subcarrier
+// layout, half-band cascade and resampling rate
+void iqpr_tx_alloc_buffers(iqpr _q)
+{
+    unsigned int frame_len  = _q->M + _q->cp_len;
+    unsigned int interp_len = frame_len << _q->tx_num_halfband;
+
+    free(_q->data_tx);
+    free(_q->data_tx_interp);
+    free(_q->data_tx_resamp);
+    _q->data_tx        = iqpr_malloc_samples(frame_len);
+    _q->data_tx_interp = iqpr_malloc_samples(interp_len);
+    _q->data_tx_resamp_len = iqpr_tx_resamp_len(_q, interp_len);
+    _q->data_tx_resamp = iqpr_malloc_samples(_q->data_tx_resamp_len);
+}
+
+// upper bound on arbitrary resampler output for _n interpolated samples
+// (the rate planner may choose rates above 2, e.g. 2.22 at 600 kHz)
+unsigned int iqpr_tx_resamp_len(iqpr _q,
+                                unsigned int _n)
+{
+    double r = _q->tx_resamp_rate;
+    return (unsigned int) ceil(_n*r) + 2*(unsigned int)ceil(r) + 4;
+}
+
+// grow render buffer to hold at least _n samples, keeping the first
+// _num_rendered samples
+void iqpr_tx_render_reserve(iqpr _q,
+                            unsigned int _n,
+                            unsigned int _num_rendered)
+{
+    if (_n <= _q->tx_render_len)
+        return;
+
+    std::complex<float> * render = iqpr_malloc_samples(2*_n);
+    memmove(render, _q->tx_render, _num_rendered*sizeof(std::complex<float>));
+    free(_q->tx_render);
+    _q->tx_render     = render;
+    _q->tx_render_len = 2*_n;
+}
+
+// allocate cache-aligned sample buffer
+std::complex<float> * iqpr_malloc_samples(unsigned int _n)
+{
+    void * x = NULL;
+    if (posix_memalign(&x, IQPR_ALIGN, (_n > 0 ? _n : 1)*sizeof(std::complex<float>)) != 0) {
+        fprintf(stderr,"error: iqpr_malloc_samples(), could not allocate %u samples\n", _n);
+        exit(1);
+    }
+    return (std::complex<float>*) x;
+}
+
+// send rendered frame (burst or continuous)
+void iqpr_tx_send(iqpr _q,
+                  std::complex<float> * _x,
+                  unsigned int _n)
+{
+    if (_q->tx_burst_mode) {
+        iqpr_tx_send_burst(_q, _x, _n);
+        return;
+    }
+
+    // continuous: fixed-size chunks, never SOB/EOB
+    unsigned int i;
+    unsigned int n;
+    for (i=0; i<_n; i+=n) {
+        n = (_n - i < IQPR_TX_CHUNK_LEN) ? _n - i : IQPR_TX_CHUNK_LEN;
+        iqpr_backend_send(_q->backend, &_x[i], n, 0, 0);
+    }
+}
+
+// send rendered frame as a single burst in usrp-sized packets, marking
+// start and end of burst so the transmitter is keyed only while sending
+void iqpr_tx_send_burst(iqpr _q,
+                        std::complex<float> * _x,
+                        unsigned int _n)
+{
+    _q->tx_burst_samples = _n;
+
+    timer_tic(_q->tx_timer);
+    unsigned int i;
+    unsigned int n;
+    for (i=0; i<_n; i+=n) {
+        n = _n - i;
+        if (n > _q->tx_max_samps) n = _q->tx_max_samps;
+
+        unsigned int num_sent = iqpr_backend_send(_q->backend,
+                                                  &_x[i], n,
+                                                  i == 0,
+                                                  i + n == _n);
+        if (num_sent != n) {
+            fprintf(stderr,"warning: iqpr_tx_send_burst(), sent %u of %u samples\n",
+                    num_sent, n);
+        }
+    }
+    _q->tx_burst_latency = timer_toc(_q->tx_timer);
+    _q->tx_num_bursts++;
+
+    if (_q->verbose) {
+        printf("tx burst: %u samples, %.3f ms\n",
+                _q->tx_burst_samples, _q->tx_burst_latency*1e3f);
+    }
+}
+
+// compute cache key (FNV-1a hash) of frame contents and properties
+unsigned int iqpr_tx_cache_key(unsigned char * _header,
+                               unsigned char * _payload,
+                               unsigned int _payload_len,
+                               ofdmflexframegenprops_s * _fgprops)
+{
+    unsigned int key = 2166136261u;
+    unsigned int i;
+    for (i=0; i<14; i++)
+        key = (key ^ _header[i]) * 16777619u;
+    for (i=0; i<_payload_len; i++)
+        key = (key ^ _payload[i]) * 16777619u;
+    unsigned char * p = (unsigned char*) _fgprops;
+    for (i=0; i<sizeof(ofdmflexframegenprops_s); i++)
+        key = (key ^ p[i]) * 16777619u;
+    return key;
+}
+
+// find rendered frame matching header, payload and current frame
+// generator properties, returning NULL if not cached
+struct iqprtxcache_s * iqpr_tx_cache_lookup(iqpr _q,
+                                            unsigned char * _header,
+                                            unsigned char * _payload,
+                                            unsigned int _payload_len)
+{
+    if (_q->tx_cache_len == 0)
+        return NULL;
+
+    unsigned int key = iqpr_tx_cache_key(_header, _payload, _payload_len, &_q->fgprops);
+    unsigned int i;
+    for (i=0; i<_q->tx_cache_len; i++) {
+        struct iqprtxcache_s * e = &_q->tx_cache[i];
+        if (e->valid && e->key == key && e->payload_len == _payload_len &&
+            memcmp(e->header,  _header,  14)           == 0 &&
+            memcmp(e->payload, _payload, _payload_len) == 0 &&
+            memcmp(&e->fgprops, &_q->fgprops, sizeof(ofdmflexframegenprops_s)) == 0)
+        {
+            e->last_used = ++_q->tx_cache_clock;
+            _q->tx_cache_hits++;
+            return e;
+        }
+    }
+
+    _q->tx_cache_misses++;
+    return NULL;
+}
+
+// invalidate cache entry, keeping its buffers for reuse
+void iqpr_tx_cache_invalidate(iqpr _q,
+                              struct iqprtxcache_s * _e)
+{
+    _e->valid = 0;
+}
+
+// evict cache entry, releasing its buffers
+void iqpr_tx_cache_evict(iqpr _q,
+                         struct iqprtxcache_s * _e)
+{
+    iqpr_tx_cache_invalidate(_q, _e);
+    _q->tx_cache_bytes -= _e->payload_cap + _e->samples_cap*sizeof(std::complex<float>);
+    free(_e->payload);
+    free(_e->samples);
+    _e->payload     = NULL;
+    _e->samples     = NULL;
+    _e->payload_cap = 0;
+    _e->samples_cap = 0;
+}
+
+// insert rendered frame into cache. The memory cap counts allocated
+// buffers, valid or not, so that the steady state reuses them. The
+// frame goes, in order of preference, into a free slot whose buffers
+// fit it, an unallocated slot while the cap allows, or the
+// least-recently-used slot whose buffers fit it; only when none does is
+// a slot grown, releasing buffers of other slots (free, then least-
+// recently used) to stay within the cap
+void iqpr_tx_cache_insert(iqpr _q,
+                          unsigned char * _header,
+                          unsigned char * _payload,
+                          unsigned int _payload_len,
+                          std::complex<float> * _x,
+                          unsigned int _n)
+{
+    unsigned long int num_bytes = _payload_len + _n*sizeof(std::complex<float>);
+    if (_q->tx_cache_len == 0 || num_bytes > _q->tx_cache_max_bytes)
+        return;
+
+    // choose slot by preference, least-recently used among equals
+    unsigned int i;
+    struct iqprtxcache_s * slot = NULL;
+    int slot_rank = -1;
+    for (i=0; i<_q->tx_cache_len; i++) {
+        struct iqprtxcache_s * e = &_q->tx_cache[i];
+        int fits = e->samples != NULL && e->payload_cap >= _payload_len && e->samples_cap >= _n;
+        int rank = 0;
+        if (fits && !e->valid)
+            rank = 3;
+        else if (e->samples == NULL && _q->tx_cache_bytes + num_bytes <= _q->tx_cache_max_bytes)
+            rank = 2;
+        else if (fits)
+            rank = 1;
+        if (rank > slot_rank ||
+            (rank == slot_rank && (e->valid ? e->last_used : 0) < (slot->valid ? slot->last_used : 0)))
+        {
+            slot = e;
+            slot_rank = rank;
+        }
+    }
+    int slot_fits = slot_rank == 3 || slot_rank == 1;
+    iqpr_tx_cache_invalidate(_q, slot);
+
+    if (!slot_fits) {
+        // release slot's buffers, then others' until the frame fits
+        iqpr_tx_cache_evict(_q, slot);
+        while (_q->tx_cache_bytes + num_bytes > _q->tx_cache_max_bytes) {
+            struct iqprtxcache_s * lru = NULL;
+            for (i=0; i<_q->tx_cache_len; i++) {
+                struct iqprtxcache_s * e = &_q->tx_cache[i];
+                if (e->samples_cap == 0 && e->payload_cap == 0)
+                    continue;
+                if (lru == NULL || (e->valid ? e->last_used : 0) < (lru->valid ? lru->last_used : 0))
+                    lru = e;
+            }
+            iqpr_tx_cache_evict(_q, lru);
+        }
+
+        slot->payload_cap = _payload_len > 0 ? _payload_len : 1;
+        slot->payload     = (unsigned char*) malloc(slot->payload_cap);
+        slot->samples_cap = _n;
+        slot->samples     = iqpr_malloc_samples(_n);
+        _q->tx_cache_bytes += slot->payload_cap + slot->samples_cap*sizeof(std::complex<float>);
+    }
+
+    slot->valid       = 1;
+    slot->key         = iqpr_tx_cache_key(_header, _payload, _payload_len, &_q->fgprops);
+    slot->payload_len = _payload_len;
+    slot->num_samples = _n;
+    slot->last_used   = ++_q->tx_cache_clock;
+    memmove(slot->header, _header, 14);
+    memmove(&slot->fgprops, &_q->fgprops, sizeof(ofdmflexframegenprops_s));
+    memmove(slot->payload, _payload, _payload_len);
+    memmove(slot->samples, _x, _n*sizeof(std::complex<float>));
+}
+
+// invalidate all cache entries, keeping their buffers
+void iqpr_tx_cache_clear(iqpr _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->tx_cache_len; i++)
+        iqpr_tx_cache_invalidate(_q, &_q->tx_cache[i]);
+}
+
 // iqpr internal callback method
 int iqpr_callback(unsigned char *  _rx_header,
                   int              _rx_header_valid,
@@ -785,43 +2050,43 @@ int iqpr_callback(unsigned char *  _rx_header,
         // ...
     }
 
-    // set internal values
-    q->rx_packet_found  = 1;
-    q->rx_header_valid  = _rx_header_valid;
-    q->rx_payload_valid = _rx_payload_valid;
+    q->rx_num_frames++;
 
-    // copy header (regardless of validity)
-    memmove(q->rx_header, _rx_header, 14*sizeof(unsigned char));
-
-    if ( !_rx_header_valid ) {
-        //if (q->verbose) printf("header crc : FAIL\n");
+    // drop frame if queue is full
+    if (q->rx_queue_size == q->rx_queue_len) {
+        q->rx_num_drops_full++;
         return 0;
     }
 
-    if ( !_rx_payload_valid ) {
-        //if (q->verbose) printf("payload crc : FAIL\n");
+    // drop frame if payload does not fit in pooled buffer
+    if (_rx_header_valid && _rx_payload_len > q->rx_payload_max) {
+        q->rx_num_drops_oversize++;
         return 0;
     }
 
-    // save statistics
-    memmove(&q->rx_stats, &_stats, sizeof(framesyncstats_s));
-
-    // re-allocate memory arrays if necessary
-    if (q->rx_payload_len != _rx_payload_len) {
-        q->rx_payload_len = _rx_payload_len;
-        q->rx_payload = (unsigned char*) realloc(q->rx_payload, q->rx_payload_len*sizeof(unsigned char));
-    }
+    // append entry to queue
+    struct iqprframe_s * frame = &q->rx_frames[(q->rx_queue_read + q->rx_queue_size) % q->rx_queue_len];
+    q->rx_queue_size++;
 
-    // copy data (regardless of validity)
-    memmove(q->rx_payload, _rx_payload, _rx_payload_len*sizeof(unsigned char));
+    // copy header (regardless of validity)
+    memmove(frame->header, _rx_header, 14*sizeof(unsigned char));
+    frame->header_valid  = _rx_header_valid;
+    frame->payload_valid = _rx_header_valid ? _rx_payload_valid : 0;
 
-    if (!_rx_payload_valid) {
-        //if (q->verbose) printf("  <<< payload crc fail >>>\n");
+    // save statistics, arrival time
+    memmove(&frame->stats, &_stats, sizeof(framesyncstats_s));
+    frame->timestamp = q->rx_sync_time;
 
-        // payload failed check
+    if ( !_rx_header_valid ) {
+        //if (q->verbose) printf("header crc : FAIL\n");
+        frame->payload_len = 0;
         return 0;
     }
 
+    // copy data (regardless of validity)
+    frame->payload_len = _rx_payload_len;
+    memmove(frame->payload, _rx_payload, _rx_payload_len*sizeof(unsigned char));
+
     return 0;
 }
 
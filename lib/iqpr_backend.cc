@@ -0,0 +1,753 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// iqpr_backend.cc
+//
+// iqpr sample source/sink backends: usrp (uhd), memory-mapped file and
+// in-process loopback
+//
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <uhd/types/stream_cmd.hpp>
+#include <uhd/usrp/single_usrp.hpp>
+
+#include "iqpr.h"
+#include "profile.h"
+#include "sc16.h"
+
+// number of samples per block for file and loopback backends
+#define IQPR_BACKEND_BLOCK_LEN  (1024)
+
+// create usrp (uhd) backend, receiving sc16 samples if _sc16 is set
+iqpr_backend iqpr_backend_create_uhd_io(int _sc16);
+
+// default operations for properties a backend does not model
+void iqpr_backend_noop(void * _userdata) {}
+void iqpr_backend_noop_set(void * _userdata, double _value) {}
+
+// allocate backend with default (no-op) operations
+iqpr_backend iqpr_backend_alloc()
+{
+    iqpr_backend b = (iqpr_backend) malloc(sizeof(struct iqpr_backend_s));
+    memset(b, 0, sizeof(struct iqpr_backend_s));
+    b->set_rx_gain = iqpr_backend_noop_set;
+    b->set_tx_gain = iqpr_backend_noop_set;
+    b->set_rx_freq = iqpr_backend_noop_set;
+    b->set_tx_freq = iqpr_backend_noop_set;
+    b->rx_start    = iqpr_backend_noop;
+    b->rx_stop     = iqpr_backend_noop;
+    b->stats       = iostats_create(0.0);
+    return b;
+}
+
+// destroy backend object
+void iqpr_backend_destroy(iqpr_backend _b)
+{
+    if (_b->destroy != NULL)
+        _b->destroy(_b->userdata);
+
+    iostats_destroy(_b->stats);
+    free(_b);
+}
+
+// receive block of samples through backend
+unsigned int iqpr_backend_recv(iqpr_backend _b,
+                               std::complex<float> * _x,
+                               unsigned int _n,
+                               double * _timestamp)
+{
+    PROFILE_BEGIN(PROFILE_RECV);
+    unsigned int num_samples = _b->recv(_b->userdata, _x, _n, _timestamp);
+    PROFILE_END(PROFILE_RECV, num_samples);
+    iostats_rx(_b->stats, num_samples, 1, *_timestamp);
+    return num_samples;
+}
+
+// send block of samples through backend
+unsigned int iqpr_backend_send(iqpr_backend _b,
+                               std::complex<float> * _x,
+                               unsigned int _n,
+                               int _start_of_burst,
+                               int _end_of_burst)
+{
+    PROFILE_BEGIN(PROFILE_SEND);
+    unsigned int num_sent = _b->send(_b->userdata, _x, _n, _start_of_burst, _end_of_burst);
+    PROFILE_END(PROFILE_SEND, num_sent);
+    iostats_tx(_b->stats, num_sent);
+    return num_sent;
+}
+
+
+//
+// usrp (uhd) backend
+//
+
+struct iqpr_backend_uhd_s {
+    uhd::usrp::single_usrp::sptr usrp;
+    double rx_rate;                 // receive sample rate
+    double rx_time_next;            // expected time of next packet [s]
+    short * rx_sc16;                // sc16 receive buffer (NULL: float32 wire)
+    iostats stats;                  // backend i/o accounting (device events)
+};
+
+void iqpr_backend_uhd_destroy(void * _userdata)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    free(u->rx_sc16);
+    delete u;
+}
+
+double iqpr_backend_uhd_set_rx_rate(void * _userdata, double _rate)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    u->usrp->set_rx_rate(_rate);
+    u->rx_rate = u->usrp->get_rx_rate();
+    return u->rx_rate;
+}
+
+double iqpr_backend_uhd_set_tx_rate(void * _userdata, double _rate)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    u->usrp->set_tx_rate(_rate);
+    return u->usrp->get_tx_rate();
+}
+
+void iqpr_backend_uhd_set_rx_gain(void * _userdata, double _gain)
+{
+    ((struct iqpr_backend_uhd_s*) _userdata)->usrp->set_rx_gain(_gain);
+}
+
+void iqpr_backend_uhd_set_tx_gain(void * _userdata, double _gain)
+{
+    ((struct iqpr_backend_uhd_s*) _userdata)->usrp->set_tx_gain(_gain);
+}
+
+void iqpr_backend_uhd_set_rx_freq(void * _userdata, double _freq)
+{
+    ((struct iqpr_backend_uhd_s*) _userdata)->usrp->set_rx_freq(_freq);
+}
+
+void iqpr_backend_uhd_set_tx_freq(void * _userdata, double _freq)
+{
+    ((struct iqpr_backend_uhd_s*) _userdata)->usrp->set_tx_freq(_freq);
+}
+
+void iqpr_backend_uhd_rx_start(void * _userdata)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    printf("issuing stream command...\n");
+    u->usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+}
+
+void iqpr_backend_uhd_rx_stop(void * _userdata)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    u->usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+}
+
+unsigned int iqpr_backend_uhd_recv(void * _userdata,
+                                   std::complex<float> * _x,
+                                   unsigned int _n,
+                                   double * _timestamp)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    uhd::rx_metadata_t md;
+
+    // grab data from port; on the sc16 wire format samples are converted
+    // to float on the host
+    unsigned int num_samples = u->usrp->get_device()->recv(
+        u->rx_sc16 != NULL ? (void*)u->rx_sc16 : (void*)_x, _n, md,
+        u->rx_sc16 != NULL ? uhd::io_type_t::COMPLEX_INT16 : uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::RECV_MODE_ONE_PACKET
+    );
+    if (u->rx_sc16 != NULL)
+        sc16_convert(u->rx_sc16, num_samples, SC16_GAIN_UNITY, _x);
+
+    //handle the error codes
+    switch(md.error_code){
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+    case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        iostats_event(u->stats, IOSTATS_OVERFLOW);
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND:
+        iostats_event(u->stats, IOSTATS_LATE);
+        break;
+    default:
+        std::cerr << "Error code: " << md.error_code << std::endl;
+        std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+        exit(1);
+    }
+
+    // use hardware timestamp if present, otherwise extrapolate from the
+    // previous packet
+    *_timestamp = md.has_time_spec ? md.time_spec.get_real_secs() : u->rx_time_next;
+    u->rx_time_next = *_timestamp + (double)num_samples / u->rx_rate;
+
+    return num_samples;
+}
+
+unsigned int iqpr_backend_uhd_send(void * _userdata,
+                                   std::complex<float> * _x,
+                                   unsigned int _n,
+                                   int _start_of_burst,
+                                   int _end_of_burst)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+
+    // set up the metadta flags
+    uhd::tx_metadata_t md;
+    md.start_of_burst = _start_of_burst ? true : false;
+    md.end_of_burst   = _end_of_burst   ? true : false;
+    md.has_time_spec  = false;  // set to false to send immediately
+
+    unsigned int num_sent = u->usrp->get_device()->send(
+        _x, _n, md,
+        uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::SEND_MODE_FULL_BUFF
+    );
+
+    // collect pending asynchronous transmit events without blocking
+    uhd::async_metadata_t async_md;
+    while (u->usrp->get_device()->recv_async_msg(async_md, 0.0)) {
+        switch (async_md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(u->stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(u->stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+
+    return num_sent;
+}
+
+double iqpr_backend_uhd_get_time(void * _userdata)
+{
+    struct iqpr_backend_uhd_s * u = (struct iqpr_backend_uhd_s*) _userdata;
+    return u->usrp->get_time_now().get_real_secs();
+}
+
+// create usrp (uhd) backend
+iqpr_backend iqpr_backend_create_uhd()
+{
+    return iqpr_backend_create_uhd_io(0);
+}
+
+// create usrp (uhd) backend receiving the sc16 wire format
+iqpr_backend iqpr_backend_create_uhd_sc16()
+{
+    return iqpr_backend_create_uhd_io(1);
+}
+
+// create usrp (uhd) backend, receiving sc16 samples if _sc16 is set
+iqpr_backend iqpr_backend_create_uhd_io(int _sc16)
+{
+    struct iqpr_backend_uhd_s * u = new struct iqpr_backend_uhd_s;
+
+    // TODO : create USRP object
+    uhd::device_addr_t dev_addr;
+    // TODO : set up address as necessary
+    u->usrp = uhd::usrp::single_usrp::make(dev_addr);
+
+    // set some properties
+    u->usrp->set_rx_antenna("TX/RX");
+    //u->usrp->set_rx_antenna("RX2");
+    // some hacked magic to 'disable' receive chain when transmitting
+    // (from http://www.ruby-forum.com/topic/1527488)
+    //u->usrp->set_rx_lo_freq((_freq_range.start() + _freq_range.stop())/2.0);
+
+    u->rx_rate      = u->usrp->get_rx_rate();
+    u->rx_time_next = 0.0;
+
+    iqpr_backend b = iqpr_backend_alloc();
+    b->userdata       = (void*)u;
+    u->stats          = b->stats;
+    b->max_recv_samps = u->usrp->get_device()->get_max_recv_samps_per_packet();
+    b->max_send_samps = u->usrp->get_device()->get_max_send_samps_per_packet();
+
+    u->rx_sc16 = NULL;
+    if (_sc16) {
+        // 2 shorts per sample, aligned for the conversion kernels
+        if (posix_memalign((void**)&u->rx_sc16, 32, 2*b->max_recv_samps*sizeof(short)) != 0) {
+            fprintf(stderr,"error: iqpr_backend_create_uhd_sc16(), could not allocate buffer\n");
+            exit(1);
+        }
+    }
+    b->destroy        = iqpr_backend_uhd_destroy;
+    b->set_rx_rate    = iqpr_backend_uhd_set_rx_rate;
+    b->set_tx_rate    = iqpr_backend_uhd_set_tx_rate;
+    b->set_rx_gain    = iqpr_backend_uhd_set_rx_gain;
+    b->set_tx_gain    = iqpr_backend_uhd_set_tx_gain;
+    b->set_rx_freq    = iqpr_backend_uhd_set_rx_freq;
+    b->set_tx_freq    = iqpr_backend_uhd_set_tx_freq;
+    b->rx_start       = iqpr_backend_uhd_rx_start;
+    b->rx_stop        = iqpr_backend_uhd_rx_stop;
+    b->recv           = iqpr_backend_uhd_recv;
+    b->send           = iqpr_backend_uhd_send;
+    b->get_time       = iqpr_backend_uhd_get_time;
+    return b;
+}
+
+
+//
+// memory-mapped file backend
+//
+// Samples are raw interleaved complex float32.  The receive capture is
+// mapped read-only and handed out in blocks; once exhausted (or if no
+// capture is given) the receiver returns silence so that timeouts still
+// expire.  The transmit file is grown and re-mapped in large steps.
+//
+
+// transmit file growth step [samples]
+#define IQPR_BACKEND_FILE_TX_STEP   (1<<20)
+
+struct iqpr_backend_file_s {
+    double rx_rate;                 // receive sample rate
+    double tx_rate;                 // transmit sample rate
+
+    // receive capture
+    int rx_fd;                      // file descriptor (-1 if none)
+    std::complex<float> * rx_map;   // mapped capture
+    unsigned long int rx_len;       // capture length [samples]
+    unsigned long int rx_index;     // next sample in capture
+    unsigned long int rx_num_read;  // samples delivered (incl. silence)
+
+    // transmit file
+    int tx_fd;                      // file descriptor (-1 if none)
+    std::complex<float> * tx_map;   // mapped output
+    unsigned long int tx_alloc;     // mapped length [samples]
+    unsigned long int tx_len;       // samples written
+};
+
+void iqpr_backend_file_destroy(void * _userdata)
+{
+    struct iqpr_backend_file_s * f = (struct iqpr_backend_file_s*) _userdata;
+
+    if (f->rx_fd >= 0) {
+        if (f->rx_map != NULL)
+            munmap(f->rx_map, f->rx_len*sizeof(std::complex<float>));
+        close(f->rx_fd);
+    }
+
+    if (f->tx_fd >= 0) {
+        if (f->tx_map != NULL)
+            munmap(f->tx_map, f->tx_alloc*sizeof(std::complex<float>));
+
+        // trim file to samples actually written
+        if (ftruncate(f->tx_fd, f->tx_len*sizeof(std::complex<float>)) != 0)
+            fprintf(stderr,"warning: iqpr_backend_file_destroy(), could not truncate output\n");
+        close(f->tx_fd);
+    }
+
+    free(f);
+}
+
+double iqpr_backend_file_set_rx_rate(void * _userdata, double _rate)
+{
+    ((struct iqpr_backend_file_s*) _userdata)->rx_rate = _rate;
+    return _rate;
+}
+
+double iqpr_backend_file_set_tx_rate(void * _userdata, double _rate)
+{
+    ((struct iqpr_backend_file_s*) _userdata)->tx_rate = _rate;
+    return _rate;
+}
+
+unsigned int iqpr_backend_file_recv(void * _userdata,
+                                    std::complex<float> * _x,
+                                    unsigned int _n,
+                                    double * _timestamp)
+{
+    struct iqpr_backend_file_s * f = (struct iqpr_backend_file_s*) _userdata;
+
+    *_timestamp = (double)(f->rx_num_read) / f->rx_rate;
+
+    unsigned int i;
+    unsigned int n = 0;
+    if (f->rx_index < f->rx_len) {
+        n = (f->rx_len - f->rx_index < _n) ? f->rx_len - f->rx_index : _n;
+        memmove(_x, &f->rx_map[f->rx_index], n*sizeof(std::complex<float>));
+        f->rx_index += n;
+    } else {
+        // end of capture: silence
+        n = _n;
+        for (i=0; i<n; i++)
+            _x[i] = 0.0f;
+    }
+
+    f->rx_num_read += n;
+    return n;
+}
+
+unsigned int iqpr_backend_file_send(void * _userdata,
+                                    std::complex<float> * _x,
+                                    unsigned int _n,
+                                    int _start_of_burst,
+                                    int _end_of_burst)
+{
+    struct iqpr_backend_file_s * f = (struct iqpr_backend_file_s*) _userdata;
+
+    if (f->tx_fd < 0)
+        return _n;
+
+    // grow file and mapping as necessary
+    if (f->tx_len + _n > f->tx_alloc) {
+        unsigned long int tx_alloc = f->tx_alloc + IQPR_BACKEND_FILE_TX_STEP;
+        while (f->tx_len + _n > tx_alloc)
+            tx_alloc += IQPR_BACKEND_FILE_TX_STEP;
+
+        if (ftruncate(f->tx_fd, tx_alloc*sizeof(std::complex<float>)) != 0) {
+            fprintf(stderr,"error: iqpr_backend_file_send(), could not extend output: %s\n", strerror(errno));
+            exit(1);
+        }
+
+        void * map = (f->tx_map == NULL) ?
+            mmap(NULL, tx_alloc*sizeof(std::complex<float>), PROT_READ | PROT_WRITE, MAP_SHARED, f->tx_fd, 0) :
+            mremap(f->tx_map, f->tx_alloc*sizeof(std::complex<float>), tx_alloc*sizeof(std::complex<float>), MREMAP_MAYMOVE);
+        if (map == MAP_FAILED) {
+            fprintf(stderr,"error: iqpr_backend_file_send(), could not map output: %s\n", strerror(errno));
+            exit(1);
+        }
+        f->tx_map   = (std::complex<float>*) map;
+        f->tx_alloc = tx_alloc;
+    }
+
+    memmove(&f->tx_map[f->tx_len], _x, _n*sizeof(std::complex<float>));
+    f->tx_len += _n;
+    return _n;
+}
+
+double iqpr_backend_file_get_time(void * _userdata)
+{
+    struct iqpr_backend_file_s * f = (struct iqpr_backend_file_s*) _userdata;
+    return (double)(f->rx_num_read) / f->rx_rate;
+}
+
+// create memory-mapped file backend
+//  _rx_filename    :   receive capture (raw complex float32), NULL for silence
+//  _tx_filename    :   transmit output (raw complex float32), NULL to discard
+iqpr_backend iqpr_backend_create_file(const char * _rx_filename,
+                                      const char * _tx_filename)
+{
+    struct iqpr_backend_file_s * f = (struct iqpr_backend_file_s*) malloc(sizeof(struct iqpr_backend_file_s));
+    f->rx_rate     = 1.0;
+    f->tx_rate     = 1.0;
+    f->rx_fd       = -1;
+    f->rx_map      = NULL;
+    f->rx_len      = 0;
+    f->rx_index    = 0;
+    f->rx_num_read = 0;
+    f->tx_fd       = -1;
+    f->tx_map      = NULL;
+    f->tx_alloc    = 0;
+    f->tx_len      = 0;
+
+    // map receive capture
+    if (_rx_filename != NULL) {
+        f->rx_fd = open(_rx_filename, O_RDONLY);
+        if (f->rx_fd < 0) {
+            fprintf(stderr,"error: iqpr_backend_create_file(), could not open '%s' for reading\n", _rx_filename);
+            exit(1);
+        }
+        struct stat st;
+        fstat(f->rx_fd, &st);
+        f->rx_len = st.st_size / sizeof(std::complex<float>);
+        if (f->rx_len > 0) {
+            void * map = mmap(NULL, f->rx_len*sizeof(std::complex<float>), PROT_READ, MAP_PRIVATE, f->rx_fd, 0);
+            if (map == MAP_FAILED) {
+                fprintf(stderr,"error: iqpr_backend_create_file(), could not map '%s'\n", _rx_filename);
+                exit(1);
+            }
+            madvise(map, f->rx_len*sizeof(std::complex<float>), MADV_SEQUENTIAL);
+            f->rx_map = (std::complex<float>*) map;
+        }
+    }
+
+    // open transmit file (mapped on first send)
+    if (_tx_filename != NULL) {
+        f->tx_fd = open(_tx_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (f->tx_fd < 0) {
+            fprintf(stderr,"error: iqpr_backend_create_file(), could not open '%s' for writing\n", _tx_filename);
+            exit(1);
+        }
+    }
+
+    iqpr_backend b = iqpr_backend_alloc();
+    b->userdata       = (void*)f;
+    b->max_recv_samps = IQPR_BACKEND_BLOCK_LEN;
+    b->max_send_samps = IQPR_BACKEND_BLOCK_LEN;
+    b->destroy        = iqpr_backend_file_destroy;
+    b->set_rx_rate    = iqpr_backend_file_set_rx_rate;
+    b->set_tx_rate    = iqpr_backend_file_set_tx_rate;
+    b->recv           = iqpr_backend_file_recv;
+    b->send           = iqpr_backend_file_send;
+    b->get_time       = iqpr_backend_file_get_time;
+    return b;
+}
+
+
+//
+// in-process loopback backend
+//
+// Each direction of the link is a sample timeline shared by one writer
+// and one reader.  Transmitted samples are placed on the peer's timeline
+// at the sender's current time (its receive position) plus the link
+// delay, or directly after previous samples if later, with silence in
+// between; burst flags are ignored.  A receiver with nothing to read
+// waits briefly for its peer and then advances over silence, so both
+// nodes run as fast as they can process samples while timeouts still
+// expire.
+//
+
+// time to wait for peer before returning silence [microseconds]
+#define IQPR_BACKEND_LOOPBACK_WAIT  (1000)
+
+// one direction of the link
+struct iqpr_loopback_channel_s {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    std::complex<float> * buffer;   // samples [read_pos, write_end)
+    unsigned long int alloc;        // allocated length of buffer
+    unsigned long int base;         // timeline position of buffer[0]
+    unsigned long int read_pos;     // reader position (reader's clock)
+    unsigned long int write_end;    // end of written samples
+};
+
+// link shared by both endpoints
+struct iqpr_loopback_s {
+    struct iqpr_loopback_channel_s channel[2];  // channel[i] is received by endpoint i
+    unsigned int delay;             // link delay [samples]
+    unsigned int refcount;          // number of endpoints not yet destroyed
+    pthread_mutex_t lock;
+};
+
+// one endpoint of the link
+struct iqpr_backend_loopback_s {
+    struct iqpr_loopback_s * link;
+    unsigned int index;             // endpoint index (0 or 1)
+    double rx_rate;                 // receive sample rate
+};
+
+void iqpr_backend_loopback_destroy(void * _userdata)
+{
+    struct iqpr_backend_loopback_s * e = (struct iqpr_backend_loopback_s*) _userdata;
+    struct iqpr_loopback_s * link = e->link;
+    free(e);
+
+    pthread_mutex_lock(&link->lock);
+    unsigned int refcount = --link->refcount;
+    pthread_mutex_unlock(&link->lock);
+    if (refcount > 0)
+        return;
+
+    // last endpoint: free link
+    unsigned int i;
+    for (i=0; i<2; i++) {
+        pthread_mutex_destroy(&link->channel[i].lock);
+        pthread_cond_destroy(&link->channel[i].cond);
+        free(link->channel[i].buffer);
+    }
+    pthread_mutex_destroy(&link->lock);
+    free(link);
+}
+
+double iqpr_backend_loopback_set_rx_rate(void * _userdata, double _rate)
+{
+    ((struct iqpr_backend_loopback_s*) _userdata)->rx_rate = _rate;
+    return _rate;
+}
+
+double iqpr_backend_loopback_set_tx_rate(void * _userdata, double _rate)
+{
+    return _rate;
+}
+
+// ensure channel buffer holds timeline up to _end; lock must be held
+void iqpr_loopback_channel_reserve(struct iqpr_loopback_channel_s * _c,
+                                   unsigned long int _end)
+{
+    // discard samples already read
+    if (_c->read_pos > _c->base) {
+        unsigned long int num_pending = _c->write_end - _c->read_pos;
+        memmove(_c->buffer, &_c->buffer[_c->read_pos - _c->base], num_pending*sizeof(std::complex<float>));
+        _c->base = _c->read_pos;
+    }
+
+    if (_end - _c->base > _c->alloc) {
+        _c->alloc  = 2*(_end - _c->base);
+        _c->buffer = (std::complex<float>*) realloc(_c->buffer, _c->alloc*sizeof(std::complex<float>));
+    }
+}
+
+unsigned int iqpr_backend_loopback_recv(void * _userdata,
+                                        std::complex<float> * _x,
+                                        unsigned int _n,
+                                        double * _timestamp)
+{
+    struct iqpr_backend_loopback_s * e = (struct iqpr_backend_loopback_s*) _userdata;
+    struct iqpr_loopback_channel_s * c = &e->link->channel[e->index];
+
+    pthread_mutex_lock(&c->lock);
+
+    // wait briefly for peer
+    if (c->write_end == c->read_pos) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        struct timespec abstime;
+        unsigned long int usec = now.tv_usec + IQPR_BACKEND_LOOPBACK_WAIT;
+        abstime.tv_sec  = now.tv_sec + usec / 1000000;
+        abstime.tv_nsec = (usec % 1000000) * 1000;
+        pthread_cond_timedwait(&c->cond, &c->lock, &abstime);
+    }
+
+    *_timestamp = (double)(c->read_pos) / e->rx_rate;
+
+    unsigned int i;
+    unsigned int n;
+    if (c->write_end > c->read_pos) {
+        n = (c->write_end - c->read_pos < _n) ? c->write_end - c->read_pos : _n;
+        memmove(_x, &c->buffer[c->read_pos - c->base], n*sizeof(std::complex<float>));
+        c->read_pos += n;
+    } else {
+        // nothing sent: advance over silence
+        n = _n;
+        for (i=0; i<n; i++)
+            _x[i] = 0.0f;
+        c->read_pos += n;
+        c->write_end = c->read_pos;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
+
+unsigned int iqpr_backend_loopback_send(void * _userdata,
+                                        std::complex<float> * _x,
+                                        unsigned int _n,
+                                        int _start_of_burst,
+                                        int _end_of_burst)
+{
+    struct iqpr_backend_loopback_s * e = (struct iqpr_backend_loopback_s*) _userdata;
+    struct iqpr_loopback_channel_s * r = &e->link->channel[e->index];   // own receive
+    struct iqpr_loopback_channel_s * c = &e->link->channel[1-e->index]; // peer receive
+
+    // sender's clock
+    pthread_mutex_lock(&r->lock);
+    unsigned long int now = r->read_pos;
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_mutex_lock(&c->lock);
+
+    // samples are placed no earlier than now plus link delay
+    unsigned long int start = c->write_end;
+    if (now + e->link->delay > start)
+        start = now + e->link->delay;
+
+    iqpr_loopback_channel_reserve(c, start + _n);
+
+    // silence between previous samples and this burst
+    unsigned long int i;
+    for (i=c->write_end; i<start; i++)
+        c->buffer[i - c->base] = 0.0f;
+    memmove(&c->buffer[start - c->base], _x, _n*sizeof(std::complex<float>));
+    c->write_end = start + _n;
+
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    return _n;
+}
+
+double iqpr_backend_loopback_get_time(void * _userdata)
+{
+    struct iqpr_backend_loopback_s * e = (struct iqpr_backend_loopback_s*) _userdata;
+    struct iqpr_loopback_channel_s * c = &e->link->channel[e->index];
+
+    pthread_mutex_lock(&c->lock);
+    unsigned long int now = c->read_pos;
+    pthread_mutex_unlock(&c->lock);
+
+    return (double)now / e->rx_rate;
+}
+
+// create pair of in-process loopback backends; samples sent on one are
+// received on the other after _delay samples
+//  _delay  :   link delay [samples]
+//  _b0     :   first endpoint
+//  _b1     :   second endpoint
+void iqpr_backend_create_loopback(unsigned int _delay,
+                                  iqpr_backend * _b0,
+                                  iqpr_backend * _b1)
+{
+    struct iqpr_loopback_s * link = (struct iqpr_loopback_s*) malloc(sizeof(struct iqpr_loopback_s));
+    link->delay    = _delay;
+    link->refcount = 2;
+    pthread_mutex_init(&link->lock, NULL);
+
+    unsigned int i;
+    for (i=0; i<2; i++) {
+        struct iqpr_loopback_channel_s * c = &link->channel[i];
+        pthread_mutex_init(&c->lock, NULL);
+        pthread_cond_init(&c->cond, NULL);
+        c->alloc     = 16*IQPR_BACKEND_BLOCK_LEN;
+        c->buffer    = (std::complex<float>*) malloc(c->alloc*sizeof(std::complex<float>));
+        c->base      = 0;
+        c->read_pos  = 0;
+        c->write_end = 0;
+    }
+
+    iqpr_backend * b[2] = {_b0, _b1};
+    for (i=0; i<2; i++) {
+        struct iqpr_backend_loopback_s * e = (struct iqpr_backend_loopback_s*) malloc(sizeof(struct iqpr_backend_loopback_s));
+        e->link    = link;
+        e->index   = i;
+        e->rx_rate = 1.0;
+
+        *b[i] = iqpr_backend_alloc();
+        (*b[i])->userdata       = (void*)e;
+        (*b[i])->max_recv_samps = IQPR_BACKEND_BLOCK_LEN;
+        (*b[i])->max_send_samps = IQPR_BACKEND_BLOCK_LEN;
+        (*b[i])->destroy        = iqpr_backend_loopback_destroy;
+        (*b[i])->set_rx_rate    = iqpr_backend_loopback_set_rx_rate;
+        (*b[i])->set_tx_rate    = iqpr_backend_loopback_set_tx_rate;
+        (*b[i])->recv           = iqpr_backend_loopback_recv;
+        (*b[i])->send           = iqpr_backend_loopback_send;
+        (*b[i])->get_time       = iqpr_backend_loopback_get_time;
+    }
+}
+
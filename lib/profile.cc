@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// profile
+//
+// Each thread keeps its own counters (registered in a global list on its
+// first PROFILE_BEGIN) so that timing a stage takes no lock.  Time is
+// read from the time stamp counter on x86, and CLOCK_MONOTONIC_RAW
+// elsewhere; ticks are converted to seconds only when printing, by
+// comparing the tick count against CLOCK_MONOTONIC_RAW over the whole
+// run.  Active stages are kept on a per-thread stack so that a stage
+// which calls into another (e.g. the resampler invoking the synchronizer
+// through its sink) is only charged for its own time.
+//
+// Counters are updated without synchronization; profile_print() and
+// profile_reset() are meant to be called once the threads are idle.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "profile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define PROFILE_RDTSC
+#  include <x86intrin.h>
+#endif
+
+// stage names
+static const char * profile_stage_str[PROFILE_NUM_STAGES] = {
+    "recv",
+    "sc16",
+    "resamp2",
+    "resamp",
+    "channelizer",
+    "sync",
+    "framegen",
+    "send",
+};
+
+// stage counters
+struct profile_stage_s {
+    unsigned long int num_calls;            // completed begin/end pairs
+    unsigned long int num_samples;          // samples processed
+    uint64_t ticks;                         // time in stage (excluding nested stages)
+    unsigned long int hist[PROFILE_NUM_BUCKETS]; // log2(ticks) per call
+};
+
+// active stage
+struct profile_frame_s {
+    int stage;                              // stage
+    uint64_t t0;                            // ticks at begin
+    uint64_t child;                         // ticks spent in nested stages
+};
+
+// per-thread state
+struct profile_thread_s {
+    struct profile_stage_s stage[PROFILE_NUM_STAGES];
+    struct profile_frame_s stack[PROFILE_MAX_DEPTH];
+    unsigned int depth;                     // number of active stages
+    struct profile_thread_s * next;         // next thread in list
+};
+
+static __thread struct profile_thread_s * profile_self = NULL;
+static struct profile_thread_s * profile_threads = NULL;
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// tick/time reference for calibration
+static uint64_t profile_ticks0;
+static double   profile_time0;
+
+// get raw monotonic time [s]
+double profile_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+// get tick count
+static inline uint64_t profile_ticks()
+{
+#ifdef PROFILE_RDTSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// get calling thread's state, registering it on first use
+static inline struct profile_thread_s * profile_thread()
+{
+    if (profile_self != NULL)
+        return profile_self;
+
+    struct profile_thread_s * t = (struct profile_thread_s*) calloc(1, sizeof(struct profile_thread_s));
+    pthread_mutex_lock(&profile_mutex);
+    if (profile_threads == NULL) {
+        profile_time0  = profile_time();
+        profile_ticks0 = profile_ticks();
+    }
+    t->next = profile_threads;
+    profile_threads = t;
+    pthread_mutex_unlock(&profile_mutex);
+
+    profile_self = t;
+    return t;
+}
+
+// start timing stage in calling thread
+void profile_begin(int _stage)
+{
+    struct profile_thread_s * t = profile_thread();
+    if (_stage < 0 || _stage >= PROFILE_NUM_STAGES) {
+        fprintf(stderr,"error: profile_begin(), invalid stage %d\n", _stage);
+        exit(1);
+    } else if (t->depth == PROFILE_MAX_DEPTH) {
+        fprintf(stderr,"error: profile_begin(), maximum nesting depth (%u) exceeded\n", PROFILE_MAX_DEPTH);
+        exit(1);
+    }
+
+    struct profile_frame_s * f = &t->stack[t->depth++];
+    f->stage = _stage;
+    f->child = 0;
+    f->t0    = profile_ticks();
+}
+
+// stop timing stage in calling thread
+void profile_end(int _stage,
+                 unsigned int _n)
+{
+    uint64_t t1 = profile_ticks();
+    struct profile_thread_s * t = profile_self;
+    if (t == NULL || t->depth == 0 || t->stack[t->depth-1].stage != _stage) {
+        fprintf(stderr,"error: profile_end(), stage %d was not started\n", _stage);
+        exit(1);
+    }
+
+    struct profile_frame_s * f = &t->stack[--t->depth];
+    uint64_t elapsed = t1 - f->t0;
+    uint64_t ticks   = elapsed > f->child ? elapsed - f->child : 0;
+
+    // histogram bucket k > 0 holds [2^(k-1), 2^k) ticks
+    unsigned int k = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    if (k >= PROFILE_NUM_BUCKETS)
+        k = PROFILE_NUM_BUCKETS-1;
+
+    struct profile_stage_s * s = &t->stage[_stage];
+    s->num_calls++;
+    s->num_samples += _n;
+    s->ticks += ticks;
+    s->hist[k]++;
+
+    // charge enclosing stage's nested time
+    if (t->depth > 0)
+        t->stack[t->depth-1].child += elapsed;
+}
+
+// clear counters of all threads
+void profile_reset()
+{
+    pthread_mutex_lock(&profile_mutex);
+    struct profile_thread_s * t;
+    for (t=profile_threads; t!=NULL; t=t->next)
+        memset(t->stage, 0, sizeof(t->stage));
+    pthread_mutex_unlock(&profile_mutex);
+}
+
+// upper bound of latency percentile _p from histogram [ticks]
+double profile_percentile(struct profile_stage_s * _s,
+                          float _p)
+{
+    unsigned long int target = (unsigned long int)(_p * _s->num_calls);
+    unsigned long int n = 0;
+    unsigned int k;
+    for (k=0; k<PROFILE_NUM_BUCKETS; k++) {
+        n += _s->hist[k];
+        if (n > target)
+            break;
+    }
+    return k == 0 ? 0.0 : (double)(1ULL << (k < 63 ? k : 63));
+}
+
+// print per-stage totals over all threads
+void profile_print()
+{
+    pthread_mutex_lock(&profile_mutex);
+
+    // sum stages over threads
+    struct profile_stage_s total[PROFILE_NUM_STAGES];
+    memset(total, 0, sizeof(total));
+    unsigned int num_threads = 0;
+    struct profile_thread_s * t;
+    unsigned int i;
+    unsigned int k;
+    for (t=profile_threads; t!=NULL; t=t->next) {
+        for (i=0; i<PROFILE_NUM_STAGES; i++) {
+            total[i].num_calls   += t->stage[i].num_calls;
+            total[i].num_samples += t->stage[i].num_samples;
+            total[i].ticks       += t->stage[i].ticks;
+            for (k=0; k<PROFILE_NUM_BUCKETS; k++)
+                total[i].hist[k] += t->stage[i].hist[k];
+        }
+        num_threads++;
+    }
+
+    // ticks per second
+    double runtime = num_threads > 0 ? profile_time() - profile_time0 : 0.0;
+#ifdef PROFILE_RDTSC
+    double rate = runtime > 0.0 ? (double)(profile_ticks() - profile_ticks0) / runtime : 1.0;
+#else
+    double rate = 1e9;
+#endif
+
+    printf("profile: %u thread(s), %.3f s\n", num_threads, runtime);
+    printf("    %-10s %10s %12s %10s %10s %10s %10s %10s\n",
+            "stage", "calls", "samples", "time [ms]", "Msamp/s", "ns/samp", "p50 [us]", "p99 [us]");
+    for (i=0; i<PROFILE_NUM_STAGES; i++) {
+        struct profile_stage_s * s = &total[i];
+        if (s->num_calls == 0)
+            continue;
+
+        double time = (double)s->ticks / rate;
+        printf("    %-10s %10lu %12lu %10.2f %10.3f %10.2f %10.2f %10.2f\n",
+                profile_stage_str[i],
+                s->num_calls,
+                s->num_samples,
+                time*1e3,
+                time > 0.0 ? 1e-6*(double)s->num_samples / time : 0.0,
+                s->num_samples > 0 ? 1e9*time / (double)s->num_samples : 0.0,
+                1e6*profile_percentile(s, 0.50f) / rate,
+                1e6*profile_percentile(s, 0.99f) / rate);
+    }
+
+    pthread_mutex_unlock(&profile_mutex);
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rateplan
+//
+// Every supported usrp factor is paired with every host chain that can
+// bridge the remaining ratio; the cheapest pair wins.  Filters are sized
+// for the target stopband with the Kaiser length estimate, and the cost
+// of each chain is the number of multiply-accumulates per baseband
+// sample:
+//
+//  half-band stage     :   2m+1 per low-rate sample (polyphase, half of
+//                          the taps are zero)
+//  arbitrary resampler :   2 dot products of 2m taps per output sample
+//                          (interpolation between filterbank branches)
+//  polyphase P/Q       :   one branch of the prototype per output sample
+//
+// msresamp_crcf is a cascade of floor(log2(r)) half-band stages followed
+// by an arbitrary resampler, and is covered by the half-band candidates.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "rateplan.h"
+
+// the signal occupies half of the baseband rate (2x over-sampled)
+#define RATEPLAN_SIGNAL_EDGE    (0.25)
+
+// keep the signal within the flat part of the usrp's own (CIC) filters:
+// signal edge must be no more than this fraction of the usrp rate
+#define RATEPLAN_HW_PASSBAND    (0.125)
+
+// maximum polyphase interpolation factor searched
+#define RATEPLAN_MAX_P          (32)
+
+// maximum filter length considered practical
+#define RATEPLAN_MAX_FILTER_LEN (4096)
+
+// design half-band cascade of _k stages and arbitrary resampler between
+// usrp rate _fu and baseband rate _fb, returning cost or -1 if infeasible
+float rateplan_design_halfband(struct rateplan_s * _plan,
+                               double _fu,
+                               double _fb,
+                               unsigned int _k);
+
+// design rational polyphase resampler P/Q between usrp rate _fu and
+// baseband rate _fb, returning cost or -1 if infeasible
+float rateplan_design_polyphase(struct rateplan_s * _plan,
+                                double _fu,
+                                double _fb);
+
+// design rate plan
+int rateplan_design(struct rateplan_s * _plan,
+                    int          _direction,
+                    double       _converter_rate,
+                    double       _baseband_rate,
+                    float        _As,
+                    unsigned int _chain_mask)
+{
+    // validate input
+    if (_direction != RATEPLAN_RX && _direction != RATEPLAN_TX) {
+        fprintf(stderr,"error: rateplan_design(), invalid direction\n");
+        exit(1);
+    } else if (_converter_rate <= 0.0 || _baseband_rate <= 0.0) {
+        fprintf(stderr,"error: rateplan_design(), rates must be greater than zero\n");
+        exit(1);
+    } else if (_As <= 0.0f) {
+        fprintf(stderr,"error: rateplan_design(), stopband attenuation must be greater than zero\n");
+        exit(1);
+    }
+
+    struct rateplan_s best;
+    best.cost = -1.0f;
+
+    struct rateplan_s candidate;
+    candidate.direction      = _direction;
+    candidate.converter_rate = _converter_rate;
+    candidate.baseband_rate  = _baseband_rate;
+    candidate.As             = _As;
+
+    unsigned int h;
+    unsigned int k;
+    for (h=1; h<=512; h++) {
+        if (!rateplan_valid_hw_factor(_direction, h))
+            continue;
+
+        double fu = _converter_rate / (double)h;
+        double fb = _baseband_rate;
+        if (RATEPLAN_SIGNAL_EDGE*fb > RATEPLAN_HW_PASSBAND*fu)
+            continue;
+
+        candidate.hw_factor = h;
+        candidate.usrp_rate = fu;
+
+        // half-band cascade: each stage needs a full factor of 2
+        for (k=0; k<=RATEPLAN_MAX_HALFBAND && (_chain_mask & RATEPLAN_CHAIN_HALFBAND); k++) {
+            if ( (double)(1<<k) > fu/fb )
+                break;
+
+            float cost = rateplan_design_halfband(&candidate, fu, fb, k);
+
+            // ties go to the larger usrp factor (less bus traffic)
+            if (cost >= 0.0f && (best.cost < 0.0f || cost <= best.cost))
+                best = candidate;
+        }
+
+        // rational polyphase
+        if (_chain_mask & RATEPLAN_CHAIN_POLYPHASE) {
+            float cost = rateplan_design_polyphase(&candidate, fu, fb);
+            if (cost >= 0.0f && (best.cost < 0.0f || cost <= best.cost))
+                best = candidate;
+        }
+    }
+
+    if (best.cost < 0.0f)
+        return -1;
+
+    *_plan = best;
+    return 0;
+}
+
+// design half-band chain for given usrp factor
+int rateplan_design_fixed(struct rateplan_s * _plan,
+                          int          _direction,
+                          double       _converter_rate,
+                          unsigned int _hw_factor,
+                          double       _baseband_rate,
+                          unsigned int _num_halfband,
+                          float        _As)
+{
+    // validate input
+    if (_direction != RATEPLAN_RX && _direction != RATEPLAN_TX) {
+        fprintf(stderr,"error: rateplan_design_fixed(), invalid direction\n");
+        exit(1);
+    } else if (_converter_rate <= 0.0 || _baseband_rate <= 0.0 || _hw_factor == 0) {
+        fprintf(stderr,"error: rateplan_design_fixed(), rates must be greater than zero\n");
+        exit(1);
+    } else if (_num_halfband > RATEPLAN_MAX_HALFBAND) {
+        fprintf(stderr,"error: rateplan_design_fixed(), at most %u half-band stages\n", RATEPLAN_MAX_HALFBAND);
+        exit(1);
+    } else if (_As <= 0.0f) {
+        fprintf(stderr,"error: rateplan_design_fixed(), stopband attenuation must be greater than zero\n");
+        exit(1);
+    }
+
+    struct rateplan_s plan;
+    plan.direction      = _direction;
+    plan.converter_rate = _converter_rate;
+    plan.baseband_rate  = _baseband_rate;
+    plan.As             = _As;
+    plan.hw_factor      = _hw_factor;
+    plan.usrp_rate      = _converter_rate / (double)_hw_factor;
+
+    if (rateplan_design_halfband(&plan, plan.usrp_rate, _baseband_rate, _num_halfband) < 0.0f)
+        return -1;
+
+    *_plan = plan;
+    return 0;
+}
+
+// print rate plan
+void rateplan_print(struct rateplan_s * _plan)
+{
+    int rx = _plan->direction == RATEPLAN_RX;
+    printf("rate plan (%s):\n", rx ? "rx" : "tx");
+    printf("    converter rate      :   %12.6f MHz\n", _plan->converter_rate*1e-6);
+    printf("    %-20s:   %u\n", rx ? "usrp decimation" : "usrp interpolation", _plan->hw_factor);
+    printf("    usrp rate           :   %12.6f kHz\n", _plan->usrp_rate*1e-3);
+    printf("    baseband rate       :   %12.6f kHz\n", _plan->baseband_rate*1e-3);
+
+    unsigned int i;
+    if (_plan->chain == RATEPLAN_CHAIN_HALFBAND) {
+        printf("    half-band stages    :   %u", _plan->num_halfband);
+        for (i=0; i<_plan->num_halfband; i++)
+            printf("%s m=%u", i==0 ? " (" : ",", _plan->halfband_m[i]);
+        printf("%s\n", _plan->num_halfband > 0 ? ")" : "");
+        printf("    arbitrary resampler :   r=%8.6f (m=%u, fc=%5.3f)\n",
+                _plan->resamp_rate, _plan->resamp_m, _plan->resamp_fc);
+    } else {
+        printf("    polyphase           :   %u/%u (%u taps)\n",
+                _plan->P, _plan->Q, _plan->poly_len);
+    }
+    printf("    stopband            :   %6.1f dB\n", _plan->As);
+    printf("    modelled cost       :   %6.1f MAC/sample (%.2f MMAC/s)\n",
+            _plan->cost, _plan->cost_mmacs);
+}
+
+// set actual usrp rate, correcting arbitrary resampling rate
+void rateplan_set_usrp_rate(struct rateplan_s * _plan,
+                            double _usrp_rate)
+{
+    _plan->usrp_rate = _usrp_rate;
+    if (_plan->chain != RATEPLAN_CHAIN_HALFBAND)
+        return;
+
+    // rate at baseband side of arbitrary resampler
+    double f = _plan->baseband_rate * (double)(1<<_plan->num_halfband);
+    _plan->resamp_rate = _plan->direction == RATEPLAN_RX ? f / _usrp_rate : _usrp_rate / f;
+}
+
+// is usrp decimation (rx) or interpolation (tx) factor supported?
+int rateplan_valid_hw_factor(int _direction,
+                             unsigned int _factor)
+{
+    if (_direction == RATEPLAN_RX) {
+        // even decimation in [4,256]
+        return _factor >= 4 && _factor <= 256 && (_factor % 2) == 0;
+    }
+
+    // interpolation: multiple of 4 in [4,512]; 240 and 244 do not work
+    return _factor >= 4 && _factor <= 512 && (_factor % 4) == 0 &&
+           _factor != 240 && _factor != 244;
+}
+
+// estimate filter length (Kaiser)
+unsigned int rateplan_filter_len(float _df,
+                                 float _As)
+{
+    if (_df <= 0.0f)
+        return RATEPLAN_MAX_FILTER_LEN + 1;
+
+    float n = (_As - 7.95f) / (14.26f * _df);
+    return n < 1.0f ? 1 : (unsigned int) ceilf(n);
+}
+
+// design half-band cascade and arbitrary resampler
+float rateplan_design_halfband(struct rateplan_s * _plan,
+                               double _fu,
+                               double _fb,
+                               unsigned int _k)
+{
+    int rx = _plan->direction == RATEPLAN_RX;
+    double edge = RATEPLAN_SIGNAL_EDGE * _fb;
+    float cost = 0.0f;
+
+    _plan->chain        = RATEPLAN_CHAIN_HALFBAND;
+    _plan->num_halfband = _k;
+    _plan->P            = 0;
+    _plan->Q            = 0;
+    _plan->poly_len     = 0;
+
+    // half-band stages, in signal order (rx: from usrp, tx: from baseband)
+    unsigned int i;
+    for (i=0; i<_k; i++) {
+        // high and low rates of this stage
+        double f_lo = rx ? _fu / (double)(1<<(i+1)) : _fb * (double)(1<<i);
+        double f_hi = 2.0*f_lo;
+
+        // transition band: signal edge to its alias/image at f_hi/2
+        float df = 0.5f - 2.0f*(float)(edge / f_hi);
+        unsigned int n = rateplan_filter_len(df, _plan->As);
+        unsigned int m = (n + 2) / 4;   // length 4m+1
+        if (m < 2) m = 2;
+        _plan->halfband_m[i] = m;
+
+        cost += (float)(2*m+1) * (float)(f_lo / _fb);
+    }
+
+    // arbitrary resampler between half-band cascade and usrp/baseband
+    double f_in  = rx ? _fu / (double)(1<<_k) : _fb * (double)(1<<_k);
+    double f_out = rx ? _fb : _fu;
+    double f_min = f_in < f_out ? f_in : f_out;
+    float df = (float)((f_min - 2.0*edge) / f_in);
+    unsigned int n = rateplan_filter_len(df, _plan->As);
+    if (n > RATEPLAN_MAX_FILTER_LEN)
+        return -1.0f;
+    unsigned int m = (n + 1) / 2;       // length 2m
+    if (m < 2) m = 2;
+
+    float fc = (float)(0.5 * f_min / f_in);
+    _plan->resamp_rate = f_out / f_in;
+    _plan->resamp_m    = m;
+    _plan->resamp_fc   = fc > 0.45f ? 0.45f : fc;
+
+    cost += (float)(2*2*m) * (float)(f_out / _fb);
+
+    _plan->cost       = cost;
+    _plan->cost_mmacs = cost * _fb * 1e-6;
+    return cost;
+}
+
+// design rational polyphase resampler
+float rateplan_design_polyphase(struct rateplan_s * _plan,
+                                double _fu,
+                                double _fb)
+{
+    int rx = _plan->direction == RATEPLAN_RX;
+    double f_in  = rx ? _fu : _fb;
+    double f_out = rx ? _fb : _fu;
+    double r = f_out / f_in;
+
+    // find smallest P for which r = P/Q exactly
+    unsigned int P;
+    unsigned int Q = 0;
+    for (P=1; P<=RATEPLAN_MAX_P; P++) {
+        double q = (double)P / r;
+        if (fabs(q - round(q)) < 1e-6*q) {
+            Q = (unsigned int) round(q);
+            break;
+        }
+    }
+    if (Q == 0)
+        return -1.0f;
+
+    // prototype runs at the interpolated rate P*f_in
+    double edge = RATEPLAN_SIGNAL_EDGE * _fb;
+    double f_min = f_in < f_out ? f_in : f_out;
+    float df = (float)((f_min - 2.0*edge) / (f_in * P));
+    unsigned int n = rateplan_filter_len(df, _plan->As);
+    if (n > RATEPLAN_MAX_FILTER_LEN)
+        return -1.0f;
+
+    _plan->chain        = RATEPLAN_CHAIN_POLYPHASE;
+    _plan->num_halfband = 0;
+    _plan->P            = P;
+    _plan->Q            = Q;
+    _plan->poly_len     = n;
+    _plan->resamp_rate  = 1.0;
+    _plan->resamp_m     = 0;
+    _plan->resamp_fc    = 0.0f;
+
+    float cost = (float)((n + P - 1) / P) * (float)(f_out / _fb);
+    _plan->cost       = cost;
+    _plan->cost_mmacs = cost * _fb * 1e-6;
+    return cost;
+}
+
@@ -0,0 +1,677 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rxfrontend
+//
+// Raw samples are processed in chunks of at most RXFRONTEND_CHUNK_LEN:
+// the first half-band stage decimates into the work buffer and later
+// stages decimate it in place, carrying an odd sample per stage over to
+// the next chunk.  The resampler writes straight into the output block.
+// For sc16 input, sc16decim replaces the first half-band stage.
+//
+// With the energy gate enabled, each chunk's mean energy is compared
+// against the noise floor before any filtering.  Quiet chunks go into a
+// ring of the most recent raw samples instead of the filters; when a
+// chunk crosses the threshold, that history is pushed through first so
+// that a preamble starting in the quiet samples is seen whole, and the
+// gate stays open until the energy has stayed below the threshold for
+// as many samples as the history holds.  The noise floor is a running
+// average of quiet chunks that follows decreases quickly and increases
+// slowly; the gate is held open while it settles on the first chunks.
+// A floor which steps up by more than the threshold (gain change,
+// interferer) leaves no quiet chunks to follow it, so the minimum chunk
+// energy is also kept over windows of chunks: a whole window without a
+// quiet chunk moves the floor to that minimum.  A signal present for
+// longer than a window thus becomes the floor, which is why the window
+// is long against a packet.
+// Filter states are stale when the gate opens, which only affects the
+// start of the history.  The time spent on open chunks (filters and the
+// synchronizer behind the sink) gives the cost per raw sample, from
+// which the time saved on skipped chunks is estimated.
+//
+// The time of each output block is its raw position (samples consumed,
+// including those the gate skips and those reported lost) at the usrp
+// rate, so that it keeps to the hardware clock while the baseband stream
+// has gaps.  The position of the block's first sample is resolved to the
+// decimated sample it was resampled from, ignoring filter delays; the
+// pre-trigger history is positioned behind the chunk which opens the gate.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <liquid/liquid.h>
+#include "profile.h"
+#include "rxfrontend.h"
+#include "sc16.h"
+
+// raw samples per processing chunk
+#define RXFRONTEND_CHUNK_LEN    (4096)
+
+// buffer alignment (cache line) [bytes]
+#define RXFRONTEND_ALIGN        (64)
+
+// default sc16 scaling (full scale to unity)
+#define RXFRONTEND_SC16_GAIN    SC16_GAIN_UNITY
+
+// energy gate: chunks during which the gate is held open to settle the
+// noise floor, and noise floor averaging rates for quiet chunks below
+// and above the current estimate
+#define RXFRONTEND_GATE_TRAIN   (16)
+#define RXFRONTEND_GATE_FALL    (0.2f)
+#define RXFRONTEND_GATE_RISE    (0.01f)
+
+// energy gate: chunks per minimum-statistics window
+#define RXFRONTEND_GATE_WINDOW  (256)
+
+// rxfrontend data structure
+struct rxfrontend_s {
+    // filters
+    unsigned int num_halfband;                      // number of half-band stages
+    resamp2_crcf decim[RATEPLAN_MAX_HALFBAND];      // half-band decimators
+    std::complex<float> decim_in[RATEPLAN_MAX_HALFBAND][2]; // odd sample carry
+    unsigned int decim_n[RATEPLAN_MAX_HALFBAND];    // samples in carry
+    resamp_crcf resamp;                             // arbitrary resampler
+    double resamp_rate;                             // resampling rate
+    double usrp_rate;                               // raw sample rate [Hz]
+    sc16decim decim_sc16;                           // sc16 first stage (NULL if none)
+    float gain;                                     // sc16 scaling
+
+    // buffers
+    std::complex<float> * work;     // decimated chunk
+    std::complex<float> * block;    // output block (+1 resampler overflow)
+    unsigned int block_len;         // samples per sink call
+    unsigned int block_n;           // samples in output block
+
+    // raw sample positions
+    unsigned long int run_position;     // next raw sample to filter
+    unsigned long int chunk_position;   // first raw sample of chunk
+    unsigned long int block_position;   // first raw sample of output block
+
+    // sink
+    rxfrontend_sink sink;           // sink callback
+    void * userdata;                // user-defined data pointer
+
+    // energy gate
+    int gate_enabled;               // gate enabled?
+    float gate_threshold;           // threshold over noise floor (linear)
+    float gate_floor;               // noise floor estimate (mean |x|^2)
+    unsigned int gate_train;        // chunks left to settle noise floor
+    int gate_open;                  // gate open?
+    unsigned int gate_hold;         // quiet samples left before closing
+    unsigned char * gate_history;   // raw sample history ring
+    unsigned int gate_history_len;  // history capacity [samples]
+    unsigned int gate_history_n;    // samples in history
+    unsigned int gate_history_write;// history write position [samples]
+    int gate_sc16;                  // history sample format is sc16?
+    float gate_min;                 // minimum chunk energy in window
+    unsigned int gate_window_n;     // chunks in window
+    int gate_window_quiet;          // quiet chunk in window?
+
+    // counters
+    unsigned long int num_input;    // raw samples consumed (or lost)
+    unsigned long int num_output;   // baseband samples produced
+    unsigned long int gate_num_chunks;      // chunks seen by gate
+    unsigned long int gate_num_skipped;     // chunks skipped
+    unsigned long int gate_num_rebased;     // floor moved to window minimum
+    unsigned long int gate_num_samples;     // raw samples filtered while open
+    unsigned long int gate_num_skipped_samples; // raw samples skipped
+    double gate_busy;               // time processing open chunks [s]
+};
+
+// allocate aligned sample buffer
+std::complex<float> * rxfrontend_malloc(unsigned int _n)
+{
+    void * x = NULL;
+    if (posix_memalign(&x, RXFRONTEND_ALIGN, _n*sizeof(std::complex<float>)) != 0) {
+        fprintf(stderr,"error: rxfrontend_malloc(), could not allocate %u samples\n", _n);
+        exit(1);
+    }
+    return (std::complex<float>*) x;
+}
+
+// decimate chunk by 2 in half-band stage _s, carrying an odd sample over
+// to the next chunk; returns number of output samples (_y may be _x)
+unsigned int rxfrontend_decim(rxfrontend _q,
+                              unsigned int _s,
+                              std::complex<float> * _x,
+                              unsigned int _n,
+                              std::complex<float> * _y);
+
+// push decimated samples through resampler into output block
+void rxfrontend_resamp(rxfrontend _q,
+                       std::complex<float> * _x,
+                       unsigned int _n);
+
+// push raw samples through energy gate (if enabled) and filters
+void rxfrontend_push(rxfrontend _q,
+                     const void * _x,
+                     unsigned int _n,
+                     int _sc16);
+
+// push raw samples through filters
+void rxfrontend_run(rxfrontend _q,
+                    const void * _x,
+                    unsigned int _n,
+                    int _sc16);
+
+// decide whether chunk passes the energy gate, pushing the history
+// through the filters when the gate opens and saving quiet chunks to the
+// history; returns 1 if the chunk is to be filtered
+int rxfrontend_gate(rxfrontend _q,
+                    const void * _x,
+                    unsigned int _n,
+                    int _sc16);
+
+// monotonic time [seconds]
+double rxfrontend_time();
+
+// create rxfrontend object
+//  _plan       :   receive rate plan (half-band chain)
+//  _block_len  :   number of baseband samples per sink call
+//  _sink       :   sink callback
+//  _userdata   :   user-defined data pointer passed to sink
+rxfrontend rxfrontend_create(struct rateplan_s * _plan,
+                             unsigned int _block_len,
+                             rxfrontend_sink _sink,
+                             void * _userdata)
+{
+    // validate input
+    if (_plan->direction != RATEPLAN_RX || _plan->chain != RATEPLAN_CHAIN_HALFBAND) {
+        fprintf(stderr,"error: rxfrontend_create(), rate plan must be receive half-band chain\n");
+        exit(1);
+    } else if (_block_len == 0) {
+        fprintf(stderr,"error: rxfrontend_create(), block length must be greater than zero\n");
+        exit(1);
+    } else if (_sink == NULL) {
+        fprintf(stderr,"error: rxfrontend_create(), sink cannot be NULL\n");
+        exit(1);
+    }
+
+    rxfrontend q = (rxfrontend) malloc(sizeof(struct rxfrontend_s));
+
+    // create filters
+    unsigned int i;
+    q->num_halfband = _plan->num_halfband;
+    for (i=0; i<q->num_halfband; i++)
+        q->decim[i] = resamp2_crcf_create(_plan->halfband_m[i], 0.0f, _plan->As);
+    q->resamp_rate = _plan->resamp_rate;
+    q->usrp_rate   = _plan->usrp_rate;
+    q->resamp = resamp_crcf_create(_plan->resamp_rate, _plan->resamp_m,
+                                   _plan->resamp_fc, _plan->As, 64);
+    q->gain = RXFRONTEND_SC16_GAIN;
+    q->decim_sc16 = q->num_halfband > 0 ?
+        sc16decim_create(_plan->halfband_m[0], _plan->As, q->gain, SC16_ISA_AUTO) : NULL;
+
+    // allocate buffers (sc16 without half-band stages converts a whole chunk)
+    q->block_len = _block_len;
+    q->work  = rxfrontend_malloc(RXFRONTEND_CHUNK_LEN);
+    q->block = rxfrontend_malloc(q->block_len + 2);
+
+    q->sink     = _sink;
+    q->userdata = _userdata;
+
+    // energy gate disabled
+    q->gate_enabled       = 0;
+    q->gate_threshold     = 0.0f;
+    q->gate_history       = NULL;
+    q->gate_history_len   = 0;
+
+    rxfrontend_reset(q);
+    return q;
+}
+
+// destroy rxfrontend object
+void rxfrontend_destroy(rxfrontend _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->num_halfband; i++)
+        resamp2_crcf_destroy(_q->decim[i]);
+    resamp_crcf_destroy(_q->resamp);
+    if (_q->decim_sc16 != NULL)
+        sc16decim_destroy(_q->decim_sc16);
+
+    free(_q->work);
+    free(_q->block);
+    free(_q->gate_history);
+
+    // free main object memory
+    free(_q);
+}
+
+// print rxfrontend object internals and counters
+void rxfrontend_print(rxfrontend _q)
+{
+    printf("rxfrontend: %u half-band stage(s), resampling rate %8.6f, %u-sample blocks\n",
+            _q->num_halfband, _q->resamp_rate, _q->block_len);
+    printf("    samples in          : %12lu\n", _q->num_input);
+    printf("    samples out         : %12lu\n", _q->num_output);
+    if (!_q->gate_enabled)
+        return;
+
+    // estimated time saved at the measured cost of open chunks
+    double cost = _q->gate_num_samples > 0 ? _q->gate_busy / _q->gate_num_samples : 0.0;
+    double saved = cost * _q->gate_num_skipped_samples;
+    printf("    energy gate         : %.1f dB over noise floor %.1f dB, %u-sample history\n",
+            10*log10f(_q->gate_threshold), 10*log10f(_q->gate_floor), _q->gate_history_len);
+    printf("    chunks skipped      : %12lu / %lu (%.2f%%)\n",
+            _q->gate_num_skipped, _q->gate_num_chunks,
+            _q->gate_num_chunks > 0 ? 100.0*_q->gate_num_skipped / _q->gate_num_chunks : 0.0);
+    printf("    floor rebased       : %12lu (no quiet chunk in %u)\n",
+            _q->gate_num_rebased, RXFRONTEND_GATE_WINDOW);
+    printf("    processing time     : %12.3f s (%.2f ns/sample)\n", _q->gate_busy, 1e9*cost);
+    printf("    est. time saved     : %12.3f s (%.2f%%)\n",
+            saved, saved + _q->gate_busy > 0.0 ? 100.0*saved / (saved + _q->gate_busy) : 0.0);
+}
+
+// reset filter states, drop partial output block
+void rxfrontend_reset(rxfrontend _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->num_halfband; i++) {
+        resamp2_crcf_clear(_q->decim[i]);
+        _q->decim_n[i] = 0;
+    }
+    resamp_crcf_reset(_q->resamp);
+    if (_q->decim_sc16 != NULL)
+        sc16decim_reset(_q->decim_sc16);
+
+    _q->block_n    = 0;
+    _q->num_input  = 0;
+    _q->num_output = 0;
+
+    _q->run_position   = 0;
+    _q->chunk_position = 0;
+    _q->block_position = 0;
+
+    _q->gate_floor         = 0.0f;
+    _q->gate_train         = RXFRONTEND_GATE_TRAIN;
+    _q->gate_open          = 1;
+    _q->gate_hold          = 0;
+    _q->gate_history_n     = 0;
+    _q->gate_history_write = 0;
+    _q->gate_sc16          = 0;
+    _q->gate_min           = 0.0f;
+    _q->gate_window_n      = 0;
+    _q->gate_window_quiet  = 0;
+    _q->gate_num_chunks    = 0;
+    _q->gate_num_skipped   = 0;
+    _q->gate_num_rebased   = 0;
+    _q->gate_num_samples   = 0;
+    _q->gate_num_skipped_samples = 0;
+    _q->gate_busy          = 0.0;
+}
+
+// push block of raw usrp samples through front end
+void rxfrontend_execute(rxfrontend _q,
+                        std::complex<float> * _x,
+                        unsigned int _n)
+{
+    rxfrontend_push(_q, _x, _n, 0);
+}
+
+// push block of raw sc16 usrp samples through front end
+void rxfrontend_execute_sc16(rxfrontend _q,
+                             const short * _x,
+                             unsigned int _n)
+{
+    rxfrontend_push(_q, _x, _n, 1);
+}
+
+// enable energy gate
+//  _q          :   rxfrontend object
+//  _threshold  :   threshold over noise floor [dB], <= 0 to disable
+//  _history    :   raw samples kept while the gate is closed
+void rxfrontend_set_gate(rxfrontend _q,
+                         float _threshold,
+                         unsigned int _history)
+{
+    free(_q->gate_history);
+    _q->gate_history     = NULL;
+    _q->gate_history_len = 0;
+    _q->gate_enabled     = _threshold > 0.0f;
+    if (!_q->gate_enabled)
+        return;
+
+    if (_history == 0) {
+        fprintf(stderr,"error: rxfrontend_set_gate(), history must be greater than zero\n");
+        exit(1);
+    }
+    _q->gate_threshold   = powf(10.0f, _threshold/10.0f);
+    _q->gate_history_len = _history;
+    _q->gate_history     = (unsigned char*) malloc(_history*sizeof(std::complex<float>));
+
+    // settle noise floor again
+    _q->gate_floor         = 0.0f;
+    _q->gate_train         = RXFRONTEND_GATE_TRAIN;
+    _q->gate_open          = 1;
+    _q->gate_hold          = 0;
+    _q->gate_history_n     = 0;
+    _q->gate_history_write = 0;
+}
+
+// get energy gate counters
+//  _q              :   rxfrontend object
+//  _num_chunks     :   chunks seen by gate
+//  _num_skipped    :   chunks skipped
+//  _time_saved     :   estimated processing time saved [s]
+void rxfrontend_get_gate_stats(rxfrontend _q,
+                               unsigned long int * _num_chunks,
+                               unsigned long int * _num_skipped,
+                               double * _time_saved)
+{
+    *_num_chunks  = _q->gate_num_chunks;
+    *_num_skipped = _q->gate_num_skipped;
+    *_time_saved  = _q->gate_num_samples > 0 ?
+        _q->gate_busy / _q->gate_num_samples * _q->gate_num_skipped_samples : 0.0;
+}
+
+// set scaling of sc16 samples
+void rxfrontend_set_gain(rxfrontend _q,
+                         float _gain)
+{
+    _q->gain = _gain;
+    if (_q->decim_sc16 != NULL)
+        sc16decim_set_gain(_q->decim_sc16, _q->gain);
+}
+
+// advance raw position past samples lost before the next block
+void rxfrontend_skip(rxfrontend _q,
+                     unsigned long int _n)
+{
+    if (_n == 0)
+        return;
+
+    _q->num_input += _n;
+
+    // history no longer leads up to the next chunk
+    _q->gate_history_n     = 0;
+    _q->gate_history_write = 0;
+}
+
+// get time of first sample in block passed to sink [s]
+double rxfrontend_get_time(rxfrontend _q)
+{
+    return (double)_q->block_position / _q->usrp_rate;
+}
+
+// invoke sink with partial output block, if any
+void rxfrontend_flush(rxfrontend _q)
+{
+    if (_q->block_n == 0)
+        return;
+
+    _q->sink(_q->block, _q->block_n, _q->userdata);
+    _q->num_output += _q->block_n;
+    _q->block_n = 0;
+}
+
+// decimate chunk by 2 in half-band stage _s
+unsigned int rxfrontend_decim(rxfrontend _q,
+                              unsigned int _s,
+                              std::complex<float> * _x,
+                              unsigned int _n,
+                              std::complex<float> * _y)
+{
+    unsigned int i=0;
+    unsigned int num_decim=0;
+
+    // complete sample pair carried over from previous chunk
+    if (_q->decim_n[_s] == 1 && _n > 0) {
+        _q->decim_in[_s][1] = _x[i++];
+        resamp2_crcf_decim_execute(_q->decim[_s], _q->decim_in[_s], &_y[num_decim++]);
+        _q->decim_n[_s] = 0;
+    }
+
+    // decimate by 2 (outputs never overtake inputs, so in place is safe)
+    for ( ; i+1 < _n; i+=2)
+        resamp2_crcf_decim_execute(_q->decim[_s], &_x[i], &_y[num_decim++]);
+
+    // save odd sample for next chunk
+    if (i < _n) {
+        _q->decim_in[_s][0] = _x[i];
+        _q->decim_n[_s] = 1;
+    }
+
+    return num_decim;
+}
+
+// push decimated samples through resampler into output block
+void rxfrontend_resamp(rxfrontend _q,
+                       std::complex<float> * _x,
+                       unsigned int _n)
+{
+    unsigned int i;
+    unsigned int nw;
+    PROFILE_BEGIN(PROFILE_RESAMP);
+    for (i=0; i<_n; i++) {
+        if (_q->block_n == 0)
+            _q->block_position = _q->chunk_position + ((unsigned long int)i << _q->num_halfband);
+        resamp_crcf_execute(_q->resamp, _x[i], &_q->block[_q->block_n], &nw);
+        _q->block_n += nw;
+
+        if (_q->block_n >= _q->block_len) {
+            _q->sink(_q->block, _q->block_len, _q->userdata);
+            _q->num_output += _q->block_len;
+
+            // keep resampler overflow for next block
+            _q->block_n -= _q->block_len;
+            if (_q->block_n > 0)
+                memmove(_q->block, &_q->block[_q->block_len], _q->block_n*sizeof(std::complex<float>));
+            _q->block_position = _q->chunk_position + ((unsigned long int)(i+1) << _q->num_halfband);
+        }
+    }
+    PROFILE_END(PROFILE_RESAMP, _n);
+}
+
+// push raw samples through energy gate (if enabled) and filters
+void rxfrontend_push(rxfrontend _q,
+                     const void * _x,
+                     unsigned int _n,
+                     int _sc16)
+{
+    unsigned long int position = _q->num_input;
+    _q->num_input += _n;
+    if (!_q->gate_enabled) {
+        _q->run_position = position;
+        rxfrontend_run(_q, _x, _n, _sc16);
+        return;
+    }
+
+    unsigned int size = _sc16 ? 2*sizeof(short) : sizeof(std::complex<float>);
+    unsigned int i;
+    for (i=0; i<_n; i+=RXFRONTEND_CHUNK_LEN) {
+        unsigned int n = (_n - i < RXFRONTEND_CHUNK_LEN) ? _n - i : RXFRONTEND_CHUNK_LEN;
+        const unsigned char * x = (const unsigned char*)_x + i*size;
+        _q->run_position = position + i;
+        if (!rxfrontend_gate(_q, x, n, _sc16))
+            continue;
+
+        double t0 = rxfrontend_time();
+        rxfrontend_run(_q, x, n, _sc16);
+        _q->gate_busy += rxfrontend_time() - t0;
+        _q->gate_num_samples += n;
+    }
+}
+
+// push raw samples through filters
+void rxfrontend_run(rxfrontend _q,
+                    const void * _x,
+                    unsigned int _n,
+                    int _sc16)
+{
+    unsigned int i;
+    unsigned int s;
+    for (i=0; i<_n; i+=RXFRONTEND_CHUNK_LEN) {
+        unsigned int n = (_n - i < RXFRONTEND_CHUNK_LEN) ? _n - i : RXFRONTEND_CHUNK_LEN;
+        _q->chunk_position = _q->run_position + i;
+
+        if (_sc16) {
+            // convert, scale and decimate in first stage, then decimate in
+            // place in the remaining stages
+            const short * x = &((const short*)_x)[2*i];
+            PROFILE_BEGIN(PROFILE_SC16);
+            if (_q->decim_sc16 != NULL) {
+                n = sc16decim_execute(_q->decim_sc16, x, n, _q->work);
+            } else {
+                sc16_convert(x, n, _q->gain, _q->work);
+            }
+            PROFILE_END(PROFILE_SC16, n);
+
+            PROFILE_BEGIN(PROFILE_HALFBAND);
+            for (s=1; s<_q->num_halfband; s++)
+                n = rxfrontend_decim(_q, s, _q->work, n, _q->work);
+            PROFILE_END(PROFILE_HALFBAND, n);
+
+            rxfrontend_resamp(_q, _q->work, n);
+        } else {
+            // decimate by 2 in each half-band stage (in place after the first)
+            std::complex<float> * x = &((std::complex<float>*)_x)[i];
+            PROFILE_BEGIN(PROFILE_HALFBAND);
+            for (s=0; s<_q->num_halfband; s++) {
+                n = rxfrontend_decim(_q, s, x, n, _q->work);
+                x = _q->work;
+            }
+            PROFILE_END(PROFILE_HALFBAND, n);
+
+            rxfrontend_resamp(_q, x, n);
+        }
+    }
+    _q->run_position += _n;
+}
+
+// decide whether chunk passes the energy gate
+int rxfrontend_gate(rxfrontend _q,
+                    const void * _x,
+                    unsigned int _n,
+                    int _sc16)
+{
+    // history holds one format only
+    if (_sc16 != _q->gate_sc16) {
+        _q->gate_sc16 = _sc16;
+        _q->gate_history_n     = 0;
+        _q->gate_history_write = 0;
+    }
+
+    // mean energy, scaled as the filters will see it
+    float energy = 0.0f;
+    unsigned int i;
+    if (_sc16) {
+        const short * x = (const short*)_x;
+        for (i=0; i<2*_n; i++)
+            energy += (float)x[i] * (float)x[i];
+        energy *= _q->gain * _q->gain;
+    } else {
+        const std::complex<float> * x = (const std::complex<float>*)_x;
+        for (i=0; i<_n; i++)
+            energy += x[i].real()*x[i].real() + x[i].imag()*x[i].imag();
+    }
+    energy /= (float)_n;
+    _q->gate_num_chunks++;
+
+    // track noise floor on chunks below threshold
+    int loud = energy > _q->gate_threshold * _q->gate_floor;
+    if (_q->gate_train == RXFRONTEND_GATE_TRAIN) {
+        _q->gate_floor = energy;
+    } else if (!loud) {
+        float alpha = energy < _q->gate_floor ? RXFRONTEND_GATE_FALL : RXFRONTEND_GATE_RISE;
+        _q->gate_floor += alpha * (energy - _q->gate_floor);
+    }
+    if (_q->gate_train > 0) {
+        _q->gate_train--;
+        _q->gate_window_n     = 0;
+        _q->gate_window_quiet = 0;
+        loud = 1;
+    } else {
+        // minimum statistics: no quiet chunk in a whole window means the
+        // floor has risen past the threshold
+        if (_q->gate_window_n == 0 || energy < _q->gate_min)
+            _q->gate_min = energy;
+        _q->gate_window_quiet |= !loud;
+        if (++_q->gate_window_n == RXFRONTEND_GATE_WINDOW) {
+            if (!_q->gate_window_quiet) {
+                _q->gate_floor = _q->gate_min;
+                _q->gate_num_rebased++;
+            }
+            _q->gate_window_n     = 0;
+            _q->gate_window_quiet = 0;
+        }
+    }
+
+    if (loud) {
+        // open: push pre-trigger history through first
+        if (!_q->gate_open && _q->gate_history_n > 0) {
+            unsigned int size = _sc16 ? 2*sizeof(short) : sizeof(std::complex<float>);
+            unsigned int len = _q->gate_history_len;
+            unsigned int start = (_q->gate_history_write + len - _q->gate_history_n) % len;
+            unsigned int n0 = start + _q->gate_history_n > len ? len - start : _q->gate_history_n;
+            double t0 = rxfrontend_time();
+            _q->run_position -= _q->gate_history_n;
+            rxfrontend_run(_q, &_q->gate_history[start*size], n0, _sc16);
+            if (n0 < _q->gate_history_n)
+                rxfrontend_run(_q, _q->gate_history, _q->gate_history_n - n0, _sc16);
+            _q->gate_busy += rxfrontend_time() - t0;
+            _q->gate_num_samples         += _q->gate_history_n;
+            _q->gate_num_skipped_samples -= _q->gate_history_n;
+        }
+        _q->gate_history_n = 0;
+        _q->gate_open = 1;
+        _q->gate_hold = _q->gate_history_len;
+        return 1;
+    }
+
+    // quiet: stay open until hold expires
+    if (_q->gate_open) {
+        _q->gate_hold = _q->gate_hold > _n ? _q->gate_hold - _n : 0;
+        if (_q->gate_hold > 0)
+            return 1;
+        _q->gate_open = 0;
+    }
+
+    // closed: keep most recent samples as history
+    unsigned int size = _sc16 ? 2*sizeof(short) : sizeof(std::complex<float>);
+    unsigned int len = _q->gate_history_len;
+    const unsigned char * x = (const unsigned char*)_x;
+    unsigned int n = _n;
+    if (n > len) {
+        x += (n - len)*size;
+        n = len;
+    }
+    unsigned int n0 = _q->gate_history_write + n > len ? len - _q->gate_history_write : n;
+    memmove(&_q->gate_history[_q->gate_history_write*size], x, n0*size);
+    memmove(_q->gate_history, &x[n0*size], (n - n0)*size);
+    _q->gate_history_write = (_q->gate_history_write + n) % len;
+    _q->gate_history_n = _q->gate_history_n + n > len ? len : _q->gate_history_n + n;
+
+    _q->gate_num_skipped++;
+    _q->gate_num_skipped_samples += _n;
+    return 0;
+}
+
+// monotonic time [seconds]
+double rxfrontend_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// rxpipe
+//
+// Each queue has exactly one producer and one consumer thread.  The
+// capture stage never waits: when the raw queue is full the packet is
+// read into a scratch buffer and dropped, so that the usrp itself never
+// overflows.  The resampler waits for room in the baseband queue rather
+// than dropping, pushing back on the raw queue instead.  Stopping drains
+// both queues before the threads are joined.
+//
+// Stage busy time is the time spent in the stage's own work (recv(),
+// rxfrontend_execute() or the synchronizer); waiting on a queue is idle.
+//
+// Raw blocks are time stamped with their position in the usrp stream,
+// counting packets dropped on a full raw queue and samples the iostats
+// object reports lost; the resampler advances the front end past such
+// gaps (rxfrontend_skip()) so that baseband blocks carry the front end's
+// time through to the synchronizer.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "rxpipe.h"
+#include "blockq.h"
+#include "iostats.h"
+#include "profile.h"
+
+// stage thread statistics
+struct rxpipe_stage_s {
+    pthread_t thread;               // stage thread
+    volatile int running;           // run flag
+    int cpu;                        // affinity (-1 for none)
+    unsigned long int num_blocks;   // blocks processed
+    double busy;                    // time spent working [seconds]
+    double wait;                    // time spent waiting on next stage [seconds]
+};
+
+// rxpipe data structure
+struct rxpipe_s {
+    // stages
+    struct rxpipe_stage_s stage[RXPIPE_NUM_STAGES];
+    int threads_running;            // threads started
+    double time_start;              // start time [seconds]
+    double time_stop;               // stop time [seconds]
+
+    // capture
+    rxpipe_recv recv;               // capture callback
+    rxpipe_recv_sc16 recv_sc16;     // sc16 capture callback (NULL if unused)
+    void * recv_userdata;           // capture callback user data
+    std::complex<float> * scratch;  // drop buffer when raw queue is full
+    unsigned long int num_dropped;  // raw samples dropped
+    iostats stats;                  // lost sample accounting (NULL if none)
+    unsigned long int num_lost;     // lost samples accounted for
+    unsigned long int capture_position; // raw position of next capture
+
+    // queues
+    unsigned int raw_len;           // raw samples per block
+    unsigned int block_len;         // baseband samples per block
+    blockq raw;                     // capture -> resampler
+    blockq baseband;                // resampler -> synchronizer
+    unsigned long int num_stalls;   // resampler waits on full baseband queue
+
+    // resampler
+    rxfrontend frontend;            // decimators and arbitrary resampler
+    double usrp_rate;               // raw sample rate [Hz]
+    unsigned long int resamp_position;  // raw position of next raw block
+
+    // synchronizer
+    rxfrontend_sink sink;           // synchronizer callback
+    void * sink_userdata;           // synchronizer callback user data
+    double sync_time;               // time of block in synchronizer [s]
+};
+
+// stage threads
+void * rxpipe_capture_process(void * _userdata);
+void * rxpipe_resamp_process(void * _userdata);
+void * rxpipe_sync_process(void * _userdata);
+
+// read raw samples with capture callback; sc16 samples are stored in
+// place of (and take half the space of) complex float samples
+unsigned int rxpipe_capture(rxpipe _q,
+                            std::complex<float> * _x,
+                            unsigned int _n);
+
+// rxfrontend sink: copy baseband block into baseband queue
+void rxpipe_push(std::complex<float> * _x,
+                 unsigned int _n,
+                 void * _userdata);
+
+// pin calling thread to stage cpu, if set
+void rxpipe_pin(rxpipe _q, int _stage);
+
+// monotonic time [seconds]
+double rxpipe_time();
+
+// create rxpipe object
+//  _plan           :   receive rate plan (half-band chain)
+//  _raw_len        :   raw samples per capture block (usrp packet size)
+//  _block_len      :   baseband samples per synchronizer block
+//  _num_blocks     :   number of blocks in each queue
+//  _recv           :   capture callback
+//  _recv_userdata  :   user-defined data pointer passed to capture callback
+//  _sink           :   synchronizer callback
+//  _sink_userdata  :   user-defined data pointer passed to synchronizer callback
+rxpipe rxpipe_create(struct rateplan_s * _plan,
+                     unsigned int _raw_len,
+                     unsigned int _block_len,
+                     unsigned int _num_blocks,
+                     rxpipe_recv _recv,
+                     void * _recv_userdata,
+                     rxfrontend_sink _sink,
+                     void * _sink_userdata)
+{
+    // validate input
+    if (_raw_len == 0 || _block_len == 0) {
+        fprintf(stderr,"error: rxpipe_create(), block lengths must be greater than zero\n");
+        exit(1);
+    } else if (_num_blocks < 2) {
+        fprintf(stderr,"error: rxpipe_create(), queues must hold at least 2 blocks\n");
+        exit(1);
+    } else if (_recv == NULL || _sink == NULL) {
+        fprintf(stderr,"error: rxpipe_create(), callbacks cannot be NULL\n");
+        exit(1);
+    }
+
+    rxpipe q = (rxpipe) malloc(sizeof(struct rxpipe_s));
+
+    q->recv          = _recv;
+    q->recv_sc16     = NULL;
+    q->recv_userdata = _recv_userdata;
+    q->sink          = _sink;
+    q->sink_userdata = _sink_userdata;
+
+    // queues and buffers
+    q->raw_len   = _raw_len;
+    q->block_len = _block_len;
+    q->raw       = blockq_create(_num_blocks, q->raw_len);
+    q->baseband  = blockq_create(_num_blocks, q->block_len);
+    q->scratch   = (std::complex<float>*) malloc(q->raw_len*sizeof(std::complex<float>));
+
+    // front end feeds baseband queue
+    q->frontend = rxfrontend_create(_plan, q->block_len, rxpipe_push, (void*)q);
+    q->usrp_rate = _plan->usrp_rate;
+    q->stats     = NULL;
+
+    unsigned int i;
+    for (i=0; i<RXPIPE_NUM_STAGES; i++) {
+        q->stage[i].running    = 0;
+        q->stage[i].cpu        = -1;
+        q->stage[i].num_blocks = 0;
+        q->stage[i].busy       = 0.0;
+        q->stage[i].wait       = 0.0;
+    }
+    q->threads_running = 0;
+    q->time_start  = 0.0;
+    q->time_stop   = 0.0;
+    q->num_dropped = 0;
+    q->num_stalls  = 0;
+    q->num_lost    = 0;
+    q->capture_position = 0;
+    q->resamp_position  = 0;
+    q->sync_time        = 0.0;
+
+    return q;
+}
+
+// destroy rxpipe object, stopping threads if running
+void rxpipe_destroy(rxpipe _q)
+{
+    if (_q->threads_running)
+        rxpipe_stop(_q);
+
+    rxfrontend_destroy(_q->frontend);
+    blockq_destroy(_q->raw);
+    blockq_destroy(_q->baseband);
+    free(_q->scratch);
+
+    // free main object memory
+    free(_q);
+}
+
+// print per-stage utilization and queue depths
+void rxpipe_print(rxpipe _q)
+{
+    const char * name[RXPIPE_NUM_STAGES] = {"capture", "resamp", "sync"};
+    double runtime = (_q->threads_running ? rxpipe_time() : _q->time_stop) - _q->time_start;
+
+    printf("rxpipe: %u raw / %u baseband samples per block, %u blocks per queue\n",
+            _q->raw_len, _q->block_len, blockq_get_capacity(_q->raw));
+    printf("    stage      cpu     blocks     busy [s]   utilization\n");
+    unsigned int i;
+    for (i=0; i<RXPIPE_NUM_STAGES; i++) {
+        printf("    %-8s  %4d  %9lu  %11.3f   %10.2f%%\n",
+                name[i],
+                _q->stage[i].cpu,
+                _q->stage[i].num_blocks,
+                _q->stage[i].busy,
+                runtime > 0.0 ? 100.0*_q->stage[i].busy / runtime : 0.0);
+    }
+    printf("    dropped samples     : %lu\n", _q->num_dropped);
+    printf("    resampler stalls    : %lu\n", _q->num_stalls);
+    printf("raw ");
+    blockq_print(_q->raw);
+    printf("baseband ");
+    blockq_print(_q->baseband);
+    rxfrontend_print(_q->frontend);
+}
+
+// pin stage thread to cpu (-1 for no affinity); takes effect on start
+void rxpipe_set_affinity(rxpipe _q,
+                         int _stage,
+                         int _cpu)
+{
+    if (_stage < 0 || _stage >= RXPIPE_NUM_STAGES) {
+        fprintf(stderr,"error: rxpipe_set_affinity(), invalid stage\n");
+        exit(1);
+    }
+    _q->stage[_stage].cpu = _cpu;
+}
+
+// capture sc16 samples instead of complex float
+void rxpipe_set_recv_sc16(rxpipe _q,
+                          rxpipe_recv_sc16 _recv)
+{
+    if (_q->threads_running) {
+        fprintf(stderr,"error: rxpipe_set_recv_sc16(), pipeline is running\n");
+        exit(1);
+    }
+    _q->recv_sc16 = _recv;
+}
+
+// set iostats object whose lost samples advance the raw position
+void rxpipe_set_iostats(rxpipe _q,
+                        iostats _stats)
+{
+    if (_q->threads_running) {
+        fprintf(stderr,"error: rxpipe_set_iostats(), pipeline is running\n");
+        exit(1);
+    }
+    _q->stats = _stats;
+}
+
+// get front end
+rxfrontend rxpipe_get_frontend(rxpipe _q)
+{
+    return _q->frontend;
+}
+
+// get time of block in synchronizer [s]
+double rxpipe_get_time(rxpipe _q)
+{
+    return _q->sync_time;
+}
+
+// start stage threads
+void rxpipe_start(rxpipe _q)
+{
+    if (_q->threads_running)
+        return;
+
+    blockq_reset(_q->raw);
+    blockq_reset(_q->baseband);
+    rxfrontend_reset(_q->frontend);
+    _q->capture_position = 0;
+    _q->resamp_position  = 0;
+    _q->sync_time        = 0.0;
+    if (_q->stats != NULL) {
+        struct iostats_counters_s c;
+        iostats_get_counters(_q->stats, &c);
+        _q->num_lost = c.num_lost_samples;
+    }
+
+    void * (*process[RXPIPE_NUM_STAGES])(void*) = {
+        rxpipe_capture_process,
+        rxpipe_resamp_process,
+        rxpipe_sync_process};
+
+    _q->time_start = rxpipe_time();
+
+    // start consumers first
+    int i;
+    for (i=RXPIPE_NUM_STAGES-1; i>=0; i--) {
+        _q->stage[i].running = 1;
+        if (pthread_create(&_q->stage[i].thread, NULL, process[i], (void*)_q) != 0) {
+            fprintf(stderr,"error: rxpipe_start(), could not create stage thread\n");
+            exit(1);
+        }
+    }
+    _q->threads_running = 1;
+}
+
+// stop capture, drain queues and join stage threads
+void rxpipe_stop(rxpipe _q)
+{
+    if (!_q->threads_running)
+        return;
+
+    // stop each stage once its producer has finished
+    unsigned int i;
+    for (i=0; i<RXPIPE_NUM_STAGES; i++) {
+        _q->stage[i].running = 0;
+        pthread_join(_q->stage[i].thread, NULL);
+
+        // resampler has exited: push out partial baseband block
+        if (i == RXPIPE_RESAMP)
+            rxfrontend_flush(_q->frontend);
+    }
+
+    _q->threads_running = 0;
+    _q->time_stop = rxpipe_time();
+}
+
+// capture thread: read usrp packets into raw queue
+void * rxpipe_capture_process(void * _userdata)
+{
+    rxpipe q = (rxpipe) _userdata;
+    struct rxpipe_stage_s * s = &q->stage[RXPIPE_CAPTURE];
+    rxpipe_pin(q, RXPIPE_CAPTURE);
+
+    while (s->running) {
+        struct blockq_block_s * block = blockq_write_acquire(q->raw);
+        double t0 = rxpipe_time();
+
+        if (block == NULL) {
+            // raw queue is full; keep draining the usrp so that the loss
+            // is confined to this packet
+            unsigned int n = rxpipe_capture(q, q->scratch, q->raw_len);
+            q->num_dropped      += n;
+            q->capture_position += n;
+        } else {
+            block->n = rxpipe_capture(q, block->x, block->capacity);
+            if (block->n > 0) {
+                // samples reported lost precede this packet
+                if (q->stats != NULL) {
+                    struct iostats_counters_s c;
+                    iostats_get_counters(q->stats, &c);
+                    q->capture_position += c.num_lost_samples - q->num_lost;
+                    q->num_lost = c.num_lost_samples;
+                }
+                block->timestamp = (double)q->capture_position / q->usrp_rate;
+                q->capture_position += block->n;
+                blockq_write_commit(q->raw);
+                s->num_blocks++;
+            }
+        }
+
+        s->busy += rxpipe_time() - t0;
+    }
+
+    return NULL;
+}
+
+// resampler thread: raw queue through front end into baseband queue
+void * rxpipe_resamp_process(void * _userdata)
+{
+    rxpipe q = (rxpipe) _userdata;
+    struct rxpipe_stage_s * s = &q->stage[RXPIPE_RESAMP];
+    rxpipe_pin(q, RXPIPE_RESAMP);
+
+    for (;;) {
+        struct blockq_block_s * block = blockq_read_acquire(q->raw);
+        if (block == NULL) {
+            // exit only once capture has stopped and the queue is drained
+            if (!s->running && blockq_read_acquire(q->raw) == NULL)
+                break;
+            usleep(100);
+            continue;
+        }
+
+        // advance front end past samples dropped or lost before block
+        unsigned long int position = (unsigned long int)(block->timestamp * q->usrp_rate + 0.5);
+        if (position > q->resamp_position)
+            rxfrontend_skip(q->frontend, position - q->resamp_position);
+        q->resamp_position = position + block->n;
+
+        double t0 = rxpipe_time();
+        double w0 = s->wait;
+        if (q->recv_sc16 != NULL)
+            rxfrontend_execute_sc16(q->frontend, (const short*)block->x, block->n);
+        else
+            rxfrontend_execute(q->frontend, block->x, block->n);
+        s->busy += rxpipe_time() - t0 - (s->wait - w0);
+        s->num_blocks++;
+
+        blockq_read_release(q->raw);
+    }
+
+    return NULL;
+}
+
+// synchronizer thread: baseband queue into synchronizer
+void * rxpipe_sync_process(void * _userdata)
+{
+    rxpipe q = (rxpipe) _userdata;
+    struct rxpipe_stage_s * s = &q->stage[RXPIPE_SYNC];
+    rxpipe_pin(q, RXPIPE_SYNC);
+
+    for (;;) {
+        struct blockq_block_s * block = blockq_read_acquire(q->baseband);
+        if (block == NULL) {
+            // exit only once resampler has stopped and the queue is drained
+            if (!s->running && blockq_read_acquire(q->baseband) == NULL)
+                break;
+            usleep(100);
+            continue;
+        }
+
+        double t0 = rxpipe_time();
+        q->sync_time = block->timestamp;
+        q->sink(block->x, block->n, q->sink_userdata);
+        s->busy += rxpipe_time() - t0;
+        s->num_blocks++;
+
+        blockq_read_release(q->baseband);
+    }
+
+    return NULL;
+}
+
+// rxfrontend sink: copy baseband block into baseband queue, waiting for
+// the synchronizer if the queue is full
+void rxpipe_push(std::complex<float> * _x,
+                 unsigned int _n,
+                 void * _userdata)
+{
+    rxpipe q = (rxpipe) _userdata;
+
+    // wait without counting an overflow on the queue itself
+    if (blockq_get_occupancy(q->baseband) >= blockq_get_capacity(q->baseband)) {
+        double t0 = rxpipe_time();
+        q->num_stalls++;
+        while (blockq_get_occupancy(q->baseband) >= blockq_get_capacity(q->baseband))
+            usleep(100);
+        q->stage[RXPIPE_RESAMP].wait += rxpipe_time() - t0;
+    }
+
+    struct blockq_block_s * block = blockq_write_acquire(q->baseband);
+    memmove(block->x, _x, _n*sizeof(std::complex<float>));
+    block->n = _n;
+    block->timestamp = rxfrontend_get_time(q->frontend);
+    blockq_write_commit(q->baseband);
+}
+
+// read raw samples with capture callback
+unsigned int rxpipe_capture(rxpipe _q,
+                            std::complex<float> * _x,
+                            unsigned int _n)
+{
+    unsigned int n;
+    PROFILE_BEGIN(PROFILE_RECV);
+    if (_q->recv_sc16 != NULL)
+        n = _q->recv_sc16((short*)_x, _n, _q->recv_userdata);
+    else
+        n = _q->recv(_x, _n, _q->recv_userdata);
+    PROFILE_END(PROFILE_RECV, n);
+    return n;
+}
+
+// pin calling thread to stage cpu, if set
+void rxpipe_pin(rxpipe _q, int _stage)
+{
+    int cpu = _q->stage[_stage].cpu;
+    if (cpu < 0)
+        return;
+
+#if HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+        fprintf(stderr,"warning: rxpipe_pin(), could not pin stage %d to cpu %d\n", _stage, cpu);
+#else
+    fprintf(stderr,"warning: rxpipe_pin(), thread affinity not supported\n");
+#endif
+}
+
+// monotonic time [seconds]
+double rxpipe_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
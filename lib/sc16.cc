@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// sc16
+//
+// A half-band filter of length 4m+1 has only two kinds of non-zero taps:
+// the center tap, and the 2m taps at odd offsets from it.  Splitting the
+// input into its even (a) and odd (b) sample phases, output k is
+//
+//      y[k] = hc*a[k-m] + sum_{i=0}^{2m-1} h[2i+1]*b[k-1-i]
+//
+// so that each output is one contiguous dot product over the odd phase.
+// Samples are processed in chunks: each chunk is converted and split
+// into the phase buffers (which keep the last L samples of history), then
+// filtered while still in cache.  The gain is folded into the taps, so
+// scaling costs nothing.  Taps are duplicated for the real and imaginary
+// parts and zero-padded at the front to a multiple of 4 samples so that
+// the dot products are whole vectors for every extension.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <liquid/liquid.h>
+#include "sc16.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define SC16_X86
+#  include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define SC16_NEON
+#  include <arm_neon.h>
+#endif
+
+// input sample pairs per processing chunk
+#define SC16_CHUNK_LEN      (512)
+
+// buffer alignment [bytes]
+#define SC16_ALIGN          (64)
+
+// convert _n samples with gain _gain
+typedef void (*sc16_convert_function)(const short * _x,
+                                      unsigned int _n,
+                                      float _gain,
+                                      std::complex<float> * _y);
+
+// convert _n sample pairs, splitting into even (_a) and odd (_b) phases
+typedef void (*sc16_split_function)(const short * _x,
+                                    unsigned int _n,
+                                    std::complex<float> * _a,
+                                    std::complex<float> * _b);
+
+// compute _n outputs from phase buffers
+typedef void (*sc16_filter_function)(sc16decim _q,
+                                     unsigned int _n,
+                                     std::complex<float> * _y);
+
+// sc16decim data structure
+struct sc16decim_s {
+    unsigned int m;             // filter semi-length
+    float As;                   // stopband attenuation [dB]
+    float gain;                 // scaling factor
+    int isa;                    // instruction set extension
+
+    // filter
+    float * h;                  // prototype, unity DC gain [size: 4m+1]
+    float hc;                   // center tap (scaled)
+    float * g;                  // odd taps (scaled, duplicated, padded) [size: 2L]
+    unsigned int L;             // window length (multiple of 4, >= 2m)
+
+    // phase buffers [size: L + SC16_CHUNK_LEN]
+    std::complex<float> * a;    // even samples
+    std::complex<float> * b;    // odd samples
+    short carry[2];             // odd trailing sample
+    int num_carry;              // carry present?
+
+    // kernels
+    sc16_split_function split;
+    sc16_filter_function filter;
+};
+
+// portable kernels
+void sc16_convert_generic(const short * _x, unsigned int _n, float _gain, std::complex<float> * _y);
+void sc16_split_generic(const short * _x, unsigned int _n, std::complex<float> * _a, std::complex<float> * _b);
+void sc16_filter_generic(sc16decim _q, unsigned int _n, std::complex<float> * _y);
+
+#ifdef SC16_X86
+void sc16_convert_sse2(const short * _x, unsigned int _n, float _gain, std::complex<float> * _y);
+void sc16_split_sse2(const short * _x, unsigned int _n, std::complex<float> * _a, std::complex<float> * _b);
+void sc16_filter_sse2(sc16decim _q, unsigned int _n, std::complex<float> * _y);
+void sc16_convert_avx2(const short * _x, unsigned int _n, float _gain, std::complex<float> * _y);
+void sc16_split_avx2(const short * _x, unsigned int _n, std::complex<float> * _a, std::complex<float> * _b);
+void sc16_filter_avx2(sc16decim _q, unsigned int _n, std::complex<float> * _y);
+#endif
+
+#ifdef SC16_NEON
+void sc16_convert_neon(const short * _x, unsigned int _n, float _gain, std::complex<float> * _y);
+void sc16_split_neon(const short * _x, unsigned int _n, std::complex<float> * _a, std::complex<float> * _b);
+void sc16_filter_neon(sc16decim _q, unsigned int _n, std::complex<float> * _y);
+#endif
+
+// select kernels for instruction set extension
+void sc16_select(int _isa,
+                 sc16_convert_function * _convert,
+                 sc16_split_function * _split,
+                 sc16_filter_function * _filter);
+
+// convert, split and filter chunk of _n sample pairs
+void sc16decim_run(sc16decim _q,
+                   const short * _x,
+                   unsigned int _n,
+                   std::complex<float> * _y);
+
+// compute scaled taps from prototype and gain
+void sc16decim_set_taps(sc16decim _q);
+
+// allocate aligned memory
+void * sc16_malloc(size_t _size);
+
+// get best instruction set extension supported by this cpu
+int sc16_isa_detect()
+{
+    if (sc16_isa_supported(SC16_ISA_AVX2)) return SC16_ISA_AVX2;
+    if (sc16_isa_supported(SC16_ISA_NEON)) return SC16_ISA_NEON;
+    if (sc16_isa_supported(SC16_ISA_SSE2)) return SC16_ISA_SSE2;
+    return SC16_ISA_GENERIC;
+}
+
+// is instruction set extension supported by this cpu (and build)?
+int sc16_isa_supported(int _isa)
+{
+    switch (_isa) {
+    case SC16_ISA_GENERIC:
+        return 1;
+#ifdef SC16_X86
+    case SC16_ISA_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case SC16_ISA_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef SC16_NEON
+    case SC16_ISA_NEON:
+        return 1;
+#endif
+    default:;
+    }
+    return 0;
+}
+
+// get instruction set extension name
+const char * sc16_isa_str(int _isa)
+{
+    switch (_isa) {
+    case SC16_ISA_GENERIC:  return "generic";
+    case SC16_ISA_SSE2:     return "sse2";
+    case SC16_ISA_AVX2:     return "avx2";
+    case SC16_ISA_NEON:     return "neon";
+    default:;
+    }
+    return "unknown";
+}
+
+// convert sc16 samples to complex float
+void sc16_convert(const short * _x,
+                  unsigned int _n,
+                  float _gain,
+                  std::complex<float> * _y)
+{
+    // select kernel once; concurrent first calls select the same one
+    static sc16_convert_function convert = NULL;
+    if (convert == NULL) {
+        sc16_convert_function f;
+        sc16_split_function s;
+        sc16_filter_function h;
+        sc16_select(sc16_isa_detect(), &f, &s, &h);
+        convert = f;
+    }
+
+    convert(_x, _n, _gain, _y);
+}
+
+// create sc16decim object
+//  _m      :   filter semi-length (filter length is 4*_m+1)
+//  _As     :   stopband attenuation [dB]
+//  _gain   :   scaling factor (1/32768 maps full scale to unity)
+//  _isa    :   instruction set extension (SC16_ISA_AUTO to detect)
+sc16decim sc16decim_create(unsigned int _m,
+                           float _As,
+                           float _gain,
+                           int _isa)
+{
+    // validate input
+    if (_m == 0) {
+        fprintf(stderr,"error: sc16decim_create(), filter semi-length must be greater than zero\n");
+        exit(1);
+    } else if (_As <= 0.0f) {
+        fprintf(stderr,"error: sc16decim_create(), stopband attenuation must be greater than zero\n");
+        exit(1);
+    }
+
+    if (_isa == SC16_ISA_AUTO)
+        _isa = sc16_isa_detect();
+    if (!sc16_isa_supported(_isa)) {
+        fprintf(stderr,"error: sc16decim_create(), instruction set '%s' not supported\n", sc16_isa_str(_isa));
+        exit(1);
+    }
+
+    sc16decim q = (sc16decim) malloc(sizeof(struct sc16decim_s));
+    q->m    = _m;
+    q->As   = _As;
+    q->gain = _gain;
+    q->isa  = _isa;
+
+    sc16_convert_function convert;
+    sc16_select(q->isa, &convert, &q->split, &q->filter);
+
+    // design prototype: force taps at even offsets from center to zero
+    // and normalize to unity gain at DC
+    unsigned int h_len = 4*q->m + 1;
+    q->h = (float*) malloc(h_len*sizeof(float));
+    liquid_firdes_kaiser(h_len, 0.25f, q->As, 0.0f, q->h);
+    unsigned int i;
+    float hsum = 0.0f;
+    for (i=0; i<h_len; i++) {
+        if ( (i % 2) == 0 && i != 2*q->m )
+            q->h[i] = 0.0f;
+        hsum += q->h[i];
+    }
+    for (i=0; i<h_len; i++)
+        q->h[i] /= hsum;
+
+    // taps and buffers
+    q->L = ((2*q->m + 3) / 4) * 4;
+    q->g = (float*) sc16_malloc(2*q->L*sizeof(float));
+    q->a = (std::complex<float>*) sc16_malloc((q->L + SC16_CHUNK_LEN)*sizeof(std::complex<float>));
+    q->b = (std::complex<float>*) sc16_malloc((q->L + SC16_CHUNK_LEN)*sizeof(std::complex<float>));
+    sc16decim_set_taps(q);
+
+    sc16decim_reset(q);
+    return q;
+}
+
+// destroy sc16decim object
+void sc16decim_destroy(sc16decim _q)
+{
+    free(_q->h);
+    free(_q->g);
+    free(_q->a);
+    free(_q->b);
+
+    // free main object memory
+    free(_q);
+}
+
+// print sc16decim object internals
+void sc16decim_print(sc16decim _q)
+{
+    printf("sc16decim: m=%u (%u taps), As=%.1f dB, gain=%12.4e, isa=%s\n",
+            _q->m, 4*_q->m+1, _q->As, _q->gain, sc16_isa_str(_q->isa));
+}
+
+// clear filter state
+void sc16decim_reset(sc16decim _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->L; i++) {
+        _q->a[i] = 0.0f;
+        _q->b[i] = 0.0f;
+    }
+    _q->num_carry = 0;
+}
+
+// set scaling factor
+void sc16decim_set_gain(sc16decim _q,
+                        float _gain)
+{
+    _q->gain = _gain;
+    sc16decim_set_taps(_q);
+}
+
+// convert, scale and decimate block of samples
+unsigned int sc16decim_execute(sc16decim _q,
+                               const short * _x,
+                               unsigned int _n,
+                               std::complex<float> * _y)
+{
+    unsigned int num_written = 0;
+
+    // complete sample pair carried over from previous call
+    if (_q->num_carry && _n > 0) {
+        short pair[4] = {_q->carry[0], _q->carry[1], _x[0], _x[1]};
+        sc16decim_run(_q, pair, 1, _y);
+        num_written++;
+        _x += 2;
+        _n--;
+        _q->num_carry = 0;
+    }
+
+    // whole pairs, in chunks
+    unsigned int num_pairs = _n / 2;
+    unsigned int i;
+    for (i=0; i<num_pairs; i+=SC16_CHUNK_LEN) {
+        unsigned int n = (num_pairs - i < SC16_CHUNK_LEN) ? num_pairs - i : SC16_CHUNK_LEN;
+        sc16decim_run(_q, &_x[4*i], n, &_y[num_written]);
+        num_written += n;
+    }
+
+    // save odd sample for next call
+    if (_n % 2) {
+        _q->carry[0] = _x[2*(_n-1)+0];
+        _q->carry[1] = _x[2*(_n-1)+1];
+        _q->num_carry = 1;
+    }
+
+    return num_written;
+}
+
+// convert, split and filter chunk of _n sample pairs
+void sc16decim_run(sc16decim _q,
+                   const short * _x,
+                   unsigned int _n,
+                   std::complex<float> * _y)
+{
+    _q->split(_x, _n, &_q->a[_q->L], &_q->b[_q->L]);
+    _q->filter(_q, _n, _y);
+
+    // keep last L samples of each phase as history
+    memmove(_q->a, &_q->a[_n], _q->L*sizeof(std::complex<float>));
+    memmove(_q->b, &_q->b[_n], _q->L*sizeof(std::complex<float>));
+}
+
+// compute scaled taps from prototype and gain
+void sc16decim_set_taps(sc16decim _q)
+{
+    // window sample t holds b[k-L+t], i.e. b[k-1-i] for t = L-1-i
+    unsigned int t;
+    for (t=0; t<_q->L; t++) {
+        unsigned int i = _q->L - 1 - t;
+        float v = i < 2*_q->m ? _q->h[2*i+1] * _q->gain : 0.0f;
+        _q->g[2*t+0] = v;
+        _q->g[2*t+1] = v;
+    }
+    _q->hc = _q->h[2*_q->m] * _q->gain;
+}
+
+// allocate aligned memory
+void * sc16_malloc(size_t _size)
+{
+    void * p = NULL;
+    if (posix_memalign(&p, SC16_ALIGN, _size) != 0) {
+        fprintf(stderr,"error: sc16_malloc(), could not allocate %lu bytes\n", (unsigned long)_size);
+        exit(1);
+    }
+    return p;
+}
+
+// select kernels for instruction set extension
+void sc16_select(int _isa,
+                 sc16_convert_function * _convert,
+                 sc16_split_function * _split,
+                 sc16_filter_function * _filter)
+{
+    *_convert = sc16_convert_generic;
+    *_split   = sc16_split_generic;
+    *_filter  = sc16_filter_generic;
+
+    switch (_isa) {
+#ifdef SC16_X86
+    case SC16_ISA_SSE2:
+        *_convert = sc16_convert_sse2;
+        *_split   = sc16_split_sse2;
+        *_filter  = sc16_filter_sse2;
+        break;
+    case SC16_ISA_AVX2:
+        *_convert = sc16_convert_avx2;
+        *_split   = sc16_split_avx2;
+        *_filter  = sc16_filter_avx2;
+        break;
+#endif
+#ifdef SC16_NEON
+    case SC16_ISA_NEON:
+        *_convert = sc16_convert_neon;
+        *_split   = sc16_split_neon;
+        *_filter  = sc16_filter_neon;
+        break;
+#endif
+    default:;
+    }
+}
+
+//
+// portable kernels
+//
+
+void sc16_convert_generic(const short * _x,
+                          unsigned int _n,
+                          float _gain,
+                          std::complex<float> * _y)
+{
+    unsigned int i;
+    for (i=0; i<_n; i++)
+        _y[i] = std::complex<float>(_x[2*i+0]*_gain, _x[2*i+1]*_gain);
+}
+
+void sc16_split_generic(const short * _x,
+                        unsigned int _n,
+                        std::complex<float> * _a,
+                        std::complex<float> * _b)
+{
+    unsigned int i;
+    for (i=0; i<_n; i++) {
+        _a[i] = std::complex<float>(_x[4*i+0], _x[4*i+1]);
+        _b[i] = std::complex<float>(_x[4*i+2], _x[4*i+3]);
+    }
+}
+
+void sc16_filter_generic(sc16decim _q,
+                         unsigned int _n,
+                         std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_q->b[k];
+        float yi = 0.0f;
+        float yq = 0.0f;
+        for (t=0; t<2*_q->L; t+=2) {
+            yi += w[t+0] * _q->g[t+0];
+            yq += w[t+1] * _q->g[t+1];
+        }
+        _y[k] = std::complex<float>(yi,yq) + _q->hc * _q->a[_q->L + k - _q->m];
+    }
+}
+
+#ifdef SC16_X86
+
+//
+// x86 SSE2 kernels
+//
+
+__attribute__((target("sse2")))
+void sc16_convert_sse2(const short * _x,
+                       unsigned int _n,
+                       float _gain,
+                       std::complex<float> * _y)
+{
+    __m128 gain = _mm_set1_ps(_gain);
+    unsigned int i;
+    for (i=0; i+2<=_n; i+=2) {
+        // 2 samples: sign-extend int16 to int32, convert, scale
+        __m128i v = _mm_loadl_epi64((const __m128i*) &_x[2*i]);
+        __m128 f = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v,v),16));
+        _mm_storeu_ps((float*) &_y[i], _mm_mul_ps(f, gain));
+    }
+    sc16_convert_generic(&_x[2*i], _n-i, _gain, &_y[i]);
+}
+
+__attribute__((target("sse2")))
+void sc16_split_sse2(const short * _x,
+                     unsigned int _n,
+                     std::complex<float> * _a,
+                     std::complex<float> * _b)
+{
+    unsigned int i;
+    for (i=0; i+2<=_n; i+=2) {
+        // 2 pairs: samples s0..s3
+        __m128i v = _mm_loadu_si128((const __m128i*) &_x[4*i]);
+        __m128 f0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v,v),16)); // s0 s1
+        __m128 f1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v,v),16)); // s2 s3
+        _mm_storeu_ps((float*) &_a[i], _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(1,0,1,0)));
+        _mm_storeu_ps((float*) &_b[i], _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3,2,3,2)));
+    }
+    sc16_split_generic(&_x[4*i], _n-i, &_a[i], &_b[i]);
+}
+
+__attribute__((target("sse2")))
+void sc16_filter_sse2(sc16decim _q,
+                      unsigned int _n,
+                      std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_q->b[k];
+        __m128 acc = _mm_setzero_ps();
+        for (t=0; t<2*_q->L; t+=4)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&w[t]), _mm_load_ps(&_q->g[t])));
+
+        // sum real and imaginary lanes
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc,acc));
+        float v[4];
+        _mm_storeu_ps(v, acc);
+        _y[k] = std::complex<float>(v[0],v[1]) + _q->hc * _q->a[_q->L + k - _q->m];
+    }
+}
+
+//
+// x86 AVX2 kernels
+//
+
+__attribute__((target("avx2,fma")))
+void sc16_convert_avx2(const short * _x,
+                       unsigned int _n,
+                       float _gain,
+                       std::complex<float> * _y)
+{
+    __m256 gain = _mm256_set1_ps(_gain);
+    unsigned int i;
+    for (i=0; i+4<=_n; i+=4) {
+        // 4 samples: sign-extend int16 to int32, convert, scale
+        __m128i v = _mm_loadu_si128((const __m128i*) &_x[2*i]);
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+        _mm256_storeu_ps((float*) &_y[i], _mm256_mul_ps(f, gain));
+    }
+    sc16_convert_generic(&_x[2*i], _n-i, _gain, &_y[i]);
+}
+
+__attribute__((target("avx2,fma")))
+void sc16_split_avx2(const short * _x,
+                     unsigned int _n,
+                     std::complex<float> * _a,
+                     std::complex<float> * _b)
+{
+    unsigned int i;
+    for (i=0; i+4<=_n; i+=4) {
+        // 4 pairs: samples s0..s7
+        __m256i v = _mm256_loadu_si256((const __m256i*) &_x[4*i]);
+        __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));      // s0..s3
+        __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v,1)));  // s4..s7
+
+        // treat each complex sample as one 64-bit lane
+        __m256d e = _mm256_unpacklo_pd(_mm256_castps_pd(f0), _mm256_castps_pd(f1)); // s0 s4 s2 s6
+        __m256d o = _mm256_unpackhi_pd(_mm256_castps_pd(f0), _mm256_castps_pd(f1)); // s1 s5 s3 s7
+        _mm256_storeu_pd((double*) &_a[i], _mm256_permute4x64_pd(e, 0xd8));          // s0 s2 s4 s6
+        _mm256_storeu_pd((double*) &_b[i], _mm256_permute4x64_pd(o, 0xd8));          // s1 s3 s5 s7
+    }
+    sc16_split_generic(&_x[4*i], _n-i, &_a[i], &_b[i]);
+}
+
+__attribute__((target("avx2,fma")))
+void sc16_filter_avx2(sc16decim _q,
+                      unsigned int _n,
+                      std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_q->b[k];
+        __m256 acc = _mm256_setzero_ps();
+        for (t=0; t<2*_q->L; t+=8)
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(&w[t]), _mm256_load_ps(&_q->g[t]), acc);
+
+        // sum real and imaginary lanes
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc,1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s,s));
+        float v[4];
+        _mm_storeu_ps(v, s);
+        _y[k] = std::complex<float>(v[0],v[1]) + _q->hc * _q->a[_q->L + k - _q->m];
+    }
+}
+
+#endif // SC16_X86
+
+#ifdef SC16_NEON
+
+//
+// ARM NEON kernels
+//
+
+void sc16_convert_neon(const short * _x,
+                       unsigned int _n,
+                       float _gain,
+                       std::complex<float> * _y)
+{
+    unsigned int i;
+    for (i=0; i+4<=_n; i+=4) {
+        // 4 samples: widen int16 to int32, convert, scale
+        int16x8_t v = vld1q_s16(&_x[2*i]);
+        float32x4_t f0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t f1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32((float*) &_y[i+0], vmulq_n_f32(f0, _gain));
+        vst1q_f32((float*) &_y[i+2], vmulq_n_f32(f1, _gain));
+    }
+    sc16_convert_generic(&_x[2*i], _n-i, _gain, &_y[i]);
+}
+
+void sc16_split_neon(const short * _x,
+                     unsigned int _n,
+                     std::complex<float> * _a,
+                     std::complex<float> * _b)
+{
+    unsigned int i;
+    for (i=0; i+4<=_n; i+=4) {
+        // 4 pairs: de-interleave 32-bit (complex int16) samples
+        int32x4x2_t v = vld2q_s32((const int32_t*) &_x[4*i]);
+        int16x8_t e = vreinterpretq_s16_s32(v.val[0]);  // s0 s2 s4 s6
+        int16x8_t o = vreinterpretq_s16_s32(v.val[1]);  // s1 s3 s5 s7
+        vst1q_f32((float*) &_a[i+0], vcvtq_f32_s32(vmovl_s16(vget_low_s16(e))));
+        vst1q_f32((float*) &_a[i+2], vcvtq_f32_s32(vmovl_s16(vget_high_s16(e))));
+        vst1q_f32((float*) &_b[i+0], vcvtq_f32_s32(vmovl_s16(vget_low_s16(o))));
+        vst1q_f32((float*) &_b[i+2], vcvtq_f32_s32(vmovl_s16(vget_high_s16(o))));
+    }
+    sc16_split_generic(&_x[4*i], _n-i, &_a[i], &_b[i]);
+}
+
+void sc16_filter_neon(sc16decim _q,
+                      unsigned int _n,
+                      std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_q->b[k];
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (t=0; t<2*_q->L; t+=4)
+            acc = vmlaq_f32(acc, vld1q_f32(&w[t]), vld1q_f32(&_q->g[t]));
+
+        // sum real and imaginary lanes
+        float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        _y[k] = std::complex<float>(vget_lane_f32(s,0), vget_lane_f32(s,1)) +
+                _q->hc * _q->a[_q->L + k - _q->m];
+    }
+}
+
+#endif // SC16_NEON
+
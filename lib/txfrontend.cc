@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txfrontend
+//
+// Input is processed in chunks of at most TXFRONTEND_CHUNK_LEN samples,
+// each of which passes through every stage while still in cache.  Every
+// stage keeps the last L samples of its input in front of the chunk so
+// that each output is one contiguous dot product over the stage's input
+// buffer, with the taps reversed, duplicated for the real and imaginary
+// parts and zero-padded at the front to a multiple of 4 samples (as in
+// sc16decim).
+//
+// Half-band interpolation by 2 of input x with a filter h of length 4m+1
+// has only one non-zero tap in its even phase:
+//
+//      y[2k]   = hc*x[k-m]
+//      y[2k+1] = sum_{i=0}^{2m-1} h[2i+1]*x[k-i]
+//
+// Each stage writes straight into the input buffer of the next, the last
+// into the resampler's.  The arbitrary resampler is a bank of npfb
+// polyphase branches of the prototype, interpolating linearly between
+// adjacent branches for the fractional output time; the output times of
+// a chunk are scheduled first so that the kernel is a plain loop of two
+// dot products per output.  The gain is folded into the resampler taps,
+// so scaling costs nothing.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <liquid/liquid.h>
+#include "profile.h"
+#include "sc16.h"
+#include "txfrontend.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define TXFRONTEND_X86
+#  include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define TXFRONTEND_NEON
+#  include <arm_neon.h>
+#endif
+
+// input samples per processing chunk
+#define TXFRONTEND_CHUNK_LEN    (256)
+
+// buffer alignment [bytes]
+#define TXFRONTEND_ALIGN        (64)
+
+// number of resampler filterbank branches
+#define TXFRONTEND_NPFB         (64)
+
+// half-band interpolator stage
+struct txfrontend_stage_s {
+    unsigned int m;             // filter semi-length
+    unsigned int L;             // window length (multiple of 4, >= 2m)
+    float * g;                  // odd taps (scaled, duplicated, padded) [size: 2L]
+    float hc;                   // center tap (scaled)
+    std::complex<float> * x;    // input history and chunk [size: L + chunk]
+};
+
+// interpolate _n samples of stage input into _y [size: 2*_n]
+typedef void (*txfrontend_interp_function)(struct txfrontend_stage_s * _s,
+                                           unsigned int _n,
+                                           std::complex<float> * _y);
+
+// compute _n scheduled resampler outputs into _y
+typedef void (*txfrontend_resamp_function)(txfrontend _q,
+                                           unsigned int _n,
+                                           std::complex<float> * _y);
+
+// txfrontend data structure
+struct txfrontend_s {
+    // half-band stages
+    unsigned int num_halfband;                          // number of stages
+    struct txfrontend_stage_s stage[RATEPLAN_MAX_HALFBAND];
+    float As;                                           // stopband attenuation [dB]
+
+    // arbitrary resampler
+    double rate;                // resampling rate (output/input)
+    unsigned int m;             // filter semi-length
+    float fc;                   // cutoff (relative to input rate)
+    unsigned int L;             // window length (multiple of 4, >= 2m)
+    float * h;                  // prototype, unity branch gain [size: 2*m*npfb+1]
+    float * g;                  // branch taps (scaled, duplicated, padded) [size: (npfb+1) x 2L]
+    std::complex<float> * x;    // input history and chunk [size: L + chunk*2^num_halfband]
+    double step;                // input samples per output sample
+    double tau;                 // time of next output after current input [samples]
+
+    // output schedule of current chunk
+    unsigned int * sched_index; // input sample
+    unsigned int * sched_branch;// filterbank branch
+    float * sched_frac;         // fraction towards next branch
+    unsigned int sched_len;     // capacity
+
+    float gain;                 // output gain (linear)
+    int isa;                    // instruction set extension
+
+    // kernels
+    txfrontend_interp_function interp;
+    txfrontend_resamp_function resamp;
+
+    // counters
+    unsigned long int num_input;    // baseband samples consumed
+    unsigned long int num_output;   // usrp samples produced
+};
+
+// portable kernels
+void txfrontend_interp_generic(struct txfrontend_stage_s * _s, unsigned int _n, std::complex<float> * _y);
+void txfrontend_resamp_generic(txfrontend _q, unsigned int _n, std::complex<float> * _y);
+
+#ifdef TXFRONTEND_X86
+void txfrontend_interp_sse2(struct txfrontend_stage_s * _s, unsigned int _n, std::complex<float> * _y);
+void txfrontend_resamp_sse2(txfrontend _q, unsigned int _n, std::complex<float> * _y);
+void txfrontend_interp_avx2(struct txfrontend_stage_s * _s, unsigned int _n, std::complex<float> * _y);
+void txfrontend_resamp_avx2(txfrontend _q, unsigned int _n, std::complex<float> * _y);
+#endif
+
+#ifdef TXFRONTEND_NEON
+void txfrontend_interp_neon(struct txfrontend_stage_s * _s, unsigned int _n, std::complex<float> * _y);
+void txfrontend_resamp_neon(txfrontend _q, unsigned int _n, std::complex<float> * _y);
+#endif
+
+// select kernels for instruction set extension
+void txfrontend_select(int _isa,
+                       txfrontend_interp_function * _interp,
+                       txfrontend_resamp_function * _resamp);
+
+// push chunk of _n input samples through all stages, returning number
+// of output samples
+unsigned int txfrontend_run(txfrontend _q,
+                            const std::complex<float> * _x,
+                            unsigned int _n,
+                            std::complex<float> * _y);
+
+// design half-band stage _s
+void txfrontend_stage_init(struct txfrontend_stage_s * _s,
+                           unsigned int _m,
+                           float _As,
+                           unsigned int _chunk_len);
+
+// compute scaled resampler branch taps from prototype and gain
+void txfrontend_set_taps(txfrontend _q);
+
+// allocate aligned memory
+void * txfrontend_malloc(size_t _size);
+
+// create txfrontend object
+//  _plan   :   transmit rate plan (half-band chain)
+//  _gain   :   linear gain applied to output
+//  _isa    :   instruction set extension (SC16_ISA_AUTO to detect)
+txfrontend txfrontend_create(struct rateplan_s * _plan,
+                             float _gain,
+                             int _isa)
+{
+    // validate input
+    if (_plan->direction != RATEPLAN_TX || _plan->chain != RATEPLAN_CHAIN_HALFBAND) {
+        fprintf(stderr,"error: txfrontend_create(), rate plan must be transmit half-band chain\n");
+        exit(1);
+    } else if (_plan->num_halfband > RATEPLAN_MAX_HALFBAND) {
+        fprintf(stderr,"error: txfrontend_create(), too many half-band stages (%u)\n", _plan->num_halfband);
+        exit(1);
+    } else if (_plan->resamp_rate <= 0.0 || _plan->resamp_m == 0) {
+        fprintf(stderr,"error: txfrontend_create(), invalid arbitrary resampler\n");
+        exit(1);
+    }
+
+    if (_isa == SC16_ISA_AUTO)
+        _isa = sc16_isa_detect();
+    if (!sc16_isa_supported(_isa)) {
+        fprintf(stderr,"error: txfrontend_create(), instruction set '%s' not supported\n", sc16_isa_str(_isa));
+        exit(1);
+    }
+
+    txfrontend q = (txfrontend) malloc(sizeof(struct txfrontend_s));
+    q->gain = _gain;
+    q->isa  = _isa;
+    q->As   = _plan->As;
+    txfrontend_select(q->isa, &q->interp, &q->resamp);
+
+    // half-band stages, chunk doubling at each
+    unsigned int i;
+    q->num_halfband = _plan->num_halfband;
+    for (i=0; i<q->num_halfband; i++)
+        txfrontend_stage_init(&q->stage[i], _plan->halfband_m[i], q->As, TXFRONTEND_CHUNK_LEN << i);
+
+    // arbitrary resampler prototype, normalized to unity gain per branch
+    q->rate = _plan->resamp_rate;
+    q->m    = _plan->resamp_m;
+    q->fc   = _plan->resamp_fc;
+    q->step = 1.0 / q->rate;
+    unsigned int h_len = 2*q->m*TXFRONTEND_NPFB + 1;
+    q->h = (float*) malloc(h_len*sizeof(float));
+    liquid_firdes_kaiser(h_len, q->fc / (float)TXFRONTEND_NPFB, q->As, 0.0f, q->h);
+    float hsum = 0.0f;
+    for (i=0; i<h_len; i++)
+        hsum += q->h[i];
+    for (i=0; i<h_len; i++)
+        q->h[i] *= (float)TXFRONTEND_NPFB / hsum;
+
+    // resampler taps and buffers
+    unsigned int chunk_len = TXFRONTEND_CHUNK_LEN << q->num_halfband;
+    q->L = ((2*q->m + 3) / 4) * 4;
+    q->g = (float*) txfrontend_malloc((TXFRONTEND_NPFB+1)*2*q->L*sizeof(float));
+    q->x = (std::complex<float>*) txfrontend_malloc((q->L + chunk_len)*sizeof(std::complex<float>));
+    txfrontend_set_taps(q);
+
+    q->sched_len    = (unsigned int) ceil(chunk_len * q->rate) + 2;
+    q->sched_index  = (unsigned int*) malloc(q->sched_len*sizeof(unsigned int));
+    q->sched_branch = (unsigned int*) malloc(q->sched_len*sizeof(unsigned int));
+    q->sched_frac   = (float*) malloc(q->sched_len*sizeof(float));
+
+    txfrontend_reset(q);
+    return q;
+}
+
+// destroy txfrontend object
+void txfrontend_destroy(txfrontend _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->num_halfband; i++) {
+        free(_q->stage[i].g);
+        free(_q->stage[i].x);
+    }
+    free(_q->h);
+    free(_q->g);
+    free(_q->x);
+    free(_q->sched_index);
+    free(_q->sched_branch);
+    free(_q->sched_frac);
+
+    // free main object memory
+    free(_q);
+}
+
+// print txfrontend object internals and counters
+void txfrontend_print(txfrontend _q)
+{
+    printf("txfrontend: %u half-band stage(s)", _q->num_halfband);
+    unsigned int i;
+    for (i=0; i<_q->num_halfband; i++)
+        printf("%sm=%u", i==0 ? " (" : ", ", _q->stage[i].m);
+    printf("%s, resampling rate %8.6f (m=%u), gain %.2f dB, isa=%s\n",
+            _q->num_halfband > 0 ? ")" : "",
+            _q->rate, _q->m, 20*log10f(_q->gain), sc16_isa_str(_q->isa));
+    printf("    samples in          : %12lu\n", _q->num_input);
+    printf("    samples out         : %12lu\n", _q->num_output);
+}
+
+// clear filter states and resampler phase
+void txfrontend_reset(txfrontend _q)
+{
+    unsigned int i;
+    unsigned int s;
+    for (s=0; s<_q->num_halfband; s++) {
+        for (i=0; i<_q->stage[s].L; i++)
+            _q->stage[s].x[i] = 0.0f;
+    }
+    for (i=0; i<_q->L; i++)
+        _q->x[i] = 0.0f;
+    _q->tau = 0.0;
+
+    _q->num_input  = 0;
+    _q->num_output = 0;
+}
+
+// set linear output gain
+void txfrontend_set_gain(txfrontend _q,
+                         float _gain)
+{
+    _q->gain = _gain;
+    txfrontend_set_taps(_q);
+}
+
+// get maximum number of output samples for _n input samples
+unsigned int txfrontend_max_output(txfrontend _q,
+                                   unsigned int _n)
+{
+    return (unsigned int) ceil((double)_n * (double)(1<<_q->num_halfband) * _q->rate) + 1;
+}
+
+// interpolate, resample and scale block of baseband samples
+unsigned int txfrontend_execute(txfrontend _q,
+                                const std::complex<float> * _x,
+                                unsigned int _n,
+                                std::complex<float> * _y)
+{
+    unsigned int num_written = 0;
+    unsigned int i;
+    for (i=0; i<_n; i+=TXFRONTEND_CHUNK_LEN) {
+        unsigned int n = (_n - i < TXFRONTEND_CHUNK_LEN) ? _n - i : TXFRONTEND_CHUNK_LEN;
+        num_written += txfrontend_run(_q, &_x[i], n, &_y[num_written]);
+    }
+
+    _q->num_input  += _n;
+    _q->num_output += num_written;
+    return num_written;
+}
+
+// push chunk of _n input samples through all stages
+unsigned int txfrontend_run(txfrontend _q,
+                            const std::complex<float> * _x,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int s;
+    unsigned int n = _n;
+
+    // half-band stages, each into the next stage's (or resampler's) input
+    PROFILE_BEGIN(PROFILE_HALFBAND);
+    std::complex<float> * v = _q->num_halfband > 0 ? _q->stage[0].x + _q->stage[0].L : _q->x + _q->L;
+    memmove(v, _x, n*sizeof(std::complex<float>));
+    for (s=0; s<_q->num_halfband; s++) {
+        struct txfrontend_stage_s * st = &_q->stage[s];
+        v = s+1 < _q->num_halfband ? _q->stage[s+1].x + _q->stage[s+1].L : _q->x + _q->L;
+        _q->interp(st, n, v);
+
+        // keep last L samples as history
+        memmove(st->x, &st->x[n], st->L*sizeof(std::complex<float>));
+        n *= 2;
+    }
+    PROFILE_END(PROFILE_HALFBAND, _n);
+
+    // schedule resampler outputs: branch and fraction of each output time
+    PROFILE_BEGIN(PROFILE_RESAMP);
+    unsigned int num_written = 0;
+    unsigned int j;
+    for (j=0; j<n; j++) {
+        while (_q->tau < 1.0) {
+            float f = (float)(_q->tau * TXFRONTEND_NPFB);
+            unsigned int b = (unsigned int) f;
+            if (b >= TXFRONTEND_NPFB)
+                b = TXFRONTEND_NPFB - 1;
+            _q->sched_index[num_written]  = j;
+            _q->sched_branch[num_written] = b;
+            _q->sched_frac[num_written]   = f - (float)b;
+            num_written++;
+            _q->tau += _q->step;
+        }
+        _q->tau -= 1.0;
+    }
+    _q->resamp(_q, num_written, _y);
+
+    // keep last L samples as history
+    memmove(_q->x, &_q->x[n], _q->L*sizeof(std::complex<float>));
+    PROFILE_END(PROFILE_RESAMP, n);
+
+    return num_written;
+}
+
+// design half-band stage _s
+void txfrontend_stage_init(struct txfrontend_stage_s * _s,
+                           unsigned int _m,
+                           float _As,
+                           unsigned int _chunk_len)
+{
+    if (_m == 0) {
+        fprintf(stderr,"error: txfrontend_stage_init(), filter semi-length must be greater than zero\n");
+        exit(1);
+    }
+    _s->m = _m;
+
+    // design prototype: force taps at even offsets from center to zero
+    // and normalize to unity gain at DC
+    unsigned int h_len = 4*_s->m + 1;
+    float h[h_len];
+    liquid_firdes_kaiser(h_len, 0.25f, _As, 0.0f, h);
+    unsigned int i;
+    float hsum = 0.0f;
+    for (i=0; i<h_len; i++) {
+        if ( (i % 2) == 0 && i != 2*_s->m )
+            h[i] = 0.0f;
+        hsum += h[i];
+    }
+
+    // interpolation by 2 needs a gain of 2 to preserve amplitude; window
+    // sample t holds x[k-L+1+t], i.e. x[k-i] for t = L-1-i
+    _s->L = ((2*_s->m + 3) / 4) * 4;
+    _s->g = (float*) txfrontend_malloc(2*_s->L*sizeof(float));
+    unsigned int t;
+    for (t=0; t<_s->L; t++) {
+        i = _s->L - 1 - t;
+        float v = i < 2*_s->m ? 2.0f * h[2*i+1] / hsum : 0.0f;
+        _s->g[2*t+0] = v;
+        _s->g[2*t+1] = v;
+    }
+    _s->hc = 2.0f * h[2*_s->m] / hsum;
+    _s->x = (std::complex<float>*) txfrontend_malloc((_s->L + _chunk_len)*sizeof(std::complex<float>));
+}
+
+// compute scaled resampler branch taps from prototype and gain
+void txfrontend_set_taps(txfrontend _q)
+{
+    // branch b holds h[b + npfb*i] for x[k-i]; branch npfb is (nearly)
+    // branch 0 one input sample later, the end point for interpolation
+    unsigned int h_len = 2*_q->m*TXFRONTEND_NPFB + 1;
+    unsigned int b;
+    unsigned int t;
+    for (b=0; b<=TXFRONTEND_NPFB; b++) {
+        float * g = &_q->g[2*_q->L*b];
+        for (t=0; t<_q->L; t++) {
+            unsigned int i = _q->L - 1 - t;
+            unsigned int k = b + TXFRONTEND_NPFB*i;
+            float v = (i < 2*_q->m && k < h_len) ? _q->h[k] * _q->gain : 0.0f;
+            g[2*t+0] = v;
+            g[2*t+1] = v;
+        }
+    }
+}
+
+// allocate aligned memory
+void * txfrontend_malloc(size_t _size)
+{
+    void * p = NULL;
+    if (posix_memalign(&p, TXFRONTEND_ALIGN, _size) != 0) {
+        fprintf(stderr,"error: txfrontend_malloc(), could not allocate %lu bytes\n", (unsigned long)_size);
+        exit(1);
+    }
+    return p;
+}
+
+// select kernels for instruction set extension
+void txfrontend_select(int _isa,
+                       txfrontend_interp_function * _interp,
+                       txfrontend_resamp_function * _resamp)
+{
+    *_interp = txfrontend_interp_generic;
+    *_resamp = txfrontend_resamp_generic;
+
+    switch (_isa) {
+#ifdef TXFRONTEND_X86
+    case SC16_ISA_SSE2:
+        *_interp = txfrontend_interp_sse2;
+        *_resamp = txfrontend_resamp_sse2;
+        break;
+    case SC16_ISA_AVX2:
+        *_interp = txfrontend_interp_avx2;
+        *_resamp = txfrontend_resamp_avx2;
+        break;
+#endif
+#ifdef TXFRONTEND_NEON
+    case SC16_ISA_NEON:
+        *_interp = txfrontend_interp_neon;
+        *_resamp = txfrontend_resamp_neon;
+        break;
+#endif
+    default:;
+    }
+}
+
+//
+// portable kernels
+//
+
+void txfrontend_interp_generic(struct txfrontend_stage_s * _s,
+                               unsigned int _n,
+                               std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_s->x[k+1];
+        float yi = 0.0f;
+        float yq = 0.0f;
+        for (t=0; t<2*_s->L; t+=2) {
+            yi += w[t+0] * _s->g[t+0];
+            yq += w[t+1] * _s->g[t+1];
+        }
+        _y[2*k+0] = _s->hc * _s->x[_s->L + k - _s->m];
+        _y[2*k+1] = std::complex<float>(yi,yq);
+    }
+}
+
+void txfrontend_resamp_generic(txfrontend _q,
+                               unsigned int _n,
+                               std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w  = (const float*) &_q->x[_q->sched_index[k]+1];
+        const float * g0 = &_q->g[2*_q->L*_q->sched_branch[k]];
+        const float * g1 = g0 + 2*_q->L;
+        float y0i = 0.0f, y0q = 0.0f;
+        float y1i = 0.0f, y1q = 0.0f;
+        for (t=0; t<2*_q->L; t+=2) {
+            y0i += w[t+0] * g0[t+0];
+            y0q += w[t+1] * g0[t+1];
+            y1i += w[t+0] * g1[t+0];
+            y1q += w[t+1] * g1[t+1];
+        }
+        float mu = _q->sched_frac[k];
+        _y[k] = std::complex<float>(y0i + mu*(y1i - y0i), y0q + mu*(y1q - y0q));
+    }
+}
+
+#ifdef TXFRONTEND_X86
+
+//
+// x86 SSE2 kernels
+//
+
+__attribute__((target("sse2")))
+void txfrontend_interp_sse2(struct txfrontend_stage_s * _s,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_s->x[k+1];
+        __m128 acc = _mm_setzero_ps();
+        for (t=0; t<2*_s->L; t+=4)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&w[t]), _mm_load_ps(&_s->g[t])));
+
+        // sum real and imaginary lanes
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc,acc));
+        _y[2*k+0] = _s->hc * _s->x[_s->L + k - _s->m];
+        _mm_storel_pi((__m64*) &_y[2*k+1], acc);
+    }
+}
+
+__attribute__((target("sse2")))
+void txfrontend_resamp_sse2(txfrontend _q,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w  = (const float*) &_q->x[_q->sched_index[k]+1];
+        const float * g0 = &_q->g[2*_q->L*_q->sched_branch[k]];
+        const float * g1 = g0 + 2*_q->L;
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (t=0; t<2*_q->L; t+=4) {
+            __m128 v = _mm_loadu_ps(&w[t]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(v, _mm_load_ps(&g0[t])));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(v, _mm_load_ps(&g1[t])));
+        }
+
+        // interpolate between branches, sum real and imaginary lanes
+        __m128 acc = _mm_add_ps(acc0, _mm_mul_ps(_mm_set1_ps(_q->sched_frac[k]), _mm_sub_ps(acc1, acc0)));
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc,acc));
+        _mm_storel_pi((__m64*) &_y[k], acc);
+    }
+}
+
+//
+// x86 AVX2 kernels
+//
+
+__attribute__((target("avx2,fma")))
+void txfrontend_interp_avx2(struct txfrontend_stage_s * _s,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_s->x[k+1];
+        __m256 acc = _mm256_setzero_ps();
+        for (t=0; t<2*_s->L; t+=8)
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(&w[t]), _mm256_load_ps(&_s->g[t]), acc);
+
+        // sum real and imaginary lanes
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc,1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s,s));
+        _y[2*k+0] = _s->hc * _s->x[_s->L + k - _s->m];
+        _mm_storel_pi((__m64*) &_y[2*k+1], s);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void txfrontend_resamp_avx2(txfrontend _q,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w  = (const float*) &_q->x[_q->sched_index[k]+1];
+        const float * g0 = &_q->g[2*_q->L*_q->sched_branch[k]];
+        const float * g1 = g0 + 2*_q->L;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (t=0; t<2*_q->L; t+=8) {
+            __m256 v = _mm256_loadu_ps(&w[t]);
+            acc0 = _mm256_fmadd_ps(v, _mm256_load_ps(&g0[t]), acc0);
+            acc1 = _mm256_fmadd_ps(v, _mm256_load_ps(&g1[t]), acc1);
+        }
+        __m128 s0 = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0,1));
+        __m128 s1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1,1));
+
+        // interpolate between branches, sum real and imaginary lanes
+        __m128 s = _mm_fmadd_ps(_mm_set1_ps(_q->sched_frac[k]), _mm_sub_ps(s1, s0), s0);
+        s = _mm_add_ps(s, _mm_movehl_ps(s,s));
+        _mm_storel_pi((__m64*) &_y[k], s);
+    }
+}
+
+#endif // TXFRONTEND_X86
+
+#ifdef TXFRONTEND_NEON
+
+//
+// ARM NEON kernels
+//
+
+void txfrontend_interp_neon(struct txfrontend_stage_s * _s,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w = (const float*) &_s->x[k+1];
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (t=0; t<2*_s->L; t+=4)
+            acc = vmlaq_f32(acc, vld1q_f32(&w[t]), vld1q_f32(&_s->g[t]));
+
+        // sum real and imaginary lanes
+        _y[2*k+0] = _s->hc * _s->x[_s->L + k - _s->m];
+        vst1_f32((float*) &_y[2*k+1], vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+    }
+}
+
+void txfrontend_resamp_neon(txfrontend _q,
+                            unsigned int _n,
+                            std::complex<float> * _y)
+{
+    unsigned int k;
+    unsigned int t;
+    for (k=0; k<_n; k++) {
+        const float * w  = (const float*) &_q->x[_q->sched_index[k]+1];
+        const float * g0 = &_q->g[2*_q->L*_q->sched_branch[k]];
+        const float * g1 = g0 + 2*_q->L;
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        for (t=0; t<2*_q->L; t+=4) {
+            float32x4_t v = vld1q_f32(&w[t]);
+            acc0 = vmlaq_f32(acc0, v, vld1q_f32(&g0[t]));
+            acc1 = vmlaq_f32(acc1, v, vld1q_f32(&g1[t]));
+        }
+
+        // interpolate between branches, sum real and imaginary lanes
+        float32x4_t acc = vmlaq_n_f32(acc0, vsubq_f32(acc1, acc0), _q->sched_frac[k]);
+        vst1_f32((float*) &_y[k], vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+    }
+}
+
+#endif // TXFRONTEND_NEON
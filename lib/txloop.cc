@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txloop
+//
+// All frames share one allocation, rounded up to whole pages, so that
+// the loop is a single contiguous run of samples with no gaps between
+// frames.  Streaming hands the device pointers straight into that
+// buffer, at most TXLOOP_CHUNK_LEN samples at a time so that the caller
+// gets control back (e.g. to poll for underflows) regularly.
+//
+// Frames are rendered in order through whatever state the render
+// callback keeps (e.g. one txfrontend), so adjacent frames join as they
+// would in a live transmitter; only the wrap from the last frame back
+// to the first is a seam, which is clean when frames end in silence.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "txloop.h"
+
+// maximum number of samples per send() call
+#define TXLOOP_CHUNK_LEN    (65536)
+
+// txloop data structure
+struct txloop_s {
+    unsigned int num_frames;        // number of frames in loop
+    unsigned int frame_len;         // maximum samples per frame
+    std::complex<float> * buffer;   // loop buffer (page-aligned)
+    size_t buffer_size;             // allocated size [bytes]
+    size_t page_size;               // page size [bytes]
+    int locked;                     // buffer is locked in memory
+    unsigned int length;            // loop length [samples]
+
+    // counters
+    double render_time;             // time spent rendering [seconds]
+    unsigned long int num_sent;     // samples sent
+    unsigned long int num_loops;    // complete passes through loop
+    double stream_time;             // time spent streaming [seconds]
+    double stream_cpu;              // cpu time spent streaming [seconds]
+};
+
+// clock time [seconds]
+double txloop_time(clockid_t _clock);
+
+// create txloop object
+//  _num_frames :   number of distinct frames in loop
+//  _frame_len  :   maximum number of usrp samples per frame
+//  _lock       :   lock buffer in memory (mlock)?
+txloop txloop_create(unsigned int _num_frames,
+                     unsigned int _frame_len,
+                     int _lock)
+{
+    // validate input
+    if (_num_frames == 0) {
+        fprintf(stderr,"error: txloop_create(), number of frames must be greater than zero\n");
+        exit(1);
+    } else if (_frame_len == 0) {
+        fprintf(stderr,"error: txloop_create(), frame length must be greater than zero\n");
+        exit(1);
+    }
+
+    txloop q = (txloop) malloc(sizeof(struct txloop_s));
+    q->num_frames = _num_frames;
+    q->frame_len  = _frame_len;
+
+    // one page-aligned allocation for all frames
+    q->page_size   = (size_t) sysconf(_SC_PAGESIZE);
+    q->buffer_size = (size_t)q->num_frames * (size_t)q->frame_len * sizeof(std::complex<float>);
+    q->buffer_size = (q->buffer_size + q->page_size - 1) / q->page_size * q->page_size;
+    void * buffer;
+    if (posix_memalign(&buffer, q->page_size, q->buffer_size) != 0) {
+        fprintf(stderr,"error: txloop_create(), could not allocate %lu bytes\n", (unsigned long int)q->buffer_size);
+        exit(1);
+    }
+    q->buffer = (std::complex<float>*) buffer;
+
+    // touch every page now rather than on the first pass
+    memset(buffer, 0, q->buffer_size);
+
+    q->locked = 0;
+    if (_lock) {
+        if (mlock(buffer, q->buffer_size) == 0)
+            q->locked = 1;
+        else
+            fprintf(stderr,"warning: txloop_create(), could not lock %lu bytes: %s\n",
+                    (unsigned long int)q->buffer_size, strerror(errno));
+    }
+
+    q->length      = 0;
+    q->render_time = 0.0;
+    q->num_sent    = 0;
+    q->num_loops   = 0;
+    q->stream_time = 0.0;
+    q->stream_cpu  = 0.0;
+
+    return q;
+}
+
+// destroy txloop object
+void txloop_destroy(txloop _q)
+{
+    if (_q->locked)
+        munlock(_q->buffer, _q->buffer_size);
+    free(_q->buffer);
+
+    // free main object memory
+    free(_q);
+}
+
+// print buffer layout and render/stream counters
+void txloop_print(txloop _q)
+{
+    printf("txloop: %u frames, %u samples (%.3f MB in %lu pages%s)\n",
+            _q->num_frames,
+            _q->length,
+            1e-6*(double)_q->buffer_size,
+            (unsigned long int)(_q->buffer_size / _q->page_size),
+            _q->locked ? ", locked" : "");
+    printf("    render time         : %.3f s\n", _q->render_time);
+    printf("    samples sent        : %lu (%lu loops)\n", _q->num_sent, _q->num_loops);
+    printf("    stream time         : %.3f s (%.3f Msamples/s)\n",
+            _q->stream_time,
+            _q->stream_time > 0.0 ? 1e-6*(double)_q->num_sent / _q->stream_time : 0.0);
+    printf("    stream cpu time     : %.3f s (%.2f%%)\n",
+            _q->stream_cpu,
+            _q->stream_time > 0.0 ? 100.0*_q->stream_cpu / _q->stream_time : 0.0);
+}
+
+// render all frames back to back into loop buffer
+void txloop_render(txloop _q,
+                   txloop_generate _generate,
+                   void * _userdata)
+{
+    double t0 = txloop_time(CLOCK_MONOTONIC);
+
+    unsigned int k;
+    _q->length = 0;
+    for (k=0; k<_q->num_frames; k++) {
+        unsigned int n = _generate(k, &_q->buffer[_q->length], _q->frame_len, _userdata);
+        if (n > _q->frame_len) {
+            fprintf(stderr,"error: txloop_render(), frame %u overflows buffer (%u > %u samples)\n",
+                    k, n, _q->frame_len);
+            exit(1);
+        }
+        _q->length += n;
+    }
+
+    _q->render_time = txloop_time(CLOCK_MONOTONIC) - t0;
+}
+
+// get loop length [samples]
+unsigned int txloop_get_length(txloop _q)
+{
+    return _q->length;
+}
+
+// stream loop buffer repeatedly until _num_samples samples have been sent
+void txloop_run(txloop _q,
+                unsigned long int _num_samples,
+                txloop_send _send,
+                void * _userdata)
+{
+    if (_q->length == 0) {
+        fprintf(stderr,"error: txloop_run(), loop has not been rendered\n");
+        exit(1);
+    }
+
+    double t0 = txloop_time(CLOCK_MONOTONIC);
+    double c0 = txloop_time(CLOCK_THREAD_CPUTIME_ID);
+
+    unsigned long int num_sent = 0;
+    unsigned int offset = 0;
+    while (num_sent < _num_samples) {
+        // next chunk, up to end of loop
+        unsigned int n = _q->length - offset;
+        if (n > TXLOOP_CHUNK_LEN)
+            n = TXLOOP_CHUNK_LEN;
+        if (n > _num_samples - num_sent)
+            n = (unsigned int)(_num_samples - num_sent);
+
+        unsigned int num_written = _send(&_q->buffer[offset], n, _userdata);
+        if (num_written == 0) {
+            fprintf(stderr,"warning: txloop_run(), device accepted no samples; stopping\n");
+            break;
+        }
+
+        num_sent += num_written;
+        offset   += num_written;
+        if (offset >= _q->length) {
+            offset = 0;
+            _q->num_loops++;
+        }
+    }
+
+    _q->num_sent    += num_sent;
+    _q->stream_time += txloop_time(CLOCK_MONOTONIC) - t0;
+    _q->stream_cpu  += txloop_time(CLOCK_THREAD_CPUTIME_ID) - c0;
+}
+
+// clock time [seconds]
+double txloop_time(clockid_t _clock)
+{
+    struct timespec ts;
+    clock_gettime(_clock, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
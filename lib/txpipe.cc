@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txpipe
+//
+// Frames are dealt out to workers round-robin by sequence number: worker
+// w generates frames w, w+W, w+2W, ... (W workers) into its own queue,
+// so that every queue still has exactly one producer and one consumer,
+// and the sender restores frame order simply by reading the queues in
+// turn.  Each queue holds ceil(depth/W) frames.
+//
+// Workers wait when their queue is full; that is the look-ahead doing
+// its job, not a stall.  The sender first waits for the look-ahead to
+// fill, then counts an underrun each time the next frame in order is not
+// ready when it is due.  Look-ahead depth is sampled before each frame
+// is sent.  Stopping lets the sender send the frames already generated,
+// up to the first one that is missing, so that no frame is skipped.
+//
+// Thread busy time is the time spent in the generator or send callback;
+// waiting on a queue is idle.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "txpipe.h"
+#include "blockq.h"
+
+// worker thread and its queue
+struct txpipe_worker_s {
+    struct txpipe_s * q;            // parent object
+    unsigned int index;             // worker index
+    pthread_t thread;               // worker thread
+    volatile int done;              // worker has generated its last frame
+    blockq queue;                   // frames index, index+W, ...
+    unsigned long int num_frames;   // frames generated
+    double busy;                    // time spent generating [seconds]
+    double wait;                    // time spent waiting on sender [seconds]
+};
+
+// txpipe data structure
+struct txpipe_s {
+    // workers
+    unsigned int num_workers;           // number of worker threads
+    unsigned int depth;                 // frames per worker queue
+    unsigned int frame_len;             // samples per frame (maximum)
+    struct txpipe_worker_s * worker;    // worker threads [size: num_workers]
+    txpipe_generate generate;           // frame generator callback
+    void * generate_userdata;           // frame generator user data
+    volatile int running;               // worker run flag
+    unsigned long int num_frames;       // frames to send (0 for no limit)
+
+    // sender
+    pthread_t sender;                   // sender thread
+    txpipe_send send;                   // send callback
+    void * send_userdata;               // send callback user data
+    volatile unsigned long int num_sent;// frames sent
+    unsigned long int num_samples;      // samples sent
+    unsigned long int num_underruns;    // next frame not ready when due
+    double busy;                        // time spent sending [seconds]
+    double wait;                        // time spent in underrun [seconds]
+
+    // look-ahead depth, sampled before each frame is sent
+    unsigned int depth_min;             // minimum frames ready
+    unsigned int depth_max;             // maximum frames ready
+    unsigned long int depth_sum;        // accumulated frames ready
+
+    int threads_running;                // threads started
+    double time_start;                  // start time [seconds]
+    double time_stop;                   // stop time [seconds]
+};
+
+// threads
+void * txpipe_worker_process(void * _userdata);
+void * txpipe_sender_process(void * _userdata);
+
+// number of frames ready across all worker queues
+unsigned int txpipe_get_depth(txpipe _q);
+
+// join worker and sender threads
+void txpipe_join(txpipe _q);
+
+// monotonic time [seconds]
+double txpipe_time();
+
+// create txpipe object
+//  _num_workers        :   number of frame generator threads
+//  _depth              :   number of frames generated ahead of sender
+//  _frame_len          :   maximum number of usrp samples per frame
+//  _generate           :   frame generator callback
+//  _generate_userdata  :   user-defined data pointer passed to generator
+//  _send               :   send callback
+//  _send_userdata      :   user-defined data pointer passed to send callback
+txpipe txpipe_create(unsigned int _num_workers,
+                     unsigned int _depth,
+                     unsigned int _frame_len,
+                     txpipe_generate _generate,
+                     void * _generate_userdata,
+                     txpipe_send _send,
+                     void * _send_userdata)
+{
+    // validate input
+    if (_num_workers == 0) {
+        fprintf(stderr,"error: txpipe_create(), number of workers must be greater than zero\n");
+        exit(1);
+    } else if (_depth == 0) {
+        fprintf(stderr,"error: txpipe_create(), look-ahead depth must be greater than zero\n");
+        exit(1);
+    } else if (_frame_len == 0) {
+        fprintf(stderr,"error: txpipe_create(), frame length must be greater than zero\n");
+        exit(1);
+    } else if (_generate == NULL || _send == NULL) {
+        fprintf(stderr,"error: txpipe_create(), callbacks cannot be NULL\n");
+        exit(1);
+    }
+
+    txpipe q = (txpipe) malloc(sizeof(struct txpipe_s));
+
+    q->generate          = _generate;
+    q->generate_userdata = _generate_userdata;
+    q->send              = _send;
+    q->send_userdata     = _send_userdata;
+
+    // split look-ahead evenly among workers
+    q->num_workers = _num_workers;
+    q->depth       = (_depth + q->num_workers - 1) / q->num_workers;
+    q->frame_len   = _frame_len;
+    q->worker = (struct txpipe_worker_s*) malloc(q->num_workers*sizeof(struct txpipe_worker_s));
+    unsigned int i;
+    for (i=0; i<q->num_workers; i++) {
+        q->worker[i].q          = q;
+        q->worker[i].index      = i;
+        q->worker[i].done       = 0;
+        q->worker[i].queue      = blockq_create(q->depth, q->frame_len);
+        q->worker[i].num_frames = 0;
+        q->worker[i].busy       = 0.0;
+        q->worker[i].wait       = 0.0;
+    }
+
+    q->running         = 0;
+    q->num_frames      = 0;
+    q->num_sent        = 0;
+    q->num_samples     = 0;
+    q->num_underruns   = 0;
+    q->busy            = 0.0;
+    q->wait            = 0.0;
+    q->depth_min       = 0;
+    q->depth_max       = 0;
+    q->depth_sum       = 0;
+    q->threads_running = 0;
+    q->time_start      = 0.0;
+    q->time_stop       = 0.0;
+
+    return q;
+}
+
+// destroy txpipe object, stopping threads if running
+void txpipe_destroy(txpipe _q)
+{
+    if (_q->threads_running)
+        txpipe_stop(_q);
+
+    unsigned int i;
+    for (i=0; i<_q->num_workers; i++)
+        blockq_destroy(_q->worker[i].queue);
+    free(_q->worker);
+
+    // free main object memory
+    free(_q);
+}
+
+// print per-thread utilization, underruns and look-ahead queue depth
+void txpipe_print(txpipe _q)
+{
+    double runtime = (_q->threads_running ? txpipe_time() : _q->time_stop) - _q->time_start;
+    unsigned int depth = _q->num_workers*_q->depth;
+
+    printf("txpipe: %u workers, %u frames look-ahead (%u per worker), %u samples per frame\n",
+            _q->num_workers, depth, _q->depth, _q->frame_len);
+    printf("    thread        frames     busy [s]   utilization\n");
+    unsigned long int num_generated = 0;
+    unsigned int i;
+    for (i=0; i<_q->num_workers; i++) {
+        printf("    worker %-3u  %9lu  %11.3f   %10.2f%%\n",
+                i,
+                _q->worker[i].num_frames,
+                _q->worker[i].busy,
+                runtime > 0.0 ? 100.0*_q->worker[i].busy / runtime : 0.0);
+        num_generated += _q->worker[i].num_frames;
+    }
+    printf("    sender      %9lu  %11.3f   %10.2f%%\n",
+            _q->num_sent,
+            _q->busy,
+            runtime > 0.0 ? 100.0*_q->busy / runtime : 0.0);
+    printf("    frames generated    : %lu\n", num_generated);
+    printf("    frames sent         : %lu (%lu samples)\n", _q->num_sent, _q->num_samples);
+    printf("    underruns           : %lu (%.3f s waiting)\n", _q->num_underruns, _q->wait);
+    printf("    look-ahead depth    : min %u, mean %.2f, max %u / %u frames\n",
+            _q->depth_min,
+            _q->num_sent > 0 ? (double)_q->depth_sum / (double)_q->num_sent : 0.0,
+            _q->depth_max,
+            depth);
+}
+
+// start worker and sender threads
+void txpipe_start(txpipe _q,
+                  unsigned long int _num_frames)
+{
+    if (_q->threads_running)
+        return;
+
+    unsigned int i;
+    for (i=0; i<_q->num_workers; i++) {
+        blockq_reset(_q->worker[i].queue);
+        _q->worker[i].done       = 0;
+        _q->worker[i].num_frames = 0;
+        _q->worker[i].busy       = 0.0;
+        _q->worker[i].wait       = 0.0;
+    }
+    _q->num_frames    = _num_frames;
+    _q->num_sent      = 0;
+    _q->num_samples   = 0;
+    _q->num_underruns = 0;
+    _q->busy          = 0.0;
+    _q->wait          = 0.0;
+    _q->depth_min     = 0;
+    _q->depth_max     = 0;
+    _q->depth_sum     = 0;
+
+    _q->time_start = txpipe_time();
+    _q->running    = 1;
+
+    // start consumer first
+    if (pthread_create(&_q->sender, NULL, txpipe_sender_process, (void*)_q) != 0) {
+        fprintf(stderr,"error: txpipe_start(), could not create sender thread\n");
+        exit(1);
+    }
+    for (i=0; i<_q->num_workers; i++) {
+        if (pthread_create(&_q->worker[i].thread, NULL, txpipe_worker_process, (void*)&_q->worker[i]) != 0) {
+            fprintf(stderr,"error: txpipe_start(), could not create worker thread\n");
+            exit(1);
+        }
+    }
+    _q->threads_running = 1;
+}
+
+// wait for all frames to be sent and join threads
+void txpipe_wait(txpipe _q)
+{
+    if (!_q->threads_running)
+        return;
+
+    if (_q->num_frames == 0) {
+        fprintf(stderr,"error: txpipe_wait(), pipeline was started without a frame limit\n");
+        exit(1);
+    }
+    txpipe_join(_q);
+}
+
+// stop generating frames, send frames already generated and join threads
+void txpipe_stop(txpipe _q)
+{
+    if (!_q->threads_running)
+        return;
+
+    _q->running = 0;
+    txpipe_join(_q);
+}
+
+// get number of frames sent
+unsigned long int txpipe_get_num_sent(txpipe _q)
+{
+    return _q->num_sent;
+}
+
+// get number of underruns
+unsigned long int txpipe_get_num_underruns(txpipe _q)
+{
+    return _q->num_underruns;
+}
+
+// worker thread: generate every num_workers-th frame into own queue
+void * txpipe_worker_process(void * _userdata)
+{
+    struct txpipe_worker_s * w = (struct txpipe_worker_s*) _userdata;
+    txpipe q = w->q;
+
+    unsigned long int seq;
+    for (seq=w->index; q->num_frames == 0 || seq < q->num_frames; seq += q->num_workers) {
+        // wait for room without counting an overflow on the queue itself
+        double t0 = txpipe_time();
+        while (q->running && blockq_get_occupancy(w->queue) >= blockq_get_capacity(w->queue))
+            usleep(100);
+        double t1 = txpipe_time();
+        w->wait += t1 - t0;
+
+        if (!q->running)
+            break;
+
+        struct blockq_block_s * block = blockq_write_acquire(w->queue);
+        block->n = q->generate(w->index, seq, block->x, block->capacity, q->generate_userdata);
+        blockq_write_commit(w->queue);
+        w->busy += txpipe_time() - t1;
+        w->num_frames++;
+    }
+
+    // publish last frame before done flag
+    __sync_synchronize();
+    w->done = 1;
+    return NULL;
+}
+
+// sender thread: send frames from worker queues in sequence order
+void * txpipe_sender_process(void * _userdata)
+{
+    txpipe q = (txpipe) _userdata;
+    unsigned int depth = q->num_workers*q->depth;
+    if (q->num_frames > 0 && q->num_frames < depth)
+        depth = q->num_frames;
+
+    // wait for look-ahead to fill before sending the first frame
+    for (;;) {
+        unsigned int i, num_done = 0;
+        for (i=0; i<q->num_workers; i++)
+            num_done += q->worker[i].done;
+        if (txpipe_get_depth(q) >= depth || num_done == q->num_workers)
+            break;
+        usleep(100);
+    }
+    q->depth_min = txpipe_get_depth(q);
+
+    unsigned long int seq;
+    for (seq=0; q->num_frames == 0 || seq < q->num_frames; ) {
+        struct txpipe_worker_s * w = &q->worker[seq % q->num_workers];
+        struct blockq_block_s * block = blockq_read_acquire(w->queue);
+        if (block == NULL) {
+            // exit only once the frame's worker has stopped and the queue
+            // is drained
+            if (w->done && blockq_read_acquire(w->queue) == NULL)
+                break;
+
+            // next frame is due but not ready
+            double t0 = txpipe_time();
+            q->num_underruns++;
+            while (blockq_read_acquire(w->queue) == NULL && !w->done)
+                usleep(100);
+            q->wait += txpipe_time() - t0;
+            continue;
+        }
+
+        // sample look-ahead depth, including this frame; the minimum
+        // ignores the last frames, which cannot fill the look-ahead
+        unsigned int d = txpipe_get_depth(q);
+        if (q->num_frames == 0 || q->num_frames - seq >= depth)
+            q->depth_min = d < q->depth_min ? d : q->depth_min;
+        q->depth_max  = d > q->depth_max ? d : q->depth_max;
+        q->depth_sum += d;
+
+        double t0 = txpipe_time();
+        q->num_samples += q->send(block->x, block->n, q->send_userdata);
+        q->busy += txpipe_time() - t0;
+
+        blockq_read_release(w->queue);
+        q->num_sent++;
+        seq++;
+    }
+
+    // stop any workers still generating (e.g. after a missing frame)
+    q->running = 0;
+    return NULL;
+}
+
+// number of frames ready across all worker queues
+unsigned int txpipe_get_depth(txpipe _q)
+{
+    unsigned int depth = 0;
+    unsigned int i;
+    for (i=0; i<_q->num_workers; i++)
+        depth += blockq_get_occupancy(_q->worker[i].queue);
+    return depth;
+}
+
+// join worker and sender threads
+void txpipe_join(txpipe _q)
+{
+    unsigned int i;
+    pthread_join(_q->sender, NULL);
+    for (i=0; i<_q->num_workers; i++)
+        pthread_join(_q->worker[i].thread, NULL);
+
+    _q->running         = 0;
+    _q->threads_running = 0;
+    _q->time_stop       = txpipe_time();
+}
+
+// monotonic time [seconds]
+double txpipe_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
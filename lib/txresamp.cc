@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txresamp
+//
+// Calibration drives every strategy with the same multi-tone test
+// signal, in blocks of the application's own length, so that per-call
+// overhead is measured as the application will see it.  The rejection
+// is the ratio of the strongest tone to the strongest spectral line
+// anywhere else in the usrp band (images, aliases, spurs), from an
+// averaged, Blackman-Harris windowed periodogram; tones are placed
+// inside the signal band, so any energy away from them is the
+// resampler's doing rather than the pulse shape's.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <liquid/liquid.h>
+
+#include "txresamp.h"
+#include "rateplan.h"
+#include "sc16.h"
+#include "timer.h"
+#include "txfrontend.h"
+
+#define TXRESAMP_NFFT           (1024)  // periodogram size
+#define TXRESAMP_NUM_SEGMENTS   (16)    // periodogram segments averaged
+#define TXRESAMP_NUM_TONES      (5)     // test tones across signal band
+#define TXRESAMP_TONE_BINS      (6)     // bins either side of tone excluded
+#define TXRESAMP_CAL_TIME       (0.02f) // minimum timing run [seconds]
+
+// txresamp data structure
+struct txresamp_s {
+    int strategy;                   // strategy
+    double rate;                    // resampling rate (usrp/baseband)
+    float gain;                     // linear output gain
+    float As;                       // stopband attenuation [dB]
+
+    resamp_crcf resamp;             // TXRESAMP_RESAMP
+    msresamp_crcf msresamp;         // TXRESAMP_MSRESAMP
+    struct rateplan_s plan;         // TXRESAMP_FRONTEND, _FRONTEND_HB
+    txfrontend fe;
+};
+
+// measure carrier to largest spur [dB] of strategy on test signal
+float txresamp_measure_rejection(txresamp _q,
+                                 std::complex<float> * _x,
+                                 unsigned int _n,
+                                 unsigned int _block_len,
+                                 float * _tones,
+                                 double _usrp_rate);
+
+// run test signal through strategy in blocks, returning number of
+// output samples
+unsigned int txresamp_run(txresamp _q,
+                          std::complex<float> * _x,
+                          unsigned int _n,
+                          unsigned int _block_len,
+                          std::complex<float> * _y);
+
+// create txresamp object, or return NULL if the strategy cannot realize
+// the rates
+txresamp txresamp_create(int _strategy,
+                         struct txresamp_props_s * _props)
+{
+    // validate input
+    if (_strategy < 0 || _strategy >= TXRESAMP_NUM_STRATEGIES) {
+        fprintf(stderr,"error: txresamp_create(), invalid strategy\n");
+        exit(1);
+    } else if (_props->usrp_rate <= 0.0 || _props->baseband_rate <= 0.0) {
+        fprintf(stderr,"error: txresamp_create(), rates must be greater than zero\n");
+        exit(1);
+    }
+
+    txresamp q = (txresamp) malloc(sizeof(struct txresamp_s));
+    q->strategy = _strategy;
+    q->rate     = _props->usrp_rate / _props->baseband_rate;
+    q->gain     = _props->gain;
+    q->As       = _props->As;
+    q->resamp   = NULL;
+    q->msresamp = NULL;
+    q->fe       = NULL;
+
+    switch (q->strategy) {
+    case TXRESAMP_RESAMP:
+        q->resamp = resamp_crcf_create(q->rate, 7, 0.4f, q->As, 64);
+        break;
+    case TXRESAMP_MSRESAMP:
+        q->msresamp = msresamp_crcf_create(q->rate, q->As);
+        break;
+    case TXRESAMP_FRONTEND:
+    case TXRESAMP_FRONTEND_HB:
+        if (rateplan_design_fixed(&q->plan, RATEPLAN_TX,
+                                  _props->converter_rate,
+                                  _props->hw_factor,
+                                  _props->baseband_rate,
+                                  q->strategy == TXRESAMP_FRONTEND_HB ? 1 : 0,
+                                  q->As) != 0)
+        {
+            free(q);
+            return NULL;
+        }
+        rateplan_set_usrp_rate(&q->plan, _props->usrp_rate);
+        q->fe = txfrontend_create(&q->plan, q->gain, SC16_ISA_AUTO);
+        break;
+    default:;
+    }
+
+    return q;
+}
+
+// destroy txresamp object
+void txresamp_destroy(txresamp _q)
+{
+    if (_q->resamp   != NULL) resamp_crcf_destroy(_q->resamp);
+    if (_q->msresamp != NULL) msresamp_crcf_destroy(_q->msresamp);
+    if (_q->fe       != NULL) txfrontend_destroy(_q->fe);
+
+    // free main object memory
+    free(_q);
+}
+
+// print txresamp object internals
+void txresamp_print(txresamp _q)
+{
+    printf("txresamp: %s, rate %f, gain %f, As %.1f dB\n",
+            txresamp_strategy_str(_q->strategy), _q->rate, _q->gain, _q->As);
+    if (_q->fe != NULL)
+        txfrontend_print(_q->fe);
+}
+
+// clear filter states
+void txresamp_reset(txresamp _q)
+{
+    if (_q->resamp   != NULL) resamp_crcf_reset(_q->resamp);
+    if (_q->msresamp != NULL) msresamp_crcf_reset(_q->msresamp);
+    if (_q->fe       != NULL) txfrontend_reset(_q->fe);
+}
+
+// get strategy
+int txresamp_get_strategy(txresamp _q)
+{
+    return _q->strategy;
+}
+
+// get maximum number of output samples for _n input samples
+unsigned int txresamp_max_output(txresamp _q,
+                                 unsigned int _n)
+{
+    if (_q->fe != NULL)
+        return txfrontend_max_output(_q->fe, _n);
+
+    // liquid resamplers may run a few samples ahead of the nominal rate
+    return (unsigned int) ceil((double)_n * _q->rate) + 2*(unsigned int)ceil(_q->rate) + 4;
+}
+
+// resample and scale block of baseband samples
+unsigned int txresamp_execute(txresamp _q,
+                              std::complex<float> * _x,
+                              unsigned int _n,
+                              std::complex<float> * _y)
+{
+    if (_q->fe != NULL)
+        return txfrontend_execute(_q->fe, _x, _n, _y);
+
+    unsigned int num_written = 0;
+    unsigned int i;
+    if (_q->resamp != NULL) {
+        unsigned int nw;
+        for (i=0; i<_n; i++) {
+            resamp_crcf_execute(_q->resamp, _x[i], &_y[num_written], &nw);
+            num_written += nw;
+        }
+    } else {
+        msresamp_crcf_execute(_q->msresamp, _x, _n, _y, &num_written);
+    }
+
+    // apply gain
+    for (i=0; i<num_written; i++)
+        _y[i] *= _q->gain;
+
+    return num_written;
+}
+
+// time every strategy on a multi-tone test signal and measure rejection
+int txresamp_calibrate(struct txresamp_props_s * _props,
+                       float _edge,
+                       unsigned int _block_len,
+                       float _mask,
+                       struct txresamp_result_s * _results)
+{
+    if (_block_len == 0) {
+        fprintf(stderr,"error: txresamp_calibrate(), block length must be greater than zero\n");
+        exit(1);
+    }
+
+    // test signal: equal tones spread across signal band, at baseband
+    double rate = _props->usrp_rate / _props->baseband_rate;
+    unsigned int n = (unsigned int)((TXRESAMP_NUM_SEGMENTS+2)*TXRESAMP_NFFT / rate) + _block_len;
+    std::complex<float> * x = (std::complex<float>*) malloc(n*sizeof(std::complex<float>));
+    float tones[TXRESAMP_NUM_TONES];
+    unsigned int i, k;
+    for (k=0; k<TXRESAMP_NUM_TONES; k++)
+        tones[k] = 0.9f * _edge * (2.0f*(float)k / (float)(TXRESAMP_NUM_TONES-1) - 1.0f);
+    for (i=0; i<n; i++) {
+        x[i] = 0.0f;
+        for (k=0; k<TXRESAMP_NUM_TONES; k++) {
+            float theta = 2.0f*M_PI*tones[k]/_props->baseband_rate*(float)i + (float)k;
+            x[i] += std::polar(1.0f/(float)TXRESAMP_NUM_TONES, theta);
+        }
+    }
+
+    timer t0 = timer_create();
+    int selected = -1;
+    int best = -1;
+    int s;
+    for (s=0; s<TXRESAMP_NUM_STRATEGIES; s++) {
+        struct txresamp_result_s * r = &_results[s];
+        txresamp q = txresamp_create(s, _props);
+        r->feasible      = q != NULL;
+        r->ns_per_sample = 0.0f;
+        r->load          = 0.0f;
+        r->rejection     = 0.0f;
+        r->mask_ok       = 0;
+        if (q == NULL)
+            continue;
+
+        // spectral mask (also warms up caches)
+        r->rejection = txresamp_measure_rejection(q, x, n, _block_len, tones, _props->usrp_rate);
+        r->mask_ok   = r->rejection >= _mask;
+
+        // time passes over test signal for at least the calibration time
+        std::complex<float> * y = (std::complex<float>*) malloc(txresamp_max_output(q,n)*sizeof(std::complex<float>));
+        unsigned long int num_output = 0;
+        float runtime;
+        timer_tic(t0);
+        do {
+            txresamp_reset(q);
+            num_output += txresamp_run(q, x, n, _block_len, y);
+            runtime = timer_toc(t0);
+        } while (runtime < TXRESAMP_CAL_TIME);
+        free(y);
+        txresamp_destroy(q);
+
+        r->ns_per_sample = 1e9f * runtime / (float)num_output;
+        r->load          = 1e-9f * r->ns_per_sample * (float)_props->usrp_rate;
+
+        // fastest meeting mask; otherwise best rejection
+        if (r->mask_ok && (selected < 0 || r->ns_per_sample < _results[selected].ns_per_sample))
+            selected = s;
+        if (best < 0 || r->rejection > _results[best].rejection)
+            best = s;
+    }
+    timer_destroy(t0);
+    free(x);
+
+    if (best < 0) {
+        fprintf(stderr,"error: txresamp_calibrate(), no strategy can realize rate %f\n", rate);
+        exit(1);
+    }
+    return selected >= 0 ? selected : best;
+}
+
+// print calibration results, marking selected strategy
+void txresamp_print_results(struct txresamp_result_s * _results,
+                            int _selected)
+{
+    printf("txresamp calibration:\n");
+    printf("      strategy        ns/sample      load   rejection\n");
+    int s;
+    for (s=0; s<TXRESAMP_NUM_STRATEGIES; s++) {
+        struct txresamp_result_s * r = &_results[s];
+        if (!r->feasible) {
+            printf("      %-12s  (infeasible)\n", txresamp_strategy_str(s));
+            continue;
+        }
+        printf("    %c %-12s  %10.2f  %7.2f%%  %7.1f dB%s\n",
+                s == _selected ? '*' : ' ',
+                txresamp_strategy_str(s),
+                r->ns_per_sample,
+                100.0f*r->load,
+                r->rejection,
+                r->mask_ok ? "" : " (fails mask)");
+    }
+}
+
+// get strategy string
+const char * txresamp_strategy_str(int _strategy)
+{
+    switch (_strategy) {
+    case TXRESAMP_RESAMP:       return "resamp";
+    case TXRESAMP_MSRESAMP:     return "msresamp";
+    case TXRESAMP_FRONTEND:     return "frontend";
+    case TXRESAMP_FRONTEND_HB:  return "frontend-hb";
+    case TXRESAMP_AUTO:         return "auto";
+    default:;
+    }
+    return "unknown";
+}
+
+// get strategy from string
+int txresamp_str2strategy(const char * _str)
+{
+    int s;
+    for (s=TXRESAMP_AUTO; s<TXRESAMP_NUM_STRATEGIES; s++) {
+        if (strcmp(_str, txresamp_strategy_str(s)) == 0)
+            return s;
+    }
+    return TXRESAMP_UNKNOWN;
+}
+
+// measure carrier to largest spur [dB] of strategy on test signal
+float txresamp_measure_rejection(txresamp _q,
+                                 std::complex<float> * _x,
+                                 unsigned int _n,
+                                 unsigned int _block_len,
+                                 float * _tones,
+                                 double _usrp_rate)
+{
+    std::complex<float> * y = (std::complex<float>*) malloc(txresamp_max_output(_q,_n)*sizeof(std::complex<float>));
+    txresamp_reset(_q);
+    unsigned int num_output = txresamp_run(_q, _x, _n, _block_len, y);
+
+    // averaged periodogram, skipping first segment (filter transients)
+    std::complex<float> x[TXRESAMP_NFFT];
+    std::complex<float> X[TXRESAMP_NFFT];
+    fftplan fft = fft_create_plan(TXRESAMP_NFFT, x, X, FFT_FORWARD, 0);
+    float psd[TXRESAMP_NFFT];
+    float w[TXRESAMP_NFFT];
+    unsigned int i, s;
+    for (i=0; i<TXRESAMP_NFFT; i++) {
+        float t = 2.0f*M_PI*(float)i / (float)(TXRESAMP_NFFT-1);
+        w[i] = 0.35875f - 0.48829f*cosf(t) + 0.14128f*cosf(2*t) - 0.01168f*cosf(3*t);
+        psd[i] = 0.0f;
+    }
+    for (s=1; (s+1)*TXRESAMP_NFFT <= num_output; s++) {
+        for (i=0; i<TXRESAMP_NFFT; i++)
+            x[i] = y[s*TXRESAMP_NFFT + i] * w[i];
+        fft_execute(fft);
+        for (i=0; i<TXRESAMP_NFFT; i++)
+            psd[i] += std::norm(X[i]);
+    }
+    fft_destroy_plan(fft);
+    free(y);
+
+    // mark bins around each tone
+    int tone[TXRESAMP_NFFT];
+    memset(tone, 0, sizeof(tone));
+    unsigned int k;
+    for (k=0; k<TXRESAMP_NUM_TONES; k++) {
+        int bin = (int)lrint(_tones[k] / _usrp_rate * TXRESAMP_NFFT);
+        int b;
+        for (b=bin-TXRESAMP_TONE_BINS; b<=bin+TXRESAMP_TONE_BINS; b++)
+            tone[(b + TXRESAMP_NFFT) % TXRESAMP_NFFT] = 1;
+    }
+
+    float carrier = 0.0f;
+    float spur = 0.0f;
+    for (i=0; i<TXRESAMP_NFFT; i++) {
+        if (tone[i]) carrier = psd[i] > carrier ? psd[i] : carrier;
+        else         spur    = psd[i] > spur    ? psd[i] : spur;
+    }
+    if (carrier <= 0.0f)
+        return 0.0f;
+    if (spur <= 0.0f)
+        return 200.0f;
+    return 10.0f*log10f(carrier / spur);
+}
+
+// run test signal through strategy in blocks
+unsigned int txresamp_run(txresamp _q,
+                          std::complex<float> * _x,
+                          unsigned int _n,
+                          unsigned int _block_len,
+                          std::complex<float> * _y)
+{
+    unsigned int num_written = 0;
+    unsigned int i;
+    for (i=0; i<_n; i+=_block_len) {
+        unsigned int n = (i + _block_len > _n) ? _n - i : _block_len;
+        num_written += txresamp_execute(_q, &_x[i], n, &_y[num_written]);
+    }
+    return num_written;
+}
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txsched
+//
+// Each burst is up-converted on its own: the front end is reset, the
+// burst is followed by enough zeros to flush its filters, and the whole
+// result is handed to the send callback in one piece, so that a burst's
+// waveform does not depend on the one before it.  Burst times are
+// rounded to the usrp sample grid relative to the slot epoch.
+//
+// A burst is checked against the clock only once it is ready to go,
+// i.e. after up-conversion: if its time has passed it is dropped as
+// missed, if it is less than the lead time ahead it is still sent but
+// counted late (the device may then report a late packet).  Bursts
+// further ahead than the horizon are held back, which bounds how far
+// the caller can run ahead of the air.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "txsched.h"
+#include "txfrontend.h"
+#include "sc16.h"
+
+// txsched data structure
+struct txsched_s {
+    // up-conversion
+    txfrontend fe;                      // interpolator, resampler and gain
+    double usrp_rate;                   // usrp sample rate
+    unsigned int max_len;               // maximum burst length [baseband samples]
+    unsigned int flush_len;             // zeros appended to each burst
+    std::complex<float> * zeros;        // flush samples [size: flush_len x 1]
+    std::complex<float> * buffer;       // usrp samples of one burst
+
+    // device
+    txsched_send send;                  // send callback
+    void * userdata;                    // send callback user data
+    txsched_clock clock;                // device clock (NULL for simulated)
+    void * clock_userdata;              // device clock user data
+
+    // slot grid and hand-off window
+    double epoch;                       // start of slot 0 [s]
+    double slot_len;                    // slot duration [s]
+    unsigned int num_slots;             // slots per TDMA frame
+    double guard;                       // guard time at end of slot [s]
+    double lead;                        // minimum hand-off lead time [s]
+    double horizon;                     // maximum hand-off lead time [s]
+    int have_last;                      // a slot has been sent
+    unsigned long int last_slot;        // last slot sent
+
+    // counters
+    unsigned long int num_results[TXSCHED_NUM_RESULTS];
+    unsigned long int num_samples;      // usrp samples sent
+    double margin_min;                  // minimum lead time at hand-off [s]
+    double margin_sum;                  // accumulated lead time at hand-off [s]
+    double grid_error;                  // maximum burst time rounding [s]
+};
+
+// up-convert burst and hand to device at _time, dropping it if it
+// would extend past _end (if _end > 0)
+int txsched_burst(txsched _q,
+                  double _time,
+                  double _end,
+                  const std::complex<float> * _x,
+                  unsigned int _n);
+
+// round device time to usrp sample grid, relative to epoch
+double txsched_round(txsched _q,
+                     double _time);
+
+// simulated device clock: host monotonic time [s]
+double txsched_simclock(void * _userdata);
+
+// create txsched object
+//  _plan       :   transmit rate plan (half-band chain)
+//  _gain       :   linear gain applied to output
+//  _max_len    :   maximum burst length [baseband samples]
+//  _send       :   send callback
+//  _userdata   :   user-defined data pointer passed to send callback
+txsched txsched_create(struct rateplan_s * _plan,
+                       float _gain,
+                       unsigned int _max_len,
+                       txsched_send _send,
+                       void * _userdata)
+{
+    // validate input
+    if (_max_len == 0) {
+        fprintf(stderr,"error: txsched_create(), maximum burst length must be greater than zero\n");
+        exit(1);
+    } else if (_send == NULL) {
+        fprintf(stderr,"error: txsched_create(), send callback cannot be NULL\n");
+        exit(1);
+    }
+
+    txsched q = (txsched) malloc(sizeof(struct txsched_s));
+    q->send     = _send;
+    q->userdata = _userdata;
+    q->clock          = NULL;
+    q->clock_userdata = NULL;
+
+    // front end; each filter spans at most twice its semi-length of
+    // its input samples, which are no slower than baseband
+    q->fe        = txfrontend_create(_plan, _gain, SC16_ISA_AUTO);
+    q->usrp_rate = _plan->usrp_rate;
+    q->max_len   = _max_len;
+    q->flush_len = 2*_plan->resamp_m + 1;
+    unsigned int i;
+    for (i=0; i<_plan->num_halfband; i++)
+        q->flush_len += 2*_plan->halfband_m[i];
+    q->zeros  = (std::complex<float>*) malloc(q->flush_len*sizeof(std::complex<float>));
+    for (i=0; i<q->flush_len; i++)
+        q->zeros[i] = 0.0f;
+    q->buffer = (std::complex<float>*) malloc((txfrontend_max_output(q->fe, q->max_len) +
+                                               txfrontend_max_output(q->fe, q->flush_len))*sizeof(std::complex<float>));
+
+    // default: back-to-back 10 ms slots from time zero
+    txsched_set_slots(q, 0.0, 10e-3, 1, 0.0);
+    txsched_set_lead(q, 2e-3, 0.0);
+    txsched_reset(q);
+
+    return q;
+}
+
+// destroy txsched object
+void txsched_destroy(txsched _q)
+{
+    txfrontend_destroy(_q->fe);
+    free(_q->zeros);
+    free(_q->buffer);
+
+    // free main object memory
+    free(_q);
+}
+
+// print slot configuration and burst counters
+void txsched_print(txsched _q)
+{
+    printf("txsched: %u slots x %.3f ms (guard %.3f ms), epoch %.6f s\n",
+            _q->num_slots, 1e3*_q->slot_len, 1e3*_q->guard, _q->epoch);
+    printf("    clock               : %s\n", _q->clock == NULL ? "simulated" : "device");
+    printf("    lead / horizon      : %.3f ms / %.3f ms\n", 1e3*_q->lead, 1e3*_q->horizon);
+    printf("    max. burst length   : %u (+%u flush) baseband samples\n", _q->max_len, _q->flush_len);
+    unsigned long int num_handed = _q->num_results[TXSCHED_SENT] + _q->num_results[TXSCHED_LATE];
+    int i;
+    for (i=0; i<TXSCHED_NUM_RESULTS; i++)
+        printf("    %-20s: %lu\n", txsched_result_str(i), _q->num_results[i]);
+    printf("    samples sent        : %lu\n", _q->num_samples);
+    printf("    lead time           : min %.3f ms, mean %.3f ms\n",
+            num_handed > 0 ? 1e3*_q->margin_min : 0.0,
+            num_handed > 0 ? 1e3*_q->margin_sum / (double)num_handed : 0.0);
+    printf("    max. grid error     : %.3f us\n", 1e6*_q->grid_error);
+}
+
+// clear counters and allow slot indices to start over
+void txsched_reset(txsched _q)
+{
+    unsigned int i;
+    for (i=0; i<TXSCHED_NUM_RESULTS; i++)
+        _q->num_results[i] = 0;
+    _q->num_samples = 0;
+    _q->margin_min  = 0.0;
+    _q->margin_sum  = 0.0;
+    _q->grid_error  = 0.0;
+    _q->have_last   = 0;
+    _q->last_slot   = 0;
+}
+
+// set device clock callback (NULL for simulated clock)
+void txsched_set_clock(txsched _q,
+                       txsched_clock _clock,
+                       void * _userdata)
+{
+    _q->clock          = _clock;
+    _q->clock_userdata = _userdata;
+}
+
+// set slot grid
+void txsched_set_slots(txsched _q,
+                       double _epoch,
+                       double _slot_len,
+                       unsigned int _num_slots,
+                       double _guard)
+{
+    if (_slot_len <= 0.0) {
+        fprintf(stderr,"error: txsched_set_slots(), slot length must be greater than zero\n");
+        exit(1);
+    } else if (_num_slots == 0) {
+        fprintf(stderr,"error: txsched_set_slots(), number of slots must be greater than zero\n");
+        exit(1);
+    } else if (_guard < 0.0 || _guard >= _slot_len) {
+        fprintf(stderr,"error: txsched_set_slots(), guard time must be in [0,slot length)\n");
+        exit(1);
+    }
+
+    _q->epoch     = _epoch;
+    _q->slot_len  = _slot_len;
+    _q->num_slots = _num_slots;
+    _q->guard     = _guard;
+}
+
+// set hand-off window
+void txsched_set_lead(txsched _q,
+                      double _lead,
+                      double _horizon)
+{
+    if (_lead < 0.0 || _horizon < 0.0) {
+        fprintf(stderr,"error: txsched_set_lead(), lead time and horizon must be non-negative\n");
+        exit(1);
+    } else if (_horizon > 0.0 && _horizon < _lead) {
+        fprintf(stderr,"error: txsched_set_lead(), horizon cannot be less than lead time\n");
+        exit(1);
+    }
+
+    _q->lead    = _lead;
+    _q->horizon = _horizon;
+}
+
+// get current device time [s]
+double txsched_get_time(txsched _q)
+{
+    if (_q->clock == NULL)
+        return txsched_simclock(NULL);
+    return _q->clock(_q->clock_userdata);
+}
+
+// get device time of start of slot [s], on the usrp sample grid
+double txsched_get_slot_time(txsched _q,
+                             unsigned long int _slot)
+{
+    return txsched_round(_q, _q->epoch + (double)_slot * _q->slot_len);
+}
+
+// get next slot index at position _slot within the TDMA frame
+unsigned long int txsched_next_slot(txsched _q,
+                                    unsigned int _slot)
+{
+    if (_slot >= _q->num_slots) {
+        fprintf(stderr,"error: txsched_next_slot(), slot %u exceeds slots per frame (%u)\n",
+                _slot, _q->num_slots);
+        exit(1);
+    }
+
+    // first slot starting at least the lead time from now
+    double x = ceil((txsched_get_time(_q) + _q->lead - _q->epoch) / _q->slot_len);
+    unsigned long int n = x > 0.0 ? (unsigned long int)x : 0;
+    if (_q->have_last && n <= _q->last_slot)
+        n = _q->last_slot + 1;
+
+    // advance to position within frame
+    n += (_slot + _q->num_slots - (n % _q->num_slots)) % _q->num_slots;
+    return n;
+}
+
+// up-convert and send burst at start of slot
+int txsched_send_slot(txsched _q,
+                      unsigned long int _slot,
+                      const std::complex<float> * _x,
+                      unsigned int _n)
+{
+    _q->have_last = 1;
+    _q->last_slot = _slot;
+
+    double time = _q->epoch + (double)_slot * _q->slot_len;
+    double end  = txsched_get_slot_time(_q, _slot+1) - _q->guard;
+    return txsched_burst(_q, time, end, _x, _n);
+}
+
+// up-convert and send burst at absolute device time
+int txsched_send_at(txsched _q,
+                    double _time,
+                    const std::complex<float> * _x,
+                    unsigned int _n)
+{
+    return txsched_burst(_q, _time, 0.0, _x, _n);
+}
+
+// get number of bursts with result
+unsigned long int txsched_get_num_results(txsched _q,
+                                          int _result)
+{
+    if (_result < 0 || _result >= TXSCHED_NUM_RESULTS) {
+        fprintf(stderr,"error: txsched_get_num_results(), invalid result\n");
+        exit(1);
+    }
+    return _q->num_results[_result];
+}
+
+// get result string
+const char * txsched_result_str(int _result)
+{
+    switch (_result) {
+    case TXSCHED_SENT:      return "sent";
+    case TXSCHED_LATE:      return "late";
+    case TXSCHED_MISSED:    return "missed";
+    case TXSCHED_OVERSIZE:  return "oversize";
+    default:;
+    }
+    return "unknown";
+}
+
+// up-convert burst and hand to device at _time, dropping it if it
+// would extend past _end (if _end > 0)
+int txsched_burst(txsched _q,
+                  double _time,
+                  double _end,
+                  const std::complex<float> * _x,
+                  unsigned int _n)
+{
+    if (_n > _q->max_len) {
+        fprintf(stderr,"error: txsched_burst(), burst length %u exceeds maximum (%u)\n", _n, _q->max_len);
+        exit(1);
+    }
+
+    // align to sample grid
+    double time = txsched_round(_q, _time);
+    double error = fabs(time - _time);
+    if (error > _q->grid_error)
+        _q->grid_error = error;
+
+    // up-convert burst and flush front end
+    txfrontend_reset(_q->fe);
+    unsigned int n = txfrontend_execute(_q->fe, _x, _n, _q->buffer);
+    n += txfrontend_execute(_q->fe, _q->zeros, _q->flush_len, &_q->buffer[n]);
+
+    if (_end > 0.0 && time + (double)n / _q->usrp_rate > _end) {
+        _q->num_results[TXSCHED_OVERSIZE]++;
+        return TXSCHED_OVERSIZE;
+    }
+
+    // hold back until within horizon
+    double now = txsched_get_time(_q);
+    if (_q->horizon > 0.0 && time - now > _q->horizon) {
+        usleep((useconds_t)(1e6*(time - now - _q->horizon)));
+        now = txsched_get_time(_q);
+    }
+
+    double margin = time - now;
+    if (margin <= 0.0) {
+        _q->num_results[TXSCHED_MISSED]++;
+        return TXSCHED_MISSED;
+    }
+
+    int result = margin < _q->lead ? TXSCHED_LATE : TXSCHED_SENT;
+    _q->num_samples += _q->send(_q->buffer, n, time, _q->userdata);
+
+    unsigned long int num_handed = _q->num_results[TXSCHED_SENT] + _q->num_results[TXSCHED_LATE];
+    if (num_handed == 0 || margin < _q->margin_min)
+        _q->margin_min = margin;
+    _q->margin_sum += margin;
+    _q->num_results[result]++;
+    return result;
+}
+
+// round device time to usrp sample grid, relative to epoch
+double txsched_round(txsched _q,
+                     double _time)
+{
+    return _q->epoch + floor((_time - _q->epoch) * _q->usrp_rate + 0.5) / _q->usrp_rate;
+}
+
+// simulated device clock: host monotonic time [s]
+double txsched_simclock(void * _userdata)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// flexframe_batch
+//
+// Offline, multi-core flexframe decoder for iqfile captures (see
+// iqcapture).  The capture is cut into segments which a pool of worker
+// threads decode independently, each segment with its own front end and
+// synchronizer.  Every segment starts decoding 'overlap' baseband
+// samples before its nominal start so that a frame straddling the
+// boundary is seen whole by the later segment; the overlap must
+// therefore be at least one maximum frame length.  Frames decoded by both
+// segments are removed by matching their sample offsets and headers, and
+// the remainder written to a single log ordered by sample offset:
+//
+//  <sample offset> <time [s]> <packet id> <header valid> <payload valid>
+//      <payload length> <evm [dB]> <rssi [dB]>
+//
+// The sample offset of a frame is the raw capture index at the end of
+// the front-end block in which the synchronizer completed it.
+//
+
+#include <iostream>
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <liquid/liquid.h>
+
+#include "iqfile.h"
+#include "profile.h"
+#include "rateplan.h"
+#include "rxfrontend.h"
+#include "timer.h"
+
+// baseband samples per synchronizer block
+#define BATCH_BLOCK_LEN         (1024)
+
+// raw samples read from the capture at a time
+#define BATCH_READ_LEN          (4096)
+
+// flexframe header length [bytes]
+#define BATCH_HEADER_LEN        (14)
+
+static bool verbose;
+
+// decoded frame
+struct frame_s {
+    unsigned long int offset;           // raw sample offset
+    unsigned char header[BATCH_HEADER_LEN];
+    int header_valid;
+    int payload_valid;
+    unsigned int payload_len;
+    float evm;
+    float rssi;
+};
+
+// capture segment
+struct segment_s {
+    unsigned long int start;            // first raw sample owned
+    unsigned long int end;              // one past last raw sample owned
+    unsigned long int read_start;       // first raw sample decoded (start - overlap)
+    std::vector<struct frame_s> frames; // frames found
+};
+
+// shared decoder state
+struct batch_s {
+    const char * filename;              // capture
+    struct rateplan_s plan;             // receive rate plan
+    float squelch_threshold;            // synchronizer squelch [dB]
+    struct segment_s * segments;        // segments
+    unsigned int num_segments;          // number of segments
+    unsigned int next_segment;          // next segment to hand out
+    pthread_mutex_t mutex;              // protects next_segment
+};
+
+// per-segment decoder context, passed to the front-end sink and the
+// synchronizer callback
+struct decoder_s {
+    flexframesync fs;                   // synchronizer
+    struct segment_s * segment;         // segment being decoded
+    unsigned long int raw_index;        // raw index at end of current block
+};
+
+static int callback(unsigned char * _rx_header,
+                    int _rx_header_valid,
+                    unsigned char * _rx_payload,
+                    unsigned int _rx_payload_len,
+                    int _rx_payload_valid,
+                    framesyncstats_s _stats,
+                    void * _userdata)
+{
+    struct decoder_s * d = (struct decoder_s*) _userdata;
+
+    struct frame_s f;
+    f.offset        = d->raw_index;
+    memmove(f.header, _rx_header, BATCH_HEADER_LEN);
+    f.header_valid  = _rx_header_valid;
+    f.payload_valid = _rx_payload_valid;
+    f.payload_len   = _rx_payload_len;
+    f.evm           = _stats.evm;
+    f.rssi          = _stats.rssi;
+    d->segment->frames.push_back(f);
+
+    return 0;
+}
+
+// push block of baseband samples through frame synchronizer
+static void rx_sink(std::complex<float> * _x,
+                    unsigned int _n,
+                    void * _userdata)
+{
+    struct decoder_s * d = (struct decoder_s*) _userdata;
+    PROFILE_BEGIN(PROFILE_SYNC);
+    flexframesync_execute(d->fs, _x, _n);
+    PROFILE_END(PROFILE_SYNC, _n);
+}
+
+// worker thread: decode segments until none are left
+void * worker_process(void * _userdata)
+{
+    struct batch_s * b = (struct batch_s*) _userdata;
+
+    // each worker maps the capture for itself
+    iqfile_reader r = iqfile_reader_open(b->filename);
+    bool sc16 = iqfile_reader_get_meta(r)->format == IQFILE_FORMAT_SC16;
+    std::vector<std::complex<float> > buff(BATCH_READ_LEN);
+    std::vector<short> buff_sc16(2*BATCH_READ_LEN);
+
+    framesyncprops_s props;
+    framesyncprops_init_default(&props);
+    props.squelch_threshold = b->squelch_threshold;
+    props.squelch_enabled = 1;
+
+    for (;;) {
+        pthread_mutex_lock(&b->mutex);
+        unsigned int k = b->next_segment++;
+        pthread_mutex_unlock(&b->mutex);
+        if (k >= b->num_segments)
+            break;
+
+        // fresh front end and synchronizer for every segment
+        struct segment_s * s = &b->segments[k];
+        struct decoder_s d;
+        d.segment   = s;
+        d.raw_index = s->read_start;
+        d.fs = flexframesync_create(&props, callback, (void*)&d);
+        rxfrontend fe = rxfrontend_create(&b->plan, BATCH_BLOCK_LEN, rx_sink, (void*)&d);
+
+        iqfile_reader_seek(r, s->read_start);
+        while (d.raw_index < s->end) {
+            unsigned long int num_remaining = s->end - d.raw_index;
+            unsigned int n = num_remaining < BATCH_READ_LEN ? (unsigned int)num_remaining : BATCH_READ_LEN;
+
+            PROFILE_BEGIN(PROFILE_RECV);
+            if (sc16)
+                n = iqfile_reader_recv_sc16(&buff_sc16.front(), n, (void*)r);
+            else
+                n = iqfile_reader_recv(&buff.front(), n, (void*)r);
+            PROFILE_END(PROFILE_RECV, n);
+
+            // frames completed anywhere in this read are tagged with the
+            // raw index at its end
+            d.raw_index += n;
+            if (sc16)
+                rxfrontend_execute_sc16(fe, &buff_sc16.front(), n);
+            else
+                rxfrontend_execute(fe, &buff.front(), n);
+            if (n == 0)
+                break;
+        }
+        rxfrontend_flush(fe);
+
+        if (verbose) {
+            printf("segment %4u [%12lu,%12lu) : %4u frame(s)\n",
+                    k, s->start, s->end, (unsigned int)s->frames.size());
+        }
+
+        rxfrontend_destroy(fe);
+        flexframesync_destroy(d.fs);
+    }
+
+    iqfile_reader_close(r);
+    return NULL;
+}
+
+// order frames by sample offset
+static bool frame_compare(const struct frame_s & _a,
+                          const struct frame_s & _b)
+{
+    return _a.offset < _b.offset;
+}
+
+// are two frames the same frame decoded by adjacent segments?
+static bool frame_duplicate(const struct frame_s & _a,
+                            const struct frame_s & _b,
+                            unsigned long int _tolerance)
+{
+    unsigned long int delta = _a.offset > _b.offset ? _a.offset - _b.offset : _b.offset - _a.offset;
+    if (delta > _tolerance || _a.header_valid != _b.header_valid)
+        return false;
+
+    // headers that failed their crc carry nothing worth comparing
+    return !_a.header_valid || memcmp(_a.header, _b.header, BATCH_HEADER_LEN) == 0;
+}
+
+void usage() {
+    printf("flexframe_batch:\n");
+    printf("  i     :   input iqfile capture (required)\n");
+    printf("  o     :   output frame log, default: frames.log\n");
+    printf("  b     :   bandwidth [Hz] the capture was recorded for\n");
+    printf("  W     :   number of worker threads, default: number of cpus\n");
+    printf("  N     :   number of segments, default: 4 x workers\n");
+    printf("  L     :   overlap (maximum frame length) [baseband samples], default: 16384\n");
+    printf("  S     :   squelch threshold [dB] (default: -37dB)\n");
+    printf("  q     :   quiet\n");
+    printf("  v     :   verbose\n");
+    printf("  u,h   :   usage/help\n");
+}
+
+int main (int argc, char **argv)
+{
+    // command-line options
+    verbose = false;
+    unsigned long int ADC_RATE = 64e6;
+
+    float min_bandwidth = 0.25f*(ADC_RATE / 256.0);
+    float max_bandwidth = 0.25f*(ADC_RATE /   4.0);
+
+    float bandwidth = min_bandwidth;
+    float squelch_threshold = -37.0f;
+    const char * filename_in = NULL;
+    const char * filename_out = "frames.log";
+    long int num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int num_workers = num_cpus > 0 ? (unsigned int)num_cpus : 1;
+    unsigned int num_segments = 0;
+    unsigned int overlap = 16384;
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"i:o:b:W:N:L:S:qvuh")) != EOF) {
+        switch (d) {
+        case 'i':   filename_in = optarg;           break;
+        case 'o':   filename_out = optarg;          break;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 'W':   num_workers = atoi(optarg);     break;
+        case 'N':   num_segments = atoi(optarg);    break;
+        case 'L':   overlap = atoi(optarg);         break;
+        case 'S':   squelch_threshold = atof(optarg);   break;
+        case 'q':   verbose = false;                break;
+        case 'v':   verbose = true;                 break;
+        case 'u':
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    if (filename_in == NULL) {
+        fprintf(stderr,"error: %s, no input capture given\n", argv[0]);
+        usage();
+        exit(1);
+    } else if (bandwidth > max_bandwidth) {
+        printf("error: maximum bandwidth exceeded (%8.4f MHz)\n", max_bandwidth*1e-6);
+        return 0;
+    } else if (bandwidth < min_bandwidth) {
+        printf("error: minimum bandwidth exceeded (%8.4f kHz)\n", min_bandwidth*1e-3);
+        return 0;
+    } else if (num_workers < 1) {
+        fprintf(stderr,"error: %s, must have at least one worker\n", argv[0]);
+        exit(1);
+    }
+    if (num_segments == 0)
+        num_segments = 4*num_workers;
+
+    // capture metadata
+    iqfile_reader r = iqfile_reader_open(filename_in);
+    iqfile_reader_print(r);
+    struct iqfile_meta_s meta = *iqfile_reader_get_meta(r);
+    iqfile_reader_close(r);
+
+    // same rate plan as the receiver, with the capture rate standing in
+    // for the usrp rate
+    struct batch_s b;
+    if (rateplan_design(&b.plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", bandwidth*1e-3f);
+        return 1;
+    }
+    if (meta.rate > 0.0)
+        rateplan_set_usrp_rate(&b.plan, meta.rate);
+    else
+        meta.rate = b.plan.usrp_rate;
+    rateplan_print(&b.plan);
+
+    // overlap and duplicate tolerance in raw samples; the same frame is
+    // completed within a front-end block or so by either segment
+    double raw_per_baseband = b.plan.usrp_rate / b.plan.baseband_rate;
+    unsigned long int overlap_raw = (unsigned long int)ceil(overlap * raw_per_baseband);
+    unsigned long int tolerance = (unsigned long int)ceil(2 * BATCH_BLOCK_LEN * raw_per_baseband) + BATCH_READ_LEN;
+
+    // split capture into segments
+    unsigned long int segment_len = (meta.num_samples + num_segments - 1) / num_segments;
+    if (segment_len < overlap_raw) {
+        // segments shorter than the overlap would only repeat each other
+        segment_len  = overlap_raw;
+        num_segments = (unsigned int)((meta.num_samples + segment_len - 1) / segment_len);
+        if (num_segments == 0)
+            num_segments = 1;
+    }
+    b.filename          = filename_in;
+    b.squelch_threshold = squelch_threshold;
+    b.segments          = new struct segment_s[num_segments];
+    b.num_segments      = num_segments;
+    b.next_segment      = 0;
+    pthread_mutex_init(&b.mutex, NULL);
+    unsigned int i;
+    for (i=0; i<num_segments; i++) {
+        struct segment_s * s = &b.segments[i];
+        s->start      = i*segment_len;
+        s->end        = std::min(s->start + segment_len, meta.num_samples);
+        s->read_start = s->start > overlap_raw ? s->start - overlap_raw : 0;
+    }
+
+    printf("segments    :   %u x %lu samples (overlap %lu)\n", num_segments, segment_len, overlap_raw);
+    printf("workers     :   %u\n", num_workers);
+
+    // decode
+    timer t0 = timer_create();
+    timer_tic(t0);
+
+    std::vector<pthread_t> workers(num_workers);
+    for (i=0; i<num_workers; i++) {
+        if (pthread_create(&workers[i], NULL, worker_process, (void*)&b) != 0) {
+            fprintf(stderr,"error: %s, could not create worker thread\n", argv[0]);
+            exit(1);
+        }
+    }
+    for (i=0; i<num_workers; i++)
+        pthread_join(workers[i], NULL);
+
+    float runtime = timer_toc(t0);
+
+    // merge segments and order by sample offset, then drop frames found
+    // twice in the overlaps; frames completed early in a segment's lead-in
+    // belong to the previous segment (and may have been picked up part way
+    // through), so only those near the segment start are kept for matching
+    std::vector<struct frame_s> found;
+    unsigned int num_found = 0;
+    for (i=0; i<num_segments; i++) {
+        struct segment_s * s = &b.segments[i];
+        unsigned int j;
+        for (j=0; j<s->frames.size(); j++) {
+            if (s->frames[j].offset + tolerance >= s->start)
+                found.push_back(s->frames[j]);
+        }
+        num_found += s->frames.size();
+    }
+    std::stable_sort(found.begin(), found.end(), frame_compare);
+
+    std::vector<struct frame_s> frames;
+    for (i=0; i<found.size(); i++) {
+        // compare against kept frames within tolerance
+        bool duplicate = false;
+        size_t n = frames.size();
+        while (n > 0 && frames[n-1].offset + tolerance >= found[i].offset) {
+            if (frame_duplicate(frames[n-1], found[i], tolerance)) {
+                duplicate = true;
+                break;
+            }
+            n--;
+        }
+        if (!duplicate)
+            frames.push_back(found[i]);
+    }
+
+    // write frame log
+    FILE * fid = fopen(filename_out, "w");
+    if (!fid) {
+        fprintf(stderr,"error: %s, could not open '%s' for writing\n", argv[0], filename_out);
+        exit(1);
+    }
+    fprintf(fid,"# %s : frames decoded from %s\n", filename_out, filename_in);
+    fprintf(fid,"# offset time id header payload length evm rssi\n");
+    unsigned int num_valid_headers_received = 0;
+    unsigned int num_valid_packets_received = 0;
+    unsigned long int num_bytes_received = 0;
+    for (i=0; i<frames.size(); i++) {
+        struct frame_s * f = &frames[i];
+        unsigned int packet_id = f->header_valid ? (f->header[0] << 8 | f->header[1]) : 0;
+        fprintf(fid,"%12lu %14.6f %6u %d %d %4u %8.3f %8.3f\n",
+                f->offset,
+                meta.time_start + f->offset / meta.rate,
+                packet_id,
+                f->header_valid,
+                f->payload_valid,
+                f->payload_len,
+                f->evm,
+                f->rssi);
+        num_valid_headers_received += f->header_valid ? 1 : 0;
+        num_valid_packets_received += f->payload_valid ? 1 : 0;
+        num_bytes_received += f->payload_valid ? f->payload_len : 0;
+    }
+    fclose(fid);
+
+    // print results
+    double duration = meta.num_samples / meta.rate;
+    printf("    frames found        : %6u\n", num_found);
+    printf("    overlap frames      : %6u (dropped)\n", num_found - (unsigned int)frames.size());
+    printf("    frames logged       : %6u\n", (unsigned int)frames.size());
+    printf("    valid headers       : %6u\n", num_valid_headers_received);
+    printf("    valid packets       : %6u\n", num_valid_packets_received);
+    printf("    bytes received      : %6lu\n", num_bytes_received);
+    printf("    capture duration    : %f s\n", duration);
+    printf("    run time            : %f s (%.2f x real time)\n", runtime, duration / runtime);
+    printf("    throughput          : %12.4f Msamples/s\n", meta.num_samples / runtime * 1e-6);
+    printf("frame log written to %s\n", filename_out);
+    PROFILE_PRINT();
+
+    // clean it up
+    timer_destroy(t0);
+    pthread_mutex_destroy(&b.mutex);
+    delete [] b.segments;
+
+    return 0;
+}
@@ -27,8 +27,21 @@
 #include <liquid/liquid.h>
 
 #include <uhd/usrp/single_usrp.hpp>
+
+#include "framelog.h"
+#include "iostats.h"
+#include "iqfile.h"
+#include "profile.h"
+#include "rxfrontend.h"
+#include "rxpipe.h"
+#include "timer.h"
  
 static bool verbose;
+static iostats stats;               // usrp i/o accounting
+static framelog flog = NULL;        // per-frame statistics log
+static rxfrontend frontend = NULL;  // front end (direct receiver)
+static rxpipe pipeline = NULL;      // pipelined receiver
+static unsigned long int num_lost_samples; // lost samples skipped
 static unsigned int num_packets_received;
 static unsigned int num_valid_headers_received;
 static unsigned int num_valid_packets_received;
@@ -44,6 +57,14 @@ static int callback(unsigned char * _rx_header,
                     framesyncstats_s _stats,
                     void * _userdata)
 {
+    // log frame, stamped with the time of the start of its block (raw
+    // position, so that gated and lost samples are counted)
+    if (flog != NULL) {
+        double t = pipeline != NULL ? rxpipe_get_time(pipeline) : rxfrontend_get_time(frontend);
+        framelog_push_frame(flog, t,
+                            _rx_header, _rx_header_valid, _rx_payload_len, _rx_payload_valid, &_stats);
+    }
+
     num_packets_received++;
     if (verbose) {
         printf("********* callback invoked, ");
@@ -75,6 +96,80 @@ static int callback(unsigned char * _rx_header,
     return 0;
 }
 
+// push block of baseband samples through frame synchronizer
+static void rx_sink(std::complex<float> * _x,
+                    unsigned int _n,
+                    void * _userdata)
+{
+    PROFILE_BEGIN(PROFILE_SYNC);
+    flexframesync_execute((flexframesync)_userdata, _x, _n);
+    PROFILE_END(PROFILE_SYNC, _n);
+}
+
+// advance front end past samples the usrp time stamps report lost
+static void rx_skip_lost(rxfrontend _fe)
+{
+    struct iostats_counters_s c;
+    iostats_get_counters(stats, &c);
+    rxfrontend_skip(_fe, c.num_lost_samples - num_lost_samples);
+    num_lost_samples = c.num_lost_samples;
+}
+
+// read one usrp packet into buffer in wire format _io_type, returning
+// number of samples
+static unsigned int usrp_recv_io(void * _x,
+                                 unsigned int _n,
+                                 void * _userdata,
+                                 const uhd::io_type_t & _io_type)
+{
+    uhd::usrp::single_usrp * usrp = (uhd::usrp::single_usrp*) _userdata;
+
+    uhd::rx_metadata_t md;
+    size_t num_rx_samps = usrp->get_device()->recv(
+        _x, _n, md,
+        _io_type,
+        uhd::device::RECV_MODE_ONE_PACKET
+    );
+
+    //handle the error codes
+    switch(md.error_code){
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        iostats_event(stats, IOSTATS_OVERFLOW);
+        break;
+
+    default:
+        std::cerr << "Error code: " << md.error_code << std::endl;
+        std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+        exit(1);
+    }
+
+    if (not md.has_time_spec){
+        std::cerr << "Metadata missing time spec, exit test..." << std::endl;
+        exit(1);
+    }
+    iostats_rx(stats, num_rx_samps, 1, md.time_spec.get_real_secs());
+
+    return num_rx_samps;
+}
+
+// read one usrp packet as complex float
+static unsigned int usrp_recv(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+// read one usrp packet as complex int16 (interleaved I/Q)
+static unsigned int usrp_recv_sc16(short * _x,
+                                   unsigned int _n,
+                                   void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_INT16);
+}
+
 void usage() {
     printf("flexframe_tx:\n");
     printf("  f     :   center frequency [Hz]\n");
@@ -82,6 +177,12 @@ void usage() {
     printf("  t     :   run time [seconds]\n");
     printf("  G     :   uhd rx gain [dB] (default: 20dB)\n");
     printf("  S     :   squelch threshold [dB] (default: -37dB)\n");
+    printf("  I     :   receive native complex int16 (sc16) samples\n");
+    printf("  P     :   pipelined receiver (capture/resample/sync threads)\n");
+    printf("  A     :   pipeline cpu affinity <capture,resamp,sync>, e.g. 0,1,2\n");
+    printf("  i     :   replay iqfile capture instead of usrp (see iqcapture)\n");
+    printf("  E     :   energy gate threshold over noise floor [dB] (default: off)\n");
+    printf("  L     :   append binary per-frame statistics to log (see framelog_summary)\n");
     printf("  q     :   quiet\n");
     printf("  v     :   verbose\n");
     printf("  u,h   :   usage/help\n");
@@ -102,9 +203,17 @@ int main (int argc, char **argv)
     double uhd_rxgain = 20.0;
     float squelch_threshold = -37.0f;
 
+    bool pipelined = false;             // pipelined receiver
+    int affinity[RXPIPE_NUM_STAGES] = {-1,-1,-1};  // stage cpu affinity
+
+    bool sc16 = false;                  // receive complex int16 samples
+    float gate_threshold = 0.0f;        // energy gate threshold [dB] (0: off)
+    const char * replay_filename = NULL;    // iqfile capture to replay
+    const char * framelog_filename = NULL;  // frame statistics log
+
     //
     int d;
-    while ((d = getopt(argc,argv,"f:b:t:G:S:qvuh")) != EOF) {
+    while ((d = getopt(argc,argv,"f:b:t:G:S:qvuhPA:Ii:L:E:")) != EOF) {
         switch (d) {
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
@@ -113,6 +222,17 @@ int main (int argc, char **argv)
         case 'S':   squelch_threshold = atof(optarg);   break;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
+        case 'I':   sc16 = true;                    break;
+        case 'P':   pipelined = true;               break;
+        case 'i':   replay_filename = optarg;       break;
+        case 'E':   gate_threshold = atof(optarg);  break;
+        case 'L':   framelog_filename = optarg;     break;
+        case 'A':
+            if (sscanf(optarg,"%d,%d,%d",&affinity[0],&affinity[1],&affinity[2]) != 3) {
+                fprintf(stderr,"error: %s, affinity must be <capture,resamp,sync>\n", argv[0]);
+                exit(1);
+            }
+            break;
         case 'u':
         case 'h':
         default:
@@ -133,56 +253,64 @@ int main (int argc, char **argv)
     printf("bandwidth   :   %12.8f [kHz]\n", bandwidth*1e-3f);
     printf("verbosity   :   %s\n", (verbose?"enabled":"disabled"));
 
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    // design rate plan: usrp decimation, half-band cascade and arbitrary
+    // resampler down to 2 samples per symbol at the synchronizer
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", bandwidth*1e-3f);
+        return 1;
+    }
 
-    stream_cmd.stream_now = true;
+    uhd::usrp::single_usrp::sptr usrp;
+    iqfile_reader replay = NULL;
+    size_t max_samps_per_packet = 4096;
+    if (replay_filename != NULL) {
+        // replay capture as fast as the receiver can take it; its rate
+        // stands in for the usrp rate
+        replay = iqfile_reader_open(replay_filename);
+        iqfile_reader_print(replay);
+        struct iqfile_meta_s * meta = iqfile_reader_get_meta(replay);
+        if (meta->rate > 0.0)
+            rateplan_set_usrp_rate(&plan, meta->rate);
+        num_seconds = (float)(meta->num_samples / plan.usrp_rate);
+        sc16 = meta->format == IQFILE_FORMAT_SC16;
+        if (pipelined) {
+            printf("warning: replay runs in a single thread, ignoring -P\n");
+            pipelined = false;
+        }
+    } else {
+        uhd::device_addr_t dev_addr;
+        usrp = uhd::usrp::single_usrp::make(dev_addr);
 
-    uhd::device_addr_t dev_addr;
-    uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
+        // NOTE : the sample rate computation MUST be in double precision so
+        //        that the UHD can compute its decimation rate properly
+        usrp->set_rx_rate(plan.usrp_rate);
 
-    // set properties
-    float rx_rate = 4.0f*bandwidth;
-#if 0
-    usrp->set_rx_rate(rx_rate);
-#else
-    // NOTE : the sample rate computation MUST be in double precision so
-    //        that the UHD can compute its decimation rate properly
-    unsigned int decim_rate = (unsigned int)(ADC_RATE / rx_rate);
-    // ensure multiple of 2
-    decim_rate = (decim_rate >> 1) << 1;
-    // compute usrp sampling rate
-    double usrp_rx_rate = ADC_RATE / decim_rate;
-    
-    // try to set rx rate
-    usrp->set_rx_rate(ADC_RATE / decim_rate);
-
-    // get actual rx rate
-    usrp_rx_rate = usrp->get_rx_rate();
-
-    // compute arbitrary resampling rate
-    double rx_resamp_rate = rx_rate / usrp_rx_rate;
-    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (decim %u)\n",
-            rx_rate * 1e-3f,
-            usrp_rx_rate * 1e-3f,
-            rx_resamp_rate,
-            decim_rate);
-#endif
-    usrp->set_rx_freq(frequency);
-    usrp->set_rx_gain(uhd_rxgain);
+        // correct arbitrary resampling rate for actual rx rate
+        rateplan_set_usrp_rate(&plan, usrp->get_rx_rate());
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(rx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, rx_resamp_rate);
+        usrp->set_rx_freq(frequency);
+        usrp->set_rx_gain(uhd_rxgain);
 
-    // half-band resampler
-    resamp2_crcf decim = resamp2_crcf_create(7,0.0f,40.0f);
+        max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    }
 
-    const size_t max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
-    unsigned int num_blocks = (unsigned int)((rx_rate*num_seconds)/(max_samps_per_packet));
+    // usrp i/o accounting
+    stats = iostats_create(plan.usrp_rate);
 
-    //allocate recv buffer and metatdata
-    uhd::rx_metadata_t md;
+    // frame statistics log
+    if (framelog_filename != NULL)
+        flog = framelog_create(framelog_filename, plan.baseband_rate, 4096);
+    unsigned int num_blocks = (unsigned int)((plan.usrp_rate*num_seconds)/(max_samps_per_packet));
+
+    // sample source: usrp or capture
+    rxpipe_recv      recv      = replay ? iqfile_reader_recv      : usrp_recv;
+    rxpipe_recv_sc16 recv_sc16 = replay ? iqfile_reader_recv_sc16 : usrp_recv_sc16;
+    void * recv_userdata       = replay ? (void*)replay           : (void*)usrp.get();
+
+    //allocate recv buffer
     std::vector<std::complex<float> > buff(max_samps_per_packet);
+    std::vector<short> buff_sc16(2*max_samps_per_packet);
 
     num_packets_received = 0;
     num_valid_packets_received = 0;
@@ -205,81 +333,82 @@ int main (int argc, char **argv)
 #endif
     flexframesync fs = flexframesync_create(&props,callback,NULL);
 
-    std::complex<float> data_rx[64];
-    std::complex<float> data_decim[32];
-    std::complex<float> data_resamp[64];
-
+    // receiver front end, feeding synchronizer in blocks of 1024 samples
+    rateplan_print(&plan);
+    rxfrontend fe = pipelined ? NULL : rxfrontend_create(&plan, 1024, rx_sink, (void*)fs);
+
+    // pipelined receiver: capture, front end and synchronizer threads
+    rxpipe pipe = NULL;
+    if (pipelined) {
+        int stage;
+        pipe = rxpipe_create(&plan, max_samps_per_packet, 1024, 64,
+                             usrp_recv, (void*)usrp.get(), rx_sink, (void*)fs);
+        for (stage=0; stage<RXPIPE_NUM_STAGES; stage++)
+            rxpipe_set_affinity(pipe, stage, affinity[stage]);
+        if (sc16)
+            rxpipe_set_recv_sc16(pipe, usrp_recv_sc16);
+        rxpipe_set_iostats(pipe, stats);
+    }
+    frontend = fe;
+    pipeline = pipe;
+
+    // energy gate, keeping 1024 baseband samples' worth of pre-trigger
+    // history
+    if (gate_threshold > 0.0f) {
+        rxfrontend_set_gate(pipelined ? rxpipe_get_frontend(pipe) : fe, gate_threshold,
+                            (unsigned int)(1024 * plan.usrp_rate / plan.baseband_rate));
+    }
 
     // start data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-    printf("usrp data transfer started\n");
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+        printf("usrp data transfer started\n");
+    }
  
     unsigned int i;
-    unsigned int n=0;
-    for (i=0; i<num_blocks; i++) {
-        // grab data from port
-        size_t num_rx_samps = usrp->get_device()->recv(
-            &buff.front(), buff.size(), md,
-            uhd::io_type_t::COMPLEX_FLOAT32,
-            uhd::device::RECV_MODE_ONE_PACKET
-        );
-
-        //handle the error codes
-        switch(md.error_code){
-        case uhd::rx_metadata_t::ERROR_CODE_NONE:
-        case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
-            break;
-
-        default:
-            std::cerr << "Error code: " << md.error_code << std::endl;
-            std::cerr << "Unexpected error on recv, exit test..." << std::endl;
-            return 1;
-        }
-
-        if (not md.has_time_spec){
-            std::cerr << "Metadata missing time spec, exit test..." << std::endl;
-            return 1;
-        }
-
-        // for now copy vector "buff" to array of complex float
-        // TODO : apply bandwidth-dependent gain
-        unsigned int j;
-        unsigned int nw=0;
-        for (j=0; j<num_rx_samps; j++) {
-            // push 64 samples into buffer
-            data_rx[n++] = buff[j];
-
-            if (n==64) {
-                // reset counter
-                n=0;
-
-                // deimate to 32
-                unsigned int k;
-                for (k=0; k<32; k++)
-                    resamp2_crcf_decim_execute(decim, &data_rx[2*k], &data_decim[k]);
-
-                // apply resampler
-                for (k=0; k<32; k++) {
-                    resamp_crcf_execute(resamp, data_decim[k], &data_resamp[n], &nw);
-                    n += nw;
-                }
-
-                // push through synchronizer
-                flexframesync_execute(fs, data_resamp, n);
-
-                // reset counter (again)
-                n = 0;
+    if (pipelined) {
+        // capture, resampler and synchronizer run in their own threads
+        rxpipe_start(pipe);
+        timer t0 = timer_create();
+        timer_tic(t0);
+        while (timer_toc(t0) < num_seconds)
+            usleep(100000);
+        timer_destroy(t0);
+        rxpipe_stop(pipe);
+    } else {
+        // read until run time elapses or the capture is exhausted
+        for (i=0; replay || i<num_blocks; i++) {
+            // grab data from port and push samples through front end; sc16
+            // conversion and scaling are fused with the first decimator
+            unsigned int num_rx_samps;
+            if (sc16) {
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv_sc16(&buff_sc16.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rx_skip_lost(fe);
+                rxfrontend_execute_sc16(fe, &buff_sc16.front(), num_rx_samps);
+            } else {
+                // TODO : apply bandwidth-dependent gain
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv(&buff.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rx_skip_lost(fe);
+                rxfrontend_execute(fe, &buff.front(), num_rx_samps);
             }
-
+            if (replay && num_rx_samps == 0)
+                break;
         }
-
+        if (replay)
+            rxfrontend_flush(fe);
     }
  
 
     // stop data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
-    printf("\n");
-    printf("usrp data transfer complete\n");
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+        printf("\n");
+        printf("usrp data transfer complete\n");
+    }
 
     // print results
     float data_rate = 8.0f * (float)(num_bytes_received) / num_seconds;
@@ -304,8 +433,24 @@ int main (int argc, char **argv)
 
     // clean it up
     flexframesync_destroy(fs);
-    resamp_crcf_destroy(resamp);
-    resamp2_crcf_destroy(decim);
+    if (pipelined) {
+        rxpipe_print(pipe);
+        rxpipe_destroy(pipe);
+    } else {
+        if (gate_threshold > 0.0f)
+            rxfrontend_print(fe);
+        rxfrontend_destroy(fe);
+    }
+    if (usrp)
+        iostats_print(stats);
+    iostats_destroy(stats);
+    PROFILE_PRINT();
+    if (flog != NULL) {
+        framelog_print(flog);
+        framelog_destroy(flog);
+    }
+    if (replay)
+        iqfile_reader_close(replay);
 
     return 0;
 }
@@ -29,6 +29,137 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
+#include "rateplan.h"
+#include "sc16.h"
+#include "txfrontend.h"
+#include "txloop.h"
+#include "txpipe.h"
+
+// per-worker frame generation state
+struct txworker_s {
+    flexframegen fg;                        // frame generator
+    interp_crcf mfinterp;                   // matched-filter interpolator
+    txfrontend fe;                          // resampler and gain
+    std::complex<float> * frame;            // frame [size: frame_len]
+    std::complex<float> * buffer_interp;    // interpolated [size: 4*frame_len]
+    unsigned char * payload;                // payload [size: payload_len]
+    unsigned int seed;                      // random data seed
+};
+
+// frame generation, shared by all workers
+struct txframe_s {
+    struct txworker_s * worker;     // per-worker state [size: num_workers]
+    unsigned int frame_len;         // frame length [symbols]
+    unsigned int payload_len;       // payload length [bytes]
+    unsigned int packet_spacing;    // silent blocks after each frame
+    bool verbose;                   // print packet ids
+};
+
+// usrp transmit state, used by sender thread
+struct txsend_s {
+    uhd::usrp::single_usrp * usrp;  // usrp
+    uhd::tx_metadata_t md;          // continuous (no burst flags)
+    iostats stats;                  // usrp i/o accounting
+};
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
+
+// txpipe generator: frame _seq with worker's frame generator, followed
+// by packet_spacing blocks of silence; frames ramp up from and down to
+// zero, so the filter state a worker carries from its previous frame is
+// negligible and frames from different workers join without transients
+static unsigned int flexframe_generate(unsigned int _worker,
+                                       unsigned long int _seq,
+                                       std::complex<float> * _y,
+                                       unsigned int _n,
+                                       void * _userdata)
+{
+    struct txframe_s * f = (struct txframe_s*) _userdata;
+    struct txworker_s * w = &f->worker[_worker];
+    unsigned int pid = _seq & 0xffff;
+    unsigned char header[14];
+    unsigned int i, j;
+
+    // generate random data
+    for (j=0; j<f->payload_len; j++)
+        w->payload[j] = rand_r(&w->seed) & 0xff;
+
+    // write header (first two bytes packet ID, remaining are random)
+    header[0] = (pid >> 8) & 0xff;
+    header[1] = (pid     ) & 0xff;
+    for (j=2; j<14; j++)
+        header[j] = rand_r(&w->seed) & 0xff;
+
+    if (f->verbose)
+        printf("packet id: %6u\n", pid);
+
+    // generate frame
+    flexframegen_execute(w->fg, header, w->payload, w->frame);
+
+    unsigned int n=0;
+    for (i=0; i<=f->packet_spacing; i++) {
+        if (i == 0) {
+            // interpolate using matched filter
+            for (j=0; j<f->frame_len; j++)
+                interp_crcf_execute(w->mfinterp, w->frame[j], &w->buffer_interp[4*j]);
+        } else {
+            // flush interpolator with zeros
+            for (j=0; j<f->frame_len; j++)
+                interp_crcf_execute(w->mfinterp, 0.0f, &w->buffer_interp[4*j]);
+        }
+
+        // run resampler, apply gain
+        n += txfrontend_execute(w->fe, w->buffer_interp, 4*f->frame_len, &_y[n]);
+    }
+
+    return n;
+}
+
+// txloop render callback: frame _k with first worker's state
+static unsigned int flexframe_render(unsigned int _k,
+                                     std::complex<float> * _y,
+                                     unsigned int _n,
+                                     void * _userdata)
+{
+    return flexframe_generate(0, _k, _y, _n, _userdata);
+}
+
+// txpipe/txloop send callback: stream samples to usrp
+static unsigned int usrp_send(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    struct txsend_s * s = (struct txsend_s*) _userdata;
+
+    size_t num_tx_samps = s->usrp->get_device()->send(
+        _x, _n, s->md,
+        uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::SEND_MODE_FULL_BUFF
+    );
+    iostats_tx(s->stats, num_tx_samps);
+    usrp_poll_async(s->usrp, s->stats);
+    return num_tx_samps;
+}
+
 void usage() {
     printf("flexframe_tx:\n");
     printf("  u,h   : usage/help\n");
@@ -46,6 +177,10 @@ void usage() {
     printf("  c     : fec coding scheme (inner)\n");
     printf("  k     : fec coding scheme (outer)\n");
     liquid_print_fec_schemes();
+    printf("  W     : number of frame generator threads <2>\n");
+    printf("  D     : look-ahead depth [frames] <8>\n");
+    printf("  K     : loop mode: render K frames once and repeat them <0, off>\n");
+    printf("  l     : loop mode: lock frames in memory\n");
 }
 
 int main (int argc, char **argv)
@@ -70,10 +205,14 @@ int main (int argc, char **argv)
     modulation_scheme ms= LIQUID_MODEM_QAM;     // modulation scheme
     unsigned int bps = 2;                       // modulation depth
     unsigned int ramp_len = 64;                 // phasing ramp up/down length
+    unsigned int num_workers = 2;               // frame generator threads
+    unsigned int depth = 8;                     // frames generated ahead of sender
+    unsigned int num_loop_frames = 0;           // loop mode frames (0: off)
+    bool loop_lock = false;                     // lock loop buffer in memory
 
     //
     int d;
-    while ((d = getopt(argc,argv,"f:b:g:G:t:n:s:r:m:c:k:qvuh")) != EOF) {
+    while ((d = getopt(argc,argv,"f:b:g:G:t:n:s:r:m:c:k:W:D:K:lqvuh")) != EOF) {
         switch (d) {
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
@@ -92,6 +231,10 @@ int main (int argc, char **argv)
             break;
         case 'c':   fec0 = liquid_getopt_str2fec(optarg);         break;
         case 'k':   fec1 = liquid_getopt_str2fec(optarg);         break;
+        case 'W':   num_workers = atoi(optarg);     break;
+        case 'D':   depth = atoi(optarg);           break;
+        case 'K':   num_loop_frames = atoi(optarg); break;
+        case 'l':   loop_lock = true;               break;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
         case 'u':
@@ -117,6 +260,9 @@ int main (int argc, char **argv)
     } else if (ms == LIQUID_MODEM_UNKNOWN) {
         fprintf(stderr,"error: unsupported modulation scheme\n");
         return 0;
+    } else if (num_workers == 0 || depth == 0) {
+        fprintf(stderr,"error: number of workers and look-ahead depth must be greater than zero\n");
+        return 1;
     }
 
     printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
@@ -129,6 +275,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     // set properties
     double tx_rate = 4.0*bandwidth;
 #if 0
@@ -163,9 +312,17 @@ int main (int argc, char **argv)
     // set the IF filter bandwidth
     //usrp->set_tx_bandwidth(2.0f*tx_rate);
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
+    // transmit front end: arbitrary resampler and gain, at the usrp
+    // rate actually set
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, tx_rate, 0, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no transmit front end for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
+
+    // transmitter gain (linear)
+    float g = powf(10.0f, txgain_dB/20.0f);
 
     // create flexframegen object
     flexframegenprops_s fgprops;
@@ -180,104 +337,77 @@ int main (int argc, char **argv)
     fgprops.mod_bps     = bps;
     fgprops.rampdn_len  = ramp_len;
 
-    flexframegen fg = flexframegen_create(&fgprops);
-    flexframegen_print(fg);
-
-    // set up the metadta flags
-    uhd::tx_metadata_t md;
-    md.start_of_burst = false;  // never SOB when continuous
-    md.end_of_burst   = false;  // 
-    md.has_time_spec  = false;  // set to false to send immediately
-
-    // framing buffers
-    unsigned int frame_len = flexframegen_getframelen(fg);
-    std::complex<float> frame[frame_len];
-#if 0
-    std::complex<float> buffer_interp[64];  // matched-filter interpolator (interp by 4)
-    std::complex<float> buffer_resamp[128]; // resampler
-#else
-    std::complex<float> buffer_interp[4*frame_len];  // matched-filter interpolator (interp by 4)
-    std::complex<float> buffer_resamp[6*frame_len]; // resampler
-    std::vector<std::complex<float> > buff(6*frame_len);
-#endif
-
-    printf("frame length        :   %u\n", frame_len);
-
-    unsigned int num_blocks = (unsigned int)((4.0f*bandwidth*num_seconds)/(4*frame_len));
-
-    // create pulse-shaping interpolator
+    // pulse-shaping interpolator
     unsigned int k=4;
     unsigned int m=3;
     float beta=0.7f;
-    interp_crcf mfinterp = interp_crcf_create_rnyquist(LIQUID_RNYQUIST_RRC,k,m,beta,0);
-
-    // data buffers
-    unsigned char header[14];
-    unsigned char payload[payload_len];
-
-    // transmitter gain (linear)
-    float g = powf(10.0f, txgain_dB/20.0f);
- 
-    unsigned int i, j, pid=0;
-    // start transmitter
-    for (i=0; i<num_blocks; i++) {
-        // generate the frame / transmit silence
-        if ((i%(packet_spacing+1))==0) {
-
-            // generate random data
-            for (j=0; j<payload_len; j++)
-                payload[j] = rand() & 0xff;
-
-            // write header (first two bytes packet ID, remaining are random)
-            header[0] = (pid >> 8) & 0xff;
-            header[1] = (pid     ) & 0xff;
-            for (j=2; j<14; j++)
-                header[j] = rand() & 0xff;
-
-            if (verbose)
-                printf("packet id: %6u\n", pid);
-            
-            // increment packet id (modulo 2^16)
-            pid = (pid+1) & 0xffff;
-
-            // generate frame
-            flexframegen_execute(fg, header, payload, frame);
 
-            // interpolate using matched filter
-            for (j=0; j<frame_len; j++)
-                interp_crcf_execute(mfinterp, g*frame[j], &buffer_interp[4*j]);
-            
-        } else {
-            // flush interpolator with zeros
-            for (j=0; j<frame_len; j++)
-                interp_crcf_execute(mfinterp, 0.0f, &buffer_interp[4*j]);
-        }
+    // each worker has its own frame generator, interpolator and front end
+    unsigned int i;
+    struct txframe_s txframe;
+    txframe.worker         = (struct txworker_s*) malloc(num_workers*sizeof(struct txworker_s));
+    txframe.payload_len    = payload_len;
+    txframe.packet_spacing = packet_spacing;
+    txframe.verbose        = verbose;
+    for (i=0; i<num_workers; i++) {
+        struct txworker_s * w = &txframe.worker[i];
+        w->fg       = flexframegen_create(&fgprops);
+        w->mfinterp = interp_crcf_create_rnyquist(LIQUID_RNYQUIST_RRC,k,m,beta,0);
+        w->fe       = txfrontend_create(&plan, g, SC16_ISA_AUTO);
+        w->seed     = i + 1;
+    }
+    flexframegen_print(txframe.worker[0].fg);
+    txfrontend_print(txframe.worker[0].fe);
 
-        // run resampler
-        unsigned int n=0;
-        unsigned int nw;
-        for (j=0; j<4*frame_len; j++) {
-            resamp_crcf_execute(resamp, buffer_interp[j], &buffer_resamp[n], &nw);
-            n += nw;
-        }
+    // framing buffers
+    unsigned int frame_len = flexframegen_getframelen(txframe.worker[0].fg);
+    txframe.frame_len = frame_len;
+    for (i=0; i<num_workers; i++) {
+        struct txworker_s * w = &txframe.worker[i];
+        w->frame         = (std::complex<float>*) malloc(frame_len*sizeof(std::complex<float>));
+        w->buffer_interp = (std::complex<float>*) malloc(4*frame_len*sizeof(std::complex<float>));
+        w->payload       = (unsigned char*) malloc(payload_len*sizeof(unsigned char));
+    }
 
-        //printf(" n = %6u (frame_len : %6u)\n", n, frame_len);
-        buff.resize(n);
-        for (j=0; j<n; j++) {
-            buff[j] = buffer_resamp[j];
-        }
+    printf("frame length        :   %u\n", frame_len);
 
-        //send the entire contents of the buffer
-        usrp->get_device()->send(
-            &buff.front(), buff.size(), md,
-            uhd::io_type_t::COMPLEX_FLOAT32,
-            uhd::device::SEND_MODE_FULL_BUFF
-        );
+    // one block per frame, packet_spacing silent blocks between frames
+    unsigned int num_blocks = (unsigned int)((4.0f*bandwidth*num_seconds)/(4*frame_len));
+    unsigned int num_frames = (num_blocks + packet_spacing) / (packet_spacing+1);
+    if (num_frames == 0)
+        num_frames = 1;
 
- 
+    // set up the metadta flags
+    struct txsend_s txsend;
+    txsend.usrp  = usrp.get();
+    txsend.stats = stats;
+    txsend.md.start_of_burst = false;  // never SOB when continuous
+    txsend.md.end_of_burst   = false;  // 
+    txsend.md.has_time_spec  = false;  // set to false to send immediately
+
+    unsigned int max_frame_len = (packet_spacing+1)*txfrontend_max_output(txframe.worker[0].fe, 4*frame_len);
+    if (num_loop_frames > 0) {
+        // start transmitter: render frames once, then stream them
+        // repeatedly
+        txloop loop = txloop_create(num_loop_frames, max_frame_len, loop_lock);
+        txloop_render(loop, flexframe_render, (void*)&txframe);
+        txloop_run(loop, (unsigned long int)(usrp_tx_rate*num_seconds), usrp_send, (void*)&txsend);
+        txloop_print(loop);
+        txloop_destroy(loop);
+    } else {
+        // start transmitter: generate frames ahead of time in worker
+        // threads, sending them in order from a single sender thread
+        txpipe pipe = txpipe_create(num_workers, depth, max_frame_len,
+                                    flexframe_generate, (void*)&txframe,
+                                    usrp_send, (void*)&txsend);
+        txpipe_start(pipe, num_frames);
+        txpipe_wait(pipe);
+        txpipe_print(pipe);
+        txpipe_destroy(pipe);
     }
  
     // send a mini EOB packet
+    uhd::tx_metadata_t md;
     md.start_of_burst = false;
     md.end_of_burst   = true;
     usrp->get_device()->send("", 0, md,
@@ -287,12 +417,21 @@ int main (int argc, char **argv)
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
 
  
     // clean it up
-    flexframegen_destroy(fg);
-    interp_crcf_destroy(mfinterp);
-    resamp_crcf_destroy(resamp);
+    for (i=0; i<num_workers; i++) {
+        flexframegen_destroy(txframe.worker[i].fg);
+        interp_crcf_destroy(txframe.worker[i].mfinterp);
+        txfrontend_destroy(txframe.worker[i].fe);
+        free(txframe.worker[i].frame);
+        free(txframe.worker[i].buffer_interp);
+        free(txframe.worker[i].payload);
+    }
+    free(txframe.worker);
+    iostats_destroy(stats);
     return 0;
 }
 
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// framelog_summary
+//
+// Summarise a binary frame log (see flexframe_rx -L, ofdmflexframe_rx
+// -L) over fixed time windows.  Packets never detected are inferred from
+// gaps in the packet ids of consecutive valid headers, less the frames
+// detected in between whose header failed (their ids are unknown, but
+// they already count as frames), so that the packet error rate counts
+// them along with frames that failed their payload check:
+//
+//  PER = (missed + frames - valid payloads) / (missed + frames)
+//
+// SNR is estimated as the negative of the mean EVM [dB].  Windows with
+// no frames are printed as empty rows.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "framelog.h"
+
+// packet id gaps at least this large are taken as a transmitter restart
+// rather than lost packets
+#define SUMMARY_MAX_GAP     (1024)
+
+// window accumulator
+struct window_s {
+    unsigned long int num_frames;           // frames detected
+    unsigned long int num_valid_headers;    // valid headers
+    unsigned long int num_valid_payloads;   // valid payloads
+    unsigned long int num_missed;           // packets inferred missing
+    double evm_sum;                         // sum of evm [dB]
+    double rssi_sum;                        // sum of rssi [dB]
+    double cfo_sum;                         // sum of cfo [Hz]
+};
+
+void usage() {
+    printf("Usage: framelog_summary [OPTION]\n");
+    printf("Summarise PER and SNR of a binary frame log over time windows\n");
+    printf("\n");
+    printf("  i     : input frame log\n");
+    printf("  w     : window length [s], default: 1\n");
+    printf("  u,h   : usage/help\n");
+}
+
+// print window row (or totals)
+void window_print(const char * _label,
+                  struct window_s * _w)
+{
+    unsigned long int num_expected = _w->num_frames + _w->num_missed;
+    float PER = num_expected > 0 ?
+        (float)(num_expected - _w->num_valid_payloads) / (float)num_expected : 0.0f;
+    double n = _w->num_frames > 0 ? (double)_w->num_frames : 1.0;
+    double SNR = _w->num_frames > 0 ? -_w->evm_sum / n : 0.0;
+    printf("%10s %8lu %8lu %8lu %8lu %8.4f %8.2f %8.2f %10.1f\n",
+            _label,
+            _w->num_frames,
+            _w->num_valid_headers,
+            _w->num_valid_payloads,
+            _w->num_missed,
+            PER,
+            SNR,
+            _w->rssi_sum / n,
+            _w->cfo_sum / n);
+}
+
+// add window _w to totals _t
+void window_accumulate(struct window_s * _t,
+                       struct window_s * _w)
+{
+    _t->num_frames         += _w->num_frames;
+    _t->num_valid_headers  += _w->num_valid_headers;
+    _t->num_valid_payloads += _w->num_valid_payloads;
+    _t->num_missed         += _w->num_missed;
+    _t->evm_sum            += _w->evm_sum;
+    _t->rssi_sum           += _w->rssi_sum;
+    _t->cfo_sum            += _w->cfo_sum;
+}
+
+int main (int argc, char **argv)
+{
+    char filename[256] = "";
+    double window = 1.0;
+
+    int d;
+    while ((d = getopt(argc,argv,"i:w:uh")) != EOF) {
+        switch (d) {
+        case 'i':   strncpy(filename,optarg,255);   break;
+        case 'w':   window = atof(optarg);          break;
+        case 'u':
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    if (strlen(filename) == 0) {
+        fprintf(stderr,"error: %s, input frame log required\n", argv[0]);
+        usage();
+        return 1;
+    } else if (window <= 0.0) {
+        fprintf(stderr,"error: %s, window length must be greater than zero\n", argv[0]);
+        return 1;
+    }
+
+    framelog_reader r = framelog_reader_open(filename);
+    double rate = framelog_reader_get_rate(r);
+    printf("frame log   :   %s\n", filename);
+    printf("rate        :   %12.4f [kHz]\n", rate*1e-3);
+    printf("window      :   %12.4f [s]\n", window);
+    printf("\n");
+    printf("%10s %8s %8s %8s %8s %8s %8s %8s %10s\n",
+            "t [s]", "frames", "headers", "payloads", "missed", "PER", "SNR [dB]", "rssi", "cfo [Hz]");
+
+    struct window_s total;
+    struct window_s w;
+    memset(&total, 0, sizeof(total));
+    memset(&w, 0, sizeof(w));
+
+    struct framelog_record_s rec;
+    long int k = -1;            // current window index
+    int have_id = 0;            // last_id valid?
+    unsigned int last_id = 0;   // packet id of last valid header
+    unsigned int num_invalid = 0;   // header failures since last valid header
+    char label[32];
+    while (framelog_reader_read(r, &rec)) {
+        long int j = (long int) floor(rec.timestamp / window);
+        if (j != k) {
+            if (k >= 0) {
+                snprintf(label, sizeof(label), "%.3f", k*window);
+                window_print(label, &w);
+                window_accumulate(&total, &w);
+            }
+            memset(&w, 0, sizeof(w));
+
+            // empty windows (no frames detected)
+            for (k = k >= 0 ? k+1 : j; k < j; k++) {
+                snprintf(label, sizeof(label), "%.3f", k*window);
+                window_print(label, &w);
+            }
+            k = j;
+        }
+
+        w.num_frames++;
+        w.evm_sum  += rec.evm;
+        w.rssi_sum += rec.rssi;
+        w.cfo_sum  += rec.cfo / (2*M_PI) * rate;
+
+        if (rec.flags & FRAMELOG_HEADER_VALID) {
+            w.num_valid_headers++;
+
+            // packets missing since the last valid header, not counting
+            // frames detected with an invalid header
+            unsigned int gap = (rec.packet_id - last_id - 1) & 0xffff;
+            if (have_id && gap < SUMMARY_MAX_GAP && gap > num_invalid)
+                w.num_missed += gap - num_invalid;
+            last_id = rec.packet_id;
+            have_id = 1;
+            num_invalid = 0;
+        } else {
+            num_invalid++;
+        }
+        if (rec.flags & FRAMELOG_PAYLOAD_VALID)
+            w.num_valid_payloads++;
+    }
+    if (k >= 0) {
+        snprintf(label, sizeof(label), "%.3f", k*window);
+        window_print(label, &w);
+        window_accumulate(&total, &w);
+    }
+
+    printf("\n");
+    window_print("total", &total);
+
+    framelog_reader_close(r);
+    return 0;
+}
@@ -26,10 +26,17 @@
 #include <liquid/liquid.h>
 
 #include <uhd/usrp/single_usrp.hpp>
+
+#include "iostats.h"
+#include "iqfile.h"
+#include "profile.h"
+#include "rxfrontend.h"
+#include "rxpipe.h"
  
 #include "timer.h"
 
 static bool verbose;
+static iostats stats;               // usrp i/o accounting
 static unsigned int num_packets_received;
 static unsigned int num_valid_headers_received;
 static unsigned int num_valid_packets_received;
@@ -76,6 +83,71 @@ static int callback(unsigned char *  _header,
     return 0;
 }
 
+// push block of baseband samples through frame synchronizer
+static void rx_sink(std::complex<float> * _x,
+                    unsigned int _n,
+                    void * _userdata)
+{
+    PROFILE_BEGIN(PROFILE_SYNC);
+    gmskframesync_execute((gmskframesync)_userdata, _x, _n);
+    PROFILE_END(PROFILE_SYNC, _n);
+}
+
+// read one usrp packet into buffer in wire format _io_type, returning
+// number of samples
+static unsigned int usrp_recv_io(void * _x,
+                                 unsigned int _n,
+                                 void * _userdata,
+                                 const uhd::io_type_t & _io_type)
+{
+    uhd::usrp::single_usrp * usrp = (uhd::usrp::single_usrp*) _userdata;
+
+    uhd::rx_metadata_t md;
+    size_t num_rx_samps = usrp->get_device()->recv(
+        _x, _n, md,
+        _io_type,
+        uhd::device::RECV_MODE_ONE_PACKET
+    );
+
+    //handle the error codes
+    switch(md.error_code){
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        iostats_event(stats, IOSTATS_OVERFLOW);
+        break;
+
+    default:
+        std::cerr << "Error code: " << md.error_code << std::endl;
+        std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+        exit(1);
+    }
+
+    if (not md.has_time_spec){
+        std::cerr << "Metadata missing time spec, exit test..." << std::endl;
+        exit(1);
+    }
+    iostats_rx(stats, num_rx_samps, 1, md.time_spec.get_real_secs());
+
+    return num_rx_samps;
+}
+
+// read one usrp packet as complex float
+static unsigned int usrp_recv(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+// read one usrp packet as complex int16 (interleaved I/Q)
+static unsigned int usrp_recv_sc16(short * _x,
+                                   unsigned int _n,
+                                   void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_INT16);
+}
+
 void usage() {
     printf("gmskframe_tx:\n");
     printf("  f     :   center frequency [Hz]\n");
@@ -83,6 +155,11 @@ void usage() {
     printf("  t     :   run time [seconds]\n");
     printf("  G     :   uhd rx gain [dB] (default: 20dB)\n");
     printf("  S     :   squelch threshold [dB] (default: -37dB)\n");
+    printf("  I     :   receive native complex int16 (sc16) samples\n");
+    printf("  P     :   pipelined receiver (capture/resample/sync threads)\n");
+    printf("  A     :   pipeline cpu affinity <capture,resamp,sync>, e.g. 0,1,2\n");
+    printf("  i     :   replay iqfile capture instead of usrp (see iqcapture)\n");
+    printf("  E     :   energy gate threshold over noise floor [dB] (default: off)\n");
     printf("  q     :   quiet\n");
     printf("  v     :   verbose\n");
     printf("  u,h   :   usage/help\n");
@@ -103,9 +180,16 @@ int main (int argc, char **argv)
     double uhd_rxgain = 20.0;
     float squelch_threshold = -37.0f;
 
+    bool pipelined = false;             // pipelined receiver
+    int affinity[RXPIPE_NUM_STAGES] = {-1,-1,-1};  // stage cpu affinity
+
+    bool sc16 = false;                  // receive complex int16 samples
+    float gate_threshold = 0.0f;        // energy gate threshold [dB] (0: off)
+    const char * replay_filename = NULL;    // iqfile capture to replay
+
     //
     int d;
-    while ((d = getopt(argc,argv,"f:b:t:G:S:qvuh")) != EOF) {
+    while ((d = getopt(argc,argv,"f:b:t:G:S:qvuhPA:Ii:E:")) != EOF) {
         switch (d) {
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
@@ -114,6 +198,16 @@ int main (int argc, char **argv)
         case 'S':   squelch_threshold = atof(optarg);   break;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
+        case 'I':   sc16 = true;                    break;
+        case 'P':   pipelined = true;               break;
+        case 'i':   replay_filename = optarg;       break;
+        case 'E':   gate_threshold = atof(optarg);  break;
+        case 'A':
+            if (sscanf(optarg,"%d,%d,%d",&affinity[0],&affinity[1],&affinity[2]) != 3) {
+                fprintf(stderr,"error: %s, affinity must be <capture,resamp,sync>\n", argv[0]);
+                exit(1);
+            }
+            break;
         case 'u':
         case 'h':
         default:
@@ -134,55 +228,60 @@ int main (int argc, char **argv)
     printf("bandwidth   :   %12.8f [kHz]\n", bandwidth*1e-3f);
     printf("verbosity   :   %s\n", (verbose?"enabled":"disabled"));
 
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-
-    stream_cmd.stream_now = true;
-
-    uhd::device_addr_t dev_addr;
-    uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
-
-    // set properties
-    float rx_rate = 4.0f*bandwidth;
-#if 0
-    usrp->set_rx_rate(rx_rate);
-#else
-    // NOTE : the sample rate computation MUST be in double precision so
-    //        that the UHD can compute its decimation rate properly
-    unsigned int decim_rate = (unsigned int)(ADC_RATE / rx_rate);
-    // ensure multiple of 2
-    decim_rate = (decim_rate >> 1) << 1;
-    // compute usrp sampling rate
-    double usrp_rx_rate = ADC_RATE / decim_rate;
-    
-    // try to set rx rate
-    usrp->set_rx_rate(ADC_RATE / decim_rate);
-
-    // get actual rx rate
-    usrp_rx_rate = usrp->get_rx_rate();
-
-    // compute arbitrary resampling rate
-    double rx_resamp_rate = rx_rate / usrp_rx_rate;
-    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (decim %u)\n",
-            rx_rate * 1e-3f,
-            usrp_rx_rate * 1e-3f,
-            rx_resamp_rate,
-            decim_rate);
-#endif
-    usrp->set_rx_freq(frequency);
-    usrp->set_rx_gain(uhd_rxgain);
-
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(rx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, rx_resamp_rate);
-
-    // half-band resampler
-    resamp2_crcf decim = resamp2_crcf_create(7,0.0f,40.0f);
-
-    const size_t max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
-
-    //allocate recv buffer and metatdata
-    uhd::rx_metadata_t md;
+    // design rate plan: usrp decimation, half-band cascade and arbitrary
+    // resampler down to 2 samples per symbol at the synchronizer
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", bandwidth*1e-3f);
+        return 1;
+    }
+
+    uhd::usrp::single_usrp::sptr usrp;
+    iqfile_reader replay = NULL;
+    size_t max_samps_per_packet = 4096;
+    if (replay_filename != NULL) {
+        // replay capture as fast as the receiver can take it; its rate
+        // stands in for the usrp rate
+        replay = iqfile_reader_open(replay_filename);
+        iqfile_reader_print(replay);
+        struct iqfile_meta_s * meta = iqfile_reader_get_meta(replay);
+        if (meta->rate > 0.0)
+            rateplan_set_usrp_rate(&plan, meta->rate);
+        num_seconds = (float)(meta->num_samples / plan.usrp_rate);
+        sc16 = meta->format == IQFILE_FORMAT_SC16;
+        if (pipelined) {
+            printf("warning: replay runs in a single thread, ignoring -P\n");
+            pipelined = false;
+        }
+    } else {
+        uhd::device_addr_t dev_addr;
+        usrp = uhd::usrp::single_usrp::make(dev_addr);
+
+        // NOTE : the sample rate computation MUST be in double precision so
+        //        that the UHD can compute its decimation rate properly
+        usrp->set_rx_rate(plan.usrp_rate);
+
+        // correct arbitrary resampling rate for actual rx rate
+        rateplan_set_usrp_rate(&plan, usrp->get_rx_rate());
+
+        usrp->set_rx_freq(frequency);
+        usrp->set_rx_gain(uhd_rxgain);
+
+        max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    }
+
+    // usrp i/o accounting
+    stats = iostats_create(plan.usrp_rate);
+
+    // sample source: usrp or capture
+    rxpipe_recv      recv      = replay ? iqfile_reader_recv      : usrp_recv;
+    rxpipe_recv_sc16 recv_sc16 = replay ? iqfile_reader_recv_sc16 : usrp_recv_sc16;
+    void * recv_userdata       = replay ? (void*)replay           : (void*)usrp.get();
+
+
+    //allocate recv buffer
     std::vector<std::complex<float> > buff(max_samps_per_packet);
+    std::vector<short> buff_sc16(2*max_samps_per_packet);
 
     num_packets_received = 0;
     num_valid_packets_received = 0;
@@ -196,92 +295,92 @@ int main (int argc, char **argv)
     float BT = 0.5f;
     gmskframesync fs = gmskframesync_create(k,m,BT,callback,NULL);
 
-    std::complex<float> data_rx[64];
-    std::complex<float> data_decim[32];
-    std::complex<float> data_resamp[64];
+    // receiver front end, feeding synchronizer in blocks of 1024 samples
+    rateplan_print(&plan);
+    rxfrontend fe = pipelined ? NULL : rxfrontend_create(&plan, 1024, rx_sink, (void*)fs);
+
+    // pipelined receiver: capture, front end and synchronizer threads
+    rxpipe pipe = NULL;
+    if (pipelined) {
+        int stage;
+        pipe = rxpipe_create(&plan, max_samps_per_packet, 1024, 64,
+                             usrp_recv, (void*)usrp.get(), rx_sink, (void*)fs);
+        for (stage=0; stage<RXPIPE_NUM_STAGES; stage++)
+            rxpipe_set_affinity(pipe, stage, affinity[stage]);
+        if (sc16)
+            rxpipe_set_recv_sc16(pipe, usrp_recv_sc16);
+    }
+
+    // energy gate, keeping 1024 baseband samples' worth of pre-trigger
+    // history
+    if (gate_threshold > 0.0f) {
+        rxfrontend_set_gate(pipelined ? rxpipe_get_frontend(pipe) : fe, gate_threshold,
+                            (unsigned int)(1024 * plan.usrp_rate / plan.baseband_rate));
+    }
+
 
     // start data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-    printf("usrp data transfer started\n");
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+        printf("usrp data transfer started\n");
+    }
  
     // run conditions
     int continue_running = 1;
     timer t0 = timer_create();
     timer_tic(t0);
 
-    unsigned int n=0;
-    while (continue_running) {
-        // grab data from port
-        size_t num_rx_samps = usrp->get_device()->recv(
-            &buff.front(), buff.size(), md,
-            uhd::io_type_t::COMPLEX_FLOAT32,
-            uhd::device::RECV_MODE_ONE_PACKET
-        );
-
-        //handle the error codes
-        switch(md.error_code){
-        case uhd::rx_metadata_t::ERROR_CODE_NONE:
-        case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
-            break;
+    if (pipelined)
+        rxpipe_start(pipe);
 
-        default:
-            std::cerr << "Error code: " << md.error_code << std::endl;
-            std::cerr << "Unexpected error on recv, exit test..." << std::endl;
-            return 1;
-        }
-
-        if (not md.has_time_spec){
-            std::cerr << "Metadata missing time spec, exit test..." << std::endl;
-            return 1;
-        }
-
-        // for now copy vector "buff" to array of complex float
-        // TODO : apply bandwidth-dependent gain
-        unsigned int j;
-        unsigned int nw=0;
-        for (j=0; j<num_rx_samps; j++) {
-            // push 64 samples into buffer
-            data_rx[n++] = buff[j];
-
-            if (n==64) {
-                // reset counter
-                n=0;
-
-                // deimate to 32
-                unsigned int k;
-                for (k=0; k<32; k++)
-                    resamp2_crcf_decim_execute(decim, &data_rx[2*k], &data_decim[k]);
-
-                // apply resampler
-                for (k=0; k<32; k++) {
-                    resamp_crcf_execute(resamp, data_decim[k], &data_resamp[n], &nw);
-                    n += nw;
-                }
-
-                // push through synchronizer
-                gmskframesync_execute(fs, data_resamp, n);
-
-                // reset counter (again)
-                n = 0;
+    while (continue_running) {
+        if (pipelined) {
+            // capture, resampler and synchronizer run in their own threads
+            usleep(100000);
+        } else {
+            // grab data from port and push samples through front end; sc16
+            // conversion and scaling are fused with the first decimator
+            unsigned int num_rx_samps;
+            if (sc16) {
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv_sc16(&buff_sc16.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rxfrontend_execute_sc16(fe, &buff_sc16.front(), num_rx_samps);
+            } else {
+                // TODO : apply bandwidth-dependent gain
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv(&buff.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rxfrontend_execute(fe, &buff.front(), num_rx_samps);
             }
 
+            // replay runs until the capture is exhausted
+            if (replay && num_rx_samps == 0) {
+                rxfrontend_flush(fe);
+                continue_running = 0;
+            }
         }
 
         // check runtime
-        if (timer_toc(t0) >= num_seconds)
+        if (!replay && timer_toc(t0) >= num_seconds)
             continue_running = 0;
     }
 
+    if (pipelined)
+        rxpipe_stop(pipe);
+
     // compute actual run-time
     float runtime = timer_toc(t0);
 
     // stop data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
-    printf("\n");
-    printf("usrp data transfer complete\n");
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+        printf("\n");
+        printf("usrp data transfer complete\n");
+    }
 
-    // print results
-    float data_rate = 8.0f * (float)(num_bytes_received) / runtime;
+    // print results (over the capture's duration when replaying)
+    float data_rate = 8.0f * (float)(num_bytes_received) / (replay ? num_seconds : runtime);
     float percent_headers_valid = (num_packets_received == 0) ?
                           0.0f :
                           100.0f * (float)num_valid_headers_received / (float)num_packets_received;
@@ -304,9 +403,21 @@ int main (int argc, char **argv)
 
     // clean it up
     gmskframesync_destroy(fs);
-    resamp_crcf_destroy(resamp);
-    resamp2_crcf_destroy(decim);
+    if (pipelined) {
+        rxpipe_print(pipe);
+        rxpipe_destroy(pipe);
+    } else {
+        if (gate_threshold > 0.0f)
+            rxfrontend_print(fe);
+        rxfrontend_destroy(fe);
+    }
     timer_destroy(t0);
+    if (usrp)
+        iostats_print(stats);
+    iostats_destroy(stats);
+    PROFILE_PRINT();
+    if (replay)
+        iqfile_reader_close(replay);
 
     return 0;
 }
@@ -28,7 +28,67 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
+#include "rateplan.h"
+#include "sc16.h"
 #include "timer.h"
+#include "txfrontend.h"
+#include "txsched.h"
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
+
+// usrp transmit state for timed bursts
+struct txsend_s {
+    uhd::usrp::single_usrp * usrp;  // usrp
+    iostats stats;                  // usrp i/o accounting
+};
+
+// txsched send callback: hand complete burst to usrp at _time
+static unsigned int usrp_send_burst(std::complex<float> * _x,
+                                    unsigned int _n,
+                                    double _time,
+                                    void * _userdata)
+{
+    struct txsend_s * s = (struct txsend_s*) _userdata;
+
+    uhd::tx_metadata_t md;
+    md.start_of_burst = true;
+    md.end_of_burst   = true;
+    md.has_time_spec  = true;
+    md.time_spec      = uhd::time_spec_t(_time);
+    size_t num_tx_samps = s->usrp->get_device()->send(
+        _x, _n, md,
+        uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::SEND_MODE_FULL_BUFF
+    );
+    iostats_tx(s->stats, num_tx_samps);
+    return num_tx_samps;
+}
+
+// txsched clock callback: usrp device time
+static double usrp_clock(void * _userdata)
+{
+    uhd::usrp::single_usrp * usrp = (uhd::usrp::single_usrp*) _userdata;
+    return usrp->get_time_now().get_real_secs();
+}
 
 void usage() {
     printf("gmskframe_tx:\n");
@@ -47,6 +107,10 @@ void usage() {
     printf("  c     : fec coding scheme (inner)\n");
     printf("  k     : fec coding scheme (outer)\n");
     liquid_print_fec_schemes();
+    printf("  T     : TDMA slot length [ms] (default: 0, continuous)\n");
+    printf("  K     : TDMA slots per frame <4>\n");
+    printf("  S     : TDMA slot owned by this node <0>\n");
+    printf("  P     : TDMA: set device time to zero at next PPS\n");
 }
 
 int main (int argc, char **argv)
@@ -72,9 +136,14 @@ int main (int argc, char **argv)
     unsigned int mod_depth = 2;                         // modulation depth
     unsigned int ramp_len = 64;                         // phasing ramp up/down length
 
+    float tdma_slot_len = 0.0f;                         // TDMA slot length [ms] (0: continuous)
+    unsigned int tdma_num_slots = 4;                    // TDMA slots per frame
+    unsigned int tdma_slot = 0;                         // TDMA slot owned by this node
+    bool tdma_pps = false;                              // set device time at next PPS
+
     //
     int d;
-    while ((d = getopt(argc,argv,"f:b:g:G:t:n:m:p:s:r:c:k:qvuh")) != EOF) {
+    while ((d = getopt(argc,argv,"f:b:g:G:t:n:m:p:s:r:c:k:T:K:S:Pqvuh")) != EOF) {
         switch (d) {
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
@@ -90,6 +159,10 @@ int main (int argc, char **argv)
         case 'r':   ramp_len = atoi(optarg);        break;
         case 'c':   fec0 = liquid_getopt_str2fec(optarg);         break;
         case 'k':   fec1 = liquid_getopt_str2fec(optarg);         break;
+        case 'T':   tdma_slot_len = atof(optarg);   break;
+        case 'K':   tdma_num_slots = atoi(optarg);  break;
+        case 'S':   tdma_slot = atoi(optarg);       break;
+        case 'P':   tdma_pps = true;                break;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
         case 'u':
@@ -115,6 +188,9 @@ int main (int argc, char **argv)
     } else if (mod_scheme == LIQUID_MODEM_UNKNOWN) {
         fprintf(stderr,"error: unsupported modulation scheme\n");
         return 0;
+    } else if (tdma_slot_len > 0.0f && tdma_slot >= tdma_num_slots) {
+        fprintf(stderr,"error: TDMA slot must be less than number of slots per frame\n");
+        return 1;
     }
 
     printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
@@ -127,6 +203,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     // set properties
     double tx_rate = 4.0*bandwidth;
 #if 0
@@ -161,12 +240,19 @@ int main (int argc, char **argv)
     // set the IF filter bandwidth
     //usrp->set_tx_bandwidth(2.0f*tx_rate);
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
+    // transmitter gain (linear)
+    float g = powf(10.0f, txgain_dB/20.0f);
 
-    // half-band resampler
-    resamp2_crcf interp = resamp2_crcf_create(7,0.0f,40.0f);
+    // transmit front end: half-band interpolator, arbitrary resampler
+    // and gain, at the usrp rate actually set
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no transmit front end for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
+    txfrontend fe = txfrontend_create(&plan, g, SC16_ISA_AUTO);
+    txfrontend_print(fe);
 
     // create gmskframegen object
     unsigned int k = 2;
@@ -182,9 +268,9 @@ int main (int argc, char **argv)
     md.has_time_spec  = false;  // set to false to send immediately
 
     // framing buffers
+    unsigned int j;
     std::complex<float> buffer[k];
-    std::complex<float> buffer_interp[2*k];
-    std::complex<float> buffer_resamp[8*k]; // resampler
+    std::complex<float> buffer_resamp[txfrontend_max_output(fe,k)];
     std::vector<std::complex<float> > buff(256);
     unsigned int tx_buffer_samples = 0;
 
@@ -192,15 +278,52 @@ int main (int argc, char **argv)
     unsigned char header[8];
     unsigned char payload[payload_len];
 
-    // transmitter gain (linear)
-    float g = powf(10.0f, txgain_dB/20.0f);
- 
+    // TDMA: send each frame as a timed burst in own slot
+    struct txsend_s txsend;
+    txsend.usrp  = usrp.get();
+    txsend.stats = stats;
+    txsched sched = NULL;
+    std::complex<float> * frame = NULL;
+    unsigned long int slot = 0;
+    if (tdma_slot_len > 0.0f) {
+        // frame length, from a dummy frame
+        unsigned int frame_len = 0;
+        for (j=0; j<8; j++)             header[j]  = 0;
+        for (j=0; j<payload_len; j++)   payload[j] = 0;
+        gmskframegen_assemble(fg, header, payload, payload_len, check, fec0, fec1);
+        while (!gmskframegen_write_samples(fg, buffer))
+            frame_len += k;
+        frame_len += k;
+        frame = (std::complex<float>*) malloc(frame_len*sizeof(std::complex<float>));
+
+        // slots count from one second after device time zero, which is
+        // common to all nodes when set at a PPS edge
+        if (tdma_pps) {
+            usrp->set_time_next_pps(uhd::time_spec_t(0.0));
+            sleep(1);
+        } else {
+            usrp->set_time_now(uhd::time_spec_t(0.0));
+        }
+
+        // guard time 5% of slot; hand bursts to the usrp between 5 ms and
+        // one TDMA frame ahead of their slot
+        double slot_len = 1e-3*tdma_slot_len;
+        double frame_period = slot_len * tdma_num_slots;
+        sched = txsched_create(&plan, g, frame_len, usrp_send_burst, (void*)&txsend);
+        txsched_set_clock(sched, usrp_clock, (void*)usrp.get());
+        txsched_set_slots(sched, 1.0, slot_len, tdma_num_slots, 0.05*slot_len);
+        txsched_set_lead(sched, 5e-3, frame_period > 10e-3 ? frame_period : 10e-3);
+
+        if (frame_len / plan.baseband_rate > 0.95*slot_len)
+            fprintf(stderr,"warning: frame (%.3f ms) does not fit in slot; frames will be dropped\n",
+                    1e3*frame_len / plan.baseband_rate);
+    }
+
     // run conditions
     int continue_running = 1;
     timer t0 = timer_create();
     timer_tic(t0);
 
-    unsigned int j;
     unsigned int pid=0;
     // start transmitter
     while (continue_running) {
@@ -231,37 +354,42 @@ int main (int argc, char **argv)
         // generate frame
         //
         int frame_complete = 0;
+        if (sched != NULL) {
+            // timed burst in next own slot
+            slot = txsched_next_slot(sched, tdma_slot);
+            unsigned int n = 0;
+            while (!frame_complete) {
+                frame_complete = gmskframegen_write_samples(fg, &frame[n]);
+                n += k;
+            }
+            int result = txsched_send_slot(sched, slot, frame, n);
+            if (result != TXSCHED_SENT)
+                printf("slot %lu: %s\n", slot, txsched_result_str(result));
+            usrp_poll_async(usrp.get(), stats);
+        }
         while (!frame_complete) {
             // generate k samples
             frame_complete = gmskframegen_write_samples(fg, buffer);
 
-            // interpolate by 2
-            for (j=0; j<k; j++)
-                resamp2_crcf_interp_execute(interp, buffer[j], &buffer_interp[2*j]);
-
-            // resample
-            // resample
-            unsigned int nw;
-            unsigned int n=0;
-            for (j=0; j<2*k; j++) {
-                resamp_crcf_execute(resamp, buffer_interp[j], &buffer_resamp[n], &nw);
-                n += nw;
-            }
+            // interpolate, resample and apply gain
+            unsigned int n = txfrontend_execute(fe, buffer, k, buffer_resamp);
 
             // push samples into buffer
             for (j=0; j<n; j++) {
-                buff[tx_buffer_samples++] = g*buffer_resamp[j];
+                buff[tx_buffer_samples++] = buffer_resamp[j];
 
                 if (tx_buffer_samples==256) {
                     // reset counter
                     tx_buffer_samples=0;
 
                     //send the entire contents of the buffer
-                    usrp->get_device()->send(
+                    size_t num_tx_samps = usrp->get_device()->send(
                         &buff.front(), buff.size(), md,
                         uhd::io_type_t::COMPLEX_FLOAT32,
                         uhd::device::SEND_MODE_FULL_BUFF
                     );
+                    iostats_tx(stats, num_tx_samps);
+                    usrp_poll_async(usrp.get(), stats);
                 }
             }
         }
@@ -271,23 +399,36 @@ int main (int argc, char **argv)
             continue_running = 0;
     }
  
-    // send a mini EOB packet
-    md.start_of_burst = false;
-    md.end_of_burst   = true;
-    usrp->get_device()->send("", 0, md,
-        uhd::io_type_t::COMPLEX_FLOAT32,
-        uhd::device::SEND_MODE_FULL_BUFF
-    );
+    if (sched != NULL) {
+        // wait for last burst to go out
+        while (txsched_get_time(sched) < txsched_get_slot_time(sched, slot+1))
+            usleep(1000);
+    } else {
+        // send a mini EOB packet
+        md.start_of_burst = false;
+        md.end_of_burst   = true;
+        usrp->get_device()->send("", 0, md,
+            uhd::io_type_t::COMPLEX_FLOAT32,
+            uhd::device::SEND_MODE_FULL_BUFF
+        );
+    }
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
+    if (sched != NULL) {
+        txsched_print(sched);
+        txsched_destroy(sched);
+        free(frame);
+    }
 
     // clean it up
     gmskframegen_destroy(fg);
-    resamp2_crcf_destroy(interp);
-    resamp_crcf_destroy(resamp);
+    txfrontend_destroy(fe);
     timer_destroy(t0);
 
+    iostats_destroy(stats);
     return 0;
 }
 
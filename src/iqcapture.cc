@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//
+// iqcapture.cc
+//
+// Record raw usrp samples to disk for offline replay (iqfile): samples
+// are written at the usrp rate the receiver apps choose for the same
+// bandwidth, so that a capture can be fed straight back through any of
+// them with their -i option.  Overflows and time stamp discontinuities
+// are logged in the sidecar metadata file.
+//
+
+#include <iostream>
+#include <complex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <uhd/usrp/single_usrp.hpp>
+
+#include "iostats.h"
+#include "iqfile.h"
+#include "rateplan.h"
+
+void usage() {
+    printf("Usage: iqcapture [OPTION]\n");
+    printf("Record raw usrp samples (and metadata) to disk\n");
+    printf("\n");
+    printf("  f     : center frequency [Hz]\n");
+    printf("  b     : bandwidth [Hz]\n");
+    printf("  t     : run time [seconds]\n");
+    printf("  G     : uhd rx gain [dB] (default: 20dB)\n");
+    printf("  F     : sample format: fc32, <sc16>\n");
+    printf("  o     : output filename, default: capture.dat\n");
+    printf("  u,h   : usage/help\n");
+}
+
+int main (int argc, char **argv)
+{
+    // command-line options
+    unsigned long int ADC_RATE = 64e6;
+    float min_bandwidth = 0.25f*(ADC_RATE / 256.0);
+    float max_bandwidth = 0.25f*(ADC_RATE /   4.0);
+
+    float frequency = 462.0e6;
+    float bandwidth = 100e3f;
+    float num_seconds = 5.0f;
+    double uhd_rxgain = 20.0;
+    int format = IQFILE_FORMAT_SC16;
+    char filename[256] = "capture.dat";
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"f:b:t:G:F:o:uh")) != EOF) {
+        switch (d) {
+        case 'f':   frequency = atof(optarg);       break;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 't':   num_seconds = atof(optarg);     break;
+        case 'G':   uhd_rxgain = atof(optarg);      break;
+        case 'F':
+            format = iqfile_format_parse(optarg);
+            if (format < 0) {
+                fprintf(stderr,"error: %s, unknown sample format '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'o':   strncpy(filename,optarg,255);   break;
+        case 'u':
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    if (bandwidth > max_bandwidth) {
+        printf("error: maximum bandwidth exceeded (%8.4f MHz)\n", max_bandwidth*1e-6);
+        return 0;
+    } else if (bandwidth < min_bandwidth) {
+        printf("error: minimum bandwidth exceeded (%8.4f kHz)\n", min_bandwidth*1e-3);
+        return 0;
+    }
+
+    printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
+    printf("bandwidth   :   %12.8f [kHz]\n", bandwidth*1e-3f);
+    printf("format      :   %s\n", iqfile_format_str(format));
+    printf("output      :   %s\n", filename);
+
+    uhd::device_addr_t dev_addr;
+    uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
+
+    // same usrp rate as the receiver apps
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", bandwidth*1e-3f);
+        return 1;
+    }
+
+    // NOTE : the sample rate computation MUST be in double precision so
+    //        that the UHD can compute its decimation rate properly
+    usrp->set_rx_rate(plan.usrp_rate);
+    double usrp_rate = usrp->get_rx_rate();
+    printf("usrp rate   :   %12.8f [kHz]\n", usrp_rate*1e-3);
+
+    usrp->set_rx_freq(frequency);
+    usrp->set_rx_gain(uhd_rxgain);
+
+    const size_t max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    const uhd::io_type_t & io_type = format == IQFILE_FORMAT_SC16 ?
+        uhd::io_type_t::COMPLEX_INT16 : uhd::io_type_t::COMPLEX_FLOAT32;
+
+    // recv buffer, large enough for either format
+    std::vector<std::complex<float> > buff(max_samps_per_packet);
+
+    // usrp i/o accounting
+    iostats stats = iostats_create(usrp_rate);
+
+    iqfile_writer w = iqfile_writer_create(filename, format, usrp_rate,
+                                           usrp->get_rx_freq(), usrp->get_rx_gain());
+
+    // start data transfer
+    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    printf("usrp data transfer started\n");
+
+    unsigned long int num_samples = (unsigned long int)(usrp_rate*num_seconds);
+    unsigned long int num_captured = 0;
+    double time_next = 0.0;
+    while (num_captured < num_samples) {
+        uhd::rx_metadata_t md;
+        size_t num_rx_samps = usrp->get_device()->recv(
+            &buff.front(), buff.size(), md,
+            io_type,
+            uhd::device::RECV_MODE_ONE_PACKET
+        );
+
+        // use hardware timestamp if present, otherwise extrapolate from
+        // the previous packet
+        double timestamp = md.has_time_spec ? md.time_spec.get_real_secs() : time_next;
+
+        //handle the error codes
+        switch(md.error_code){
+        case uhd::rx_metadata_t::ERROR_CODE_NONE:
+            break;
+        case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+            iostats_event(stats, IOSTATS_OVERFLOW);
+            iqfile_writer_overflow(w, timestamp);
+            break;
+        case uhd::rx_metadata_t::ERROR_CODE_TIMEOUT:
+            break;
+        default:
+            std::cerr << "Error code: " << md.error_code << std::endl;
+            std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+            exit(1);
+        }
+
+        iostats_rx(stats, num_rx_samps, md.has_time_spec, timestamp);
+        iqfile_writer_write(w, &buff.front(), num_rx_samps, timestamp);
+        time_next = timestamp + (double)num_rx_samps / usrp_rate;
+        num_captured += num_rx_samps;
+    }
+
+    // stop data transfer
+    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+    printf("usrp data transfer complete\n");
+
+    iqfile_writer_print(w);
+    iqfile_writer_destroy(w);
+    iostats_print(stats);
+    iostats_destroy(stats);
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// iqpr_rxbench.cc
+//
+// benchmark iqpr receiver chain (half-band decimator, arbitrary
+// resampler, ofdmflexframesync) processing one sample pair at a time
+// against processing entire usrp blocks at a time.
+//
+// The capture file holds raw interleaved complex float32 samples at the
+// usrp receive rate; if none is given, a synthetic capture is generated.
+//
+
+#include <iostream>
+#include <complex>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <liquid/liquid.h>
+
+#include "timer.h"
+
+static unsigned int num_frames_detected;
+
+static int callback(unsigned char *  _header,
+                    int              _header_valid,
+                    unsigned char *  _payload,
+                    unsigned int     _payload_len,
+                    int              _payload_valid,
+                    framesyncstats_s _stats,
+                    void *           _userdata)
+{
+    num_frames_detected++;
+    return 0;
+}
+
+void usage() {
+    printf("iqpr_rxbench -- benchmark iqpr receiver chain\n");
+    printf("  u,h   :   usage/help\n");
+    printf("  i     :   input capture (raw complex float32), default: synthetic\n");
+    printf("  r     :   arbitrary resampling rate, default: 1.0\n");
+    printf("  B     :   usrp block length [samples], default: 1024\n");
+    printf("  N     :   number of frames in synthetic capture, default: 200\n");
+    printf("  n     :   number of trials, default: 4\n");
+}
+
+// generate synthetic capture: ofdmflexframes interpolated by 2 with
+// silence between frames and additive noise
+std::complex<float> * generate_capture(unsigned int   _M,
+                                       unsigned int   _cp_len,
+                                       unsigned char * _p,
+                                       unsigned int   _num_frames,
+                                       unsigned int * _num_samples)
+{
+    ofdmflexframegenprops_s fgprops;
+    ofdmflexframegenprops_init_default(&fgprops);
+    fgprops.check      = LIQUID_CRC_32;
+    fgprops.fec0       = LIQUID_FEC_NONE;
+    fgprops.fec1       = LIQUID_FEC_HAMMING74;
+    fgprops.mod_scheme = LIQUID_MODEM_QPSK;
+    fgprops.mod_bps    = 2;
+    ofdmflexframegen fg = ofdmflexframegen_create(_M, _cp_len, _p, &fgprops);
+    resamp2_crcf interp = resamp2_crcf_create(7,0.0f,40.0f);
+
+    unsigned int symbol_len = _M + _cp_len;
+    unsigned int num_pad = 40;  // number of silent symbols between frames
+    unsigned int num_alloc = 0;
+    unsigned int n = 0;
+    std::complex<float> * y = NULL;
+    std::complex<float> buffer[symbol_len];
+
+    unsigned char header[8];
+    unsigned char payload[200];
+    unsigned int i, j;
+    for (i=0; i<_num_frames; i++) {
+        for (j=0; j<8;   j++) header[j]  = rand() & 0xff;
+        for (j=0; j<200; j++) payload[j] = rand() & 0xff;
+        ofdmflexframegen_reset(fg);
+        ofdmflexframegen_assemble(fg, header, payload, 200);
+
+        int last_symbol = 0;
+        unsigned int zero_pad = num_pad;
+        unsigned int num_samples;
+        while (!last_symbol || zero_pad > 0) {
+            if (!last_symbol) {
+                last_symbol = ofdmflexframegen_writesymbol(fg, buffer, &num_samples);
+            } else {
+                zero_pad--;
+                num_samples = symbol_len;
+                for (j=0; j<num_samples; j++)
+                    buffer[j] = 0.0f;
+            }
+
+            // re-allocate output as necessary
+            if (n + 2*num_samples > num_alloc) {
+                num_alloc = 2*(n + 2*num_samples);
+                y = (std::complex<float>*) realloc(y, num_alloc*sizeof(std::complex<float>));
+            }
+
+            // interpolate by 2, add noise
+            for (j=0; j<num_samples; j++) {
+                resamp2_crcf_interp_execute(interp, 0.1f*buffer[j], &y[n]);
+                y[n++] += 1e-3f*std::complex<float>(randnf(), randnf());
+                y[n++] += 1e-3f*std::complex<float>(randnf(), randnf());
+            }
+        }
+    }
+
+    ofdmflexframegen_destroy(fg);
+    resamp2_crcf_destroy(interp);
+
+    *_num_samples = n;
+    return y;
+}
+
+int main (int argc, char **argv)
+{
+    // options
+    char filename[256] = "";
+    float resamp_rate = 1.0f;
+    unsigned int block_len = 1024;
+    unsigned int num_frames = 200;
+    unsigned int num_trials = 4;
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhi:r:B:N:n:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                        return 0;
+        case 'i':   strncpy(filename,optarg,255);   break;
+        case 'r':   resamp_rate = atof(optarg);     break;
+        case 'B':   block_len = atoi(optarg);       break;
+        case 'N':   num_frames = atoi(optarg);      break;
+        case 'n':   num_trials = atoi(optarg);      break;
+        default:
+            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    if (block_len < 2) {
+        fprintf(stderr,"error: %s, block length must be at least 2\n", argv[0]);
+        exit(1);
+    }
+
+    // subcarrier allocation (same as iqpr)
+    unsigned int M = 40;
+    unsigned int cp_len = 8;
+    unsigned char p[M];
+    unsigned int guard = M / 6;
+    unsigned int pilot_spacing = 8;
+    unsigned int i0 = (M/2) - guard;
+    unsigned int i1 = (M/2) + guard;
+    unsigned int i;
+    for (i=0; i<M; i++) {
+        if ( i == 0 || (i > i0 && i < i1) )
+            p[i] = OFDMFRAME_SCTYPE_NULL;
+        else if ( (i%pilot_spacing)==0 )
+            p[i] = OFDMFRAME_SCTYPE_PILOT;
+        else
+            p[i] = OFDMFRAME_SCTYPE_DATA;
+    }
+
+    // load capture
+    unsigned int num_samples = 0;
+    std::complex<float> * x = NULL;
+    if (strlen(filename) > 0) {
+        FILE * fid = fopen(filename,"rb");
+        if (!fid) {
+            fprintf(stderr,"error: %s, could not open '%s' for reading\n", argv[0], filename);
+            exit(1);
+        }
+        fseek(fid, 0, SEEK_END);
+        num_samples = ftell(fid) / sizeof(std::complex<float>);
+        fseek(fid, 0, SEEK_SET);
+        x = (std::complex<float>*) malloc(num_samples*sizeof(std::complex<float>));
+        num_samples = fread(x, sizeof(std::complex<float>), num_samples, fid);
+        fclose(fid);
+        printf("capture     :   %s (%u samples)\n", filename, num_samples);
+    } else {
+        x = generate_capture(M, cp_len, p, num_frames, &num_samples);
+        printf("capture     :   synthetic, %u frames (%u samples)\n", num_frames, num_samples);
+    }
+
+    // create receiver objects
+    resamp2_crcf decim  = resamp2_crcf_create(7, 0.0, 40.0);
+    resamp_crcf  resamp = resamp_crcf_create(resamp_rate, 7, 0.4, 60.0, 64);
+    resamp_crcf_setrate(resamp, resamp_rate);
+    ofdmflexframesync fs = ofdmflexframesync_create(M, cp_len, p, callback, NULL);
+
+    // block buffers, synchronizer chunk size (as in iqpr)
+    std::complex<float> * buffer_decim  = (std::complex<float>*) malloc((block_len/2+1)*sizeof(std::complex<float>));
+    std::complex<float> * buffer_resamp = (std::complex<float>*) malloc((block_len+4)*sizeof(std::complex<float>));
+    unsigned int sync_len = 4*(M + cp_len);
+
+    timer t0 = timer_create();
+    unsigned int trial;
+    unsigned int j, k, nw;
+    float runtime_sample = 0.0f;
+    float runtime_block  = 0.0f;
+    unsigned int frames_sample = 0;
+    unsigned int frames_block  = 0;
+    for (trial=0; trial<num_trials; trial++) {
+        //
+        // sample mode: one sample pair at a time
+        //
+        resamp2_crcf_clear(decim);
+        resamp_crcf_reset(resamp);
+        ofdmflexframesync_reset(fs);
+        num_frames_detected = 0;
+        std::complex<float> decim_out;
+        std::complex<float> y[4];
+        timer_tic(t0);
+        for (i=0; i+1<num_samples; i+=2) {
+            resamp2_crcf_decim_execute(decim, &x[i], &decim_out);
+            resamp_crcf_execute(resamp, decim_out, y, &nw);
+            ofdmflexframesync_execute(fs, y, nw);
+        }
+        runtime_sample += timer_toc(t0);
+        frames_sample += num_frames_detected;
+
+        //
+        // block mode: one usrp block at a time
+        //
+        resamp2_crcf_clear(decim);
+        resamp_crcf_reset(resamp);
+        ofdmflexframesync_reset(fs);
+        num_frames_detected = 0;
+        timer_tic(t0);
+        for (i=0; i<num_samples; i+=block_len) {
+            unsigned int n = (i + block_len > num_samples) ? num_samples - i : block_len;
+            n &= ~1u;
+
+            // decimate
+            unsigned int num_decim = 0;
+            for (j=0; j<n; j+=2)
+                resamp2_crcf_decim_execute(decim, &x[i+j], &buffer_decim[num_decim++]);
+
+            // resample
+            unsigned int num_resamp = 0;
+            for (j=0; j<num_decim; j++) {
+                resamp_crcf_execute(resamp, buffer_decim[j], &buffer_resamp[num_resamp], &nw);
+                num_resamp += nw;
+            }
+
+            // synchronize in chunks
+            for (j=0; j<num_resamp; j+=sync_len) {
+                k = (j + sync_len > num_resamp) ? num_resamp - j : sync_len;
+                ofdmflexframesync_execute(fs, &buffer_resamp[j], k);
+            }
+        }
+        runtime_block += timer_toc(t0);
+        frames_block += num_frames_detected;
+    }
+
+    // print results
+    float total_samples = (float)num_samples * (float)num_trials;
+    printf("block length        : %u samples\n", block_len);
+    printf("sample mode         : %12.4f Msamples/s (%u frames detected)\n",
+            total_samples / runtime_sample * 1e-6f, frames_sample / num_trials);
+    printf("block mode          : %12.4f Msamples/s (%u frames detected)\n",
+            total_samples / runtime_block * 1e-6f, frames_block / num_trials);
+    printf("speedup             : %12.4f\n", runtime_sample / runtime_block);
+
+    // destroy objects
+    resamp2_crcf_destroy(decim);
+    resamp_crcf_destroy(resamp);
+    ofdmflexframesync_destroy(fs);
+    timer_destroy(t0);
+    free(buffer_decim);
+    free(buffer_resamp);
+    free(x);
+
+    return 0;
+}
+
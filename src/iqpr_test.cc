@@ -24,52 +24,47 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <time.h>
 #include <liquid/liquid.h>
 
 #include "iqpr.h"
+#include "profile.h"
+#include "timer.h"
  
 void usage() {
     printf("iqpr_test:\n");
     printf("  u,h   :   usage/help\n");
+    printf("  i     :   receive from capture file (raw complex float32)\n");
+    printf("  o     :   transmit to file (raw complex float32)\n");
+    printf("  L     :   in-process loopback with delay [samples]\n");
+    printf("  N     :   number of packets to transmit, default: 1000\n");
+    printf("  n     :   number of receive attempts, default: 200\n");
+    printf("  P     :   transmit microbenchmark [packets] (no usrp)\n");
 }
 
-int main (int argc, char **argv)
+// set rx/tx parameters
+void iqpr_test_configure(iqpr _q)
 {
-    //srand(time(NULL));
-
-    //
-    int d;
-    while ((d = getopt(argc,argv,"uh:")) != EOF) {
-        switch (d) {
-        case 'u':
-        case 'h':   usage();                return 0;
-        default:
-            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
-            exit(1);
-        }
-    }
-
-    iqpr q = iqpr_create();
-
     // set rx parameters
-    iqpr_set_rx_gain(q, 20);
-    iqpr_set_rx_rate(q, 80e3);
-    iqpr_set_rx_freq(q, 462e6f);
+    iqpr_set_rx_gain(_q, 20);
+    iqpr_set_rx_rate(_q, 80e3);
+    iqpr_set_rx_freq(_q, 462e6f);
 
     // set tx parameters
-    iqpr_set_tx_gain(q, 40);
-    iqpr_set_tx_rate(q, 80e3);
-    iqpr_set_tx_freq(q, 462e6f);
+    iqpr_set_tx_gain(_q, 40);
+    iqpr_set_tx_rate(_q, 80e3);
+    iqpr_set_tx_freq(_q, 462e6f);
 
     // other options
-    iqpr_unset_verbose(q);
-
-    unsigned int i;
+    iqpr_unset_verbose(_q);
+}
 
-#if 1
-    //
+// run receiver for _num_attempts attempts
+void iqpr_test_rx(iqpr _q,
+                  unsigned int _num_attempts)
+{
     unsigned int    timespec = 10000;
     unsigned char * rx_header = NULL;
     int             rx_header_valid;
@@ -78,15 +73,17 @@ int main (int argc, char **argv)
     int             rx_payload_valid;
     framesyncstats_s stats;
 
-    //
-    // receiver
-    //
+    unsigned int i;
+    unsigned int num_packets_received = 0;
+    timer t0 = timer_create();
 
     printf("starting receiver...\n");
-    iqpr_rx_start(q);
-    for (i=0; i<200; i++) {
+    iqpr_rx_start(_q);
+    double t_start = iqpr_get_time(_q);
+    timer_tic(t0);
+    for (i=0; i<_num_attempts; i++) {
         int packet_received =
-        iqpr_rxpacket(q, timespec,
+        iqpr_rxpacket(_q, timespec,
                       &rx_header,
                       &rx_header_valid,
                       &rx_payload,
@@ -95,6 +92,7 @@ int main (int argc, char **argv)
                       &stats);
 
         if (packet_received) {
+            num_packets_received++;
             printf("iqpr received packet");
 
             if (rx_header_valid) {
@@ -111,36 +109,46 @@ int main (int argc, char **argv)
             }
         }
     }
-    iqpr_rx_stop(q);
-#endif
-
-#if 1
+    float runtime = timer_toc(t0);
+    double t_stop = iqpr_get_time(_q);
+    iqpr_rx_stop(_q);
 
-    //
-    // transmitter
-    //
+    printf("received %u packets in %.3f s (%.3f s of samples)\n",
+            num_packets_received, runtime, t_stop - t_start);
+    timer_destroy(t0);
+}
 
-    ofdmflexframegenprops_s fgprops;
-    ofdmflexframegenprops_init_default(&fgprops);
-    fgprops.check        = LIQUID_CRC_32;
-    fgprops.fec0         = LIQUID_FEC_NONE;
-    fgprops.fec1         = LIQUID_FEC_NONE;
-    fgprops.mod_scheme   = LIQUID_MODEM_QAM;
-    fgprops.mod_bps      = 2;
+// set frame generator properties for test packets
+void iqpr_test_fgprops(ofdmflexframegenprops_s * _fgprops)
+{
+    ofdmflexframegenprops_init_default(_fgprops);
+    _fgprops->check        = LIQUID_CRC_32;
+    _fgprops->fec0         = LIQUID_FEC_NONE;
+    _fgprops->fec1         = LIQUID_FEC_NONE;
+    _fgprops->mod_scheme   = LIQUID_MODEM_QAM;
+    _fgprops->mod_bps      = 2;
 #if 0
-    fgprops.rampup_len   = 40;
-    fgprops.phasing_len  = 40;
-    fgprops.rampdn_len   = 40;
+    _fgprops->rampup_len   = 40;
+    _fgprops->phasing_len  = 40;
+    _fgprops->rampdn_len   = 40;
 #endif
+}
+
+// transmit _num_packets packets
+void iqpr_test_tx(iqpr _q,
+                  unsigned int _num_packets)
+{
+    ofdmflexframegenprops_s fgprops;
+    iqpr_test_fgprops(&fgprops);
 
-    unsigned int num_packets = 1000;
     unsigned int payload_len = 200;
     unsigned char header[14];
     unsigned char payload[payload_len];
 
     printf("starting transmitter...\n");
-    for (i=0; i<num_packets; i++) {
-        //printf("  transmitting packet %6u / %6u\n", i, num_packets);
+    unsigned int i;
+    for (i=0; i<_num_packets; i++) {
+        //printf("  transmitting packet %6u / %6u\n", i, _num_packets);
 
         header[0] = (i >> 8) & 0xff;
         header[1] = (i    ) & 0xff;
@@ -149,17 +157,129 @@ int main (int argc, char **argv)
         for (j=2; j<14; j++) header[j] = rand() & 0xff;
         for (j=0; j<payload_len; j++) payload[j] = rand() & 0xff;
 
-        iqpr_txpacket(q, header, payload, payload_len, &fgprops);
+        iqpr_txpacket(_q, header, payload, payload_len, &fgprops);
 
         //usleep(10000);
     }
-#endif
+}
+
+// transmit microbenchmark: packets per second rendered and sent to a
+// discarding file backend, streamed, as bursts and from the frame cache
+void iqpr_test_txbench(unsigned int _num_packets)
+{
+    iqpr q = iqpr_create_backend(iqpr_backend_create_file(NULL, NULL));
+    iqpr_test_configure(q);
 
-    // destroy object
+    ofdmflexframegenprops_s fgprops;
+    iqpr_test_fgprops(&fgprops);
+
+    unsigned int payload_len = 200;
+    unsigned char header[14];
+    unsigned char payload[payload_len];
+    unsigned int j;
+    for (j=0; j<14; j++) header[j] = rand() & 0xff;
+    for (j=0; j<payload_len; j++) payload[j] = rand() & 0xff;
+
+    const char * mode_str[3] = {"continuous", "burst", "cached"};
+    timer t0 = timer_create();
+
+    printf("transmit benchmark (%u packets, %u bytes):\n", _num_packets, payload_len);
+    unsigned int mode;
+    for (mode=0; mode<3; mode++) {
+        // cache only in last mode (same packet resent)
+        iqpr_set_tx_cache(q, mode == 2 ? 8 : 0, 1<<20);
+        if (mode == 1) iqpr_set_tx_burst_mode(q);
+        else           iqpr_unset_tx_burst_mode(q);
+
+        unsigned int i;
+        timer_tic(t0);
+        for (i=0; i<_num_packets; i++) {
+            if (mode != 2) {
+                header[0] = (i >> 8) & 0xff;
+                header[1] = (i    ) & 0xff;
+            }
+            iqpr_txpacket(q, header, payload, payload_len, &fgprops);
+        }
+        float runtime = timer_toc(t0);
+
+        printf("    %-12s: %10.1f packets/s (%8.2f us/packet)\n",
+                mode_str[mode],
+                _num_packets / runtime,
+                runtime * 1e6f / _num_packets);
+    }
+
+    timer_destroy(t0);
     iqpr_destroy(q);
+}
+
+int main (int argc, char **argv)
+{
+    //srand(time(NULL));
+
+    // options
+    char rx_filename[256] = "";
+    char tx_filename[256] = "";
+    int loopback = 0;
+    unsigned int loopback_delay = 0;
+    unsigned int num_packets = 1000;
+    unsigned int num_attempts = 200;
+    unsigned int num_bench_packets = 0;
 
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhi:o:L:N:n:P:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                return 0;
+        case 'i':   strncpy(rx_filename,optarg,255);    break;
+        case 'o':   strncpy(tx_filename,optarg,255);    break;
+        case 'L':   loopback = 1; loopback_delay = atoi(optarg); break;
+        case 'N':   num_packets = atoi(optarg);         break;
+        case 'n':   num_attempts = atoi(optarg);        break;
+        case 'P':   num_bench_packets = atoi(optarg);   break;
+        default:
+            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    if (num_bench_packets > 0) {
+        iqpr_test_txbench(num_bench_packets);
+    } else if (loopback) {
+        // transmit into receiver of second object, then receive
+        iqpr_backend b0, b1;
+        iqpr_backend_create_loopback(loopback_delay, &b0, &b1);
+        iqpr q_tx = iqpr_create_backend(b0);
+        iqpr q    = iqpr_create_backend(b1);
+        iqpr_test_configure(q_tx);
+        iqpr_test_configure(q);
+
+        iqpr_test_tx(q_tx, num_packets);
+        iqpr_test_rx(q, num_attempts);
+
+        iqpr_print(q);
+        iqpr_destroy(q_tx);
+        iqpr_destroy(q);
+    } else {
+        iqpr q;
+        if (strlen(rx_filename) > 0 || strlen(tx_filename) > 0) {
+            q = iqpr_create_backend(iqpr_backend_create_file(
+                    strlen(rx_filename) > 0 ? rx_filename : NULL,
+                    strlen(tx_filename) > 0 ? tx_filename : NULL));
+        } else {
+            q = iqpr_create();
+        }
+        iqpr_test_configure(q);
+
+        iqpr_test_rx(q, num_attempts);
+        iqpr_test_tx(q, num_packets);
+
+        // destroy object
+        iqpr_destroy(q);
+    }
+
+    PROFILE_PRINT();
     printf("done.\n");
 
     return 0;
 }
-
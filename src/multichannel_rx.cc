@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// multichannel_rx
+//
+// Receive a wideband usrp stream, split it into num_channels adjacent
+// subchannels with a polyphase analysis channelizer, and decode each
+// subchannel with its own frame synchronizer.  Channel c is centered at
+// frequency + c*spacing (wrapping to negative offsets for the upper half
+// of the channels), where spacing = 2*bandwidth.  Synchronizers are
+// spread across a pool of worker threads, each of which owns every
+// num_workers-th channel and is fed channelized blocks through its own
+// lock-free queue.
+//
+
+#include <iostream>
+#include <complex>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <liquid/liquid.h>
+
+#include <uhd/usrp/single_usrp.hpp>
+
+#include "blockq.h"
+#include "iostats.h"
+#include "iqfile.h"
+#include "profile.h"
+#include "rxfrontend.h"
+#include "timer.h"
+
+// channelized samples per channel per block
+#define MULTICHANNEL_BLOCK_LEN  (256)
+
+// blocks in each worker queue
+#define MULTICHANNEL_NUM_BLOCKS (32)
+
+// frame types
+#define FRAME_FLEX  (0)
+#define FRAME_OFDM  (1)
+
+static bool verbose;
+static iostats stats;               // usrp i/o accounting
+
+// per-channel synchronizer and statistics (touched only by the worker
+// that owns the channel)
+struct channel_s {
+    unsigned int index;                 // channel index
+    double offset;                      // offset from center frequency [Hz]
+    flexframesync fs;                   // synchronizer (FRAME_FLEX)
+    ofdmflexframesync ofs;              // synchronizer (FRAME_OFDM)
+
+    unsigned int num_packets_received;
+    unsigned int num_valid_headers_received;
+    unsigned int num_valid_packets_received;
+    unsigned int num_bytes_received;
+    float SNRdB_av;
+};
+
+// worker thread
+struct worker_s {
+    pthread_t thread;                   // worker thread
+    volatile int running;               // run flag
+    blockq q;                           // channelized blocks [channel][sample]
+    struct channel_s ** channels;       // channels owned by this worker
+    unsigned int num_channels;          // number of channels owned
+    int frame_type;                     // FRAME_FLEX or FRAME_OFDM
+    unsigned long int num_blocks;       // blocks processed
+    struct blockq_block_s * block;      // block being filled by channelizer
+};
+
+// channelizer state (front-end sink)
+struct channelizer_s {
+    firpfbch_crcf channelizer;          // analysis filterbank
+    unsigned int num_channels;          // number of channels
+    std::complex<float> * y;            // channelizer output [num_channels]
+    struct worker_s * workers;          // worker pool
+    unsigned int num_workers;           // number of workers
+};
+
+static int callback(unsigned char * _rx_header,
+                    int _rx_header_valid,
+                    unsigned char * _rx_payload,
+                    unsigned int _rx_payload_len,
+                    int _rx_payload_valid,
+                    framesyncstats_s _stats,
+                    void * _userdata)
+{
+    struct channel_s * c = (struct channel_s*) _userdata;
+
+    c->num_packets_received++;
+    if (verbose) {
+        printf("********* channel %3u, ", c->index);
+        printf("evm=%5.1fdB, ", _stats.evm);
+        printf("rssi=%5.1fdB, ", _stats.rssi);
+    }
+
+    // make better estimate of SNR
+    float noise_floor = -38.0f; // noise floor estimate
+    float SNRdB = _stats.rssi - noise_floor;
+    c->SNRdB_av += SNRdB;
+
+    if ( !_rx_header_valid ) {
+        if (verbose) printf("header crc : FAIL\n");
+        return 0;
+    }
+    c->num_valid_headers_received++;
+    unsigned int packet_id = (_rx_header[0] << 8 | _rx_header[1]);
+    if (verbose) printf("packet id: %6u\n", packet_id);
+
+    if ( !_rx_payload_valid ) {
+        if (verbose) printf("payload crc : FAIL\n");
+        return 0;
+    }
+
+    c->num_valid_packets_received++;
+    c->num_bytes_received += _rx_payload_len;
+
+    return 0;
+}
+
+// worker thread: run each owned channel's synchronizer on its part of
+// every channelized block
+void * worker_process(void * _userdata)
+{
+    struct worker_s * w = (struct worker_s*) _userdata;
+
+    for (;;) {
+        struct blockq_block_s * block = blockq_read_acquire(w->q);
+        if (block == NULL) {
+            // exit only once stopped and the queue is drained
+            if (!w->running && blockq_read_acquire(w->q) == NULL)
+                break;
+            usleep(100);
+            continue;
+        }
+
+        unsigned int j;
+        for (j=0; j<w->num_channels; j++) {
+            std::complex<float> * x = &block->x[j*block->n];
+            PROFILE_BEGIN(PROFILE_SYNC);
+            if (w->frame_type == FRAME_FLEX)
+                flexframesync_execute(w->channels[j]->fs, x, block->n);
+            else
+                ofdmflexframesync_execute(w->channels[j]->ofs, x, block->n);
+            PROFILE_END(PROFILE_SYNC, block->n);
+        }
+        w->num_blocks++;
+
+        blockq_read_release(w->q);
+    }
+
+    return NULL;
+}
+
+// front-end sink: channelize block of baseband samples and hand each
+// worker its channels; a worker whose queue is full loses the block
+// (counted as a queue overflow)
+static void channelize(std::complex<float> * _x,
+                       unsigned int _n,
+                       void * _userdata)
+{
+    struct channelizer_s * q = (struct channelizer_s*) _userdata;
+    unsigned int M = q->num_channels;
+    unsigned int K = _n / M;    // channelized samples per channel
+
+    unsigned int i;
+    for (i=0; i<q->num_workers; i++) {
+        q->workers[i].block = blockq_write_acquire(q->workers[i].q);
+        if (q->workers[i].block != NULL)
+            q->workers[i].block->n = K;
+    }
+
+    unsigned int t;
+    unsigned int j;
+    PROFILE_BEGIN(PROFILE_CHANNELIZER);
+    for (t=0; t<K; t++) {
+        firpfbch_crcf_analyzer_execute(q->channelizer, &_x[t*M], q->y);
+
+        // channel c belongs to worker c % num_workers, slot c / num_workers
+        for (i=0; i<M; i++) {
+            struct worker_s * w = &q->workers[i % q->num_workers];
+            j = i / q->num_workers;
+            if (w->block != NULL)
+                w->block->x[j*K + t] = q->y[i];
+        }
+    }
+    PROFILE_END(PROFILE_CHANNELIZER, K*M);
+
+    for (i=0; i<q->num_workers; i++) {
+        if (q->workers[i].block != NULL)
+            blockq_write_commit(q->workers[i].q);
+    }
+}
+
+// read one usrp packet into buffer in wire format _io_type, returning
+// number of samples
+static unsigned int usrp_recv_io(void * _x,
+                                 unsigned int _n,
+                                 void * _userdata,
+                                 const uhd::io_type_t & _io_type)
+{
+    uhd::usrp::single_usrp * usrp = (uhd::usrp::single_usrp*) _userdata;
+
+    uhd::rx_metadata_t md;
+    size_t num_rx_samps = usrp->get_device()->recv(
+        _x, _n, md,
+        _io_type,
+        uhd::device::RECV_MODE_ONE_PACKET
+    );
+
+    //handle the error codes
+    switch(md.error_code){
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        iostats_event(stats, IOSTATS_OVERFLOW);
+        break;
+
+    default:
+        std::cerr << "Error code: " << md.error_code << std::endl;
+        std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+        exit(1);
+    }
+
+    if (not md.has_time_spec){
+        std::cerr << "Metadata missing time spec, exit test..." << std::endl;
+        exit(1);
+    }
+    iostats_rx(stats, num_rx_samps, 1, md.time_spec.get_real_secs());
+
+    return num_rx_samps;
+}
+
+// read one usrp packet as complex float
+static unsigned int usrp_recv(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+// read one usrp packet as complex int16 (interleaved I/Q)
+static unsigned int usrp_recv_sc16(short * _x,
+                                   unsigned int _n,
+                                   void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_INT16);
+}
+
+void usage() {
+    printf("multichannel_rx -- receive packets on adjacent channels\n");
+    printf("  u,h   :   usage/help\n");
+    printf("  q/v   :   quiet/verbose\n");
+    printf("  f     :   center frequency [Hz]\n");
+    printf("  b     :   bandwidth per channel [Hz] (channel spacing is 2x)\n");
+    printf("  N     :   number of channels, default: 8\n");
+    printf("  W     :   number of worker threads, default: 2\n");
+    printf("  T     :   frame type: flex, ofdm (default: flex)\n");
+    printf("  M     :   number of ofdm subcarriers, default: 48\n");
+    printf("  C     :   ofdm cyclic prefix length, default: 8\n");
+    printf("  t     :   run time [seconds]\n");
+    printf("  G     :   uhd rx gain [dB] (default: 20dB)\n");
+    printf("  S     :   squelch threshold [dB] (default: -37dB)\n");
+    printf("  I     :   receive native complex int16 (sc16) samples\n");
+    printf("  i     :   replay iqfile capture instead of usrp (see iqcapture)\n");
+}
+
+int main (int argc, char **argv)
+{
+    // command-line options
+    verbose = false;
+    unsigned long int ADC_RATE = 64e6;
+
+    // total bandwidth across all channels
+    double min_bandwidth = 0.25*(ADC_RATE / 256.0);
+    double max_bandwidth = 0.25*(ADC_RATE /   4.0);
+
+    double frequency = 462.0e6;
+    double bandwidth = 100e3;
+    unsigned int num_channels = 8;
+    unsigned int num_workers = 2;
+    int frame_type = FRAME_FLEX;
+    double num_seconds = 5.0f;
+    double uhd_rxgain = 20.0;
+    float squelch_threshold = -37.0f;
+
+    // ofdm properties
+    unsigned int M = 48;                // number of subcarriers
+    unsigned int cp_len = 8;            // cyclic prefix length
+
+    bool sc16 = false;                  // receive complex int16 samples
+    const char * replay_filename = NULL;    // iqfile capture to replay
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhqvf:b:N:W:T:M:C:t:G:S:Ii:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                        return 0;
+        case 'q':   verbose = false;                break;
+        case 'v':   verbose = true;                 break;
+        case 'I':   sc16 = true;                    break;
+        case 'i':   replay_filename = optarg;       break;
+        case 'f':   frequency = atof(optarg);       break;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 'N':   num_channels = atoi(optarg);    break;
+        case 'W':   num_workers = atoi(optarg);     break;
+        case 'T':
+            if (strcmp(optarg,"flex")==0)       frame_type = FRAME_FLEX;
+            else if (strcmp(optarg,"ofdm")==0)  frame_type = FRAME_OFDM;
+            else {
+                fprintf(stderr,"error: %s, unknown frame type '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'M':   M = atoi(optarg);               break;
+        case 'C':   cp_len = atoi(optarg);          break;
+        case 't':   num_seconds = atof(optarg);     break;
+        case 'G':   uhd_rxgain = atof(optarg);      break;
+        case 'S':   squelch_threshold = atof(optarg);   break;
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    // total bandwidth: channels are spaced at twice the symbol rate
+    double total_bandwidth = bandwidth * num_channels;
+
+    if (num_channels < 2) {
+        fprintf(stderr,"error: %s, must have at least 2 channels\n", argv[0]);
+        exit(1);
+    } else if (num_workers < 1 || num_workers > num_channels) {
+        fprintf(stderr,"error: %s, number of workers must be in [1,%u]\n", argv[0], num_channels);
+        exit(1);
+    } else if (total_bandwidth > max_bandwidth) {
+        fprintf(stderr,"error: %s, maximum total bandwidth exceeded (%8.4f MHz)\n", argv[0], max_bandwidth*1e-6);
+        exit(1);
+    } else if (total_bandwidth < min_bandwidth) {
+        fprintf(stderr,"error: %s, minimum total bandwidth exceeded (%8.4f kHz)\n", argv[0], min_bandwidth*1e-3);
+        exit(1);
+    } else if (cp_len == 0 || cp_len > M) {
+        fprintf(stderr,"error: %s, cyclic prefix must be in (0,M]\n", argv[0]);
+        exit(1);
+    }
+
+    unsigned int i;
+
+    // design rate plan: usrp decimation, half-band cascade and arbitrary
+    // resampler down to 2 samples per symbol on each channel
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*total_bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", total_bandwidth*1e-3f);
+        return 1;
+    }
+
+    uhd::usrp::single_usrp::sptr usrp;
+    iqfile_reader replay = NULL;
+    size_t max_samps_per_packet = 4096;
+    if (replay_filename != NULL) {
+        // replay capture as fast as the receiver can take it; its rate
+        // stands in for the usrp rate
+        replay = iqfile_reader_open(replay_filename);
+        iqfile_reader_print(replay);
+        struct iqfile_meta_s * meta = iqfile_reader_get_meta(replay);
+        if (meta->rate > 0.0)
+            rateplan_set_usrp_rate(&plan, meta->rate);
+        num_seconds = meta->num_samples / plan.usrp_rate;
+        sc16 = meta->format == IQFILE_FORMAT_SC16;
+    } else {
+        uhd::device_addr_t dev_addr;
+        usrp = uhd::usrp::single_usrp::make(dev_addr);
+
+        // NOTE : the sample rate computation MUST be in double precision so
+        //        that the UHD can compute its decimation rate properly
+        usrp->set_rx_rate(plan.usrp_rate);
+
+        // correct arbitrary resampling rate for actual rx rate
+        rateplan_set_usrp_rate(&plan, usrp->get_rx_rate());
+
+        usrp->set_rx_freq(frequency);
+        usrp->set_rx_gain(uhd_rxgain);
+
+        max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    }
+
+    // usrp i/o accounting
+    stats = iostats_create(plan.usrp_rate);
+
+    double spacing = 2.0*bandwidth;
+    printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
+    printf("bandwidth   :   %12.8f [kHz] x %u channels\n", bandwidth*1e-3f, num_channels);
+    printf("spacing     :   %12.8f [kHz]\n", spacing*1e-3f);
+    printf("frame type  :   %s\n", frame_type == FRAME_FLEX ? "flex" : "ofdm");
+    printf("workers     :   %u\n", num_workers);
+    printf("verbosity   :   %s\n", (verbose?"enabled":"disabled"));
+    rateplan_print(&plan);
+
+    // ofdm subcarrier allocation (as in ofdmflexframe_tx)
+    unsigned char p[M];
+    unsigned int guard = M / 6;
+    unsigned int pilot_spacing = 8;
+    unsigned int i0 = (M/2) - guard;
+    unsigned int i1 = (M/2) + guard;
+    for (i=0; i<M; i++) {
+        if ( i == 0 || (i > i0 && i < i1) )
+            p[i] = OFDMFRAME_SCTYPE_NULL;
+        else if ( (i%pilot_spacing)==0 )
+            p[i] = OFDMFRAME_SCTYPE_PILOT;
+        else
+            p[i] = OFDMFRAME_SCTYPE_DATA;
+    }
+
+    // framing properties
+    framesyncprops_s props;
+    framesyncprops_init_default(&props);
+    props.squelch_threshold = squelch_threshold;
+    props.squelch_enabled = 1;
+
+    // create channels
+    struct channel_s channels[num_channels];
+    for (i=0; i<num_channels; i++) {
+        struct channel_s * c = &channels[i];
+        c->index  = i;
+        c->offset = (i < (num_channels+1)/2 ? (double)i : (double)i - (double)num_channels) * spacing;
+        c->fs  = NULL;
+        c->ofs = NULL;
+        if (frame_type == FRAME_FLEX)
+            c->fs  = flexframesync_create(&props, callback, (void*)c);
+        else
+            c->ofs = ofdmflexframesync_create(M, cp_len, p, callback, (void*)c);
+
+        c->num_packets_received = 0;
+        c->num_valid_headers_received = 0;
+        c->num_valid_packets_received = 0;
+        c->num_bytes_received = 0;
+        c->SNRdB_av = 0.0f;
+    }
+
+    // create worker pool: worker w owns channels w, w+num_workers, ...
+    struct worker_s workers[num_workers];
+    for (i=0; i<num_workers; i++) {
+        struct worker_s * w = &workers[i];
+        w->num_channels = (num_channels - i + num_workers - 1) / num_workers;
+        w->channels = (struct channel_s**) malloc(w->num_channels*sizeof(struct channel_s*));
+        unsigned int j;
+        for (j=0; j<w->num_channels; j++)
+            w->channels[j] = &channels[i + j*num_workers];
+        w->q = blockq_create(MULTICHANNEL_NUM_BLOCKS, w->num_channels*MULTICHANNEL_BLOCK_LEN);
+        w->frame_type = frame_type;
+        w->num_blocks = 0;
+        w->block      = NULL;
+        w->running    = 1;
+        if (pthread_create(&w->thread, NULL, worker_process, (void*)w) != 0) {
+            fprintf(stderr,"error: %s, could not create worker thread\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    // analysis channelizer fed by receiver front end in blocks of
+    // MULTICHANNEL_BLOCK_LEN samples per channel
+    struct channelizer_s ch;
+    ch.channelizer  = firpfbch_crcf_create_kaiser(LIQUID_ANALYZER, num_channels, 7, 60.0f);
+    ch.num_channels = num_channels;
+    ch.y            = (std::complex<float>*) malloc(num_channels*sizeof(std::complex<float>));
+    ch.workers      = workers;
+    ch.num_workers  = num_workers;
+    rxfrontend fe = rxfrontend_create(&plan, num_channels*MULTICHANNEL_BLOCK_LEN, channelize, (void*)&ch);
+
+    //allocate recv buffer
+    std::vector<std::complex<float> > buff(max_samps_per_packet);
+    std::vector<short> buff_sc16(2*max_samps_per_packet);
+
+    // start data transfer
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+        printf("usrp data transfer started\n");
+    }
+
+    // run conditions
+    timer t0 = timer_create();
+    timer_tic(t0);
+
+    // replay runs until the capture is exhausted
+    while (replay || timer_toc(t0) < num_seconds) {
+        // grab data from port and push samples through front end; sc16
+        // conversion and scaling are fused with the first decimator
+        unsigned int num_rx_samps;
+        if (sc16) {
+            PROFILE_BEGIN(PROFILE_RECV);
+            num_rx_samps = replay ?
+                iqfile_reader_recv_sc16(&buff_sc16.front(), buff.size(), (void*)replay) :
+                usrp_recv_sc16(&buff_sc16.front(), buff.size(), (void*)usrp.get());
+            PROFILE_END(PROFILE_RECV, num_rx_samps);
+            rxfrontend_execute_sc16(fe, &buff_sc16.front(), num_rx_samps);
+        } else {
+            PROFILE_BEGIN(PROFILE_RECV);
+            num_rx_samps = replay ?
+                iqfile_reader_recv(&buff.front(), buff.size(), (void*)replay) :
+                usrp_recv(&buff.front(), buff.size(), (void*)usrp.get());
+            PROFILE_END(PROFILE_RECV, num_rx_samps);
+            rxfrontend_execute(fe, &buff.front(), num_rx_samps);
+        }
+        if (replay && num_rx_samps == 0) {
+            rxfrontend_flush(fe);
+            break;
+        }
+    }
+
+    // stop data transfer
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+        printf("\n");
+        printf("usrp data transfer complete\n");
+    }
+
+    // stop workers, letting them drain their queues
+    for (i=0; i<num_workers; i++) {
+        workers[i].running = 0;
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // print results
+    printf("  ch   offset [kHz]  packets  headers [%%]  packets [%%]       PER    SNR [dB]     bytes   rate [kbps]\n");
+    for (i=0; i<num_channels; i++) {
+        struct channel_s * c = &channels[i];
+        float data_rate = 8.0f * (float)(c->num_bytes_received) / num_seconds;
+        float percent_headers_valid = (c->num_packets_received == 0) ?
+                              0.0f :
+                              100.0f * (float)c->num_valid_headers_received / (float)c->num_packets_received;
+        float percent_packets_valid = (c->num_packets_received == 0) ?
+                              0.0f :
+                              100.0f * (float)c->num_valid_packets_received / (float)c->num_packets_received;
+        if (c->num_packets_received > 0)
+            c->SNRdB_av /= c->num_packets_received;
+        float PER = 1.0f - 0.01f*percent_packets_valid;
+        printf("  %3u  %12.3f  %7u  %10.2f  %11.2f  %8.4f  %10.4f  %8u  %12.4f\n",
+                c->index,
+                c->offset*1e-3,
+                c->num_packets_received,
+                percent_headers_valid,
+                percent_packets_valid,
+                PER,
+                c->SNRdB_av,
+                c->num_bytes_received,
+                data_rate*1e-3f);
+    }
+    for (i=0; i<num_workers; i++) {
+        printf("worker %u: %u channel(s), %lu blocks, ", i, workers[i].num_channels, workers[i].num_blocks);
+        blockq_print(workers[i].q);
+    }
+
+    // clean it up
+    rxfrontend_destroy(fe);
+    firpfbch_crcf_destroy(ch.channelizer);
+    free(ch.y);
+    for (i=0; i<num_workers; i++) {
+        blockq_destroy(workers[i].q);
+        free(workers[i].channels);
+    }
+    for (i=0; i<num_channels; i++) {
+        if (frame_type == FRAME_FLEX)
+            flexframesync_destroy(channels[i].fs);
+        else
+            ofdmflexframesync_destroy(channels[i].ofs);
+    }
+    timer_destroy(t0);
+    if (usrp)
+        iostats_print(stats);
+    iostats_destroy(stats);
+    PROFILE_PRINT();
+    if (replay)
+        iqfile_reader_close(replay);
+
+    return 0;
+}
+
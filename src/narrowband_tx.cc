@@ -28,7 +28,29 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
 #include "timer.h"
+#include "txresamp.h"
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
 
 void usage() {
     printf("narrowband_tx [OPTION]\n");
@@ -43,6 +65,8 @@ void usage() {
     printf("  t     : execute time [s], default: 10\n");
     printf("  m     : modulation scheme (qpsk default)\n");
     printf("  F     : filter type: [rrcos], rkaiser, arkaiser, hM3, gmsk, fexp, fsech, farcsech\n");
+    printf("  R     : resampler: [auto], resamp, msresamp, frontend, frontend-hb\n");
+    printf("  A     : resampler spectral mask for auto [dB], default: 50\n");
 }
 
 int main (int argc, char **argv)
@@ -69,9 +93,13 @@ int main (int argc, char **argv)
     unsigned int m = 3;         // matched-filter semi-length
     float beta = 0.3f;          // excess bandwidth factor
 
+    // resampler properties
+    int strategy = TXRESAMP_AUTO;   // resampler strategy
+    float mask = 50.0f;             // required spurious rejection [dB]
+
     //
     int d;
-    while ((d = getopt(argc,argv,"hqvf:b:g:G:t:m:F:")) != EOF) {
+    while ((d = getopt(argc,argv,"hqvf:b:g:G:t:m:F:R:A:")) != EOF) {
         switch (d) {
         case 'h':   usage();                        return 0;
         case 'q':   verbose = false;                break;
@@ -102,6 +130,14 @@ int main (int argc, char **argv)
                 exit(1);
             }
             break;
+        case 'R':
+            strategy = txresamp_str2strategy(optarg);
+            if (strategy == TXRESAMP_UNKNOWN) {
+                fprintf(stderr,"error: %s, unknown resampler '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'A':   mask = atof(optarg);            break;
         default:
             usage();
             return 0;
@@ -121,6 +157,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     // set properties
     double tx_rate = 2.0*bandwidth;
 
@@ -175,28 +214,43 @@ int main (int argc, char **argv)
     // create matched filter interpolator
     interp_crcf mfinterp = interp_crcf_create_rnyquist(ftype, 2, m, beta, 0);
 
-    // create arbitrary resampler
-#if 0
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
-#else
-    msresamp_crcf resamp = msresamp_crcf_create(tx_resamp_rate,60.0f);
-    printf("arbitrary resampling rate: %f\n", tx_resamp_rate);
-#endif
-
-    // transmitter gain (linear)
-    float g = powf(10.0f, txgain_dB/20.0f);
-
-    // buffer lengths
-    unsigned int num_symbols = 40;  // number of symbols per buffer
-    unsigned int resamp_buffer_len = 2*num_symbols*tx_resamp_rate;
-    if (resamp_buffer_len < 2*num_symbols)
-        resamp_buffer_len = 2*num_symbols;
+    // number of symbols per buffer
+    unsigned int num_symbols = 40;
+
+    // create resampler (and gain), calibrating strategies at these rates
+    // against the signal band unless one is given
+    struct txresamp_props_s props;
+    props.converter_rate = DAC_RATE;
+    props.hw_factor      = interp_rate;
+    props.usrp_rate      = usrp_tx_rate;
+    props.baseband_rate  = tx_rate;
+    props.As             = 60.0f;
+    props.gain           = powf(10.0f, txgain_dB/20.0f);
+    if (strategy == TXRESAMP_AUTO) {
+        struct txresamp_result_s results[TXRESAMP_NUM_STRATEGIES];
+        strategy = txresamp_calibrate(&props, 0.5f*(1.0f+beta)*bandwidth,
+                                      2*num_symbols, mask, results);
+        if (verbose)
+            txresamp_print_results(results, strategy);
+        printf("resampler   :   %s (%.2f ns/sample, %s%.1f dB mask)\n",
+                txresamp_strategy_str(strategy),
+                results[strategy].ns_per_sample,
+                results[strategy].mask_ok ? "meets " : "fails ",
+                mask);
+    }
+    txresamp resamp = txresamp_create(strategy, &props);
+    if (resamp == NULL) {
+        fprintf(stderr,"error: %s, resampler '%s' cannot realize rate %f\n",
+                argv[0], txresamp_strategy_str(strategy), tx_resamp_rate);
+        exit(1);
+    }
+    if (verbose)
+        txresamp_print(resamp);
 
     // buffers
     std::complex<float> buffer[num_symbols];
     std::complex<float> buffer_interp[2*num_symbols];
-    std::complex<float> buffer_resamp[resamp_buffer_len];
+    std::vector<std::complex<float> > buffer_resamp(txresamp_max_output(resamp, 2*num_symbols));
 
     // set up the metadata flags
     std::vector<std::complex<float> > buff(256);
@@ -221,32 +275,25 @@ int main (int argc, char **argv)
         for (j=0; j<num_symbols; j++)
             interp_crcf_execute(mfinterp, buffer[j], &buffer_interp[2*j]);
         
-        // resample
-        unsigned int nw;
-        unsigned int n=0;
-        for (j=0; j<2*num_symbols; j++) {
-#if 0
-            resamp_crcf_execute(resamp, buffer_interp[j], &buffer_resamp[n], &nw);
-#else
-            msresamp_crcf_execute(resamp, &buffer_interp[j], 1, &buffer_resamp[n], &nw);
-#endif
-            n += nw;
-        }
+        // resample and scale
+        unsigned int n = txresamp_execute(resamp, buffer_interp, 2*num_symbols, &buffer_resamp.front());
 
         // push samples into buffer
         for (j=0; j<n; j++) {
-            buff[tx_buffer_samples++] = g*buffer_resamp[j];
+            buff[tx_buffer_samples++] = buffer_resamp[j];
 
             if (tx_buffer_samples==256) {
                 // reset counter
                 tx_buffer_samples=0;
 
                 //send the entire contents of the buffer
-                usrp->get_device()->send(
+                size_t num_tx_samps = usrp->get_device()->send(
                     &buff.front(), buff.size(), md,
                     uhd::io_type_t::COMPLEX_FLOAT32,
                     uhd::device::SEND_MODE_FULL_BUFF
                 );
+                iostats_tx(stats, num_tx_samps);
+                usrp_poll_async(usrp.get(), stats);
             }
         }
 
@@ -268,17 +315,16 @@ int main (int argc, char **argv)
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
 
     // clean it up
-#if 0
-    resamp_crcf_destroy(resamp);
-#else
-    msresamp_crcf_destroy(resamp);
-#endif
+    txresamp_destroy(resamp);
     modem_destroy(mod);
     interp_crcf_destroy(mfinterp);
     timer_destroy(t0);
 
+    iostats_destroy(stats);
     return 0;
 }
 
@@ -24,14 +24,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
-#include <assert.h>
 #include <liquid/liquid.h>
 
 #include <uhd/usrp/single_usrp.hpp>
+
+#include "framelog.h"
+#include "iostats.h"
+#include "iqfile.h"
+#include "profile.h"
+#include "rxfrontend.h"
+#include "rxpipe.h"
  
 #include "timer.h"
 
 static bool verbose;
+static iostats stats;               // usrp i/o accounting
+static framelog flog = NULL;        // per-frame statistics log
+static rxfrontend frontend = NULL;  // front end (direct receiver)
+static rxpipe pipeline = NULL;      // pipelined receiver
+static unsigned long int num_lost_samples; // lost samples skipped
 
 // data counters
 unsigned int num_frames_detected;
@@ -48,6 +59,14 @@ int callback(unsigned char *  _header,
              framesyncstats_s _stats,
              void *           _userdata)
 {
+    // log frame, stamped with the time of the start of its block (raw
+    // position, so that gated and lost samples are counted)
+    if (flog != NULL) {
+        double t = pipeline != NULL ? rxpipe_get_time(pipeline) : rxfrontend_get_time(frontend);
+        framelog_push_frame(flog, t,
+                            _header, _header_valid, _payload_len, _payload_valid, &_stats);
+    }
+
     if (verbose) {
         // compute true carrier offset
         double samplerate = *((double*)_userdata);
@@ -79,6 +98,80 @@ int callback(unsigned char *  _header,
     return 0;
 }
 
+// push block of baseband samples through frame synchronizer
+static void rx_sink(std::complex<float> * _x,
+                    unsigned int _n,
+                    void * _userdata)
+{
+    PROFILE_BEGIN(PROFILE_SYNC);
+    ofdmflexframesync_execute((ofdmflexframesync)_userdata, _x, _n);
+    PROFILE_END(PROFILE_SYNC, _n);
+}
+
+// advance front end past samples the usrp time stamps report lost
+static void rx_skip_lost(rxfrontend _fe)
+{
+    struct iostats_counters_s c;
+    iostats_get_counters(stats, &c);
+    rxfrontend_skip(_fe, c.num_lost_samples - num_lost_samples);
+    num_lost_samples = c.num_lost_samples;
+}
+
+// read one usrp packet into buffer in wire format _io_type, returning
+// number of samples
+static unsigned int usrp_recv_io(void * _x,
+                                 unsigned int _n,
+                                 void * _userdata,
+                                 const uhd::io_type_t & _io_type)
+{
+    uhd::usrp::single_usrp * usrp = (uhd::usrp::single_usrp*) _userdata;
+
+    uhd::rx_metadata_t md;
+    size_t num_rx_samps = usrp->get_device()->recv(
+        _x, _n, md,
+        _io_type,
+        uhd::device::RECV_MODE_ONE_PACKET
+    );
+
+    //handle the error codes
+    switch(md.error_code){
+    case uhd::rx_metadata_t::ERROR_CODE_NONE:
+        break;
+    case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+        iostats_event(stats, IOSTATS_OVERFLOW);
+        break;
+
+    default:
+        std::cerr << "Error code: " << md.error_code << std::endl;
+        std::cerr << "Unexpected error on recv, exit test..." << std::endl;
+        exit(1);
+    }
+
+    if (not md.has_time_spec){
+        std::cerr << "Metadata missing time spec, exit test..." << std::endl;
+        exit(1);
+    }
+    iostats_rx(stats, num_rx_samps, 1, md.time_spec.get_real_secs());
+
+    return num_rx_samps;
+}
+
+// read one usrp packet as complex float
+static unsigned int usrp_recv(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+// read one usrp packet as complex int16 (interleaved I/Q)
+static unsigned int usrp_recv_sc16(short * _x,
+                                   unsigned int _n,
+                                   void * _userdata)
+{
+    return usrp_recv_io(_x, _n, _userdata, uhd::io_type_t::COMPLEX_INT16);
+}
+
 void usage() {
     printf("ofdmflexframe_rx -- receive OFDM packets\n");
     printf("  u,h   :   usage/help\n");
@@ -90,6 +183,12 @@ void usage() {
     printf("  C     :   cyclic prefix length, default: 16\n");
     printf("  t     :   run time [seconds]\n");
     printf("  z     :   number of subcarriers to notch in the center band, default: 0\n");
+    printf("  I     :   receive native complex int16 (sc16) samples\n");
+    printf("  P     :   pipelined receiver (capture/resample/sync threads)\n");
+    printf("  A     :   pipeline cpu affinity <capture,resamp,sync>, e.g. 0,1,2\n");
+    printf("  i     :   replay iqfile capture instead of usrp (see iqcapture)\n");
+    printf("  E     :   energy gate threshold over noise floor [dB] (default: off)\n");
+    printf("  L     :   append binary per-frame statistics to log (see framelog_summary)\n");
 }
 
 int main (int argc, char **argv)
@@ -115,14 +214,33 @@ int main (int argc, char **argv)
 
     unsigned int num_notched = 0;       // number of subcarrier in the center band to notch
 
+    bool pipelined = false;             // pipelined receiver
+    int affinity[RXPIPE_NUM_STAGES] = {-1,-1,-1};  // stage cpu affinity
+
+    bool sc16 = false;                  // receive complex int16 samples
+    float gate_threshold = 0.0f;        // energy gate threshold [dB] (0: off)
+    const char * replay_filename = NULL;    // iqfile capture to replay
+    const char * framelog_filename = NULL;  // frame statistics log
+
     //
     int d;
-    while ((d = getopt(argc,argv,"uhqvf:b:G:M:C:t:m:p:z:")) != EOF) {
+    while ((d = getopt(argc,argv,"uhqvf:b:G:M:C:t:m:p:z:PA:Ii:L:E:")) != EOF) {
         switch (d) {
         case 'u':
         case 'h':   usage();                        return 0;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
+        case 'I':   sc16 = true;                    break;
+        case 'P':   pipelined = true;               break;
+        case 'i':   replay_filename = optarg;       break;
+        case 'E':   gate_threshold = atof(optarg);  break;
+        case 'L':   framelog_filename = optarg;     break;
+        case 'A':
+            if (sscanf(optarg,"%d,%d,%d",&affinity[0],&affinity[1],&affinity[2]) != 3) {
+                fprintf(stderr,"error: %s, affinity must be <capture,resamp,sync>\n", argv[0]);
+                exit(1);
+            }
+            break;
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
         case 'G':   uhd_rxgain = atof(optarg);      break;
@@ -157,62 +275,73 @@ int main (int argc, char **argv)
         exit(1);
     }
 
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    // design rate plan: usrp decimation, half-band cascade and arbitrary
+    // resampler down to 2 samples per symbol at the synchronizer
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: no rate plan for bandwidth %8.4f kHz\n", bandwidth*1e-3f);
+        return 1;
+    }
+
+    uhd::usrp::single_usrp::sptr usrp;
+    iqfile_reader replay = NULL;
+    size_t max_samps_per_packet = 4096;
+    if (replay_filename != NULL) {
+        // replay capture as fast as the receiver can take it; its rate
+        // stands in for the usrp rate
+        replay = iqfile_reader_open(replay_filename);
+        iqfile_reader_print(replay);
+        struct iqfile_meta_s * meta = iqfile_reader_get_meta(replay);
+        if (meta->rate > 0.0)
+            rateplan_set_usrp_rate(&plan, meta->rate);
+        num_seconds = (float)(meta->num_samples / plan.usrp_rate);
+        sc16 = meta->format == IQFILE_FORMAT_SC16;
+        if (pipelined) {
+            printf("warning: replay runs in a single thread, ignoring -P\n");
+            pipelined = false;
+        }
+    } else {
+        uhd::device_addr_t dev_addr;
+        usrp = uhd::usrp::single_usrp::make(dev_addr);
+
+        // NOTE : the sample rate computation MUST be in double precision so
+        //        that the UHD can compute its decimation rate properly
+        usrp->set_rx_rate(plan.usrp_rate);
 
-    stream_cmd.stream_now = true;
+        // correct arbitrary resampling rate for actual rx rate
+        rateplan_set_usrp_rate(&plan, usrp->get_rx_rate());
 
-    uhd::device_addr_t dev_addr;
-    uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
+        usrp->set_rx_freq(frequency);
+        usrp->set_rx_gain(uhd_rxgain);
 
-    // set properties
-    double rx_rate = 4.0f*bandwidth;
-    // NOTE : the sample rate computation MUST be in double precision so
-    //        that the UHD can compute its decimation rate properly
-    unsigned int decim_rate = (unsigned int)(ADC_RATE / rx_rate);
-    // ensure multiple of 2
-    decim_rate = (decim_rate >> 1) << 1;
-    // compute usrp sampling rate
-    double usrp_rx_rate = ADC_RATE / (float)decim_rate;
-    
-    // try to set rx rate
-    usrp->set_rx_rate(ADC_RATE / decim_rate);
+        max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    }
 
-    // get actual rx rate
-    usrp_rx_rate = usrp->get_rx_rate();
+    // usrp i/o accounting
+    stats = iostats_create(plan.usrp_rate);
 
-    // compute arbitrary resampling rate
-    double rx_resamp_rate = rx_rate / usrp_rx_rate;
+    // frame statistics log
+    if (framelog_filename != NULL)
+        flog = framelog_create(framelog_filename, plan.baseband_rate, 4096);
 
-    usrp->set_rx_freq(frequency);
-    usrp->set_rx_gain(uhd_rxgain);
+    // sample source: usrp or capture
+    rxpipe_recv      recv      = replay ? iqfile_reader_recv      : usrp_recv;
+    rxpipe_recv_sc16 recv_sc16 = replay ? iqfile_reader_recv_sc16 : usrp_recv_sc16;
+    void * recv_userdata       = replay ? (void*)replay           : (void*)usrp.get();
 
     printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
     printf("bandwidth   :   %12.8f [kHz]\n", bandwidth*1e-3f);
     printf("verbosity   :   %s\n", (verbose?"enabled":"disabled"));
-    printf("sample rate :   %12.8f kHz = %12.8f * %8.6f (decim %u)\n",
-            rx_rate * 1e-3f,
-            usrp_rx_rate * 1e-3f,
-            rx_resamp_rate,
-            decim_rate);
     if (num_seconds >= 0)
         printf("run time    :   %f seconds\n", num_seconds);
     else
         printf("run time    :   (forever)\n");
 
-    // add arbitrary resampling block
-    resamp_crcf resamp = resamp_crcf_create(rx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, rx_resamp_rate);
-
-    unsigned int block_len = 64;
-    assert( (block_len % 2) == 0);  // ensure block length is even
+    unsigned int block_len = 1024;  // front end output block length
 
-    //allocate recv buffer and metatdata
-    uhd::rx_metadata_t md;
-    const size_t max_samps_per_packet = usrp->get_device()->get_max_recv_samps_per_packet();
+    //allocate recv buffer
     std::vector<std::complex<float> > buff(max_samps_per_packet);
-
-    // half-band decimator
-    resamp2_crcf decim = resamp2_crcf_create(7,0.0f,40.0f);
+    std::vector<short> buff_sc16(2*max_samps_per_packet);
 
     // initialize subcarrier allocation
     unsigned char p[M];
@@ -240,13 +369,37 @@ int main (int argc, char **argv)
     ofdmflexframesync fs = ofdmflexframesync_create(M, cp_len, p, callback, (void*)&bandwidth);
     ofdmflexframesync_print(fs);
 
+    // receiver front end, feeding synchronizer in blocks of block_len samples
+    rateplan_print(&plan);
+    rxfrontend fe = pipelined ? NULL : rxfrontend_create(&plan, block_len, rx_sink, (void*)fs);
+
+    // pipelined receiver: capture, front end and synchronizer threads
+    rxpipe pipe = NULL;
+    if (pipelined) {
+        int stage;
+        pipe = rxpipe_create(&plan, max_samps_per_packet, block_len, 64,
+                             usrp_recv, (void*)usrp.get(), rx_sink, (void*)fs);
+        for (stage=0; stage<RXPIPE_NUM_STAGES; stage++)
+            rxpipe_set_affinity(pipe, stage, affinity[stage]);
+        if (sc16)
+            rxpipe_set_recv_sc16(pipe, usrp_recv_sc16);
+        rxpipe_set_iostats(pipe, stats);
+    }
+    frontend = fe;
+    pipeline = pipe;
+
+    // energy gate, keeping 1024 baseband samples' worth of pre-trigger
+    // history
+    if (gate_threshold > 0.0f) {
+        rxfrontend_set_gate(pipelined ? rxpipe_get_frontend(pipe) : fe, gate_threshold,
+                            (unsigned int)(1024 * plan.usrp_rate / plan.baseband_rate));
+    }
+
     // start data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-    printf("usrp data transfer started\n");
- 
-    std::complex<float> data_rx[block_len];
-    std::complex<float> data_decim[block_len/2];
-    std::complex<float> data_resamp[block_len];
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+        printf("usrp data transfer started\n");
+    }
  
     // reset counters
     num_frames_detected=0;
@@ -259,70 +412,56 @@ int main (int argc, char **argv)
     timer t0 = timer_create();
     timer_tic(t0);
 
-    unsigned int n=0;
-    while (continue_running) {
-        // grab data from port
-        size_t num_rx_samps = usrp->get_device()->recv(
-            &buff.front(), buff.size(), md,
-            uhd::io_type_t::COMPLEX_FLOAT32,
-            uhd::device::RECV_MODE_ONE_PACKET
-        );
-
-        //handle the error codes
-        switch(md.error_code){
-        case uhd::rx_metadata_t::ERROR_CODE_NONE:
-        case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
-            break;
+    if (pipelined)
+        rxpipe_start(pipe);
 
-        default:
-            std::cerr << "Error code: " << md.error_code << std::endl;
-            std::cerr << "Unexpected error on recv, exit test..." << std::endl;
-            return 1;
-        }
+    while (continue_running) {
+        if (pipelined) {
+            // capture, resampler and synchronizer run in their own threads
+            usleep(100000);
+        } else {
+            // grab data from port and push samples through front end; sc16
+            // conversion and scaling are fused with the first decimator
+            unsigned int num_rx_samps;
+            if (sc16) {
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv_sc16(&buff_sc16.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rx_skip_lost(fe);
+                rxfrontend_execute_sc16(fe, &buff_sc16.front(), num_rx_samps);
+            } else {
+                // TODO : apply bandwidth-dependent gain
+                PROFILE_BEGIN(PROFILE_RECV);
+                num_rx_samps = recv(&buff.front(), buff.size(), recv_userdata);
+                PROFILE_END(PROFILE_RECV, num_rx_samps);
+                rx_skip_lost(fe);
+                rxfrontend_execute(fe, &buff.front(), num_rx_samps);
+            }
 
-        // for now copy vector "buff" to array of complex float
-        // TODO : apply bandwidth-dependent gain
-        unsigned int j;
-        unsigned int nw=0;
-        for (j=0; j<num_rx_samps; j++) {
-            // push samples into buffer
-            data_rx[n++] = buff[j];
-
-            if (n==block_len) {
-                // reset counter
-                n=0;
-
-                // decimate to block_len/2
-                unsigned int k;
-                for (k=0; k<block_len/2; k++)
-                    resamp2_crcf_decim_execute(decim, &data_rx[2*k], &data_decim[k]);
-
-                // apply resampler
-                for (k=0; k<block_len/2; k++) {
-                    resamp_crcf_execute(resamp, data_decim[k], &data_resamp[n], &nw);
-                    n += nw;
-                }
-
-                // push through synchronizer
-                ofdmflexframesync_execute(fs, data_resamp, n);
-
-                // reset counter (again)
-                n = 0;
+            // replay runs until the capture is exhausted
+            if (replay && num_rx_samps == 0) {
+                rxfrontend_flush(fe);
+                continue_running = 0;
             }
         }
 
         // check runtime
-        if (timer_toc(t0) >= num_seconds)
+        if (!replay && timer_toc(t0) >= num_seconds)
             continue_running = 0;
     }
  
+    if (pipelined)
+        rxpipe_stop(pipe);
+
     // compute actual run-time
     float runtime = timer_toc(t0);
 
     // stop data transfer
-    usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
-    printf("\n");
-    printf("usrp data transfer complete\n");
+    if (usrp) {
+        usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+        printf("\n");
+        printf("usrp data transfer complete\n");
+    }
  
     // print results
     float data_rate = num_valid_bytes_received * 8.0f / num_seconds;
@@ -340,10 +479,26 @@ int main (int argc, char **argv)
     printf("    data rate           : %8.4f kbps\n", data_rate*1e-3f);
 
     // destroy objects
-    resamp_crcf_destroy(resamp);
-    resamp2_crcf_destroy(decim);
+    if (pipelined) {
+        rxpipe_print(pipe);
+        rxpipe_destroy(pipe);
+    } else {
+        if (gate_threshold > 0.0f)
+            rxfrontend_print(fe);
+        rxfrontend_destroy(fe);
+    }
     ofdmflexframesync_destroy(fs);
     timer_destroy(t0);
+    if (usrp)
+        iostats_print(stats);
+    iostats_destroy(stats);
+    PROFILE_PRINT();
+    if (flog != NULL) {
+        framelog_print(flog);
+        framelog_destroy(flog);
+    }
+    if (replay)
+        iqfile_reader_close(replay);
 
     return 0;
 }
@@ -28,6 +28,130 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
+#include "rateplan.h"
+#include "sc16.h"
+#include "txfrontend.h"
+#include "txpipe.h"
+
+// per-worker frame generation state
+struct txworker_s {
+    ofdmflexframegen fg;            // frame generator
+    txfrontend fe;                  // interpolator, resampler and gain
+    std::complex<float> * buffer;   // ofdm symbol [size: M+cp_len]
+    unsigned char * payload;        // payload [size: payload_len]
+    unsigned int seed;              // random data seed
+};
+
+// frame generation, shared by all workers
+struct txframe_s {
+    struct txworker_s * worker;     // per-worker state [size: num_workers]
+    unsigned int symbol_len;        // samples per ofdm symbol (M+cp_len)
+    unsigned int payload_len;       // payload length [bytes]
+    bool verbose;                   // print packet ids
+};
+
+// usrp transmit state, used by sender thread
+struct txsend_s {
+    uhd::usrp::single_usrp * usrp;  // usrp
+    uhd::tx_metadata_t md;          // continuous (no burst flags)
+    iostats stats;                  // usrp i/o accounting
+};
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
+
+// txpipe generator: assemble frame _seq with worker's frame generator,
+// followed by one zero symbol to flush the front end, so that frames
+// from different workers do not depend on each other
+static unsigned int ofdmflexframe_generate(unsigned int _worker,
+                                           unsigned long int _seq,
+                                           std::complex<float> * _y,
+                                           unsigned int _n,
+                                           void * _userdata)
+{
+    struct txframe_s * f = (struct txframe_s*) _userdata;
+    struct txworker_s * w = &f->worker[_worker];
+    unsigned int pid = _seq & 0xffff;
+    unsigned char header[8];
+    unsigned int j;
+
+    // reset frame generator (resets pilot generator, etc.)
+    ofdmflexframegen_reset(w->fg);
+
+    if (f->verbose)
+        printf("tx packet id: %6u\n", pid);
+
+    // write header (first two bytes packet ID, remaining are random)
+    header[0] = (pid >> 8) & 0xff;
+    header[1] = (pid     ) & 0xff;
+    for (j=2; j<8; j++)
+        header[j] = rand_r(&w->seed) & 0xff;
+
+    // initialize payload
+    for (j=0; j<f->payload_len; j++)
+        w->payload[j] = rand_r(&w->seed) & 0xff;
+
+    // assemble frame
+    ofdmflexframegen_assemble(w->fg, header, w->payload, f->payload_len);
+
+    // generate frame
+    int last_symbol=0;
+    unsigned int zero_pad=1;
+    unsigned int num_samples;
+    unsigned int n=0;
+    while (!last_symbol || zero_pad > 0) {
+        if (!last_symbol) {
+            // generate symbol
+            last_symbol = ofdmflexframegen_writesymbol(w->fg, w->buffer, &num_samples);
+        } else {
+            zero_pad--;
+            num_samples = f->symbol_len;
+            for (j=0; j<num_samples; j++)
+                w->buffer[j] = 0.0f;
+        }
+
+        // interpolate, resample and apply gain
+        n += txfrontend_execute(w->fe, w->buffer, num_samples, &_y[n]);
+    }
+
+    return n;
+}
+
+// txpipe send callback: stream samples to usrp
+static unsigned int usrp_send(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    struct txsend_s * s = (struct txsend_s*) _userdata;
+
+    size_t num_tx_samps = s->usrp->get_device()->send(
+        _x, _n, s->md,
+        uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::SEND_MODE_FULL_BUFF
+    );
+    iostats_tx(s->stats, num_tx_samps);
+    usrp_poll_async(s->usrp, s->stats);
+    return num_tx_samps;
+}
+
 void usage() {
     printf("ofdmflexframe_tx [OPTION]\n");
     printf("transmit OFDM packets\n");
@@ -48,6 +172,8 @@ void usage() {
     printf("  k     : coding scheme (outer): none default\n");
     liquid_print_fec_schemes();
     printf("  z     : number of subcarriers to notch in the center band, default: 0\n");
+    printf("  W     : number of frame generator threads, default: 2\n");
+    printf("  D     : look-ahead depth [frames], default: 8\n");
 }
 
 int main (int argc, char **argv)
@@ -79,9 +205,12 @@ int main (int argc, char **argv)
     
     unsigned int num_notched = 0;       // number of subcarrier in the center band to notch
 
+    unsigned int num_workers = 2;       // frame generator threads
+    unsigned int depth = 8;             // frames generated ahead of sender
+
     //
     int d;
-    while ((d = getopt(argc,argv,"uhqvf:b:g:G:N:M:C:P:m:c:k:z:")) != EOF) {
+    while ((d = getopt(argc,argv,"uhqvf:b:g:G:N:M:C:P:m:c:k:z:W:D:")) != EOF) {
         switch (d) {
         case 'u':
         case 'h':   usage();                        return 0;
@@ -121,6 +250,8 @@ int main (int argc, char **argv)
         case 'z':
             num_notched = atoi(optarg);
             break;
+        case 'W':   num_workers = atoi(optarg);     break;
+        case 'D':   depth = atoi(optarg);           break;
         default:
             usage();
             return 0;
@@ -138,6 +269,9 @@ int main (int argc, char **argv)
     } else if (cp_len == 0 || cp_len > M) {
         fprintf(stderr,"error: %s, cyclic prefix must be in (0,M]\n", argv[0]);
         exit(1);
+    } else if (num_workers == 0 || depth == 0) {
+        fprintf(stderr,"error: %s, number of workers and look-ahead depth must be greater than zero\n", argv[0]);
+        exit(1);
     }
 
     uhd::device_addr_t dev_addr;
@@ -145,6 +279,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     // set properties
     double tx_rate = 4.0*bandwidth;
 
@@ -188,16 +325,18 @@ int main (int argc, char **argv)
     //usrp->set_tx_bandwidth(2.0f*tx_rate);
 
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
-
-    // half-band resampler
-    resamp2_crcf interp = resamp2_crcf_create(7,0.0f,40.0f);
-
     // transmitter gain (linear)
     float g = powf(10.0f, txgain_dB/20.0f);
 
+    // transmit front end: half-band interpolator, arbitrary resampler
+    // and gain, at the usrp rate actually set
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no transmit front end for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
+
     // initialize subcarrier allocation
     unsigned char p[M];
     unsigned int guard = M / 6;
@@ -220,11 +359,7 @@ int main (int argc, char **argv)
     unsigned int M_data=0;
     ofdmframe_validate_sctype(p,M, &M_null, &M_pilot, &M_data);
 
-    // data arrays
-    unsigned char header[8];
-    unsigned char payload[payload_len];
-    
-    // create frame generator
+    // frame generator properties
     ofdmflexframegenprops_s fgprops;
     ofdmflexframegenprops_init_default(&fgprops);
     fgprops.num_symbols_S0  = num_symbols_S0;
@@ -233,99 +368,55 @@ int main (int argc, char **argv)
     fgprops.fec1            = fec1;
     fgprops.mod_scheme      = ms;
     fgprops.mod_bps         = bps;
-    ofdmflexframegen fg = ofdmflexframegen_create(M, cp_len, p, &fgprops);
-    ofdmflexframegen_print(fg);
 
-    // arrays
-    std::complex<float> buffer[M+cp_len];    // output time series
-    std::complex<float> buffer_interp[2*(M+cp_len)];
-    std::complex<float> buffer_resamp[3*(M+cp_len)];
+    // each worker has its own frame generator and front end
+    struct txframe_s txframe;
+    txframe.worker      = (struct txworker_s*) malloc(num_workers*sizeof(struct txworker_s));
+    txframe.symbol_len  = M + cp_len;
+    txframe.payload_len = payload_len;
+    txframe.verbose     = verbose;
+    for (i=0; i<num_workers; i++) {
+        struct txworker_s * w = &txframe.worker[i];
+        w->fg      = ofdmflexframegen_create(M, cp_len, p, &fgprops);
+        w->fe      = txfrontend_create(&plan, g, SC16_ISA_AUTO);
+        w->buffer  = (std::complex<float>*) malloc((M+cp_len)*sizeof(std::complex<float>));
+        w->payload = (unsigned char*) malloc(payload_len*sizeof(unsigned char));
+        w->seed    = i + 1;
+    }
+    ofdmflexframegen_print(txframe.worker[0].fg);
+    txfrontend_print(txframe.worker[0].fe);
+
+    // count symbols in frame, including zero pad, to size frame buffers
+    unsigned char header[8] = {0};
+    unsigned int num_symbols = 1;
+    unsigned int num_samples;
+    for (i=0; i<payload_len; i++)
+        txframe.worker[0].payload[i] = 0;
+    ofdmflexframegen_assemble(txframe.worker[0].fg, header, txframe.worker[0].payload, payload_len);
+    while (!ofdmflexframegen_writesymbol(txframe.worker[0].fg, txframe.worker[0].buffer, &num_samples))
+        num_symbols++;
+    num_symbols++;
+    unsigned int frame_len = num_symbols*txfrontend_max_output(txframe.worker[0].fe, M+cp_len);
 
     // set up the metadta flags
-    std::vector<std::complex<float> > buff(256);
-    unsigned int tx_buffer_samples;
-    uhd::tx_metadata_t md;
-    md.start_of_burst = false;  // never SOB when continuous
-    md.end_of_burst   = false;  // 
-    md.has_time_spec  = false;  // set to false to send immediately
-
-    unsigned int j;
-    unsigned int pid;
-    tx_buffer_samples=0;
-    for (pid=0; pid<num_frames; pid++) {
-        // reset frame generator (resets pilot generator, etc.)
-        ofdmflexframegen_reset(fg);
-
-        if (verbose)
-            printf("tx packet id: %6u\n", pid);
-        
-        // write header (first two bytes packet ID, remaining are random)
-        header[0] = (pid >> 8) & 0xff;
-        header[1] = (pid     ) & 0xff;
-        for (j=2; j<8; j++)
-            header[j] = rand() & 0xff;
-
-        // initialize payload
-        for (j=0; j<payload_len; j++)
-            payload[j] = rand() & 0xff;
-
-        // assemble frame
-        ofdmflexframegen_assemble(fg, header, payload, payload_len);
-
-        // generate frame
-        int last_symbol=0;
-        unsigned int zero_pad=1;
-        unsigned int num_samples;
-        while (!last_symbol || zero_pad > 0) {
-            if (!last_symbol) {
-                // generate symbol
-                last_symbol = ofdmflexframegen_writesymbol(fg, buffer, &num_samples);
-            } else {
-                zero_pad--;
-                num_samples = M+cp_len;
-                for (j=0; j<num_samples; j++)
-                    buffer[j] = 0.0f;
-            }
-
-            // interpolate by 2
-            for (j=0; j<num_samples; j++)
-                resamp2_crcf_interp_execute(interp, buffer[j], &buffer_interp[2*j]);
-            
-            // resample
-            unsigned int nw;
-            unsigned int n=0;
-            for (j=0; j<2*num_samples; j++) {
-                resamp_crcf_execute(resamp, buffer_interp[j], &buffer_resamp[n], &nw);
-                n += nw;
-            }
-
-            // push samples into buffer
-            for (j=0; j<n; j++) {
-                buff[tx_buffer_samples++] = g*buffer_resamp[j];
-
-                if (tx_buffer_samples==256) {
-                    // reset counter
-                    tx_buffer_samples=0;
-
-                    //send the entire contents of the buffer
-                    usrp->get_device()->send(
-                        &buff.front(), buff.size(), md,
-                        uhd::io_type_t::COMPLEX_FLOAT32,
-                        uhd::device::SEND_MODE_FULL_BUFF
-                    );
-                }
-            }
-        }
-
-
-#if 0
-        // pad remaining samples with zeros
-        for (j=num_samples; j<frame_len; j++)
-            frame[j] = 0.0f;
-#endif
-    }
+    struct txsend_s txsend;
+    txsend.usrp  = usrp.get();
+    txsend.stats = stats;
+    txsend.md.start_of_burst = false;  // never SOB when continuous
+    txsend.md.end_of_burst   = false;  // 
+    txsend.md.has_time_spec  = false;  // set to false to send immediately
+
+    // generate frames ahead of time in worker threads, sending them in
+    // order from a single sender thread
+    txpipe pipe = txpipe_create(num_workers, depth, frame_len,
+                                ofdmflexframe_generate, (void*)&txframe,
+                                usrp_send, (void*)&txsend);
+    txpipe_start(pipe, num_frames);
+    txpipe_wait(pipe);
+    txpipe_print(pipe);
  
     // send a mini EOB packet
+    uhd::tx_metadata_t md;
     md.start_of_burst = false;
     md.end_of_burst   = true;
     usrp->get_device()->send("", 0, md,
@@ -339,12 +430,20 @@ int main (int argc, char **argv)
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
 
     // clean it up
-    ofdmflexframegen_destroy(fg);
-    resamp2_crcf_destroy(interp);
-    resamp_crcf_destroy(resamp);
+    txpipe_destroy(pipe);
+    for (i=0; i<num_workers; i++) {
+        ofdmflexframegen_destroy(txframe.worker[i].fg);
+        txfrontend_destroy(txframe.worker[i].fe);
+        free(txframe.worker[i].buffer);
+        free(txframe.worker[i].payload);
+    }
+    free(txframe.worker);
 
+    iostats_destroy(stats);
     return 0;
 }
 
@@ -29,6 +29,99 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
+#include "rateplan.h"
+#include "sc16.h"
+#include "txfrontend.h"
+#include "txloop.h"
+
+// loop mode frame rendering state
+struct txrender_s {
+    framegen64 framegen;            // frame generator
+    txfrontend fe;                  // interpolator, resampler and gain
+    std::complex<float> * frame;    // frame [size: frame_len]
+    unsigned int frame_len;         // frame length [samples]
+    unsigned int packet_spacing;    // silent blocks after each frame
+    bool verbose;                   // print packet ids
+};
+
+// usrp transmit state
+struct txsend_s {
+    uhd::usrp::single_usrp * usrp;  // usrp
+    uhd::tx_metadata_t md;          // continuous (no burst flags)
+    iostats stats;                  // usrp i/o accounting
+};
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
+
+// txloop render callback: frame _k followed by packet_spacing blocks of
+// silence
+static unsigned int packet_render(unsigned int _k,
+                                  std::complex<float> * _y,
+                                  unsigned int _n,
+                                  void * _userdata)
+{
+    struct txrender_s * r = (struct txrender_s*) _userdata;
+    unsigned char header[24];
+    unsigned char payload[64];
+    unsigned int i, j;
+
+    // generate random data
+    for (j=0; j<24; j++)    header[j]  = rand() % 256;
+    for (j=0; j<64; j++)    payload[j] = rand() % 256;
+    header[0] = (_k >> 8) & 0x00ff;
+    header[1] = (_k     ) & 0x00ff;
+    if (r->verbose)
+        printf("packet id: %u\n", _k);
+
+    unsigned int n = 0;
+    for (i=0; i<=r->packet_spacing; i++) {
+        if (i == 0) {
+            framegen64_execute(r->framegen, header, payload, r->frame);
+        } else {
+            for (j=0; j<r->frame_len; j++)
+                r->frame[j] = 0.0f;
+        }
+        n += txfrontend_execute(r->fe, r->frame, r->frame_len, &_y[n]);
+    }
+    return n;
+}
+
+// txloop send callback: stream samples to usrp
+static unsigned int usrp_send(std::complex<float> * _x,
+                              unsigned int _n,
+                              void * _userdata)
+{
+    struct txsend_s * s = (struct txsend_s*) _userdata;
+
+    size_t num_tx_samps = s->usrp->get_device()->send(
+        _x, _n, s->md,
+        uhd::io_type_t::COMPLEX_FLOAT32,
+        uhd::device::SEND_MODE_FULL_BUFF
+    );
+    iostats_tx(s->stats, num_tx_samps);
+    usrp_poll_async(s->usrp, s->stats);
+    return num_tx_samps;
+}
+
 void usage() {
     printf("packet_tx:\n");
     printf("  f     :   center frequency [Hz] (default: 462 MHz)\n");
@@ -37,6 +130,8 @@ void usage() {
     printf("  g     :   software transmit power gain [dB] (default: -3dB)\n");
     printf("  G     :   uhd tx gain [dB] (default: -40dB)\n");
     printf("  t     :   run time [seconds] (default: 5.0)\n");
+    printf("  K     :   loop mode: render K frames once and repeat them (default: 0, off)\n");
+    printf("  l     :   loop mode: lock frames in memory\n");
     printf("  q     :   quiet\n");
     printf("  v     :   verbose\n");
     printf("  u,h   :   usage/help\n");
@@ -58,10 +153,12 @@ int main (int argc, char **argv)
     double uhd_txgain = -40.0;
 
     unsigned int packet_spacing=1;
+    unsigned int num_loop_frames=0;     // loop mode frames (0: off)
+    bool loop_lock = false;             // lock loop buffer in memory
 
     //
     int d;
-    while ((d = getopt(argc,argv,"f:b:p:g:G:t:qvuh")) != EOF) {
+    while ((d = getopt(argc,argv,"f:b:p:g:G:t:K:lqvuh")) != EOF) {
         switch (d) {
         case 'f':   frequency = atof(optarg);       break;
         case 'b':   bandwidth = atof(optarg);       break;
@@ -69,6 +166,8 @@ int main (int argc, char **argv)
         case 'g':   txgain_dB = atof(optarg);       break;
         case 'G':   uhd_txgain = atof(optarg);      break;
         case 't':   num_seconds = atof(optarg);     break;
+        case 'K':   num_loop_frames = atoi(optarg); break;
+        case 'l':   loop_lock = true;               break;
         case 'q':   verbose = false;                break;
         case 'v':   verbose = true;                 break;
         case 'u':
@@ -92,6 +191,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     printf("frequency   :   %12.8f [MHz]\n", frequency*1e-6f);
     printf("bandwidth   :   %12.8f [kHz]\n", bandwidth*1e-3f);
     printf("tx gain     :   %12.8f [dB]\n", txgain_dB);
@@ -127,13 +229,6 @@ int main (int argc, char **argv)
 
     //assert(tx_resamp_rate <= 1.0);
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
-
-    // half-band resampler
-    resamp2_crcf interp = resamp2_crcf_create(7,0.0f,40.0f);
-
     // framegen parameters
     //unsigned int k=2; // samples per symbol
     unsigned int m=3; // filter delay
@@ -141,6 +236,17 @@ int main (int argc, char **argv)
 
     // transmitter gain (linear)
     float g = powf(10.0f, txgain_dB/20.0f);
+
+    // transmit front end: half-band interpolator, arbitrary resampler
+    // and gain, at the usrp rate
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no transmit front end for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
+    txfrontend fe = txfrontend_create(&plan, g, SC16_ISA_AUTO);
+    txfrontend_print(fe);
  
     // set up the metadta flags
     uhd::tx_metadata_t md;
@@ -150,10 +256,8 @@ int main (int argc, char **argv)
 
     // buffers
     unsigned int frame_len = 1280;
-    std::vector<std::complex<float> > buff(2*frame_len);
+    std::vector<std::complex<float> > buff(txfrontend_max_output(fe,frame_len));
     std::complex<float> frame[frame_len];
-    std::complex<float> buffer_interp[2*frame_len];
-    std::complex<float> buffer_resamp[3*frame_len];
     framegen64 framegen = framegen64_create(m,beta);
 
     // data buffers
@@ -167,8 +271,33 @@ int main (int argc, char **argv)
     printf("frame time : %12.8f us\n", frame_time * 1e6f);
     //unsigned long int delay = (unsigned long int)(frame_time*1e6f);
 
+    if (num_loop_frames > 0) {
+        // render frames once, then stream them repeatedly
+        struct txrender_s txrender;
+        txrender.framegen       = framegen;
+        txrender.fe             = fe;
+        txrender.frame          = frame;
+        txrender.frame_len      = frame_len;
+        txrender.packet_spacing = packet_spacing;
+        txrender.verbose        = verbose;
+
+        struct txsend_s txsend;
+        txsend.usrp  = usrp.get();
+        txsend.md    = md;
+        txsend.stats = stats;
+
+        txloop loop = txloop_create(num_loop_frames,
+                                    (packet_spacing+1)*txfrontend_max_output(fe,frame_len),
+                                    loop_lock);
+        txloop_render(loop, packet_render, (void*)&txrender);
+        txloop_run(loop, (unsigned long int)(usrp_tx_rate*num_seconds), usrp_send, (void*)&txsend);
+        txloop_print(loop);
+        txloop_destroy(loop);
+    }
+
+    // generate frames continuously (nothing left to send in loop mode)
     unsigned int i;
-    unsigned int num_blocks = (unsigned int)((tx_rate*num_seconds)/(frame_len));
+    unsigned int num_blocks = num_loop_frames > 0 ? 0 : (unsigned int)((tx_rate*num_seconds)/(frame_len));
     for (i=0; i<num_blocks; i++) {
         // generate the frame / transmit silence
         if ((i%(packet_spacing+1))==0) {
@@ -190,33 +319,19 @@ int main (int argc, char **argv)
                 frame[j] = 0.0f;
         }
 
-        // resample, apply gain, copy to vector (fill the buffer)
-        unsigned int nw;
-        unsigned int n = 0;
-        for (j=0; j<frame_len; j++) {
-            //
-            resamp_crcf_execute(resamp, frame[j], &buffer_resamp[n], &nw);
-            n += nw;
-        }
-        
-        // interpolate by 2
-        for (j=0; j<n; j++) {
-            //
-            resamp2_crcf_interp_execute(interp, buffer_resamp[j], &buffer_interp[2*j]);
-        }
-        
-        //printf(" n = %6u (frame_len : %6u)\n", n, frame_len);
-        buff.resize(2*n);
-        for (j=0; j<2*n; j++) {
-            buff[j] = g*buffer_interp[j];
-        }
+        // interpolate, resample and apply gain straight into the buffer
+        buff.resize(txfrontend_max_output(fe,frame_len));
+        unsigned int n = txfrontend_execute(fe, frame, frame_len, &buff.front());
+        buff.resize(n);
 
         //send the entire contents of the buffer
-        usrp->get_device()->send(
+        size_t num_tx_samps = usrp->get_device()->send(
             &buff.front(), buff.size(), md,
             uhd::io_type_t::COMPLEX_FLOAT32,
             uhd::device::SEND_MODE_FULL_BUFF
         );
+        iostats_tx(stats, num_tx_samps);
+        usrp_poll_async(usrp.get(), stats);
 
     }
  
@@ -230,11 +345,13 @@ int main (int argc, char **argv)
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
 
     // clean it up
     framegen64_destroy(framegen);
-    resamp_crcf_destroy(resamp);
-    resamp2_crcf_destroy(interp);
+    txfrontend_destroy(fe);
+    iostats_destroy(stats);
     return 0;
 }
 
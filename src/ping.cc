@@ -45,6 +45,7 @@
 #include <liquid/liquid.h>
 
 #include "iqpr.h"
+#include "profile.h"
 
 #define PING_NODE_MASTER    (0)
 #define PING_NODE_SLAVE     (1)
@@ -65,9 +66,181 @@ void usage() {
     printf("  p     :   [master] mod. depth: <1>,2,...8\n");
     printf("  c     :   [master] fec coding scheme (inner)\n");
     printf("  k     :   [master] fec coding scheme (outer)\n");
+    printf("  R     :   receive ring length [blocks] (streaming receiver), default: 0 (off)\n");
+    printf("  B     :   burst-mode transmitter (single burst per frame)\n");
+    printf("  T     :   [master] ack timeout [us], default: 100000\n");
+    printf("  L     :   run master and slave in-process over loopback, delay [samples]\n");
+    printf("  F     :   number of OFDM subcarriers, default: 40\n");
+    printf("  C     :   cyclic prefix length, default: 8\n");
+    printf("  I     :   receive native sc16 wire format (convert on host)\n");
     printf("  v/q   :   set verbose/quiet mode, default: verbose\n");
 }
 
+// slave node: acknowledge data packets until the last packet is received
+// (or until stopped when run on its own thread)
+struct ping_slave_s {
+    iqpr q;                             // slave node
+    unsigned int num_packets;           // number of packets
+    int verbose;                        // verbose output?
+    ofdmflexframegenprops_s fgprops;    // ack frame properties
+    volatile int running;               // run flag
+    unsigned long int num_bytes_received;
+};
+
+// emit 'O'/'U' output codes for usrp overflows/underflows recorded since
+// the previous call
+void ping_print_io_events(iqpr _q,
+                          struct iostats_counters_s * _prev,
+                          int _verbose)
+{
+    struct iostats_counters_s c;
+    iostats_get_counters(iqpr_get_iostats(_q), &c);
+    unsigned long int num_overflows  = c.num_events[IOSTATS_OVERFLOW]  - _prev->num_events[IOSTATS_OVERFLOW];
+    unsigned long int num_underflows = c.num_events[IOSTATS_UNDERFLOW] - _prev->num_events[IOSTATS_UNDERFLOW];
+    *_prev = c;
+
+    if (num_overflows == 0 && num_underflows == 0)
+        return;
+
+    if (_verbose) {
+        printf("  usrp : %lu overflow(s), %lu underflow(s)\n", num_overflows, num_underflows);
+    } else {
+        unsigned long int i;
+        for (i=0; i<num_overflows;  i++) fprintf(stdout,"O");
+        for (i=0; i<num_underflows; i++) fprintf(stdout,"U");
+    }
+    fflush(stdout);
+}
+
+void * ping_slave(void * _userdata)
+{
+    struct ping_slave_s * s = (struct ping_slave_s*) _userdata;
+    iqpr q = s->q;
+    int verbose = s->verbose;
+    ofdmflexframegenprops_s fgprops = s->fgprops;
+
+    unsigned int    timespec = 500;
+    unsigned char * rx_header = NULL;
+    int             rx_header_valid;
+    unsigned char * rx_payload = NULL;
+    unsigned int    rx_payload_len;
+    int             rx_payload_valid;
+    framesyncstats_s stats;
+    unsigned int rx_pid = 0;
+    unsigned char tx_header[14];
+    unsigned int n;
+
+    struct iostats_counters_s io_prev;
+    iostats_get_counters(iqpr_get_iostats(q), &io_prev);
+
+    int packet_found = 0;
+    do {
+        // wait for data packet
+        do {
+            // attempt to receive data packet
+            packet_found =
+            iqpr_rxpacket(q,
+                          timespec,
+                          &rx_header,
+                          &rx_header_valid,
+                          &rx_payload,
+                          &rx_payload_len,
+                          &rx_payload_valid,
+                          &stats);
+        } while (!packet_found && s->running);
+
+        if (!packet_found)
+            break;
+        
+        if (!rx_header_valid) {
+            if (verbose) printf("  header crc : FAIL\n");
+            else         fprintf(stdout,"x");
+            fflush(stdout);
+            continue;
+        } else if (rx_header[2] != PING_PACKET_DATA) {
+            // effectively ignore our own transmitted signal
+            //printf("  invalid packet type\n");
+            continue;
+        }
+        
+        rx_pid = (rx_header[0] << 8) | rx_header[1];
+        //if (rx_pid == 1) break;
+
+        if (!rx_payload_valid) {
+            if (verbose) printf("  payload crc : FAIL [%4u]\n", rx_pid);
+            else         fprintf(stdout,"X");
+            fflush(stdout);
+            continue;
+        }
+
+        s->num_bytes_received += rx_payload_len;
+
+        if (verbose) {
+            printf("  ping received %4u data bytes on packet [%4u] rssi : %12.4f dB\n",
+                    rx_payload_len,
+                    rx_pid,
+                    stats.rssi);
+        } else {
+            fprintf(stdout,".");
+            fflush(stdout);
+        }
+
+        // print received frame statistics
+        //if (verbose) framesyncstats_print(&stats);
+
+        // transmit acknowledgement
+        tx_header[0] = rx_header[0];
+        tx_header[1] = rx_header[1];
+        tx_header[2] = PING_PACKET_ACK;  // ACK code
+        for (n=3; n<14; n++)
+            tx_header[n] = rand() & 0xff;
+
+        unsigned char ack_payload[10];
+        for (n=0; n<10; n++)
+            ack_payload[n] = rand() & 0xff;
+        iqpr_txpacket(q, tx_header, ack_payload, 10, &fgprops);
+        ping_print_io_events(q, &io_prev, verbose);
+
+    } while (rx_pid != s->num_packets-1 && s->running);
+
+    return NULL;
+}
+
+// set rx/tx parameters and options
+void ping_configure(iqpr _q,
+                    float _frequency,
+                    float _symbolrate,
+                    unsigned int _rx_ring_len,
+                    int _tx_burst_mode,
+                    unsigned int _M,
+                    unsigned int _cp_len)
+{
+    // set subcarrier layout (default allocation)
+    iqpr_txconfig(_q, _M, _cp_len, NULL);
+    iqpr_rxconfig(_q, _M, _cp_len, NULL);
+
+    // set rx parameters
+    iqpr_set_rx_gain(_q, 40);
+    iqpr_set_rx_rate(_q, _symbolrate);
+    iqpr_set_rx_freq(_q, _frequency);
+
+    // set tx parameters
+    iqpr_set_tx_gain(_q, 40);
+    iqpr_set_tx_rate(_q, _symbolrate);
+    iqpr_set_tx_freq(_q, _frequency);
+
+    // other options
+    iqpr_unset_verbose(_q);
+    iqpr_set_rx_block_mode(_q);
+    if (_rx_ring_len > 0)
+        iqpr_set_rx_streaming(_q, _rx_ring_len);
+    if (_tx_burst_mode)
+        iqpr_set_tx_burst_mode(_q);
+
+    // unacknowledged packets are resent unchanged
+    iqpr_set_tx_cache(_q, 8, 1<<20);
+}
+
 int main (int argc, char **argv) {
     // options
     float frequency = 462e6f;
@@ -84,11 +257,18 @@ int main (int argc, char **argv) {
     fec_scheme fec1     = LIQUID_FEC_HAMMING74; // outer FEC scheme
     modulation_scheme mod_scheme = LIQUID_MODEM_QAM;    // modulation scheme
     unsigned int mod_depth = 2;                         // modulation depth
-    unsigned int ack_timeout=50000;
+    unsigned int ack_timeout=100000;            // ack timeout [us]
+    unsigned int rx_ring_len = 0;               // receive ring length (0: off)
+    int tx_burst_mode = 0;                      // burst-mode transmitter
+    int loopback = 0;                           // in-process loopback?
+    unsigned int loopback_delay = 0;            // loopback delay [samples]
+    unsigned int M = 40;                        // number of subcarriers
+    unsigned int cp_len = 8;                    // cyclic prefix length
+    int sc16 = 0;                               // receive sc16 wire format?
 
     //
     int d;
-    while ((d = getopt(argc,argv,"uhf:b:N:A:MSn:m:p:c:k:vq")) != EOF) {
+    while ((d = getopt(argc,argv,"uhf:b:N:A:MSn:m:p:c:k:R:BT:L:F:C:Ivq")) != EOF) {
         switch (d) {
         case 'u':
         case 'h': usage();                          return 0;
@@ -103,6 +283,13 @@ int main (int argc, char **argv) {
         case 'p': mod_depth = atoi(optarg);                     break;
         case 'c': fec0 = liquid_getopt_str2fec(optarg);         break;
         case 'k': fec1 = liquid_getopt_str2fec(optarg);         break;
+        case 'R': rx_ring_len = atoi(optarg);                   break;
+        case 'B': tx_burst_mode = 1;                            break;
+        case 'T': ack_timeout = atoi(optarg);                   break;
+        case 'L': loopback = 1; loopback_delay = atoi(optarg);  break;
+        case 'I': sc16 = 1;                                     break;
+        case 'F': M = atoi(optarg);                             break;
+        case 'C': cp_len = atoi(optarg);                        break;
         case 'v': verbose = 1;                                  break;
         case 'q': verbose = 0;                                  break;
         default:
@@ -111,35 +298,32 @@ int main (int argc, char **argv) {
         }
     }
 
-    // initialize iqpr structure
-    iqpr q = iqpr_create();
-
-    // set rx parameters
-    iqpr_set_rx_gain(q, 40);
-    iqpr_set_rx_rate(q, symbolrate);
-    iqpr_set_rx_freq(q, frequency);
-
-    // set tx parameters
-    iqpr_set_tx_gain(q, 40);
-    iqpr_set_tx_rate(q, symbolrate);
-    iqpr_set_tx_freq(q, frequency);
-
-    // other options
-    iqpr_unset_verbose(q);
+    // initialize iqpr structure; in loopback mode this node is the master
+    // and a slave node runs on its own thread
+    iqpr q = NULL;
+    iqpr q_slave = NULL;
+    if (loopback) {
+        iqpr_backend b0, b1;
+        iqpr_backend_create_loopback(loopback_delay, &b0, &b1);
+        q       = iqpr_create_backend(b0);
+        q_slave = iqpr_create_backend(b1);
+        node_type = PING_NODE_MASTER;
+        ping_configure(q_slave, frequency, symbolrate, rx_ring_len, tx_burst_mode, M, cp_len);
+    } else {
+        q = sc16 ? iqpr_create_backend(iqpr_backend_create_uhd_sc16()) : iqpr_create();
+    }
+    ping_configure(q, frequency, symbolrate, rx_ring_len, tx_burst_mode, M, cp_len);
 
     // sleep for a small time before starting tx/rx processes
-    usleep(1000000);
+    if (!loopback)
+        usleep(1000000);
 
     // 
     // receiver properties
     //
-    unsigned int    timespec = 500;
     unsigned char * rx_header = NULL;
     int             rx_header_valid;
-    unsigned char * rx_payload = NULL;
-    unsigned int    rx_payload_len;
     int             rx_payload_valid;
-    framesyncstats_s stats;
     unsigned int rx_pid = 0;
 
     //
@@ -165,12 +349,37 @@ int main (int argc, char **argv) {
     struct timeval timer0;
     struct timeval timer1;
     unsigned long int num_bytes_received=0;
+    unsigned int num_turnarounds = 0;   // number of acks timed
+    double turnaround_sum = 0.0;        // sum of turnaround times [s]
+    double turnaround_min = 0.0;        // minimum turnaround time [s]
+    double turnaround_max = 0.0;        // maximum turnaround time [s]
 
     unsigned int n;
     unsigned int num_attempts = 0;
 
+    // slave node (ack frames use no crc, qpsk)
+    struct ping_slave_s slave;
+    slave.q           = q_slave;
+    slave.num_packets = num_packets;
+    slave.verbose     = verbose;
+    slave.fgprops     = fgprops;
+    slave.fgprops.check      = LIQUID_CRC_NONE;
+    slave.fgprops.mod_scheme = LIQUID_MODEM_QPSK;
+    slave.fgprops.mod_bps    = 2;
+    slave.running     = 1;
+    slave.num_bytes_received = 0;
+    pthread_t slave_thread;
+
     printf("ping: starting node as %s\n", node_type == PING_NODE_MASTER ? "master" : "slave");
     iqpr_rx_start(q);
+    if (loopback) {
+        printf("ping: starting slave node on loopback (delay: %u samples)\n", loopback_delay);
+        iqpr_rx_start(q_slave);
+        if (pthread_create(&slave_thread, NULL, ping_slave, (void*)&slave) != 0) {
+            fprintf(stderr,"error: %s, could not create slave thread\n", argv[0]);
+            exit(1);
+        }
+    }
 
     // start timer
     gettimeofday(&timer0, NULL);
@@ -180,6 +389,8 @@ int main (int argc, char **argv) {
         // MASTER NODE
         //
         int ack_received;
+        struct iostats_counters_s io_prev;
+        iostats_get_counters(iqpr_get_iostats(q), &io_prev);
 
         for (tx_pid=0; tx_pid<num_packets; tx_pid++) {
 
@@ -207,26 +418,28 @@ int main (int argc, char **argv) {
                 }
 
                 //iqpr_txpacket(q,&tx_header,payload,payload_len,ms,bps,fec0,fec1);
+                double t_tx = iqpr_get_time(q);
                 iqpr_txpacket(q, tx_header, tx_payload, tx_payload_len, &fgprops);
 
                 //usleep(4000);
 
-                // wait for acknowledgement
-                unsigned int timer=0;
+                // wait for acknowledgement until deadline (usrp clock)
+                double t_deadline = t_tx + 1e-6*ack_timeout;
+                struct iqprframe_s * frame = NULL;
                 ack_received=0;
                 // TODO : estimate ack_timeout based on frame size...
-                while (!ack_received && timer < ack_timeout) {
+                while (!ack_received) {
+                    double t_remaining = t_deadline - iqpr_get_time(q);
+                    if (t_remaining <= 0.0)
+                        break;
+
                     int packet_received =
-                    iqpr_rxpacket(q, timespec,
-                                  &rx_header,
-                                  &rx_header_valid,
-                                  &rx_payload,
-                                  &rx_payload_len,
-                                  &rx_payload_valid,
-                                  &stats);
-                    timer += timespec;
+                    iqpr_rxframe_us(q, (unsigned int)(t_remaining*1e6), &frame);
 
                     if (packet_received) {
+                        rx_header        = frame->header;
+                        rx_header_valid  = frame->header_valid;
+                        rx_payload_valid = frame->payload_valid;
                         rx_pid = (rx_header[0] << 8) | rx_header[1];
 
                         if (!rx_header_valid) {
@@ -243,13 +456,22 @@ int main (int argc, char **argv) {
                             else         fprintf(stdout,"?");
                         } else {
                             ack_received = 1;
-                            if (verbose) ;
+
+                            // over-the-air turnaround time
+                            double turnaround = frame->timestamp - t_tx;
+                            if (num_turnarounds == 0 || turnaround < turnaround_min) turnaround_min = turnaround;
+                            if (num_turnarounds == 0 || turnaround > turnaround_max) turnaround_max = turnaround;
+                            turnaround_sum += turnaround;
+                            num_turnarounds++;
+                            if (verbose) printf("  ack received, turnaround %8.3f ms\n", turnaround*1e3);
                             else         fprintf(stdout,".");
                         }
                         fflush(stdout);
                     }
                 }
 
+                ping_print_io_events(q, &io_prev, verbose);
+
                 //ack_received = packet_received && rx_pid == tx_pid && rx_header[2] == PING_PACKET_ACK;
 
                 if (ack_received) {
@@ -274,75 +496,16 @@ int main (int argc, char **argv) {
         // 
         // SLAVE NODE
         //
-        fgprops.check        = LIQUID_CRC_NONE;
-        fgprops.mod_scheme   = LIQUID_MODEM_QPSK;
-        fgprops.mod_bps      = 2;
-
-        int packet_found = 0;
-        do {
-            // wait for data packet
-            do {
-                // attempt to receive data packet
-                packet_found =
-                iqpr_rxpacket(q,
-                              timespec,
-                              &rx_header,
-                              &rx_header_valid,
-                              &rx_payload,
-                              &rx_payload_len,
-                              &rx_payload_valid,
-                              &stats);
-            } while (!packet_found);
-            
-            if (!rx_header_valid) {
-                if (verbose) printf("  header crc : FAIL\n");
-                else         fprintf(stdout,"x");
-                fflush(stdout);
-                continue;
-            } else if (rx_header[2] != PING_PACKET_DATA) {
-                // effectively ignore our own transmitted signal
-                //printf("  invalid packet type\n");
-                continue;
-            }
-            
-            rx_pid = (rx_header[0] << 8) | rx_header[1];
-            //if (rx_pid == 1) break;
-
-            if (!rx_payload_valid) {
-                if (verbose) printf("  payload crc : FAIL [%4u]\n", rx_pid);
-                else         fprintf(stdout,"X");
-                fflush(stdout);
-                continue;
-            }
-
-            num_bytes_received += rx_payload_len;
-
-            if (verbose) {
-                printf("  ping received %4u data bytes on packet [%4u] rssi : %12.4f dB\n",
-                        rx_payload_len,
-                        rx_pid,
-                        stats.rssi);
-            } else {
-                fprintf(stdout,".");
-                fflush(stdout);
-            }
-
-            // print received frame statistics
-            //if (verbose) framesyncstats_print(&stats);
-
-            // transmit acknowledgement
-            tx_header[0] = rx_header[0];
-            tx_header[1] = rx_header[1];
-            tx_header[2] = PING_PACKET_ACK;  // ACK code
-            for (n=3; n<14; n++)
-                tx_header[n] = rand() & 0xff;
-
-            unsigned char ack_payload[10];
-            for (n=0; n<10; n++)
-                ack_payload[n] = rand() & 0xff;
-            iqpr_txpacket(q, tx_header, ack_payload, 10, &fgprops);
+        slave.q = q;
+        ping_slave((void*)&slave);
+        num_bytes_received = slave.num_bytes_received;
+    }
 
-        } while (rx_pid != num_packets-1);
+    // stop slave node (loopback)
+    if (loopback) {
+        slave.running = 0;
+        pthread_join(slave_thread, NULL);
+        iqpr_rx_stop(q_slave);
     }
 
     // stop timer
@@ -362,9 +525,19 @@ int main (int argc, char **argv) {
     printf("    execution time      : %12.8f s\n", runtime);
     printf("    data rate           : %12.8f kbps\n", data_rate*1e-3f);
     printf("    spectral efficiency : %12.8f b/s/Hz\n", spectral_efficiency);
+    if (num_turnarounds > 0) {
+        printf("    turnaround time     : %12.6f ms (min %.6f, max %.6f)\n",
+                turnaround_sum / num_turnarounds * 1e3,
+                turnaround_min * 1e3,
+                turnaround_max * 1e3);
+    }
+    iqpr_print(q);
+    PROFILE_PRINT();
 
     // destroy main data object
     iqpr_destroy(q);
+    if (q_slave != NULL)
+        iqpr_destroy(q_slave);
 
     return 0;
 }
@@ -27,6 +27,7 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
 #include "timer.h"
 
 void usage() {
@@ -125,6 +126,9 @@ int main (int argc, char **argv)
     usrp->set_rx_freq(frequency);
     usrp->set_rx_gain(uhd_rxgain);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(usrp->get_rx_rate());
+
     // create and initialize arbitrary resampling component
     resamp_crcf resamp = resamp_crcf_create(rx_resamp_rate,7,0.4f,60.0f,64);
     resamp_crcf_setrate(resamp, rx_resamp_rate);
@@ -172,7 +176,9 @@ int main (int argc, char **argv)
         //handle the error codes
         switch(md.error_code){
         case uhd::rx_metadata_t::ERROR_CODE_NONE:
+            break;
         case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+            iostats_event(stats, IOSTATS_OVERFLOW);
             break;
 
         default:
@@ -185,6 +191,7 @@ int main (int argc, char **argv)
             std::cerr << "Metadata missing time spec, exit test..." << std::endl;
             return 1;
         }
+        iostats_rx(stats, num_rx_samps, 1, md.time_spec.get_real_secs());
 
         // copy vector "buff" to array of complex float, run
         // resampler, and push through AGC object
@@ -232,8 +239,10 @@ int main (int argc, char **argv)
     usrp->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
     printf("\n");
     printf("usrp data transfer complete\n");
+    iostats_print(stats);
 
     // clean object allocation
+    iostats_destroy(stats);
     resamp_crcf_destroy(resamp);
     agc_crcf_destroy(agc_rx);
     timer_destroy(t0);
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//
+// sc16_bench.cc
+//
+// benchmark the native sc16 receive path against the float32 path:
+//
+//  float32     :   int16 to float conversion as done by uhd for the
+//                  COMPLEX_FLOAT32 io type, followed by the rxfrontend
+//  sc16        :   rxfrontend fed sc16 samples directly (conversion,
+//                  scaling and first half-band stage fused)
+//
+// and the fused sc16decim kernel for every instruction set extension
+// supported by this cpu against the portable version.
+//
+// The capture file holds raw interleaved complex int16 samples at the
+// usrp receive rate; if none is given, a synthetic capture is generated.
+//
+
+#include <iostream>
+#include <complex>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <liquid/liquid.h>
+
+#include "rateplan.h"
+#include "rxfrontend.h"
+#include "sc16.h"
+#include "timer.h"
+
+static unsigned long int num_baseband_samples;
+
+static void sink(std::complex<float> * _x,
+                 unsigned int _n,
+                 void * _userdata)
+{
+    num_baseband_samples += _n;
+}
+
+void usage() {
+    printf("sc16_bench -- benchmark sc16 receive path\n");
+    printf("  u,h   :   usage/help\n");
+    printf("  i     :   input capture (raw complex int16), default: synthetic\n");
+    printf("  b     :   bandwidth [Hz], default: 100 kHz\n");
+    printf("  B     :   usrp block length [samples], default: 1024\n");
+    printf("  N     :   number of samples in synthetic capture, default: 4000000\n");
+    printf("  n     :   number of trials, default: 4\n");
+}
+
+// generate synthetic capture: tone plus noise at about -12 dBFS
+short * generate_capture(unsigned int _num_samples)
+{
+    short * x = (short*) malloc(2*_num_samples*sizeof(short));
+    unsigned int i;
+    for (i=0; i<_num_samples; i++) {
+        std::complex<float> v = 0.2f*std::complex<float>(cosf(0.01f*i), sinf(0.01f*i)) +
+                                0.02f*std::complex<float>(randnf(), randnf());
+        x[2*i+0] = (short) lrintf(32767.0f*v.real());
+        x[2*i+1] = (short) lrintf(32767.0f*v.imag());
+    }
+    return x;
+}
+
+int main (int argc, char **argv)
+{
+    // options
+    char filename[256] = "";
+    float bandwidth = 100e3f;
+    unsigned int block_len = 1024;
+    unsigned int num_samples = 4000000;
+    unsigned int num_trials = 4;
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhi:b:B:N:n:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                        return 0;
+        case 'i':   strncpy(filename,optarg,255);   break;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 'B':   block_len = atoi(optarg);       break;
+        case 'N':   num_samples = atoi(optarg);     break;
+        case 'n':   num_trials = atoi(optarg);      break;
+        default:
+            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    if (block_len < 2) {
+        fprintf(stderr,"error: %s, block length must be at least 2\n", argv[0]);
+        exit(1);
+    }
+
+    // load capture
+    short * x = NULL;
+    if (strlen(filename) > 0) {
+        FILE * fid = fopen(filename,"rb");
+        if (!fid) {
+            fprintf(stderr,"error: %s, could not open '%s' for reading\n", argv[0], filename);
+            exit(1);
+        }
+        fseek(fid, 0, SEEK_END);
+        num_samples = ftell(fid) / (2*sizeof(short));
+        fseek(fid, 0, SEEK_SET);
+        x = (short*) malloc(2*num_samples*sizeof(short));
+        num_samples = fread(x, 2*sizeof(short), num_samples, fid);
+        fclose(fid);
+        printf("capture     :   %s (%u samples)\n", filename, num_samples);
+    } else {
+        x = generate_capture(num_samples);
+        printf("capture     :   synthetic (%u samples)\n", num_samples);
+    }
+
+    // design receive chain as in the rx apps
+    unsigned long int ADC_RATE = 64e6;
+    struct rateplan_s plan;
+    if (rateplan_design(&plan, RATEPLAN_RX, ADC_RATE, 2.0*bandwidth, 60.0f, RATEPLAN_CHAIN_HALFBAND) != 0) {
+        fprintf(stderr,"error: %s, no rate plan for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_print(&plan);
+    rxfrontend fe = rxfrontend_create(&plan, 1024, sink, NULL);
+
+    // float32 buffer for one usrp block
+    std::complex<float> * buffer = (std::complex<float>*) malloc(block_len*sizeof(std::complex<float>));
+
+    timer t0 = timer_create();
+    unsigned int trial;
+    unsigned int i, j;
+    float runtime_float = 0.0f;
+    float runtime_sc16  = 0.0f;
+    unsigned long int out_float = 0;
+    unsigned long int out_sc16  = 0;
+    for (trial=0; trial<num_trials; trial++) {
+        //
+        // float32 path: convert each block, then run front end
+        //
+        rxfrontend_reset(fe);
+        num_baseband_samples = 0;
+        timer_tic(t0);
+        for (i=0; i<num_samples; i+=block_len) {
+            unsigned int n = (i + block_len > num_samples) ? num_samples - i : block_len;
+            for (j=0; j<n; j++)
+                buffer[j] = std::complex<float>(x[2*(i+j)+0] * SC16_GAIN_UNITY,
+                                                x[2*(i+j)+1] * SC16_GAIN_UNITY);
+            rxfrontend_execute(fe, buffer, n);
+        }
+        rxfrontend_flush(fe);
+        runtime_float += timer_toc(t0);
+        out_float += num_baseband_samples;
+
+        //
+        // sc16 path
+        //
+        rxfrontend_reset(fe);
+        num_baseband_samples = 0;
+        timer_tic(t0);
+        for (i=0; i<num_samples; i+=block_len) {
+            unsigned int n = (i + block_len > num_samples) ? num_samples - i : block_len;
+            rxfrontend_execute_sc16(fe, &x[2*i], n);
+        }
+        rxfrontend_flush(fe);
+        runtime_sc16 += timer_toc(t0);
+        out_sc16 += num_baseband_samples;
+    }
+
+    // print results
+    float total_samples = (float)num_samples * (float)num_trials;
+    printf("block length        : %u samples\n", block_len);
+    printf("float32 path        : %12.4f Msamples/s (%lu baseband samples)\n",
+            total_samples / runtime_float * 1e-6f, out_float / num_trials);
+    printf("sc16 path           : %12.4f Msamples/s (%lu baseband samples)\n",
+            total_samples / runtime_sc16 * 1e-6f, out_sc16 / num_trials);
+    printf("speedup             : %12.4f\n", runtime_float / runtime_sc16);
+
+    //
+    // fused kernel, each instruction set extension against generic
+    //
+    unsigned int m = plan.num_halfband > 0 ? plan.halfband_m[0] : 7;
+    unsigned int num_decim = (num_samples + 1) / 2;
+    std::complex<float> * y_ref = (std::complex<float>*) malloc(num_decim*sizeof(std::complex<float>));
+    std::complex<float> * y     = (std::complex<float>*) malloc(num_decim*sizeof(std::complex<float>));
+    float runtime_ref = 0.0f;
+    int isa;
+    for (isa=SC16_ISA_GENERIC; isa<=SC16_ISA_NEON; isa++) {
+        if (!sc16_isa_supported(isa))
+            continue;
+
+        sc16decim q = sc16decim_create(m, plan.As, SC16_GAIN_UNITY, isa);
+        float runtime = 0.0f;
+        unsigned int k = 0;
+        for (trial=0; trial<num_trials; trial++) {
+            sc16decim_reset(q);
+            k = 0;
+            timer_tic(t0);
+            for (i=0; i<num_samples; i+=block_len) {
+                unsigned int n = (i + block_len > num_samples) ? num_samples - i : block_len;
+                k += sc16decim_execute(q, &x[2*i], n, &y[k]);
+            }
+            runtime += timer_toc(t0);
+        }
+        sc16decim_destroy(q);
+
+        // compare against generic output
+        float max_error = 0.0f;
+        if (isa == SC16_ISA_GENERIC) {
+            memmove(y_ref, y, k*sizeof(std::complex<float>));
+            runtime_ref = runtime;
+        } else {
+            for (j=0; j<k; j++) {
+                float e = std::abs(y[j] - y_ref[j]);
+                max_error = e > max_error ? e : max_error;
+            }
+        }
+        printf("sc16decim %-8s  : %12.4f Msamples/s (speedup %6.2f, max. error %12.4e)\n",
+                sc16_isa_str(isa), total_samples / runtime * 1e-6f,
+                runtime_ref / runtime, max_error);
+    }
+
+    // destroy objects
+    rxfrontend_destroy(fe);
+    timer_destroy(t0);
+    free(buffer);
+    free(y_ref);
+    free(y);
+    free(x);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txfrontend_bench.cc
+//
+// benchmark the fused transmit front end against the sample-by-sample
+// chain the tx apps used to run:
+//
+//  liquid      :   resamp2_crcf_interp_execute() per sample, then
+//                  resamp_crcf_execute() per interpolated sample, then
+//                  a gain loop; once with the filters the apps used
+//                  (half-band m=7, resampler m=7) and once with the
+//                  filters of the rate plan
+//  txfrontend  :   the same rate plan, for every instruction set
+//                  extension supported by this cpu, each compared
+//                  against the portable version
+//
+// Input is a block-wise stream of 2x over-sampled random QPSK, as from
+// a frame generator writing one symbol at a time.
+//
+
+#include <iostream>
+#include <complex>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <liquid/liquid.h>
+
+#include "rateplan.h"
+#include "sc16.h"
+#include "timer.h"
+#include "txfrontend.h"
+
+void usage() {
+    printf("txfrontend_bench -- benchmark fused transmit front end\n");
+    printf("  u,h   :   usage/help\n");
+    printf("  b     :   bandwidth [Hz], default: 100 kHz\n");
+    printf("  B     :   input block length [samples], default: 80\n");
+    printf("  N     :   number of input samples, default: 1000000\n");
+    printf("  n     :   number of trials, default: 4\n");
+}
+
+// run sample-by-sample liquid chain over input, returning number of
+// output samples
+unsigned int liquid_chain(resamp2_crcf _interp,
+                          resamp_crcf _resamp,
+                          float _g,
+                          std::complex<float> * _x,
+                          unsigned int _num_samples,
+                          unsigned int _block_len,
+                          std::complex<float> * _y)
+{
+    std::complex<float> buffer_interp[2*_block_len];
+    unsigned int num_written = 0;
+    unsigned int i, j;
+    for (i=0; i<_num_samples; i+=_block_len) {
+        unsigned int n = (i + _block_len > _num_samples) ? _num_samples - i : _block_len;
+
+        // interpolate by 2
+        for (j=0; j<n; j++)
+            resamp2_crcf_interp_execute(_interp, _x[i+j], &buffer_interp[2*j]);
+
+        // resample
+        unsigned int nw;
+        unsigned int k = num_written;
+        for (j=0; j<2*n; j++) {
+            resamp_crcf_execute(_resamp, buffer_interp[j], &_y[num_written], &nw);
+            num_written += nw;
+        }
+
+        // apply gain
+        for (j=k; j<num_written; j++)
+            _y[j] *= _g;
+    }
+    return num_written;
+}
+
+int main (int argc, char **argv)
+{
+    // options
+    float bandwidth = 100e3f;
+    unsigned int block_len = 80;
+    unsigned int num_samples = 1000000;
+    unsigned int num_trials = 4;
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhb:B:N:n:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                        return 0;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 'B':   block_len = atoi(optarg);       break;
+        case 'N':   num_samples = atoi(optarg);     break;
+        case 'n':   num_trials = atoi(optarg);      break;
+        default:
+            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    if (block_len == 0) {
+        fprintf(stderr,"error: %s, block length must be greater than zero\n", argv[0]);
+        exit(1);
+    }
+
+    // usrp interpolation as chosen by the tx apps
+    unsigned long int DAC_RATE = 64e6;
+    double tx_rate = 4.0*bandwidth;
+    unsigned int interp_rate = (unsigned int)(DAC_RATE / tx_rate);
+    interp_rate = (interp_rate >> 2) << 2;
+    interp_rate += 4;
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no rate plan for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_print(&plan);
+
+    // 2x over-sampled random QPSK
+    std::complex<float> * x = (std::complex<float>*) malloc(num_samples*sizeof(std::complex<float>));
+    unsigned int i, j;
+    for (i=0; i<num_samples; i++) {
+        if ((i % 2) == 0) {
+            x[i] = std::complex<float>(rand() & 1 ? M_SQRT1_2 : -M_SQRT1_2,
+                                       rand() & 1 ? M_SQRT1_2 : -M_SQRT1_2);
+        } else {
+            x[i] = x[i-1];
+        }
+    }
+
+    float g = 0.5f;
+    unsigned int max_output = (unsigned int) ceil(2.0*num_samples*plan.resamp_rate) + 16;
+    std::complex<float> * y_ref = (std::complex<float>*) malloc(max_output*sizeof(std::complex<float>));
+    std::complex<float> * y     = (std::complex<float>*) malloc(max_output*sizeof(std::complex<float>));
+    float total_samples = (float)num_samples * (float)num_trials;
+    timer t0 = timer_create();
+    unsigned int trial;
+    unsigned int k = 0;
+
+    printf("input block length  : %u samples\n", block_len);
+
+    //
+    // sample-by-sample liquid chain: filters the apps used, and the plan's
+    //
+    float runtime_app = 0.0f;
+    float runtime_liquid = 0.0f;
+    for (i=0; i<2; i++) {
+        resamp2_crcf interp = i==0 ? resamp2_crcf_create(7, 0.0f, 40.0f) :
+                                     resamp2_crcf_create(plan.halfband_m[0], 0.0f, plan.As);
+        resamp_crcf resamp = i==0 ? resamp_crcf_create(plan.resamp_rate, 7, 0.4f, 60.0f, 64) :
+                                    resamp_crcf_create(plan.resamp_rate, plan.resamp_m, plan.resamp_fc, plan.As, 64);
+        float runtime = 0.0f;
+        for (trial=0; trial<num_trials; trial++) {
+            resamp2_crcf_clear(interp);
+            resamp_crcf_reset(resamp);
+            timer_tic(t0);
+            k = liquid_chain(interp, resamp, g, x, num_samples, block_len, y);
+            runtime += timer_toc(t0);
+        }
+        resamp2_crcf_destroy(interp);
+        resamp_crcf_destroy(resamp);
+
+        if (i == 0) runtime_app    = runtime;
+        else        runtime_liquid = runtime;
+        printf("liquid %-4s filters   : %12.4f Msamples/s (%u output samples)\n",
+                i==0 ? "app" : "plan",
+                total_samples / runtime * 1e-6f, k);
+    }
+
+    //
+    // fused front end, each instruction set extension against generic
+    //
+    int isa;
+    for (isa=SC16_ISA_GENERIC; isa<=SC16_ISA_NEON; isa++) {
+        if (!sc16_isa_supported(isa))
+            continue;
+
+        txfrontend q = txfrontend_create(&plan, g, isa);
+        float runtime = 0.0f;
+        for (trial=0; trial<num_trials; trial++) {
+            txfrontend_reset(q);
+            k = 0;
+            timer_tic(t0);
+            for (i=0; i<num_samples; i+=block_len) {
+                unsigned int n = (i + block_len > num_samples) ? num_samples - i : block_len;
+                k += txfrontend_execute(q, &x[i], n, &y[k]);
+            }
+            runtime += timer_toc(t0);
+        }
+        txfrontend_destroy(q);
+
+        // compare against generic output
+        float max_error = 0.0f;
+        if (isa == SC16_ISA_GENERIC) {
+            memmove(y_ref, y, k*sizeof(std::complex<float>));
+        } else {
+            for (j=0; j<k; j++) {
+                float e = std::abs(y[j] - y_ref[j]);
+                max_error = e > max_error ? e : max_error;
+            }
+        }
+        printf("txfrontend %-11s: %12.4f Msamples/s (speedup %6.2f / %6.2f, max. error %12.4e)\n",
+                sc16_isa_str(isa), total_samples / runtime * 1e-6f,
+                runtime_app / runtime, runtime_liquid / runtime, max_error);
+    }
+    printf("(speedup against liquid chain with app filters / plan filters)\n");
+
+    // destroy objects
+    timer_destroy(t0);
+    free(x);
+    free(y_ref);
+    free(y);
+
+    return 0;
+}
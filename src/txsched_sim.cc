@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2011 Joseph Gaeddert
+ * Copyright (c) 2011 Virginia Polytechnic Institute & State University
+ *
+ * This file is part of liquid.
+ *
+ * liquid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * liquid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with liquid.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// txsched_sim.cc
+//
+// check TDMA slot accuracy of the timed burst scheduler without
+// hardware: one thread per node, each owning one slot of the TDMA frame,
+// schedules bursts of random QPSK against the simulated clock (with
+// optional random processing delay before each hand-off).  Every burst
+// handed to the (simulated) device is recorded and afterwards checked
+// against its slot, whose boundaries are computed here from the epoch
+// and slot length rather than taken from the scheduler: start on the
+// sample grid at the slot boundary, end before the guard time, and no
+// overlap with another node's burst.  Every node must send a burst in
+// each frame; late, missed or oversize bursts fail the run.
+//
+
+#include <iostream>
+#include <complex>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "rateplan.h"
+#include "txsched.h"
+
+void usage() {
+    printf("txsched_sim -- simulate TDMA burst scheduling\n");
+    printf("  u,h   :   usage/help\n");
+    printf("  b     :   bandwidth [Hz], default: 100 kHz\n");
+    printf("  K     :   slots per TDMA frame (one node each), default: 4\n");
+    printf("  T     :   slot length [ms], default: 10\n");
+    printf("  g     :   guard time [ms], default: 0.5\n");
+    printf("  L     :   burst length [baseband samples], default: 800\n");
+    printf("  N     :   number of TDMA frames, default: 50\n");
+    printf("  l     :   lead time [ms], default: 2\n");
+    printf("  j     :   maximum processing delay before hand-off [ms], default: 0\n");
+}
+
+// burst handed to device
+struct burst_s {
+    double time;                // time of first sample [s]
+    unsigned int n;             // number of usrp samples
+    unsigned int node;          // node index
+};
+
+// node
+struct node_s {
+    pthread_t thread;           // node thread
+    unsigned int index;         // node index (and slot within frame)
+    txsched q;                  // burst scheduler
+    struct burst_s * bursts;    // bursts sent [size: num_frames x 1]
+    unsigned int num_bursts;    // number of bursts sent
+    unsigned int burst_len;     // burst length [baseband samples]
+    unsigned int num_frames;    // number of TDMA frames
+    unsigned int jitter;        // maximum processing delay [us]
+    unsigned int seed;          // random seed
+};
+
+// txsched send callback: record burst
+unsigned int sim_send(std::complex<float> * _x,
+                      unsigned int _n,
+                      double _time,
+                      void * _userdata)
+{
+    struct node_s * node = (struct node_s*) _userdata;
+    struct burst_s * b = &node->bursts[node->num_bursts++];
+    b->time = _time;
+    b->n    = _n;
+    b->node = node->index;
+    return _n;
+}
+
+// node thread: one burst in own slot of each TDMA frame
+void * node_process(void * _userdata)
+{
+    struct node_s * node = (struct node_s*) _userdata;
+    std::complex<float> x[node->burst_len];
+    unsigned int i, j;
+    for (i=0; i<node->num_frames; i++) {
+        unsigned long int slot = txsched_next_slot(node->q, node->index);
+
+        // 2x over-sampled random QPSK
+        for (j=0; j<node->burst_len; j++) {
+            if ((j % 2) == 0) {
+                x[j] = std::complex<float>(rand_r(&node->seed) & 1 ? M_SQRT1_2 : -M_SQRT1_2,
+                                           rand_r(&node->seed) & 1 ? M_SQRT1_2 : -M_SQRT1_2);
+            } else {
+                x[j] = x[j-1];
+            }
+        }
+
+        // processing delay
+        if (node->jitter > 0)
+            usleep(rand_r(&node->seed) % node->jitter);
+
+        txsched_send_slot(node->q, slot, x, node->burst_len);
+    }
+    return NULL;
+}
+
+// sort bursts by time
+int burst_compare(const void * _a,
+                  const void * _b)
+{
+    double ta = ((const struct burst_s*)_a)->time;
+    double tb = ((const struct burst_s*)_b)->time;
+    return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+int main (int argc, char **argv)
+{
+    // options
+    float bandwidth = 100e3f;
+    unsigned int num_slots = 4;
+    float slot_len = 10.0f;
+    float guard = 0.5f;
+    unsigned int burst_len = 800;
+    unsigned int num_frames = 50;
+    float lead = 2.0f;
+    float jitter = 0.0f;
+
+    //
+    int d;
+    while ((d = getopt(argc,argv,"uhb:K:T:g:L:N:l:j:")) != EOF) {
+        switch (d) {
+        case 'u':
+        case 'h':   usage();                        return 0;
+        case 'b':   bandwidth = atof(optarg);       break;
+        case 'K':   num_slots = atoi(optarg);       break;
+        case 'T':   slot_len = atof(optarg);        break;
+        case 'g':   guard = atof(optarg);           break;
+        case 'L':   burst_len = atoi(optarg);       break;
+        case 'N':   num_frames = atoi(optarg);      break;
+        case 'l':   lead = atof(optarg);            break;
+        case 'j':   jitter = atof(optarg);          break;
+        default:
+            fprintf(stderr,"error: %s, unsupported option\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    if (num_slots == 0 || burst_len == 0 || num_frames == 0) {
+        fprintf(stderr,"error: %s, slots, burst length and frames must be greater than zero\n", argv[0]);
+        exit(1);
+    }
+
+    // usrp interpolation as chosen by the tx apps
+    unsigned long int DAC_RATE = 64e6;
+    double tx_rate = 4.0*bandwidth;
+    unsigned int interp_rate = (unsigned int)(DAC_RATE / tx_rate);
+    interp_rate = (interp_rate >> 2) << 2;
+    interp_rate += 4;
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no rate plan for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_print(&plan);
+
+    printf("burst duration      : %.3f ms (slot %.3f ms, guard %.3f ms)\n",
+            1e3*burst_len/plan.baseband_rate, slot_len, guard);
+
+    // nodes share the simulated clock; start slot grid shortly from now
+    struct node_s node[num_slots];
+    unsigned int i, j;
+    for (i=0; i<num_slots; i++) {
+        node[i].index      = i;
+        node[i].q          = txsched_create(&plan, 1.0f, burst_len, sim_send, (void*)&node[i]);
+        node[i].bursts     = (struct burst_s*) malloc(num_frames*sizeof(struct burst_s));
+        node[i].num_bursts = 0;
+        node[i].burst_len  = burst_len;
+        node[i].num_frames = num_frames;
+        node[i].jitter     = (unsigned int)(1e3f*jitter);
+        node[i].seed       = i + 1;
+    }
+    double epoch = txsched_get_time(node[0].q) + 0.1;
+    for (i=0; i<num_slots; i++) {
+        txsched_set_slots(node[i].q, epoch, 1e-3*slot_len, num_slots, 1e-3*guard);
+        txsched_set_lead(node[i].q, 1e-3*lead, 1e-3*slot_len*num_slots);
+    }
+
+    for (i=0; i<num_slots; i++) {
+        if (pthread_create(&node[i].thread, NULL, node_process, (void*)&node[i]) != 0) {
+            fprintf(stderr,"error: %s, could not create node thread\n", argv[0]);
+            exit(1);
+        }
+    }
+    for (i=0; i<num_slots; i++)
+        pthread_join(node[i].thread, NULL);
+
+    txsched_print(node[0].q);
+
+    // check every burst against its slot, from the slot grid itself
+    double slot_sec  = 1e-3*slot_len;
+    double guard_sec = 1e-3*guard;
+    unsigned int num_bursts = 0;
+    for (i=0; i<num_slots; i++)
+        num_bursts += node[i].num_bursts;
+    struct burst_s * bursts = (struct burst_s*) malloc((num_bursts+1)*sizeof(struct burst_s));
+    unsigned int num_misaligned = 0;
+    unsigned int num_overrun = 0;
+    unsigned long int num_failed = 0;
+    unsigned int k = 0;
+    printf("  node       sent       late     missed   oversize\n");
+    for (i=0; i<num_slots; i++) {
+        printf("  %4u  %9lu  %9lu  %9lu  %9lu\n", i,
+                txsched_get_num_results(node[i].q, TXSCHED_SENT),
+                txsched_get_num_results(node[i].q, TXSCHED_LATE),
+                txsched_get_num_results(node[i].q, TXSCHED_MISSED),
+                txsched_get_num_results(node[i].q, TXSCHED_OVERSIZE));
+        num_failed += txsched_get_num_results(node[i].q, TXSCHED_LATE) +
+                      txsched_get_num_results(node[i].q, TXSCHED_MISSED) +
+                      txsched_get_num_results(node[i].q, TXSCHED_OVERSIZE);
+        for (j=0; j<node[i].num_bursts; j++) {
+            struct burst_s * b = &node[i].bursts[j];
+            unsigned long int slot = (unsigned long int) floor((b->time - epoch) / slot_sec + 0.5);
+            double t0 = epoch + (double)slot * slot_sec;
+            double t1 = epoch + (double)(slot+1) * slot_sec - guard_sec;
+            double grid = (b->time - epoch) * plan.usrp_rate;
+            if ((slot % num_slots) != i ||
+                fabs(b->time - t0) > 0.5/plan.usrp_rate ||
+                fabs(grid - floor(grid + 0.5)) > 1e-3)
+            {
+                num_misaligned++;
+            }
+            if (b->time + b->n / plan.usrp_rate > t1 + 0.5/plan.usrp_rate)
+                num_overrun++;
+            bursts[k++] = *b;
+        }
+    }
+
+    // overlap between consecutive bursts on air
+    qsort(bursts, num_bursts, sizeof(struct burst_s), burst_compare);
+    unsigned int num_collisions = 0;
+    for (i=1; i<num_bursts; i++) {
+        if (bursts[i-1].time + bursts[i-1].n / plan.usrp_rate > bursts[i].time)
+            num_collisions++;
+    }
+    unsigned int num_expected = num_slots * num_frames;
+    printf("bursts on air       : %u / %u\n", num_bursts, num_expected);
+    printf("late/missed/oversize: %lu\n", num_failed);
+    printf("misaligned          : %u\n", num_misaligned);
+    printf("into guard time     : %u\n", num_overrun);
+    printf("collisions          : %u\n", num_collisions);
+
+    // destroy objects
+    for (i=0; i<num_slots; i++) {
+        txsched_destroy(node[i].q);
+        free(node[i].bursts);
+    }
+    free(bursts);
+
+    int fail = num_bursts != num_expected || num_failed > 0 ||
+               (num_misaligned + num_overrun + num_collisions) > 0;
+    return fail ? 1 : 0;
+}
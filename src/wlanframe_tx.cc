@@ -30,6 +30,31 @@
 
 #include <uhd/usrp/single_usrp.hpp>
 
+#include "iostats.h"
+#include "rateplan.h"
+#include "sc16.h"
+#include "txfrontend.h"
+
+// poll usrp for asynchronous transmit events without blocking, counting
+// underflows and late packets
+static void usrp_poll_async(uhd::usrp::single_usrp * _usrp,
+                            iostats _stats)
+{
+    uhd::async_metadata_t md;
+    while (_usrp->get_device()->recv_async_msg(md, 0.0)) {
+        switch (md.event_code) {
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+        case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+            iostats_event(_stats, IOSTATS_UNDERFLOW);
+            break;
+        case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+            iostats_event(_stats, IOSTATS_LATE);
+            break;
+        default:;
+        }
+    }
+}
+
 void usage() {
     printf("ofdmflexframe_tx [OPTION]\n");
     printf("transmit OFDM packets\n");
@@ -117,6 +142,9 @@ int main (int argc, char **argv)
     //dev_addr["addr1"] = "192.168.10.3";
     uhd::usrp::single_usrp::sptr usrp = uhd::usrp::single_usrp::make(dev_addr);
 
+    // usrp i/o accounting
+    iostats stats = iostats_create(0.0);
+
     // set properties
     double tx_rate = 4.0*bandwidth;
 
@@ -160,16 +188,20 @@ int main (int argc, char **argv)
     //usrp->set_tx_bandwidth(2.0f*tx_rate);
 
 
-    // add arbitrary resampling component
-    resamp_crcf resamp = resamp_crcf_create(tx_resamp_rate,7,0.4f,60.0f,64);
-    resamp_crcf_setrate(resamp, tx_resamp_rate);
-
-    // half-band resampler
-    resamp2_crcf interp = resamp2_crcf_create(7,0.0f,40.0f);
-
     // transmitter gain (linear)
     float g = powf(10.0f, txgain_dB/20.0f);
 
+    // transmit front end: half-band interpolator, arbitrary resampler
+    // and gain, at the usrp rate actually set
+    struct rateplan_s plan;
+    if (rateplan_design_fixed(&plan, RATEPLAN_TX, DAC_RATE, interp_rate, 0.5*tx_rate, 1, 60.0f) != 0) {
+        fprintf(stderr,"error: %s, no transmit front end for bandwidth %f\n", argv[0], bandwidth);
+        exit(1);
+    }
+    rateplan_set_usrp_rate(&plan, usrp_tx_rate);
+    txfrontend fe = txfrontend_create(&plan, g, SC16_ISA_AUTO);
+    txfrontend_print(fe);
+
     // data arrays/objects
     struct wlan_txvector_s txvector;
     txvector.LENGTH      = payload_len;
@@ -184,8 +216,7 @@ int main (int argc, char **argv)
 
     // arrays
     std::complex<float> buffer[80];    // output time series
-    std::complex<float> buffer_interp[2*80];
-    std::complex<float> buffer_resamp[3*80];
+    std::complex<float> buffer_resamp[txfrontend_max_output(fe,80)];
 
     // set up the metadta flags
     std::vector<std::complex<float> > buff(256);
@@ -230,32 +261,25 @@ int main (int argc, char **argv)
             last_symbol = wlanframegen_writesymbol(fg, buffer);
 #endif
 
-            // interpolate by 2
-            for (j=0; j<80; j++)
-                resamp2_crcf_interp_execute(interp, buffer[j], &buffer_interp[2*j]);
-            
-            // resample
-            unsigned int nw;
-            unsigned int n=0;
-            for (j=0; j<2*80; j++) {
-                resamp_crcf_execute(resamp, buffer_interp[j], &buffer_resamp[n], &nw);
-                n += nw;
-            }
+            // interpolate, resample and apply gain
+            unsigned int n = txfrontend_execute(fe, buffer, 80, buffer_resamp);
 
             // push samples into buffer
             for (j=0; j<n; j++) {
-                buff[tx_buffer_samples++] = g*buffer_resamp[j];
+                buff[tx_buffer_samples++] = buffer_resamp[j];
 
                 if (tx_buffer_samples==256) {
                     // reset counter
                     tx_buffer_samples=0;
 
                     //send the entire contents of the buffer
-                    usrp->get_device()->send(
+                    size_t num_tx_samps = usrp->get_device()->send(
                         &buff.front(), buff.size(), md,
                         uhd::io_type_t::COMPLEX_FLOAT32,
                         uhd::device::SEND_MODE_FULL_BUFF
                     );
+                    iostats_tx(stats, num_tx_samps);
+                    usrp_poll_async(usrp.get(), stats);
                 }
             }
         }
@@ -282,12 +306,14 @@ int main (int argc, char **argv)
 
     //finished
     printf("usrp data transfer complete\n");
+    usrp_poll_async(usrp.get(), stats);
+    iostats_print(stats);
 
     // clean it up
     wlanframegen_destroy(fg);
-    resamp2_crcf_destroy(interp);
-    resamp_crcf_destroy(resamp);
+    txfrontend_destroy(fe);
 
+    iostats_destroy(stats);
     return 0;
 }
 